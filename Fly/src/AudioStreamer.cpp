@@ -8,6 +8,8 @@
 #include <stdexcept>
 #include <AL/alext.h>
 
+#include "dsp/FastMath.h"
+
 AudioStreamer::AudioStreamer()
 {
 	LOG_DEBUG("Initializing AudioStreamer");
@@ -40,11 +42,21 @@ AudioStreamer::AudioStreamer(AudioStreamer&& other) noexcept
         m_isRunning(other.m_isRunning.load()),
         m_looping(other.m_looping.load()),
         m_volume(other.m_volume.load()),
-        m_samplesProcessed(other.m_samplesProcessed.load()),
+        m_normalizationGainDb(other.m_normalizationGainDb.load()),
+        m_normalizationGain(other.m_normalizationGain.load()),
+        m_streamFrame(other.m_streamFrame.load()),
+        m_outputFrame(other.m_outputFrame.load()),
+        m_queuedBuffers(std::move(other.m_queuedBuffers)),
         m_streamingThread(std::move(other.m_streamingThread)),
         m_audioQueue(std::move(other.m_audioQueue)),
         m_processingBuffer(std::move(other.m_processingBuffer)),
-        m_effectProcessor(std::move(other.m_effectProcessor))
+        m_effectProcessor(std::move(other.m_effectProcessor)),
+        m_effectLatency(std::move(other.m_effectLatency)),
+        m_effectTail(std::move(other.m_effectTail)),
+        m_speed(other.m_speed.load()),
+        m_stretcher(std::move(other.m_stretcher)),
+        m_stretching(other.m_stretching),
+        m_stretchSegments(std::move(other.m_stretchSegments))
 {
 }
 
@@ -63,11 +75,21 @@ AudioStreamer& AudioStreamer::operator=(AudioStreamer&& other) noexcept
 		m_isRunning = other.m_isRunning.load();
 		m_looping = other.m_looping.load();
 		m_volume = other.m_volume.load();
-		m_samplesProcessed = other.m_samplesProcessed.load();
+		m_normalizationGainDb = other.m_normalizationGainDb.load();
+		m_normalizationGain = other.m_normalizationGain.load();
+		m_streamFrame = other.m_streamFrame.load();
+		m_outputFrame = other.m_outputFrame.load();
+		m_queuedBuffers = std::move(other.m_queuedBuffers);
 		m_streamingThread = std::move(other.m_streamingThread);
 		m_audioQueue = std::move(other.m_audioQueue);
 		m_processingBuffer = std::move(other.m_processingBuffer);
 		m_effectProcessor = std::move(other.m_effectProcessor);
+		m_effectLatency = std::move(other.m_effectLatency);
+		m_effectTail = std::move(other.m_effectTail);
+		m_speed = other.m_speed.load();
+		m_stretcher = std::move(other.m_stretcher);
+		m_stretching = other.m_stretching;
+		m_stretchSegments = std::move(other.m_stretchSegments);
 	}
 
 	return *this;
@@ -265,46 +287,18 @@ void AudioStreamer::UpdateBufferStream()
 	while (processed--)
 	{
 		ALuint buffer;
-		alSourceUnqueueBuffers(m_source, 1, &buffer);
-		CheckAlError("Failed to unqueue buffer");
-
-		AudioChunk chunk;
-		bool gotData = OnGetData(chunk);
-
-		if (gotData && chunk.samples && chunk.sampleCount > 0)
 		{
-			// Convert float samples to int16_t
-			std::vector<int16_t> convertedBuffer(chunk.sampleCount);
-			for (size_t i = 0; i < chunk.sampleCount; ++i)
-			{
-				// Convert float (-1.0 to 1.0) to int16_t (-32768 to 32767)
-				float sample = std::clamp(chunk.samples[i], -1.0f, 1.0f);
-				convertedBuffer[i] = static_cast<int16_t>(sample * 32767.0f);
-			}
+			std::lock_guard<std::mutex> lock(m_queueMutex);
+			alSourceUnqueueBuffers(m_source, 1, &buffer);
+			CheckAlError("Failed to unqueue buffer");
 
-			if (m_effectProcessor)
+			if (!m_queuedBuffers.empty())
 			{
-				m_processingBuffer.resize(chunk.sampleCount);
-				std::memcpy(m_processingBuffer.data(), chunk.samples, chunk.sampleCount * sizeof(float));
-				m_effectProcessor(m_processingBuffer, m_config.channelCount, m_config.sampleRate);
-
-				// Convert processed float samples to int16_t
-				for (size_t i = 0; i < chunk.sampleCount; ++i)
-				{
-					float sample = std::clamp(m_processingBuffer[i], -1.0f, 1.0f);
-					convertedBuffer[i] = static_cast<int16_t>(sample * 32767.0f);
-				}
+				m_queuedBuffers.pop_front();
 			}
-
-			alBufferData(buffer, m_config.channelCount == 1 ? AL_FORMAT_MONO16 : AL_FORMAT_STEREO16, convertedBuffer.data(), static_cast<ALsizei>(chunk.sampleCount * sizeof(int16_t)), m_config.sampleRate);
-
-			CheckAlError("Failed to buffer audio data");
-			alSourceQueueBuffers(m_source, 1, &buffer);
-			CheckAlError("Failed to queue buffer");
-
-			m_samplesProcessed += chunk.sampleCount;
 		}
-		else
+
+		if (!FillBuffer(buffer))
 		{
 			LOG_WARN("No audio data received for buffer");
 		}
@@ -326,6 +320,218 @@ void AudioStreamer::UpdateBufferStream()
 	}
 }
 
+bool AudioStreamer::ReadChunk(AudioChunk& chunk)
+{
+	bool gotData = OnGetData(chunk) && chunk.samples && chunk.sampleCount > 0;
+
+	// Looping is handled here rather than with AL_LOOPING, which would replay the queue and starve the stream
+	if (!gotData && m_looping)
+	{
+		if (std::optional<std::size_t> loopFrame = OnLoop())
+		{
+			LOG_DEBUG("Stream looped back to frame {}", *loopFrame);
+			m_streamFrame = *loopFrame;
+			gotData = OnGetData(chunk) && chunk.samples && chunk.sampleCount > 0;
+		}
+	}
+
+	return gotData;
+}
+
+bool AudioStreamer::ReadStretched(AudioChunk& chunk, std::size_t& sourceFrame, std::size_t& sourceFrames)
+{
+	const unsigned int channels = m_config.channelCount;
+	if (m_stretcher.GetChannelCount() != channels || m_stretcher.GetSampleRate() != m_config.sampleRate)
+	{
+		m_stretcher.Configure(channels, m_config.sampleRate);
+		m_stretchSegments.clear();
+	}
+	m_stretcher.SetSpeed(m_speed);
+
+	// Decode until a whole buffer of output is ready, at 2x that takes about two chunks
+	const std::size_t maxFrames = AUDIO_STREAM_BUFFER_SIZE / channels;
+	while (m_stretcher.GetAvailable() < maxFrames && !m_stretcher.IsFlushing())
+	{
+		AudioChunk input;
+		if (!ReadChunk(input))
+		{
+			m_stretcher.Flush();
+			break;
+		}
+
+		// Contiguous chunks carry on the last segment, only a loop starts a new one
+		const std::int64_t inputFrame = m_stretcher.GetInputFrames();
+		if (m_stretchSegments.empty() ||
+		    m_stretchSegments.back().streamFrame + static_cast<std::size_t>(inputFrame - m_stretchSegments.back().inputFrame) != m_streamFrame)
+		{
+			m_stretchSegments.push_back({ inputFrame, m_streamFrame });
+		}
+
+		const std::size_t frames = input.sampleCount / channels;
+		m_stretcher.Push(input.samples, frames);
+		m_streamFrame += frames;
+	}
+
+	if (m_stretcher.GetAvailable() == 0)
+		return false;
+
+	// Map the output back to stream frames. A buffer ends where the next segment starts, so
+	// one buffer never spans a loop and the position within it can be interpolated
+	const double position = m_stretcher.GetOutputPosition();
+	while (m_stretchSegments.size() > 1 && static_cast<double>(m_stretchSegments[1].inputFrame) <= position)
+	{
+		m_stretchSegments.pop_front();
+	}
+
+	std::size_t frames = min(m_stretcher.GetAvailable(), maxFrames);
+	if (m_stretchSegments.size() > 1)
+	{
+		const double remaining = static_cast<double>(m_stretchSegments[1].inputFrame) - position;
+		frames = min(frames, max(static_cast<std::size_t>(std::ceil(remaining / m_stretcher.GetSpeed())), static_cast<std::size_t>(1)));
+	}
+
+	const StretchSegment& segment = m_stretchSegments.front();
+	sourceFrame = segment.streamFrame + static_cast<std::size_t>(std::llround(max(0.0, position - static_cast<double>(segment.inputFrame))));
+	sourceFrames = static_cast<std::size_t>(std::llround(m_stretcher.GetInputSpan(frames)));
+
+	m_stretchBuffer.resize(frames * channels);
+	m_stretcher.Pull(m_stretchBuffer.data(), frames);
+	chunk = { m_stretchBuffer.data(), m_stretchBuffer.size() };
+	return true;
+}
+
+void AudioStreamer::ResetStretcher()
+{
+	m_stretcher.Reset();
+	m_stretchSegments.clear();
+	m_stretching = m_speed != 1.0f;
+}
+
+bool AudioStreamer::FillBuffer(ALuint buffer)
+{
+	const unsigned int channels = m_config.channelCount;
+	if (m_speed != 1.0f)
+	{
+		m_stretching = true;
+	}
+
+	// Stream frames the chunk was taken from, the chunk itself may be longer or shorter when stretched
+	AudioChunk chunk;
+	std::size_t sourceFrame = m_streamFrame;
+	std::size_t sourceFrames = 0;
+	bool gotData = false;
+	if (m_stretching)
+	{
+		gotData = ReadStretched(chunk, sourceFrame, sourceFrames);
+	}
+	else if (ReadChunk(chunk))
+	{
+		// At 1x the output timeline follows the stream, jumps included
+		gotData = true;
+		sourceFrame = m_streamFrame;
+		sourceFrames = chunk.sampleCount / channels;
+		m_outputFrame = m_streamFrame.load();
+		m_streamFrame += sourceFrames;
+	}
+
+	// Effects that delay their output still hold the end of the stream, and reverbs ring on past it.
+	// Silence pushes both out, over as many buffers as that takes. The held back part still belongs
+	// to the stream and moves the clock on, the decay after it keeps the clock at the end
+	std::size_t latency = m_effectProcessor && m_effectLatency ? m_effectLatency() : 0;
+	const std::size_t tail = !gotData && m_effectProcessor && m_effectTail ? m_effectTail() : 0;
+	if (!gotData && m_tailFramesFlushed < latency + tail)
+	{
+		const bool decay = m_tailFramesFlushed >= latency;
+		const std::size_t remaining = decay ? latency + tail - m_tailFramesFlushed : latency - m_tailFramesFlushed;
+		const std::size_t frames = min(remaining, AUDIO_STREAM_BUFFER_SIZE / channels);
+		m_silence.assign(frames * channels, 0.0f);
+		chunk = { m_silence.data(), m_silence.size() };
+		sourceFrame = m_streamFrame;
+		sourceFrames = decay ? 0 : m_stretching ? static_cast<std::size_t>(std::llround(static_cast<double>(frames) * m_stretcher.GetSpeed())) : frames;
+		m_streamFrame += sourceFrames;
+		m_tailFramesFlushed += frames;
+		gotData = true;
+	}
+	else if (gotData)
+	{
+		m_tailFramesFlushed = 0;
+	}
+
+	if (!gotData)
+		return false;
+
+	// Normalization rides on a pass that happens anyway, the copy for the effects or the conversion.
+	// A gain change glides over NORMALIZATION_RAMP_SECONDS, which takes the copy as well
+	const float target = m_normalizationGain;
+	if (target != m_rampTarget)
+	{
+		m_rampTarget = target;
+		m_rampStep = (target - m_appliedGain) / (NORMALIZATION_RAMP_SECONDS * static_cast<float>(m_config.sampleRate));
+	}
+
+	const float* samples = chunk.samples;
+	float gain = m_appliedGain;
+	if (m_effectProcessor || gain != target)
+	{
+		m_processingBuffer.resize(chunk.sampleCount);
+		if (gain != target)
+		{
+			RampNormalizationGain(chunk.samples, m_processingBuffer.data(), chunk.sampleCount / channels, channels);
+		}
+		else if (gain == 1.0f)
+		{
+			std::memcpy(m_processingBuffer.data(), chunk.samples, chunk.sampleCount * sizeof(float));
+		}
+		else
+		{
+			for (std::size_t i = 0; i < chunk.sampleCount; ++i)
+			{
+				m_processingBuffer[i] = chunk.samples[i] * gain;
+			}
+		}
+		gain = 1.0f;
+		samples = m_processingBuffer.data();
+
+		if (m_effectProcessor)
+		{
+			m_effectProcessor(m_processingBuffer, channels, m_config.sampleRate);
+			latency = m_effectLatency ? m_effectLatency() : 0;
+		}
+	}
+
+	// First frame actually in this buffer, on both timelines. Effect latency is in output frames
+	const std::size_t frameCount = chunk.sampleCount / channels;
+	const std::size_t sourceLatency = latency * sourceFrames / max(frameCount, static_cast<std::size_t>(1));
+	const std::size_t bufferFrame = sourceFrame - min(sourceLatency, sourceFrame);
+	const std::size_t nextOutputFrame = m_outputFrame;
+	const std::size_t outputFrame = nextOutputFrame - min(latency, nextOutputFrame);
+
+	m_loudnessMeter.Process(samples, frameCount, static_cast<std::int64_t>(outputFrame));
+
+	// Convert float samples to int16_t
+	std::vector<int16_t> convertedBuffer(chunk.sampleCount);
+	for (size_t i = 0; i < chunk.sampleCount; ++i)
+	{
+		// Convert float (-1.0 to 1.0) to int16_t (-32768 to 32767). The limiter at the end of the
+		// effect chain keeps peaks under full scale, the clamp only catches what gets past it
+		float sample = std::clamp(samples[i] * gain, -1.0f, 1.0f);
+		convertedBuffer[i] = static_cast<int16_t>(sample * 32767.0f);
+	}
+
+	alBufferData(buffer, channels == 1 ? AL_FORMAT_MONO16 : AL_FORMAT_STEREO16, convertedBuffer.data(), static_cast<ALsizei>(chunk.sampleCount * sizeof(int16_t)), m_config.sampleRate);
+	CheckAlError("Failed to buffer audio data");
+
+	{
+		std::lock_guard<std::mutex> lock(m_queueMutex);
+		alSourceQueueBuffers(m_source, 1, &buffer);
+		CheckAlError("Failed to queue buffer");
+		m_queuedBuffers.push_back({ bufferFrame, sourceFrames, outputFrame, frameCount });
+	}
+
+	m_outputFrame += frameCount;
+	return true;
+}
+
 void AudioStreamer::Play()
 {
 	if (m_status != Status::Playing)
@@ -363,8 +569,7 @@ void AudioStreamer::Stop(bool clearInfo)
 	alSourceStop(m_source);
 	CheckAlError("Failed to stop playback");
 	m_status = Status::Stopped;
-	m_samplesProcessed = 0;
-	
+
 	if (clearInfo)
 	{
 		// Reset m_trackInfo
@@ -379,16 +584,51 @@ void AudioStreamer::setVolume(float newVolume)
 	LOG_DEBUG("Volume set to {}", m_volume.load());
 }
 
+void AudioStreamer::SetNormalizationGain(float gainDb)
+{
+	if (gainDb == m_normalizationGainDb)
+		return;
+
+	m_normalizationGainDb = gainDb;
+	m_normalizationGain = FastMath::DbToLinear(gainDb);
+	LOG_DEBUG("Normalization gain set to {:.2f} dB", gainDb);
+}
+
+void AudioStreamer::RampNormalizationGain(const float* input, float* output, std::size_t frames, unsigned int channels)
+{
+	for (std::size_t frame = 0; frame < frames; frame++)
+	{
+		if (m_appliedGain != m_rampTarget)
+		{
+			m_appliedGain += m_rampStep;
+			if ((m_rampStep > 0.0f) == (m_appliedGain > m_rampTarget))
+			{
+				m_appliedGain = m_rampTarget;
+			}
+		}
+
+		for (unsigned int channel = 0; channel < channels; channel++)
+		{
+			output[frame * channels + channel] = input[frame * channels + channel] * m_appliedGain;
+		}
+	}
+}
+
+void AudioStreamer::SetPlaybackSpeed(float speed)
+{
+	m_speed = std::clamp(speed, TimeStretcher::MIN_SPEED, TimeStretcher::MAX_SPEED);
+	LOG_DEBUG("Playback speed set to {}", m_speed.load());
+}
+
 void AudioStreamer::SetLooping(bool shouldLoop)
 {
 	m_looping = shouldLoop;
-	alSourcei(m_source, AL_LOOPING, shouldLoop ? AL_TRUE : AL_FALSE);
 	LOG_INFO("Looping {} for audio source", shouldLoop ? "enabled" : "disabled");
 }
 
 std::optional<std::size_t> AudioStreamer::OnLoop()
 {
-	SetPlayingOffset(0.0);
+	OnSeek(0.0);
 
 	return 0;
 }
@@ -403,10 +643,48 @@ float AudioStreamer::GetDuration() const
 
 double AudioStreamer::GetPlayingOffset() const
 {
-	ALint sampleOffset;
+	if (m_config.sampleRate == 0)
+		return 0.0;
+
+	return GetPlaybackPosition().streamFrame / m_config.sampleRate;
+}
+
+AudioStreamer::PlaybackPosition AudioStreamer::GetPlaybackPosition() const
+{
+	std::lock_guard<std::mutex> lock(m_queueMutex);
+	if (m_queuedBuffers.empty())
+		return { static_cast<double>(m_streamFrame), m_outputFrame.load() };
 
+	ALint state;
+	ALint sampleOffset;
+	alGetSourcei(m_source, AL_SOURCE_STATE, &state);
 	alGetSourcei(m_source, AL_SAMPLE_OFFSET, &sampleOffset);
-	return static_cast<double>(m_samplesProcessed + sampleOffset) / (m_config.sampleRate * m_config.channelCount);
+
+	// A source that ran out of data rewinds its offset, but it really sits at the end of the queue
+	const QueuedBuffer& last = m_queuedBuffers.back();
+	const PlaybackPosition end{ static_cast<double>(last.startFrame + last.sourceFrames), last.outputFrame + last.frameCount };
+	if (state == AL_STOPPED && m_status == Status::Playing)
+		return end;
+
+	// The offset counts from the head of the queue, walk it to find the buffer being heard. Within
+	// a buffer stream frames advance evenly, by the tempo it was stretched at
+	std::size_t offset = static_cast<std::size_t>(max(sampleOffset, 0));
+	for (const QueuedBuffer& queued: m_queuedBuffers)
+	{
+		if (offset < queued.frameCount)
+		{
+			const double progress = static_cast<double>(offset) / static_cast<double>(queued.frameCount);
+			return { static_cast<double>(queued.startFrame) + progress * static_cast<double>(queued.sourceFrames), queued.outputFrame + offset };
+		}
+		offset -= queued.frameCount;
+	}
+
+	return end;
+}
+
+const LoudnessMeter::Reading& AudioStreamer::AcquireLoudness()
+{
+	return m_loudnessMeter.AcquireReading(static_cast<std::int64_t>(GetPlaybackPosition().outputFrame));
 }
 
 void AudioStreamer::SetPosition(float x, float z)
@@ -440,8 +718,9 @@ void AudioStreamer::SetPlayingOffset(double timeOffset)
 
 	Stop();
 
-	std::size_t frame = static_cast<std::size_t>(timeOffset * m_config.sampleRate);
-	m_samplesProcessed = frame * m_config.channelCount;
+	m_streamFrame = static_cast<std::size_t>(std::llround(timeOffset * m_config.sampleRate));
+	m_outputFrame = m_streamFrame.load();
+	ResetStretcher();
 
 	OnSeek(timeOffset);
 
@@ -463,8 +742,13 @@ void AudioStreamer::CheckAlError(const char* operation)
 void AudioStreamer::Init(const StreamingConfig& newConfig)
 {
 	LOG_INFO("Initializing stream with {} channels, {} Hz sample rate, {} buffers", newConfig.channelCount, newConfig.sampleRate, newConfig.numBuffers);
-	m_samplesProcessed = 0;
+	m_streamFrame = newConfig.startFrame;
+	m_outputFrame = newConfig.startFrame;
 	m_config = newConfig;
+	ResetStretcher();
+	m_appliedGain = m_normalizationGain;
+	m_rampTarget = m_appliedGain;
+	m_loudnessMeter.Configure(m_config.channelCount, m_config.sampleRate);
 
 	Stop(true); // false = clear track info as a new track is being loaded
 
@@ -503,35 +787,15 @@ void AudioStreamer::CreateAndFillBuffers(bool recreateBuffers)
 		}
 	}
 
+	{
+		std::lock_guard<std::mutex> lock(m_queueMutex);
+		m_queuedBuffers.clear();
+	}
+
 	// Fill buffers with initial audio data
 	for (ALuint buffer: m_buffers)
 	{
-		AudioChunk chunk;
-		bool gotData = OnGetData(chunk);
-
-		if (gotData && chunk.samples && chunk.sampleCount > 0)
-		{
-			LOG_DEBUG("Queueing initial buffer with {} samples", chunk.sampleCount);
-
-			// Convert float samples to int16_t
-			std::vector<int16_t> convertedBuffer(chunk.sampleCount);
-			for (size_t i = 0; i < chunk.sampleCount; ++i)
-			{
-				// Convert float (-1.0 to 1.0) to int16_t (-32768 to 32767)
-				float sample = std::clamp(chunk.samples[i], -1.0f, 1.0f);
-				convertedBuffer[i] = static_cast<int16_t>(sample * 32767.0f);
-			}
-
-
-			alBufferData(buffer, m_config.channelCount == 1 ? AL_FORMAT_MONO16 : AL_FORMAT_STEREO16, convertedBuffer.data(), static_cast<ALsizei>(chunk.sampleCount * sizeof(int16_t)), m_config.sampleRate);
-			CheckAlError("Failed to fill initial buffer");
-
-			alSourceQueueBuffers(m_source, 1, &buffer);
-			CheckAlError("Failed to queue initial buffer");
-
-			m_samplesProcessed += chunk.sampleCount;
-		}
-		else
+		if (!FillBuffer(buffer))
 		{
 			LOG_WARN("Failed to get initial audio data");
 			break;
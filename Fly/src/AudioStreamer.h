@@ -3,6 +3,7 @@
 #include <AL/al.h>
 #include <AL/alc.h>
 #include <atomic>
+#include <deque>
 #include <functional>
 #include <mutex>
 #include <optional>
@@ -10,6 +11,8 @@
 #include <vector>
 
 #include "containers/ThreadSafeQueue.h"
+#include "dsp/LoudnessMeter.h"
+#include "dsp/TimeStretcher.h"
 #include "RoomReverb.h"
 
 class AudioStreamer
@@ -37,6 +40,7 @@ public:
 		unsigned int channelCount{ 2 };
 		unsigned int sampleRate{ 44100 };
 		unsigned int numBuffers{ 4 };
+		std::size_t startFrame{ 0 }; // Stream frame the first decoded chunk starts at
 	};
 
 	struct AudioChunk
@@ -74,7 +78,7 @@ public:
 	void Cleanup();
 
 	// State control
-	void SetLooping(bool loop);
+	virtual void SetLooping(bool loop);
 
 	bool IsLooping() const
 	{
@@ -104,11 +108,33 @@ public:
 		return m_config.sampleRate;
 	}
 
-	// Position control
+	// Position control, in source time whatever the playback speed
 	void SetPlayingOffset(double timeOffset);
 	double GetPlayingOffset() const;
 	float GetDuration() const;
 
+	// Tempo without a change in pitch, 0.5 to 2. Applied as the stream is decoded, so it is heard
+	// once the buffers already queued have played out
+	void SetPlaybackSpeed(float speed);
+
+	float GetPlaybackSpeed() const
+	{
+		return m_speed;
+	}
+
+	// Gain changes during playback glide over this long instead of stepping
+	static constexpr float NORMALIZATION_RAMP_SECONDS = 0.3f;
+
+	// Loudness normalization, in dB. Scales the decoded audio on its way into the effects, so the
+	// limiter catches what a boost takes over full scale. Heard once the queued buffers played out,
+	// a new stream starts at the gain set before opening it
+	void SetNormalizationGain(float gainDb);
+
+	float GetNormalizationGain() const
+	{
+		return m_normalizationGainDb;
+	}
+
 	// Effects
 	void SetEffectProcessor(EffectProcessor processor)
 	{
@@ -120,6 +146,21 @@ public:
 		m_effectProcessor = nullptr;
 	}
 
+	// Frames the effect processor delays its output by, polled on the streaming thread after each
+	// call. Buffers are stamped with the stream position they actually carry, so the clock, metering
+	// and visualizer stay with what is heard, and the held back end of a stream is flushed out
+	void SetEffectLatency(std::function<std::size_t()> latency)
+	{
+		m_effectLatency = std::move(latency);
+	}
+
+	// Frames the effect processor keeps ringing after its input stops, reverb decays. Polled when
+	// the stream runs dry, the flush carries on this much past the latency so the decay is heard
+	void SetEffectTail(std::function<std::size_t()> tail)
+	{
+		m_effectTail = std::move(tail);
+	}
+
 	// Spatial audio control
 	void SetPosition(float x, float z);
 	void SetListenerPosition(float x, float z);
@@ -144,15 +185,26 @@ public:
 		return m_roomReverb;
 	}
 
+	// Metering of the output, after effects. Returns the reading for the audio being heard, UI thread only
+	const LoudnessMeter::Reading& AcquireLoudness();
+
 protected:
 	// Virtual methods for derived classes
 	virtual bool OnGetData(AudioChunk& chunk) = 0;
 	virtual void OnSeek(double timeOffset) = 0;
+
+	// Rewinds the stream when it runs dry while looping, returns the stream frame playback continues from
 	virtual std::optional<std::size_t> OnLoop();
 
 	// Returns total number of samples in the stream
 	virtual float OnGetDuration() const = 0;
 
+	// Holds off the streaming thread, e.g. while the derived class swaps its data source
+	std::unique_lock<std::recursive_mutex> LockStream()
+	{
+		return std::unique_lock<std::recursive_mutex>(m_streamMutex);
+	}
+
 	// Track info
 	AudioStreamer::TrackInfo m_trackInfo{};
 
@@ -167,8 +219,47 @@ private:
 	void CleanupOpenAL();
 	void StreamingThreadFunc();
 	void UpdateBufferStream();
+	bool FillBuffer(ALuint buffer);
 	void CheckAlError(const char* operation);
 
+	// Next decoded chunk, rewinding first when looping. Leaves m_streamFrame at the chunk's first frame
+	bool ReadChunk(AudioChunk& chunk);
+
+	// Next chunk of time-stretched audio, along with the stream frames it was taken from
+	bool ReadStretched(AudioChunk& chunk, std::size_t& sourceFrame, std::size_t& sourceFrames);
+
+	// Drops whatever the stretcher holds, for seeks and new tracks
+	void ResetStretcher();
+
+	// Scales frames by the normalization gain as it glides to m_rampTarget
+	void RampNormalizationGain(const float* input, float* output, std::size_t frames, unsigned int channels);
+
+	// Stream position covered by a buffer in the AL queue. Output frames count what is played and
+	// only differ from stream frames while the tempo is changed
+	struct QueuedBuffer
+	{
+		std::size_t startFrame{ 0 };
+		std::size_t sourceFrames{ 0 };
+		std::size_t outputFrame{ 0 };
+		std::size_t frameCount{ 0 };
+	};
+
+	// Where the source is in the AL queue, as a stream frame and on the output timeline
+	struct PlaybackPosition
+	{
+		double streamFrame{ 0.0 };
+		std::size_t outputFrame{ 0 };
+	};
+
+	PlaybackPosition GetPlaybackPosition() const;
+
+	// Stretcher input position where the stream jumped, on a loop, so output maps back to the right frames
+	struct StretchSegment
+	{
+		std::int64_t inputFrame{ 0 };
+		std::size_t streamFrame{ 0 };
+	};
+
 	// OpenAL state
 	ALCdevice* m_device{ nullptr };
 	ALCcontext* m_context{ nullptr };
@@ -181,7 +272,20 @@ private:
 	std::atomic<bool> m_isRunning{ false };
 	std::atomic<bool> m_looping{ false };
 	std::atomic<float> m_volume{ 0.5f };
-	std::atomic<std::size_t> m_samplesProcessed{ 0 };
+	std::atomic<float> m_normalizationGainDb{ 0.0f };
+	std::atomic<float> m_normalizationGain{ 1.0f }; // Linear
+	float m_appliedGain{ 1.0f }; // Streaming side, what the last frame was scaled by
+	float m_rampTarget{ 1.0f };
+	float m_rampStep{ 0.0f }; // Per frame
+
+	// Written on the streaming thread, read by the UI as the playing positions while nothing is queued
+	std::atomic<std::size_t> m_streamFrame{ 0 }; // Stream frame the next decoded chunk starts at
+	std::atomic<std::size_t> m_outputFrame{ 0 }; // Output frame the next buffer starts at, follows m_streamFrame at 1x
+
+	// Mirrors the AL queue so the playing offset can be mapped back to a stream position,
+	// which stays correct across loops and seeks where a running sample count would not
+	std::deque<QueuedBuffer> m_queuedBuffers;
+	mutable std::mutex m_queueMutex;
 
 	// Thread management
 	std::thread m_streamingThread;
@@ -191,7 +295,21 @@ private:
 	// Audio processing
 	std::vector<float> m_processingBuffer;
 	EffectProcessor m_effectProcessor;
+	std::function<std::size_t()> m_effectLatency;
+	std::function<std::size_t()> m_effectTail;
+	std::vector<float> m_silence;  // Pushed through delaying effects once the stream runs dry
+	std::size_t m_tailFramesFlushed{ 0 }; // Silence pushed since the stream ran dry, in output frames
+
+	// Time-stretch, the stretcher stays in the path from the first speed change until the next seek
+	std::atomic<float> m_speed{ 1.0f };
+	TimeStretcher m_stretcher;
+	bool m_stretching{ false };
+	std::deque<StretchSegment> m_stretchSegments;
+	std::vector<float> m_stretchBuffer;
 
 	// Effects
 	RoomReverb m_roomReverb;
+
+	// Metering
+	LoudnessMeter m_loudnessMeter;
 };
@@ -2,248 +2,248 @@
 
 #include "AudioVisualizer.h"
 
+#include <cstring>
+
+#include "dsp/FastMath.h"
+
 AudioVisualizer::AudioVisualizer()
-      : m_ringBuffer(RING_BUFFER_SIZE), m_visualizerData(NUM_BANDS), m_bandPeaks(NUM_BANDS), m_bandDecay(NUM_BANDS), m_prevMagnitudes(NUM_BANDS), m_lastUpdateTime(std::chrono::steady_clock::now())
+      : m_bars(std::make_shared<BarSpectrumView>())
 {
+	m_history.Configure(1, RING_BUFFER_SIZE);
+	m_stereoHistory.Configure(2, RING_BUFFER_SIZE);
+	m_monoScratch.resize(AUDIO_STREAM_BUFFER_SIZE);
+	m_stereoScratch.resize(AUDIO_STREAM_BUFFER_SIZE * 2);
+	m_stereoWindow.resize(MAX_STEREO_FRAMES * 2);
+	ConfigureFft(DEFAULT_FFT_SIZE);
+
+	m_views.push_back(m_bars);
 }
 
-void AudioVisualizer::PushAudioData(const std::vector<float>& buffer, int channels, int sampleRate)
+void AudioVisualizer::SetFftSize(int size)
 {
-	std::lock_guard<std::mutex> lock(m_bufferMutex);
-	m_currentSampleRate = sampleRate;
-
-	// Convert to mono and add to ring buffer
-	for (size_t i = 0; i < buffer.size(); i += channels)
+	if (size < 64 || size > MAX_FFT_SIZE || (size & (size - 1)) != 0)
 	{
-		float sample = 0.0f;
-		for (int ch = 0; ch < channels; ch++)
-		{
-			// No need to divide by 32768 since data is already in float format
-			sample += buffer[i + ch];
-		}
-		sample /= channels; // Average the channels
-
-		sample = std::tanh(sample * 1.5f); // Soft limiting with slight amplification
-
-		m_ringBuffer[m_writePos] = sample;
-		m_writePos = (m_writePos + 1) & (RING_BUFFER_SIZE - 1); // Wrap around
-
-		// If buffer is full, move read position
-		if (m_writePos == m_readPos)
-		{
-			m_readPos = (m_readPos + 1) & (RING_BUFFER_SIZE - 1);
-		}
+		LOG_WARN("Ignoring invalid visualizer FFT size {}", size);
+		return;
 	}
+	m_requestedFftSize = size;
 }
 
-// Called from main/rendering thread
-bool AudioVisualizer::Update()
+void AudioVisualizer::ConfigureFft(int size)
 {
-	auto now = std::chrono::steady_clock::now();
-	auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(now - m_lastUpdateTime).count();
-
-	// Only update at specified interval
-	if (elapsed < UPDATE_INTERVAL_MS)
+	m_fftSize = size;
+	m_fftPlan = std::make_unique<FFTPlan>(size);
+	m_fftInput.resize(size);
+	m_spectrum.resize(m_fftPlan->GetBinCount());
+	m_processBuffer.resize(size);
+	m_magnitudes.resize(size / 2);
+
+	// Hann window
+	m_window.resize(size);
+	float windowSum = 0.0f;
+	for (int i = 0; i < size; i++)
 	{
-		return false;
+		m_window[i] = 0.5f * (1.0f - std::cos(2.0f * M_PI * i / (size - 1)));
+		windowSum += m_window[i];
 	}
+	m_magnitudeScale = 2.0f / windowSum;
 
-	m_lastUpdateTime = now;
-
-	std::vector<float> processBuffer;
-	{
-		std::lock_guard<std::mutex> lock(m_bufferMutex);
-
-		// Calculate available samples
-		size_t available;
-		if (m_writePos >= m_readPos)
-		{
-			available = m_writePos - m_readPos;
-		}
-		else
-		{
-			available = RING_BUFFER_SIZE - (m_readPos - m_writePos);
-		}
+	// Force the next hop to analyze even if playback hasn't moved
+	m_lastAnalyzedFrame = -1;
+}
 
-		// Need enough samples for FFT
-		if (available < FFT_SIZE)
-		{
-			return false;
-		}
+AudioVisualizer::~AudioVisualizer()
+{
+	SetRunning(false);
+}
 
-		// Copy samples for processing
-		processBuffer.reserve(FFT_SIZE);
-		for (size_t i = 0; i < FFT_SIZE; i++)
-		{
-			processBuffer.push_back(m_ringBuffer[(m_readPos + i) & (RING_BUFFER_SIZE - 1)]);
-		}
+void AudioVisualizer::SetRunning(bool running)
+{
+	if (running == m_running)
+		return;
 
-		// Update read position
-		m_readPos = (m_readPos + FFT_SIZE / 2) & (RING_BUFFER_SIZE - 1); // Overlap by 50%
+	m_running = running;
+	if (running)
+	{
+		m_workerThread = std::thread(&AudioVisualizer::WorkerThreadFunc, this);
+		SetThreadDescription(m_workerThread.native_handle(), L"AnalysisWorker");
+	}
+	else if (m_workerThread.joinable())
+	{
+		m_workerThread.join();
 	}
+}
 
-	// Process the audio data
-	ProcessFFT(processBuffer);
-	return true;
+void AudioVisualizer::AddView(std::shared_ptr<AnalysisView> view)
+{
+	std::lock_guard<std::mutex> lock(m_viewsMutex);
+	m_views.push_back(std::move(view));
 }
 
-void AudioVisualizer::ProcessFFT(const std::vector<float>& samples)
+void AudioVisualizer::RemoveView(const std::shared_ptr<AnalysisView>& view)
 {
-	static const float RISE_SPEED = 0.7f;
-	static const float FALL_SPEED = 0.15f;
-	static const float PEAK_FALL_SPEED = 0.08f;
-	static const float MIN_DB = -60.0f;
-	static const float MAX_DB = -6.0f;
-
-	// Scale samples to -1.0 to 1.0 range (knowing max is around 0.60)
-	std::vector<float> normalizedSamples(samples.size());
-	const float scaleAdjust = 0.05f; // Scale factor to normalize to -1.0 to 1.0
-	for (size_t i = 0; i < samples.size(); i++)
+	std::lock_guard<std::mutex> lock(m_viewsMutex);
+	m_views.erase(std::remove(m_views.begin(), m_views.end(), view), m_views.end());
+}
+
+void AudioVisualizer::PushAudioData(const float* samples, size_t frameCount, int64_t startFrame, int channels, int sampleRate)
+{
+	TapBlock* block = m_tap.beginPush();
+	if (!block)
 	{
-		normalizedSamples[i] = samples[i] * scaleAdjust;
+		// Analysis isn't draining the tap (visualizer hidden or falling behind), losing visual data is fine
+		return;
 	}
 
-	// Perform FFT and get magnitudes
-	std::vector<float> rawMagnitudes;
-	PerformFFT(normalizedSamples, rawMagnitudes);
+	block->sampleCount = min(frameCount * channels, block->samples.size());
+	block->startFrame = startFrame;
+	block->channels = channels;
+	block->sampleRate = sampleRate;
+	std::memcpy(block->samples.data(), samples, block->sampleCount * sizeof(float));
 
-	std::vector<float> newMagnitudes(NUM_BANDS, 0.0f);
-	float sampleRate = m_currentSampleRate > 0 ? m_currentSampleRate : 44100.0f;
+	m_tap.commitPush();
+}
 
-	float minFreq = 20.0f;
-	float maxFreq = 20000.0f;
+void AudioVisualizer::WorkerThreadFunc()
+{
+	LOG_DEBUG("Analysis worker started");
 
-	for (int band = 0; band < NUM_BANDS; band++)
+	auto nextHop = std::chrono::steady_clock::now();
+	while (m_running)
 	{
-		float freq1 = minFreq * std::pow(maxFreq / minFreq, static_cast<float>(band) / NUM_BANDS);
-		float freq2 = minFreq * std::pow(maxFreq / minFreq, static_cast<float>(band + 1) / NUM_BANDS);
-
-		int bin1 = static_cast<int>(freq1 * FFT_SIZE / sampleRate);
-		int bin2 = static_cast<int>(freq2 * FFT_SIZE / sampleRate);
-		bin1 = std::clamp(bin1, 0, static_cast<int>(rawMagnitudes.size() - 1));
-		bin2 = std::clamp(bin2, 0, static_cast<int>(rawMagnitudes.size() - 1));
-
-		float sum = 0.0f;
-		float weightSum = 0.0f;
-		for (int bin = bin1; bin <= bin2; bin++)
+		int64_t playingFrame = m_clock ? m_clock() : 0;
+		DrainTap(playingFrame);
+		Analyze(playingFrame);
+
+		// Fixed hop rate, skipping hops rather than bunching them up after a stall
+		nextHop += std::chrono::milliseconds(UPDATE_INTERVAL_MS);
+		auto now = std::chrono::steady_clock::now();
+		if (nextHop < now)
 		{
-			float freq = bin * sampleRate / FFT_SIZE;
-			// Very light frequency weighting
-			float weight = 1.0f;
-			if (freq < 100.0f)
-				weight = 1.1f; // Slight bass boost
-			if (freq > 10000.0f)
-				weight = 1.05f; // Slight treble boost
-
-			sum += rawMagnitudes[bin] * weight;
-			weightSum += weight;
+			nextHop = now;
 		}
+		std::this_thread::sleep_until(nextHop);
+	}
 
-		float avgMagnitude = (weightSum > 0.0f) ? (sum / weightSum) : 0.0f;
-
-		// Dynamics processing
-		float db = 20.0f * std::log10(avgMagnitude + 1e-6f);
-		db = std::clamp(db, MIN_DB, MAX_DB);
+	LOG_DEBUG("Analysis worker stopped");
+}
 
-		float normalizedMag = (db - MIN_DB) / (MAX_DB - MIN_DB);
-		// Apply a moderate compression curve
-		normalizedMag = std::pow(normalizedMag, 1.2f);
-		// Scale to leave headroom
-		normalizedMag *= 0.8f;
+void AudioVisualizer::DrainTap(int64_t playingFrame)
+{
+	while (TapBlock* block = m_tap.front())
+	{
+		m_currentSampleRate = block->sampleRate;
+		const int channels = block->channels;
+		const size_t frameCount = channels > 0 ? block->sampleCount / channels : 0;
 
-		// Temporal smoothing
-		float delta = normalizedMag - m_prevMagnitudes[band];
-		if (delta > 0)
+		// A jump in stream position (seek, loop or new track) invalidates the history
+		if (block->startFrame != m_history.GetEndFrame())
 		{
-			newMagnitudes[band] = m_prevMagnitudes[band] + delta * RISE_SPEED;
-		}
-		else
-		{
-			newMagnitudes[band] = m_prevMagnitudes[band] + delta * FALL_SPEED;
+			m_history.Clear(block->startFrame);
+			m_stereoHistory.Clear(block->startFrame);
 		}
 
-		// Peak tracking
-		if (newMagnitudes[band] > m_bandPeaks[band])
+		// Blocks that finished playing before the analysis window are never looked at, don't bother mixing them
+		if (block->startFrame + static_cast<int64_t>(frameCount) < playingFrame - MAX_FFT_SIZE)
 		{
-			m_bandPeaks[band] = newMagnitudes[band];
+			m_history.Clear(block->startFrame + static_cast<int64_t>(frameCount));
+			m_stereoHistory.Clear(block->startFrame + static_cast<int64_t>(frameCount));
+			m_tap.pop();
+			continue;
 		}
-		else
+
+		// Convert to mono, and keep the first two channels as they are (mono duplicated) for the time-domain views
+		const int rightChannel = channels > 1 ? 1 : 0;
+		for (size_t frame = 0; frame < frameCount; frame++)
 		{
-			m_bandPeaks[band] *= (1.0f - PEAK_FALL_SPEED);
+			const float* samples = block->samples.data() + frame * channels;
+			float sample = 0.0f;
+			for (int ch = 0; ch < channels; ch++)
+			{
+				sample += samples[ch];
+			}
+			sample /= channels; // Average the channels
+
+			m_monoScratch[frame] = sample * 1.5f; // Slight amplification, limited below
+			m_stereoScratch[frame * 2] = samples[0];
+			m_stereoScratch[frame * 2 + 1] = samples[rightChannel];
 		}
+		FastMath::Tanh(m_monoScratch.data(), m_monoScratch.data(), frameCount); // Soft limiting
+		m_history.Push(m_monoScratch.data(), frameCount);
+		m_stereoHistory.Push(m_stereoScratch.data(), frameCount);
 
-		// Final safety clamp
-		newMagnitudes[band] = std::clamp(newMagnitudes[band], 0.0f, 0.85f);
+		m_tap.pop();
 	}
-
-	m_prevMagnitudes = newMagnitudes;
-	m_visualizerData = newMagnitudes;
 }
 
-const std::vector<float>& AudioVisualizer::GetVisualizerData() const
+bool AudioVisualizer::Analyze(int64_t playingFrame)
 {
-	return m_visualizerData;
-}
+	if (m_requestedFftSize != m_fftSize)
+	{
+		ConfigureFft(m_requestedFftSize);
+	}
 
-const std::vector<float>& AudioVisualizer::GetBandPeaks() const
-{
-	return m_bandPeaks;
-}
+	// Nothing new is audible while paused
+	if (playingFrame == m_lastAnalyzedFrame)
+	{
+		return false;
+	}
 
-void AudioVisualizer::PerformFFT(const std::vector<float>& samples, std::vector<float>& magnitudes)
-{
-	// Apply Hann window and prepare FFT input
-	std::vector<std::complex<float>> fftInput(FFT_SIZE);
-	for (size_t i = 0; i < min(samples.size(), size_t(FFT_SIZE)); i++)
+	// Analyze the window centered on what is being heard, it may not be decoded yet right after a seek
+	int64_t windowStart = playingFrame - m_fftSize / 2;
+	if (m_history.Read(windowStart, m_processBuffer.data(), m_fftSize) != static_cast<size_t>(m_fftSize))
 	{
-		float window = 0.5f * (1.0f - std::cos(2.0f * M_PI * i / (FFT_SIZE - 1)));
-		fftInput[i] = std::complex<float>(samples[i] * window, 0.0f);
+		return false;
 	}
+	m_lastAnalyzedFrame = playingFrame;
 
-	// Perform FFT (Cooley-Tukey algorithm)
-	size_t n = fftInput.size();
-	for (size_t k = 0; k < n; ++k)
+	PerformFFT(m_processBuffer, m_magnitudes);
+
+	const int sampleRate = m_currentSampleRate > 0 ? m_currentSampleRate : 44100;
+
+	// Stereo window for the time-domain views, also centered, left out if it isn't all there yet
+	size_t stereoFrames = min(static_cast<size_t>(sampleRate) * STEREO_WINDOW_MS / 1000, MAX_STEREO_FRAMES);
+	int64_t stereoStart = playingFrame - static_cast<int64_t>(stereoFrames / 2);
+	if (m_stereoHistory.Read(stereoStart, m_stereoWindow.data(), stereoFrames) != stereoFrames)
 	{
-		size_t j = 0;
-		for (size_t i = 0; i < n; ++i)
-		{
-			if (i < j)
-			{
-				std::swap(fftInput[i], fftInput[j]);
-			}
-			size_t m = n >> 1;
-			while (j >= m && m > 0)
-			{
-				j -= m;
-				m >>= 1;
-			}
-			j += m;
-		}
+		stereoFrames = 0;
 	}
 
-	for (size_t len = 2; len <= n; len <<= 1)
+	AnalysisFrame frame;
+	frame.samples = m_processBuffer.data();
+	frame.sampleCount = m_processBuffer.size();
+	frame.magnitudes = m_magnitudes.data();
+	frame.binCount = m_magnitudes.size();
+	frame.fftSize = m_fftSize;
+	frame.stereo = stereoFrames > 0 ? m_stereoWindow.data() : nullptr;
+	frame.stereoFrameCount = stereoFrames;
+	frame.sampleRate = sampleRate;
+	frame.playingFrame = playingFrame;
+
+	std::lock_guard<std::mutex> lock(m_viewsMutex);
+	for (const std::shared_ptr<AnalysisView>& view: m_views)
 	{
-		float angle = -2.0f * M_PI / static_cast<float>(len);
-		std::complex<float> wlen(std::cos(angle), std::sin(angle));
-		for (size_t i = 0; i < n; i += len)
-		{
-			std::complex<float> w(1.0f, 0.0f);
-			for (size_t j = 0; j < len / 2; ++j)
-			{
-				std::complex<float> u = fftInput[i + j];
-				std::complex<float> v = fftInput[i + j + len / 2] * w;
-				fftInput[i + j] = u + v;
-				fftInput[i + j + len / 2] = u - v;
-				w *= wlen;
-			}
-		}
+		view->Process(frame);
+	}
+	return true;
+}
+
+void AudioVisualizer::PerformFFT(const std::vector<float>& samples, std::vector<float>& magnitudes)
+{
+	// Apply the Hann window, zero padding a short input
+	size_t count = min(samples.size(), m_window.size());
+	for (size_t i = 0; i < count; i++)
+	{
+		m_fftInput[i] = samples[i] * m_window[i];
 	}
+	std::fill(m_fftInput.begin() + count, m_fftInput.end(), 0.0f);
+
+	m_fftPlan->Forward(m_fftInput.data(), m_spectrum.data());
 
 	// Calculate magnitude spectrum
-	magnitudes.resize(FFT_SIZE / 2);
-	for (size_t i = 0; i < FFT_SIZE / 2; i++)
+	magnitudes.resize(m_fftSize / 2);
+	for (size_t i = 0; i < magnitudes.size(); i++)
 	{
-		float mag = std::abs(fftInput[i]);
-		magnitudes[i] = mag;
+		magnitudes[i] = std::abs(m_spectrum[i]) * m_magnitudeScale;
 	}
 }
@@ -1,41 +1,122 @@
 #pragma once
 
+#include <array>
+#include <atomic>
+#include <memory>
+#include <thread>
+
+#include "analysis/AnalysisView.h"
+#include "analysis/BarSpectrumView.h"
+#include "containers/RewindBuffer.h"
+#include "containers/SpscQueue.h"
+#include "dsp/FFTPlan.h"
+
+// Collects the audio being played and analyzes it on a worker thread of its own. Every hop the
+// worker takes the window centered on the audible position, runs one FFT and hands the result
+// to each registered AnalysisView, which publish their output for the UI lock-free.
 class AudioVisualizer
 {
 private:
-	static constexpr size_t RING_BUFFER_SIZE = 16384; // Power of 2 for efficient wrapping
-	static constexpr size_t UPDATE_INTERVAL_MS = 16;  // ~60 FPS
-	static const int NUM_BANDS = 23;                  // Number of frequency bands
-	static const int FFT_SIZE = 2048;                 // Size of FFT window
+	// Decoding runs up to numBuffers x AUDIO_STREAM_BUFFER_SIZE frames ahead of what is heard,
+	// the history has to reach back from the newest decoded frame to the audible one
+	static constexpr size_t RING_BUFFER_SIZE = 262144;
+	static constexpr size_t UPDATE_INTERVAL_MS = 16; // Analysis hop, ~60 FPS
+	static const int DEFAULT_FFT_SIZE = 2048;        // Size of FFT window
+	static const int MAX_FFT_SIZE = 16384;
+
+	// Time-domain views get up to this much stereo audio around the playing position, 100 ms at 192 kHz
+	static constexpr size_t MAX_STEREO_FRAMES = 19200;
+	static constexpr int STEREO_WINDOW_MS = 100;
+
+	// Histories addressed by stream frame, only touched by the worker. The mono one is downmixed and
+	// soft limited for the spectrum views, the stereo one is the untouched first two channels
+	RewindBuffer m_history;
+	RewindBuffer m_stereoHistory;
+	std::vector<float> m_monoScratch;
+	std::vector<float> m_stereoScratch;
+	int64_t m_lastAnalyzedFrame = -1;
+
+	// Raw audio handed over by the streaming thread. Downmixing and limiting happen on the
+	// consumer side in DrainTap, so the producer only ever does a memcpy and never waits
+	struct TapBlock
+	{
+		std::array<float, AUDIO_STREAM_BUFFER_SIZE> samples;
+		size_t sampleCount = 0;
+		int64_t startFrame = 0; // Stream frame of the first sample
+		int channels = 0;
+		int sampleRate = 0;
+	};
+
+	static constexpr size_t TAP_BLOCKS = 8;
+	SpscQueue<TapBlock, TAP_BLOCKS> m_tap;
 
-	std::vector<float> m_ringBuffer;
-	size_t m_writePos = 0;
-	size_t m_readPos = 0;
+	int m_currentSampleRate = 0;
 
-	std::vector<float> m_visualizerData;
-	std::vector<float> m_bandPeaks;
-	std::vector<float> m_bandDecay;
-	std::vector<float> m_prevMagnitudes;
+	// FFT state, rebuilt by the worker only when the size changes
+	int m_fftSize = 0;
+	std::atomic<int> m_requestedFftSize{ DEFAULT_FFT_SIZE };
+	std::unique_ptr<FFTPlan> m_fftPlan;
+	std::vector<float> m_window;
+	float m_magnitudeScale = 1.0f; // Normalizes magnitudes so a full-scale sine peaks at 1 whatever the size
+	std::vector<float> m_fftInput;
+	std::vector<std::complex<float>> m_spectrum;
 
-	std::chrono::steady_clock::time_point m_lastUpdateTime;
+	// Scratch, kept so an analysis hop never allocates
+	std::vector<float> m_processBuffer;
+	std::vector<float> m_stereoWindow;
+	std::vector<float> m_magnitudes;
 
-	// Mutex for thread safety
-	std::mutex m_bufferMutex;
+	// Views
+	std::shared_ptr<BarSpectrumView> m_bars;
+	std::vector<std::shared_ptr<AnalysisView>> m_views;
+	std::mutex m_viewsMutex;
 
-	int m_currentSampleRate;
+	// Worker
+	std::function<int64_t()> m_clock;
+	std::thread m_workerThread;
+	std::atomic<bool> m_running{ false };
 
+	void WorkerThreadFunc();
+	void ConfigureFft(int size);
+	void DrainTap(int64_t playingFrame);
+	bool Analyze(int64_t playingFrame);
 	void PerformFFT(const std::vector<float>& samples, std::vector<float>& magnitudes);
 
 public:
 	AudioVisualizer();
+	~AudioVisualizer();
+
+	// Called from audio streaming thread, wait-free. Blocks are dropped if analysis falls behind
+	void PushAudioData(const float* samples, size_t frameCount, int64_t startFrame, int channels, int sampleRate);
+
+	// Returns the stream frame currently being heard, polled by the worker every hop
+	void SetClock(std::function<int64_t()> clock)
+	{
+		m_clock = std::move(clock);
+	}
+
+	// Starts or stops the analysis worker, there is no point analyzing while nothing is shown
+	void SetRunning(bool running);
+
+	bool IsRunning() const
+	{
+		return m_running;
+	}
+
+	// Power of two, takes effect on the next hop. Larger sizes trade time resolution for frequency resolution
+	void SetFftSize(int size);
 
-	// Called from audio streaming thread
-	void PushAudioData(const std::vector<float>& buffer, int channels, int sampleRate);
+	int GetFftSize() const
+	{
+		return m_requestedFftSize;
+	}
 
-	// Called from main/rendering thread
-	bool Update();
-	void ProcessFFT(const std::vector<float>& samples);
+	// Views share the FFT of each hop, Process is called on the worker thread
+	void AddView(std::shared_ptr<AnalysisView> view);
+	void RemoveView(const std::shared_ptr<AnalysisView>& view);
 
-	const std::vector<float>& GetVisualizerData() const;
-	const std::vector<float>& GetBandPeaks() const;
+	BarSpectrumView& GetBars()
+	{
+		return *m_bars;
+	}
 };
@@ -0,0 +1,83 @@
+#include "pch.h"
+
+#include "BarRenderer.h"
+
+#include "dsp/FastMath.h"
+
+BarRenderer::BarRenderer(float curveExponent)
+      : m_curveExponent(curveExponent)
+{
+}
+
+void BarRenderer::ApplyCurve(const float* input, float* output, int count) const
+{
+	// Four bars at a time, clamped first so silence and overs stay on the curve. Zero comes out
+	// around 1e-27, well under a pixel
+	std::transform(input, input + count, output, [](float level) { return std::clamp(level, 0.0f, 1.0f); });
+	FastMath::Pow(output, output, static_cast<std::size_t>(count), m_curveExponent);
+}
+
+void BarRenderer::Draw(ImDrawList* drawList, const ImVec2& pos, const ImVec2& size, const float* levels, const float* peaks, int count)
+{
+	m_lastVertexCount = 0;
+	if (count <= 0)
+	{
+		return;
+	}
+
+	m_shapedLevels.resize(count);
+	m_shapedPeaks.resize(count);
+	ApplyCurve(levels, m_shapedLevels.data(), count);
+	ApplyCurve(peaks, m_shapedPeaks.data(), count);
+
+	const float fitWidth = (size.x - m_spacing * (count - 1)) / count;
+	const float barWidth = max(fitWidth, 1.0f);
+	const float step = barWidth + m_spacing;
+	const float centerY = pos.y + size.y * 0.5f;
+	const float scale = size.y * 0.95f * 0.5f; // Half height, bars grow both ways from the center
+	const float minHalfHeight = m_minHeight * 0.5f;
+
+	// A gradient bar and a one pixel peak line per band, 4 vertices and 6 indices each
+	const int vertexCount = count * 8;
+	const int indexCount = count * 12;
+	drawList->PrimReserve(indexCount, vertexCount);
+
+	ImDrawVert* vtx = drawList->_VtxWritePtr;
+	ImDrawIdx* idx = drawList->_IdxWritePtr;
+	unsigned int base = drawList->_VtxCurrentIdx;
+	const ImVec2 uv = drawList->_Data->TexUvWhitePixel;
+
+	auto writeQuad = [&](float x0, float y0, float x1, float y1, ImU32 topColor, ImU32 bottomColor)
+	{
+		vtx[0] = { ImVec2(x0, y0), uv, topColor };
+		vtx[1] = { ImVec2(x1, y0), uv, topColor };
+		vtx[2] = { ImVec2(x1, y1), uv, bottomColor };
+		vtx[3] = { ImVec2(x0, y1), uv, bottomColor };
+		idx[0] = static_cast<ImDrawIdx>(base);
+		idx[1] = static_cast<ImDrawIdx>(base + 1);
+		idx[2] = static_cast<ImDrawIdx>(base + 2);
+		idx[3] = static_cast<ImDrawIdx>(base);
+		idx[4] = static_cast<ImDrawIdx>(base + 2);
+		idx[5] = static_cast<ImDrawIdx>(base + 3);
+		vtx += 4;
+		idx += 6;
+		base += 4;
+	};
+
+	for (int i = 0; i < count; i++)
+	{
+		const float x0 = pos.x + step * i;
+		const float x1 = x0 + barWidth;
+
+		const float halfHeight = max(m_shapedLevels[i] * scale, minHalfHeight);
+		writeQuad(x0, centerY - halfHeight, x1, centerY + halfHeight, m_topColor, m_bottomColor);
+
+		const float peakY = centerY - m_shapedPeaks[i] * scale;
+		writeQuad(x0, peakY, x1, peakY + 1.0f, m_peakColor, m_peakColor);
+	}
+
+	drawList->_VtxWritePtr = vtx;
+	drawList->_IdxWritePtr = idx;
+	drawList->_VtxCurrentIdx = base;
+	m_lastVertexCount = vertexCount;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <vector>
+
+// Draws a row of mirrored bars with peak markers in one go. All quads are written straight into
+// a single reserved block of the draw list instead of going through an ImGui item per bar, so the
+// cost stays flat whether there are 23 bars or several hundred.
+class BarRenderer
+{
+public:
+	// Levels and peaks are shaped by level^exponent before drawing
+	explicit BarRenderer(float curveExponent = 0.7f);
+
+	void SetColors(ImU32 top, ImU32 bottom, ImU32 peak)
+	{
+		m_topColor = top;
+		m_bottomColor = bottom;
+		m_peakColor = peak;
+	}
+
+	void SetSpacing(float spacing)
+	{
+		m_spacing = spacing;
+	}
+
+	void SetMinHeight(float height)
+	{
+		m_minHeight = height;
+	}
+
+	// Levels and peaks in 0..1, bars are centered vertically in the rectangle at pos
+	void Draw(ImDrawList* drawList, const ImVec2& pos, const ImVec2& size, const float* levels, const float* peaks, int count);
+
+	int GetLastVertexCount() const
+	{
+		return m_lastVertexCount;
+	}
+
+private:
+	void ApplyCurve(const float* input, float* output, int count) const;
+
+	float m_curveExponent;
+	std::vector<float> m_shapedLevels;
+	std::vector<float> m_shapedPeaks;
+
+	ImU32 m_topColor = IM_COL32(255, 255, 255, 255);
+	ImU32 m_bottomColor = IM_COL32(255, 255, 255, 255);
+	ImU32 m_peakColor = IM_COL32(255, 255, 255, 255);
+	float m_spacing = 2.0f;
+	float m_minHeight = 2.0f;
+	int m_lastVertexCount = 0;
+};
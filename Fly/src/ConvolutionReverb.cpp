@@ -0,0 +1,477 @@
+#include "pch.h"
+
+#include "ConvolutionReverb.h"
+
+#include <sndfile.h>
+
+ConvolutionReverb::~ConvolutionReverb()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_prepareMutex);
+		m_prepareStop = true;
+	}
+	m_prepareWake.notify_all();
+	if (m_prepareThread.joinable())
+	{
+		m_prepareThread.join();
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_workerMutex);
+		m_workerStop = true;
+	}
+	m_workerWake.notify_all();
+	if (m_workerThread.joinable())
+	{
+		m_workerThread.join();
+	}
+}
+
+bool ConvolutionReverb::LoadImpulseResponse(const std::string& path)
+{
+	SF_INFO info{};
+	SNDFILE* file = sf_open(path.c_str(), SFM_READ, &info);
+	if (!file)
+	{
+		LOG_WARN("Failed to open impulse response {}: {}", path, sf_strerror(nullptr));
+		return false;
+	}
+
+	const unsigned int channels = static_cast<unsigned int>(info.channels);
+	const sf_count_t maxFrames = static_cast<sf_count_t>(MAX_SECONDS * static_cast<float>(info.samplerate));
+	std::vector<float> samples(static_cast<std::size_t>(min(info.frames, maxFrames)) * channels);
+	const sf_count_t framesRead = sf_readf_float(file, samples.data(), static_cast<sf_count_t>(samples.size() / max(channels, 1u)));
+	sf_close(file);
+
+	if (framesRead <= 0)
+	{
+		LOG_WARN("Impulse response {} holds no audio", path);
+		return false;
+	}
+	samples.resize(static_cast<std::size_t>(framesRead) * channels);
+	return SetImpulseResponse(std::move(samples), channels, static_cast<unsigned int>(info.samplerate), std::filesystem::path(path).stem().string());
+}
+
+bool ConvolutionReverb::SetImpulseResponse(std::vector<float> samples, unsigned int channels, unsigned int sampleRate, const std::string& name)
+{
+	if (channels == 0 || sampleRate == 0 || samples.size() < channels)
+	{
+		LOG_WARN("Impulse response {} holds no audio", name);
+		return false;
+	}
+
+	auto ir = std::make_shared<ImpulseResponse>();
+	ir->channels = channels;
+	ir->sampleRate = sampleRate;
+	ir->frames = min(samples.size() / channels, static_cast<std::size_t>(MAX_SECONDS * static_cast<float>(sampleRate)));
+	ir->samples = std::move(samples);
+	ir->samples.resize(ir->frames * ir->channels);
+
+	// Unit energy in the loudest channel, so responses of any length come out at a similar level
+	std::vector<double> energy(ir->channels, 0.0);
+	for (std::size_t i = 0; i < ir->samples.size(); i++)
+	{
+		energy[i % ir->channels] += static_cast<double>(ir->samples[i]) * ir->samples[i];
+	}
+	const double loudest = *std::max_element(energy.begin(), energy.end());
+	if (loudest > 0.0)
+	{
+		const float scale = static_cast<float>(1.0 / std::sqrt(loudest));
+		for (float& sample: ir->samples)
+		{
+			sample *= scale;
+		}
+	}
+
+	LOG_INFO("Loaded impulse response {}: {} channels, {} frames at {} Hz", name, ir->channels, ir->frames, ir->sampleRate);
+	m_irName = name;
+	m_irSeconds = static_cast<float>(ir->frames) / static_cast<float>(ir->sampleRate);
+	{
+		std::lock_guard<std::mutex> lock(m_prepareMutex);
+		m_pendingIr = std::move(ir);
+		m_irGeneration++;
+	}
+	m_prepareWake.notify_one();
+
+	if (!m_prepareThread.joinable())
+	{
+		m_prepareThread = std::thread(&ConvolutionReverb::PrepareThreadFunc, this);
+		SetThreadDescription(m_prepareThread.native_handle(), L"ConvolutionPrepare");
+	}
+	return true;
+}
+
+void ConvolutionReverb::SetMix(float mix)
+{
+	m_mix = std::clamp(mix, 0.0f, 1.0f);
+}
+
+void ConvolutionReverb::SetBlockSize(std::size_t frames)
+{
+	std::size_t blockSize = MIN_BLOCK_SIZE;
+	while (blockSize < frames && blockSize < MAX_BLOCK_SIZE)
+	{
+		blockSize <<= 1;
+	}
+	m_blockSize = blockSize;
+	m_prepareWake.notify_one();
+}
+
+std::function<void(std::vector<float>&, unsigned int, unsigned int)> ConvolutionReverb::CreateProcessor()
+{
+	return [this](std::vector<float>& buffer, unsigned int channels, unsigned int sampleRate)
+	{
+		Process(buffer, channels, sampleRate);
+	};
+}
+
+void ConvolutionReverb::Process(std::vector<float>& buffer, unsigned int channels, unsigned int sampleRate)
+{
+	if (channels == 0)
+		return;
+
+	// Prepared for even while the reverb is off, so switching it on only waits if the layout changed since
+	m_streamChannels.store(channels, std::memory_order_relaxed);
+	m_streamRate.store(sampleRate, std::memory_order_relaxed);
+
+	if (!m_enabled)
+	{
+		// By the time the reverb comes back whatever the convolution holds is long gone, have a fresh one built
+		if (m_active)
+		{
+			m_active = false;
+			m_stale = true;
+			m_restarts++;
+		}
+		m_latency = 0;
+		m_tailLength = 0;
+		return;
+	}
+	m_active = true;
+
+	if (m_hasPrepared.load(std::memory_order_acquire))
+	{
+		TakePrepared();
+	}
+
+	// Dry until there is a convolution for this stream, a new response or block size keeps the last one running meanwhile
+	if (!m_convolution || m_stale || m_convolution->channels != channels || m_convolution->sampleRate != sampleRate)
+	{
+		m_latency = 0;
+		m_tailLength = 0;
+		return;
+	}
+
+	Convolution& convolution = *m_convolution;
+	m_latency = convolution.headBlock;
+	m_tailLength = convolution.tailLength;
+
+	const std::size_t frames = buffer.size() / channels;
+	const std::size_t irChannels = convolution.headFilters.size();
+	std::vector<float>& wet = convolution.wet;
+	wet.resize(frames * channels);
+
+	// Head, each channel through its own small-block convolver
+	for (unsigned int channel = 0; channel < channels; channel++)
+	{
+		float* channelWet = wet.data() + channel * frames;
+		for (std::size_t frame = 0; frame < frames; frame++)
+		{
+			channelWet[frame] = buffer[frame * channels + channel];
+		}
+		convolution.heads[channel].Process(channelWet, frames, convolution.headFilters[channel % irChannels]);
+	}
+
+	// Tail, collected a block at a time for the worker. Its results are due once the head runs out,
+	// delayed by the head block like everything else, which is at least a stream buffer after the
+	// block was handed over
+	if (convolution.hasTail)
+	{
+		const std::size_t tail = convolution.tailBlock;
+		const std::size_t slots = convolution.tailSlots;
+		const std::size_t offset = convolution.headBlock + convolution.tailOffset;
+		for (std::size_t frame = 0; frame < frames; frame++)
+		{
+			const std::size_t n = convolution.frame + frame;
+			const std::size_t index = n % tail;
+			float* input = convolution.tailInput.data() + (((n / tail) % slots) * tail + index) * channels;
+			std::copy_n(buffer.data() + frame * channels, channels, input);
+			if (index == tail - 1)
+			{
+				SubmitTailBlock(convolution, n / tail);
+			}
+
+			if (n < offset)
+				continue;
+
+			const std::size_t block = (n - offset) / tail;
+			const std::size_t position = (n - offset) % tail;
+			if (position == 0)
+			{
+				WaitForTailBlock(convolution, block);
+			}
+			const float* output = convolution.tailOutput.data() + ((block % slots) * tail + position) * channels;
+			for (unsigned int channel = 0; channel < channels; channel++)
+			{
+				wet[channel * frames + frame] += output[channel];
+			}
+		}
+	}
+
+	// Mix with the dry signal, held back by the head block so the two line up
+	const float mix = m_mix;
+	const float dryGain = 1.0f - mix;
+	const std::size_t headBlock = convolution.headBlock;
+	for (std::size_t frame = 0; frame < frames; frame++)
+	{
+		for (unsigned int channel = 0; channel < channels; channel++)
+		{
+			float& sample = buffer[frame * channels + channel];
+			float& delayed = convolution.dryDelay[channel * headBlock + convolution.dryPosition];
+			const float dry = delayed;
+			delayed = sample;
+			sample = dry * dryGain + wet[channel * frames + frame] * mix;
+		}
+		convolution.dryPosition = convolution.dryPosition + 1 == headBlock ? 0 : convolution.dryPosition + 1;
+	}
+
+	convolution.frame += frames;
+}
+
+void ConvolutionReverb::TakePrepared()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_prepareMutex);
+		std::swap(m_convolution, m_prepared);
+		m_hasPrepared = false;
+	}
+
+	// Tail blocks still in flight for the old one finish into buffers nobody reads any more
+	{
+		std::lock_guard<std::mutex> lock(m_workerMutex);
+		m_tailConvolution = m_convolution;
+	}
+	m_stale = false;
+}
+
+std::shared_ptr<ConvolutionReverb::Convolution> ConvolutionReverb::Prepare(const ImpulseResponse& ir, const Layout& layout)
+{
+	auto convolution = std::make_shared<Convolution>();
+	Convolution& c = *convolution;
+	c.channels = layout.channels;
+	c.sampleRate = layout.sampleRate;
+	c.headBlock = layout.blockSize;
+	c.tailBlock = layout.blockSize * TAIL_RATIO;
+
+	// A tail block is handed over once its last frame arrives and its result is due at the tail
+	// offset plus the head block. Reaching a whole stream buffer past the first tail block keeps
+	// that in a later call than the hand-over, however the stream is cut
+	const std::size_t maxBufferFrames = AUDIO_STREAM_BUFFER_SIZE / layout.channels;
+	c.tailOffset = (maxBufferFrames + c.tailBlock - c.headBlock + c.headBlock - 1) / c.headBlock * c.headBlock;
+	c.tailSlots = (c.headBlock + c.tailOffset + c.tailBlock - 1) / c.tailBlock + 1;
+
+	// Head partitions cover the tail offset, the tail partitions the rest
+	FFTPlan headPlan(c.headBlock * 2);
+	FFTPlan tailPlan(c.tailBlock * 2);
+	std::size_t taps = 0;
+	c.headFilters.resize(ir.channels);
+	c.tailFilters.resize(ir.channels);
+	for (unsigned int channel = 0; channel < ir.channels; channel++)
+	{
+		const std::vector<float> response = ResampleChannel(ir, channel, layout.sampleRate);
+		taps = response.size();
+
+		c.headFilters[channel].blockSize = c.headBlock;
+		PartitionedConvolver::Prepare(headPlan, response.data(), min(taps, c.tailOffset), c.headFilters[channel]);
+
+		c.tailFilters[channel].blockSize = c.tailBlock;
+		if (taps > c.tailOffset)
+		{
+			PartitionedConvolver::Prepare(tailPlan, response.data() + c.tailOffset, taps - c.tailOffset, c.tailFilters[channel]);
+		}
+	}
+	c.hasTail = taps > c.tailOffset;
+	c.tailLength = static_cast<std::size_t>(std::ceil(static_cast<double>(ir.frames) * layout.sampleRate / ir.sampleRate));
+
+	c.heads.resize(layout.channels);
+	for (PartitionedConvolver& head: c.heads)
+	{
+		head.Configure(1, c.headBlock, c.headFilters[0].partitions);
+	}
+
+	if (c.hasTail)
+	{
+		c.tails.resize(layout.channels);
+		for (PartitionedConvolver& tail: c.tails)
+		{
+			tail.Configure(1, c.tailBlock, c.tailFilters[0].partitions);
+		}
+		c.tailInput.assign(c.tailSlots * c.tailBlock * layout.channels, 0.0f);
+		c.tailOutput.assign(c.tailSlots * c.tailBlock * layout.channels, 0.0f);
+		c.workerInput.resize(c.tailBlock);
+		c.workerOutput.resize(c.tailBlock);
+	}
+
+	c.dryDelay.assign(layout.channels * c.headBlock, 0.0f);
+	c.wet.reserve(AUDIO_STREAM_BUFFER_SIZE);
+
+	LOG_DEBUG("Convolution reverb prepared for {} channels at {} Hz, {} taps in blocks of {} and {} from tap {}", layout.channels, layout.sampleRate, taps, c.headBlock,
+	          c.tailBlock, c.tailOffset);
+	return convolution;
+}
+
+std::vector<float> ConvolutionReverb::ResampleChannel(const ImpulseResponse& ir, unsigned int channel, unsigned int sampleRate)
+{
+	auto tap = [&](std::int64_t index)
+	{
+		return index >= 0 && index < static_cast<std::int64_t>(ir.frames) ? ir.samples[static_cast<std::size_t>(index) * ir.channels + channel] : 0.0f;
+	};
+
+	if (ir.sampleRate == sampleRate)
+	{
+		std::vector<float> response(ir.frames);
+		for (std::size_t i = 0; i < ir.frames; i++)
+		{
+			response[i] = tap(static_cast<std::int64_t>(i));
+		}
+		return response;
+	}
+
+	// Catmull-Rom, scaled by the rate ratio so the response keeps its gain
+	const double ratio = static_cast<double>(ir.sampleRate) / static_cast<double>(sampleRate);
+	std::vector<float> response(static_cast<std::size_t>(std::ceil(static_cast<double>(ir.frames) / ratio)));
+	for (std::size_t i = 0; i < response.size(); i++)
+	{
+		const double position = static_cast<double>(i) * ratio;
+		const std::int64_t index = static_cast<std::int64_t>(position);
+		const float t = static_cast<float>(position - static_cast<double>(index));
+		const float p0 = tap(index - 1), p1 = tap(index), p2 = tap(index + 1), p3 = tap(index + 2);
+		const float value = p1 + 0.5f * t * (p2 - p0 + t * (2.0f * p0 - 5.0f * p1 + 4.0f * p2 - p3 + t * (3.0f * (p1 - p2) + p3 - p0)));
+		response[i] = value * static_cast<float>(ratio);
+	}
+	return response;
+}
+
+void ConvolutionReverb::SubmitTailBlock(Convolution& convolution, std::size_t block)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_workerMutex);
+		convolution.submitted = block + 1;
+	}
+	m_workerWake.notify_one();
+}
+
+void ConvolutionReverb::WaitForTailBlock(Convolution& convolution, std::size_t block)
+{
+	std::unique_lock<std::mutex> lock(m_workerMutex);
+	m_tailDone.wait(lock, [&]() { return convolution.completed > block; });
+}
+
+void ConvolutionReverb::PrepareThreadFunc()
+{
+	Layout prepared;
+	while (true)
+	{
+		Layout layout;
+		std::shared_ptr<const ImpulseResponse> ir;
+		std::shared_ptr<Convolution> released;
+		{
+			// The stream layout is only known to the processor, so it is polled rather than signalled and the audio thread never locks here
+			std::unique_lock<std::mutex> lock(m_prepareMutex);
+			auto current = [&]()
+			{
+				return Layout{ m_irGeneration, m_streamChannels.load(std::memory_order_relaxed), m_streamRate.load(std::memory_order_relaxed), m_blockSize, m_restarts };
+			};
+			m_prepareWake.wait_for(lock, std::chrono::milliseconds(50), [&]() { return m_prepareStop || current() != prepared; });
+			if (m_prepareStop)
+				return;
+
+			// Whatever the processor handed back is freed here, outside the lock
+			if (!m_hasPrepared)
+			{
+				released = std::move(m_prepared);
+			}
+
+			layout = current();
+			ir = m_pendingIr;
+		}
+		released.reset();
+
+		// Anything missing shows up as a layout change once it arrives
+		if (layout == prepared)
+			continue;
+		prepared = layout;
+		if (!ir || layout.channels == 0 || layout.sampleRate == 0)
+			continue;
+
+		[[maybe_unused]] auto start = std::chrono::steady_clock::now();
+		std::shared_ptr<Convolution> convolution = Prepare(*ir, layout);
+
+		if (convolution->hasTail && !m_workerThread.joinable())
+		{
+			m_workerThread = std::thread(&ConvolutionReverb::WorkerThreadFunc, this);
+			SetThreadDescription(m_workerThread.native_handle(), L"ConvolutionTail");
+		}
+
+		// An older one the processor never took is replaced, and freed here as well
+		{
+			std::lock_guard<std::mutex> lock(m_prepareMutex);
+			std::swap(m_prepared, convolution);
+			m_hasPrepared.store(true, std::memory_order_release);
+		}
+		convolution.reset();
+
+		LOG_DEBUG("Prepared {:.1f} s impulse response in {} ms", static_cast<float>(ir->frames) / static_cast<float>(ir->sampleRate),
+		          std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count());
+	}
+}
+
+void ConvolutionReverb::WorkerThreadFunc()
+{
+	while (true)
+	{
+		// Holding on to the convolution keeps it alive through a hand-over, it is released outside the lock
+		std::shared_ptr<Convolution> convolution;
+		std::size_t block = 0;
+		{
+			std::unique_lock<std::mutex> lock(m_workerMutex);
+			m_workerWake.wait(lock, [&]() { return m_workerStop || (m_tailConvolution && m_tailConvolution->completed < m_tailConvolution->submitted); });
+			if (m_workerStop)
+				return;
+
+			convolution = m_tailConvolution;
+			block = convolution->completed;
+		}
+
+		RunTailBlock(*convolution, block);
+
+		{
+			std::lock_guard<std::mutex> lock(m_workerMutex);
+			convolution->completed = block + 1;
+		}
+		m_tailDone.notify_all();
+	}
+}
+
+void ConvolutionReverb::RunTailBlock(Convolution& convolution, std::size_t block)
+{
+	const std::size_t tail = convolution.tailBlock;
+	const unsigned int channels = convolution.channels;
+	const float* input = convolution.tailInput.data() + (block % convolution.tailSlots) * tail * channels;
+	float* output = convolution.tailOutput.data() + (block % convolution.tailSlots) * tail * channels;
+
+	for (unsigned int channel = 0; channel < channels; channel++)
+	{
+		for (std::size_t frame = 0; frame < tail; frame++)
+		{
+			convolution.workerInput[frame] = input[frame * channels + channel];
+		}
+
+		convolution.tails[channel].ProcessBlock(convolution.workerInput.data(), convolution.workerOutput.data(), convolution.tailFilters[channel % convolution.tailFilters.size()]);
+
+		for (std::size_t frame = 0; frame < tail; frame++)
+		{
+			output[frame * channels + channel] = convolution.workerOutput[frame];
+		}
+	}
+}
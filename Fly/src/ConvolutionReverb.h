@@ -0,0 +1,214 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "dsp/FFTPlan.h"
+#include "dsp/PartitionedConvolver.h"
+
+// Software reverb that convolves the stream with a recorded impulse response, loaded with
+// libsndfile. The response is split in two: the head runs in small partitions on the streaming
+// thread, which keeps the latency at one head block, and everything after runs in partitions 8
+// times as long on a worker thread. The head reaches a whole stream buffer past the first tail
+// block, so a tail block is only due a buffer after it was handed over and the worker keeps up
+// across calls instead of the streaming thread waiting on it. Multi-second responses cost about as
+// much per sample as a short one.
+//
+// Resampling the response and transforming its partitions takes a while for long responses, so
+// that runs on a preparation thread. The processor keeps running the previous convolution until
+// the new one is ready, or passes the stream through dry if there is none for its layout.
+//
+// Mono responses are used for every channel, otherwise channel n runs through response channel n.
+class ConvolutionReverb
+{
+public:
+	static constexpr float MAX_SECONDS = 10.0f; // Longer responses are cut off
+	static constexpr std::size_t MIN_BLOCK_SIZE = 64;
+	static constexpr std::size_t MAX_BLOCK_SIZE = 4096;
+
+	ConvolutionReverb() = default;
+	~ConvolutionReverb();
+
+	ConvolutionReverb(const ConvolutionReverb&) = delete;
+	ConvolutionReverb& operator=(const ConvolutionReverb&) = delete;
+
+	// UI side. Reads and normalizes the response, the processor switches to it once it is prepared
+	bool LoadImpulseResponse(const std::string& path);
+
+	// UI side. The same for interleaved samples already in memory, at their own rate
+	bool SetImpulseResponse(std::vector<float> samples, unsigned int channels, unsigned int sampleRate, const std::string& name);
+
+	const std::string& GetImpulseResponseName() const
+	{
+		return m_irName;
+	}
+
+	float GetImpulseResponseSeconds() const
+	{
+		return m_irSeconds;
+	}
+
+	void SetEnabled(bool enabled)
+	{
+		m_enabled = enabled;
+	}
+
+	bool IsEnabled() const
+	{
+		return m_enabled;
+	}
+
+	// 0 is only the dry signal, 1 only the reverb
+	void SetMix(float mix);
+
+	float GetMix() const
+	{
+		return m_mix;
+	}
+
+	// Head partition in frames, a power of two from MIN_BLOCK_SIZE to MAX_BLOCK_SIZE. Smaller blocks
+	// cut latency and cost more per sample
+	void SetBlockSize(std::size_t frames);
+
+	std::size_t GetBlockSize() const
+	{
+		return m_blockSize;
+	}
+
+	// Frames the output trails the input by, one head block while running. The dry signal is delayed to match
+	std::size_t GetLatency() const
+	{
+		return m_latency;
+	}
+
+	// Frames the reverb keeps ringing after the input stops, the response length at the stream rate
+	// while running. The streamer flushes this much on top of the latency at the end of a stream
+	std::size_t GetTailLength() const
+	{
+		return m_tailLength;
+	}
+
+	// This will make it into a lambda function for the audio streamer
+	std::function<void(std::vector<float>&, unsigned int, unsigned int)> CreateProcessor();
+
+private:
+	struct ImpulseResponse
+	{
+		std::vector<float> samples; // Interleaved
+		unsigned int channels{ 0 };
+		unsigned int sampleRate{ 0 };
+		std::size_t frames{ 0 };
+	};
+
+	// What a convolution is built for. The restart count forces a fresh one after the reverb was off
+	struct Layout
+	{
+		unsigned int generation{ 0 };
+		unsigned int channels{ 0 };
+		unsigned int sampleRate{ 0 };
+		std::size_t blockSize{ 0 };
+		unsigned int restarts{ 0 };
+
+		bool operator==(const Layout&) const = default;
+	};
+
+	// Everything the processor and the worker run for one response, stream layout and block size,
+	// built on the preparation thread and handed over whole
+	struct Convolution
+	{
+		unsigned int channels{ 0 };
+		unsigned int sampleRate{ 0 };
+		std::size_t headBlock{ 0 };
+		std::size_t tailBlock{ 0 };
+		std::size_t tailOffset{ 0 }; // Taps the head covers, where the tail partitions start
+		std::size_t tailSlots{ 0 };
+		std::size_t tailLength{ 0 }; // Response length at the stream rate
+		bool hasTail{ false };
+
+		std::vector<PartitionedConvolver::Filter> headFilters; // Per response channel
+		std::vector<PartitionedConvolver::Filter> tailFilters;
+		std::vector<PartitionedConvolver> heads; // Per stream channel, mono, streaming thread
+		std::vector<PartitionedConvolver> tails; // Worker
+
+		std::vector<float> wet;      // [channel][frame] of the current buffer
+		std::vector<float> dryDelay; // [channel][frame], one head block
+		std::size_t dryPosition{ 0 };
+		std::size_t frame{ 0 }; // Frames processed
+
+		// Tail blocks, [slot][frame][channel]. Input is written here as it arrives and the worker
+		// leaves the result in the same slot of tailOutput
+		std::vector<float> tailInput;
+		std::vector<float> tailOutput;
+		std::vector<float> workerInput;
+		std::vector<float> workerOutput;
+
+		// Tail blocks handed to the worker and finished by it, under m_workerMutex
+		std::size_t submitted{ 0 };
+		std::size_t completed{ 0 };
+	};
+
+	static constexpr std::size_t TAIL_RATIO = 8; // Tail block over head block
+
+	void Process(std::vector<float>& buffer, unsigned int channels, unsigned int sampleRate);
+
+	// Streaming side, swaps in the prepared convolution. The one it replaces goes back for the preparation thread to free
+	void TakePrepared();
+
+	// Preparation side, resamples the response and sets up the partitions and buffers for the layout
+	static std::shared_ptr<Convolution> Prepare(const ImpulseResponse& ir, const Layout& layout);
+
+	// One response channel resampled to the stream rate
+	static std::vector<float> ResampleChannel(const ImpulseResponse& ir, unsigned int channel, unsigned int sampleRate);
+
+	// Hands a collected tail block to the worker, and waits for one to be done
+	void SubmitTailBlock(Convolution& convolution, std::size_t block);
+	void WaitForTailBlock(Convolution& convolution, std::size_t block);
+
+	void PrepareThreadFunc();
+	void WorkerThreadFunc();
+	static void RunTailBlock(Convolution& convolution, std::size_t block);
+
+	// UI side
+	std::string m_irName;
+	float m_irSeconds{ 0.0f };
+	std::atomic<bool> m_enabled{ false };
+	std::atomic<float> m_mix{ 0.3f };
+	std::atomic<std::size_t> m_blockSize{ 512 };
+	std::atomic<std::size_t> m_latency{ 0 };
+	std::atomic<std::size_t> m_tailLength{ 0 };
+
+	// Stream layout, set by the processor and polled by the preparation thread
+	std::atomic<unsigned int> m_streamChannels{ 0 };
+	std::atomic<unsigned int> m_streamRate{ 0 };
+	std::atomic<unsigned int> m_restarts{ 0 };
+
+	// Processor side
+	std::shared_ptr<Convolution> m_convolution;
+	bool m_active{ false }; // Enabled last buffer
+	bool m_stale{ false };  // The convolution ran before the reverb was switched off, wait for a fresh one
+
+	// Preparation thread, started with the first response. The prepared slot holds a new
+	// convolution while m_hasPrepared is set, otherwise whatever the processor handed back
+	std::thread m_prepareThread;
+	std::mutex m_prepareMutex;
+	std::condition_variable m_prepareWake;
+	std::shared_ptr<const ImpulseResponse> m_pendingIr;
+	std::atomic<unsigned int> m_irGeneration{ 0 };
+	std::shared_ptr<Convolution> m_prepared;
+	std::atomic<bool> m_hasPrepared{ false };
+	bool m_prepareStop{ false };
+
+	// Worker, started the first time a response has a tail. Runs the tail blocks of the convolution in use
+	std::thread m_workerThread;
+	std::mutex m_workerMutex;
+	std::condition_variable m_workerWake;
+	std::condition_variable m_tailDone;
+	std::shared_ptr<Convolution> m_tailConvolution;
+	bool m_workerStop{ false };
+};
@@ -0,0 +1,304 @@
+#include "pch.h"
+
+#include "Dynamics.h"
+
+#include <numbers>
+
+#include "dsp/FastMath.h"
+
+namespace
+{
+	// One pole smoothing coefficient for a time constant
+	float TimeConstant(float milliseconds, unsigned int sampleRate)
+	{
+		return FastMath::Exp2(-FastMath::LOG2_E * 1000.0f / (milliseconds * static_cast<float>(sampleRate)));
+	}
+}
+
+Dynamics::Dynamics()
+{
+	m_published.reset(m_settings);
+
+	// Same windowed sinc interpolator as the loudness meter's true-peak, each phase unity at DC
+	const int length = TRUE_PEAK_TAPS * 4;
+	const double center = (length - 1) * 0.5;
+	std::array<double, length> taps{};
+	for (int i = 0; i < length; i++)
+	{
+		double x = (i - center) / 4.0;
+		double sinc = x == 0.0 ? 1.0 : std::sin(std::numbers::pi * x) / (std::numbers::pi * x);
+		double phase = 2.0 * std::numbers::pi * i / (length - 1);
+		double blackman = 0.42 - 0.5 * std::cos(phase) + 0.08 * std::cos(2.0 * phase);
+		taps[i] = sinc * blackman;
+	}
+
+	std::array<double, 4> phaseSums{};
+	for (int i = 0; i < length; i++)
+	{
+		phaseSums[i % 4] += taps[i];
+	}
+
+	for (int k = 0; k < TRUE_PEAK_TAPS; k++)
+	{
+		m_truePeakTaps[k] = _mm_set_ps(static_cast<float>(taps[4 * k + 3] / phaseSums[3]), static_cast<float>(taps[4 * k + 2] / phaseSums[2]),
+		                               static_cast<float>(taps[4 * k + 1] / phaseSums[1]), static_cast<float>(taps[4 * k] / phaseSums[0]));
+	}
+}
+
+void Dynamics::SetSettings(const Settings& settings)
+{
+	m_settings = settings;
+	m_settings.thresholdDb = std::clamp(settings.thresholdDb, -60.0f, 0.0f);
+	m_settings.ratio = std::clamp(settings.ratio, 1.0f, 20.0f);
+	m_settings.attackMs = std::clamp(settings.attackMs, 0.1f, 200.0f);
+	m_settings.releaseMs = std::clamp(settings.releaseMs, 10.0f, 2000.0f);
+	m_settings.makeupDb = std::clamp(settings.makeupDb, 0.0f, 24.0f);
+	m_settings.ceilingDb = std::clamp(settings.ceilingDb, -12.0f, 0.0f);
+	m_settings.limiterReleaseMs = std::clamp(settings.limiterReleaseMs, 10.0f, 1000.0f);
+
+	m_published.back() = m_settings;
+	m_published.publish();
+}
+
+std::function<void(std::vector<float>&, unsigned int, unsigned int)> Dynamics::CreateProcessor()
+{
+	return [this](std::vector<float>& buffer, unsigned int channels, unsigned int sampleRate)
+	{
+		Process(buffer, channels, sampleRate);
+	};
+}
+
+void Dynamics::Process(std::vector<float>& buffer, unsigned int channels, unsigned int sampleRate)
+{
+	if (channels == 0 || sampleRate == 0)
+		return;
+
+	const bool updated = m_published.update();
+	if (updated)
+	{
+		m_active = m_published.front();
+	}
+
+	if (channels != m_channels || sampleRate != m_sampleRate)
+	{
+		Configure(channels, sampleRate);
+	}
+	else if (updated)
+	{
+		UpdateCoefficients();
+	}
+
+	const std::size_t frameCount = buffer.size() / channels;
+	if (m_active.compressorEnabled)
+	{
+		Compress(buffer.data(), frameCount);
+	}
+	else
+	{
+		m_reductionDb = 0.0f;
+		m_compressorReductionDb = 0.0f;
+	}
+
+	if (m_active.limiterEnabled)
+	{
+		// Coming back on, whatever the detector saw before it was switched off is long gone
+		if (!m_limiting)
+		{
+			std::fill(m_truePeakHistory.begin(), m_truePeakHistory.end(), 0.0f);
+			m_truePeakPosition = 0;
+			m_peaks.Clear();
+			m_limiting = true;
+			m_unity = false;
+		}
+		Limit(buffer.data(), frameCount);
+	}
+	else if (!m_unity)
+	{
+		// Switched off, let the gain release and then average back up to exactly unity
+		m_limiting = false;
+		Limit(buffer.data(), frameCount);
+		if (m_heldGain == 1.0f && m_smoothingSum >= static_cast<double>(m_lookahead) - 0.5e-4)
+		{
+			std::fill(m_smoothing.begin(), m_smoothing.end(), 1.0f);
+			m_smoothingSum = static_cast<double>(m_lookahead);
+			m_unity = true;
+		}
+	}
+	else
+	{
+		Delay(buffer.data(), frameCount);
+		m_limiterReductionDb = 0.0f;
+	}
+}
+
+void Dynamics::Configure(unsigned int channels, unsigned int sampleRate)
+{
+	m_channels = channels;
+	m_sampleRate = sampleRate;
+
+	m_reductionDb = 0.0f;
+
+	// A peak at frame p can show up in the detector anywhere from p to p + TRUE_PEAK_DELAY. The
+	// window covers all of that plus the lookahead, and the delay line makes the moving average
+	// reach its lowest just as frame p comes out
+	m_lookahead = max(static_cast<std::size_t>(LOOKAHEAD_MS * 0.001f * static_cast<float>(sampleRate)), static_cast<std::size_t>(1));
+	m_peaks.Configure(m_lookahead + TRUE_PEAK_DELAY);
+	m_smoothing.assign(m_lookahead, 1.0f);
+	m_smoothingSum = static_cast<double>(m_lookahead);
+	m_smoothingPosition = 0;
+	m_delay.assign((m_lookahead - 1 + TRUE_PEAK_DELAY) * channels, 0.0f);
+	m_delayPosition = 0;
+	m_heldGain = 1.0f;
+	m_limiting = false;
+	m_unity = true;
+	m_latency = m_delay.size() / channels;
+
+	m_truePeakHistory.assign(static_cast<std::size_t>(channels) * TRUE_PEAK_TAPS * 2, 0.0f);
+	m_truePeakPosition = 0;
+
+	UpdateCoefficients();
+
+	LOG_DEBUG("Dynamics configured for {} channels at {} Hz, {} frame lookahead", channels, sampleRate, m_lookahead);
+}
+
+void Dynamics::UpdateCoefficients()
+{
+	m_attack = TimeConstant(m_active.attackMs, m_sampleRate);
+	m_release = TimeConstant(m_active.releaseMs, m_sampleRate);
+	m_ceiling = FastMath::DbToLinear(m_active.ceilingDb);
+	m_limiterRelease = TimeConstant(m_active.limiterReleaseMs, m_sampleRate);
+}
+
+void Dynamics::Compress(float* samples, std::size_t frameCount)
+{
+	// Linked detector, the loudest channel of every frame
+	m_detector.resize(frameCount);
+	for (std::size_t n = 0; n < frameCount; n++)
+	{
+		const float* frame = samples + n * m_channels;
+		float peak = 0.0f;
+		for (unsigned int channel = 0; channel < m_channels; channel++)
+		{
+			peak = max(peak, std::abs(frame[channel]));
+		}
+		m_detector[n] = peak;
+	}
+	FastMath::LinearToDb(m_detector.data(), m_detector.data(), frameCount);
+
+	// Soft knee gain computer, then attack and release on the reduction itself
+	const float threshold = m_active.thresholdDb;
+	const float slope = 1.0f / m_active.ratio - 1.0f;
+	float deepest = 0.0f;
+	for (std::size_t n = 0; n < frameCount; n++)
+	{
+		const float over = m_detector[n] - threshold;
+		float target = 0.0f;
+		if (over >= KNEE_DB * 0.5f)
+		{
+			target = slope * over;
+		}
+		else if (over > -KNEE_DB * 0.5f)
+		{
+			const float into = over + KNEE_DB * 0.5f;
+			target = slope * into * into / (2.0f * KNEE_DB);
+		}
+
+		const float coefficient = target < m_reductionDb ? m_attack : m_release;
+		m_reductionDb = target + (m_reductionDb - target) * coefficient;
+		deepest = min(deepest, m_reductionDb);
+		m_detector[n] = m_reductionDb + m_active.makeupDb;
+	}
+	m_compressorReductionDb = deepest;
+
+	FastMath::DbToLinear(m_detector.data(), m_detector.data(), frameCount);
+	for (std::size_t n = 0; n < frameCount; n++)
+	{
+		float* frame = samples + n * m_channels;
+		const float gain = m_detector[n];
+		for (unsigned int channel = 0; channel < m_channels; channel++)
+		{
+			frame[channel] *= gain;
+		}
+	}
+}
+
+float Dynamics::DetectTruePeak(const float* frame)
+{
+	const __m128 signMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+	const int position = m_truePeakPosition;
+
+	__m128 peak = _mm_setzero_ps();
+	for (unsigned int channel = 0; channel < m_channels; channel++)
+	{
+		float* history = m_truePeakHistory.data() + static_cast<std::size_t>(channel) * TRUE_PEAK_TAPS * 2;
+		history[position] = frame[channel];
+		history[position + TRUE_PEAK_TAPS] = frame[channel];
+
+		// history[position + TRUE_PEAK_TAPS - k] is x[n - k]
+		const float* newest = history + position + TRUE_PEAK_TAPS;
+		__m128 acc = _mm_setzero_ps();
+		for (int k = 0; k < TRUE_PEAK_TAPS; k++)
+		{
+			acc = _mm_add_ps(acc, _mm_mul_ps(m_truePeakTaps[k], _mm_set1_ps(newest[-k])));
+		}
+		peak = _mm_max_ps(peak, _mm_and_ps(acc, signMask));
+		peak = _mm_max_ps(peak, _mm_and_ps(_mm_set1_ps(frame[channel]), signMask));
+	}
+	m_truePeakPosition = position + 1 == TRUE_PEAK_TAPS ? 0 : position + 1;
+
+	peak = _mm_max_ps(peak, _mm_movehl_ps(peak, peak));
+	peak = _mm_max_ss(peak, _mm_shuffle_ps(peak, peak, _MM_SHUFFLE(1, 1, 1, 1)));
+	return _mm_cvtss_f32(peak);
+}
+
+void Dynamics::Limit(float* samples, std::size_t frameCount)
+{
+	const std::size_t delayFrames = m_delay.size() / m_channels;
+	const float inverseLookahead = 1.0f / static_cast<float>(m_lookahead);
+	float lowest = 1.0f;
+
+	for (std::size_t n = 0; n < frameCount; n++)
+	{
+		float* frame = samples + n * m_channels;
+
+		// Gain the loudest peak in the window needs, taken at once and let go of slowly. Close to
+		// unity the release step rounds away, so a release that stalls snaps the rest of the way
+		const float peak = m_limiting ? m_peaks.Push(DetectTruePeak(frame)) : 0.0f;
+		const float needed = peak > m_ceiling ? m_ceiling / peak : 1.0f;
+		const float released = needed + (m_heldGain - needed) * m_limiterRelease;
+		m_heldGain = needed < m_heldGain || released == m_heldGain ? needed : released;
+
+		// Moving average over the lookahead turns the step into a ramp that bottoms out on the peak
+		m_smoothingSum += m_heldGain - m_smoothing[m_smoothingPosition];
+		m_smoothing[m_smoothingPosition] = m_heldGain;
+		m_smoothingPosition = m_smoothingPosition + 1 == m_lookahead ? 0 : m_smoothingPosition + 1;
+		const float gain = min(static_cast<float>(m_smoothingSum) * inverseLookahead, 1.0f);
+		lowest = min(lowest, gain);
+
+		float* delayed = m_delay.data() + m_delayPosition * m_channels;
+		for (unsigned int channel = 0; channel < m_channels; channel++)
+		{
+			const float input = frame[channel];
+			frame[channel] = delayed[channel] * gain;
+			delayed[channel] = input;
+		}
+		m_delayPosition = m_delayPosition + 1 == delayFrames ? 0 : m_delayPosition + 1;
+	}
+
+	m_limiterReductionDb = FastMath::LinearToDb(lowest);
+}
+
+void Dynamics::Delay(float* samples, std::size_t frameCount)
+{
+	const std::size_t delayFrames = m_delay.size() / m_channels;
+	for (std::size_t n = 0; n < frameCount; n++)
+	{
+		float* frame = samples + n * m_channels;
+		float* delayed = m_delay.data() + m_delayPosition * m_channels;
+		for (unsigned int channel = 0; channel < m_channels; channel++)
+		{
+			std::swap(frame[channel], delayed[channel]);
+		}
+		m_delayPosition = m_delayPosition + 1 == delayFrames ? 0 : m_delayPosition + 1;
+	}
+}
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <vector>
+
+#include <xmmintrin.h>
+
+#include "containers/SlidingMax.h"
+#include "containers/TripleBuffer.h"
+
+// Dynamics at the end of the effect chain: a compressor, then a brickwall limiter that keeps the
+// true peak under a ceiling so boosted tone and EQ settings never reach the clamp of the output
+// conversion.
+//
+// The compressor is feed-forward and stereo linked, soft knee, with its detector run through
+// FastMath's SIMD dB conversions. The limiter looks ahead: every frame's peak is estimated at 4x
+// oversampling, all four phases of a channel in one SSE register, and a sliding window maximum
+// over the lookahead finds the deepest cut coming up. That cut is held, released slowly and
+// smoothed over the lookahead, so the gain is already down when the peak leaves the delay line.
+// The delay line is the limiter's latency. It keeps running with the limiter off and the gain
+// releases back to unity instead, so switching the limiter never clicks or moves the clock.
+class Dynamics
+{
+public:
+	struct Settings
+	{
+		bool compressorEnabled{ false };
+		float thresholdDb{ -18.0f }; // -60 to 0
+		float ratio{ 3.0f };         // 1 to 20
+		float attackMs{ 10.0f };     // 0.1 to 200
+		float releaseMs{ 150.0f };   // 10 to 2000
+		float makeupDb{ 0.0f };      // 0 to 24
+
+		bool limiterEnabled{ true };
+		float ceilingDb{ -1.0f };         // -12 to 0, dBTP
+		float limiterReleaseMs{ 80.0f }; // 10 to 1000
+	};
+
+	static constexpr float LOOKAHEAD_MS = 5.0f;
+	static constexpr float KNEE_DB = 6.0f;
+
+	Dynamics();
+
+	Dynamics(const Dynamics&) = delete;
+	Dynamics& operator=(const Dynamics&) = delete;
+
+	const Settings& GetSettings() const
+	{
+		return m_settings;
+	}
+
+	// Clamped to the ranges above, taken up by the processor at its next buffer
+	void SetSettings(const Settings& settings);
+
+	// Frames the output trails the input by, the lookahead whether the limiter is on or not
+	std::size_t GetLatency() const
+	{
+		return m_latency;
+	}
+
+	// Deepest gain reduction of the last buffer processed, for metering. Zero or negative dB
+	float GetCompressorReduction() const
+	{
+		return m_compressorReductionDb;
+	}
+
+	float GetLimiterReduction() const
+	{
+		return m_limiterReductionDb;
+	}
+
+	// This will make it into a lambda function for the audio streamer
+	std::function<void(std::vector<float>&, unsigned int, unsigned int)> CreateProcessor();
+
+private:
+	static constexpr int TRUE_PEAK_TAPS = 12;  // Per phase, 48 tap interpolator
+	static constexpr int TRUE_PEAK_DELAY = 6; // Input frames the interpolated phases lag by, rounded up
+
+	void Process(std::vector<float>& buffer, unsigned int channels, unsigned int sampleRate);
+
+	// Sizes the lookahead and the detector history for the layout, clears all state
+	void Configure(unsigned int channels, unsigned int sampleRate);
+
+	// Applies the settings to the time constants, state is kept
+	void UpdateCoefficients();
+
+	void Compress(float* samples, std::size_t frameCount);
+
+	// Through the delay line at the limiter's gain. With the limiter off nothing is detected and the gain releases towards unity
+	void Limit(float* samples, std::size_t frameCount);
+
+	// Through the delay line alone, once the gain has released all the way
+	void Delay(float* samples, std::size_t frameCount);
+
+	// Highest absolute value over the channels of the frame itself and of four points interpolated
+	// at quarter frames about TRUE_PEAK_DELAY frames back
+	float DetectTruePeak(const float* frame);
+
+	// UI side
+	Settings m_settings;
+	TripleBuffer<Settings> m_published;
+
+	// Processor side
+	Settings m_active;
+	unsigned int m_channels{ 0 };
+	unsigned int m_sampleRate{ 0 };
+	std::atomic<std::size_t> m_latency{ 0 };
+	std::atomic<float> m_compressorReductionDb{ 0.0f };
+	std::atomic<float> m_limiterReductionDb{ 0.0f };
+
+	// Compressor, gain reduction in dB smoothed towards the gain computer's target
+	float m_attack{ 0.0f };
+	float m_release{ 0.0f };
+	float m_reductionDb{ 0.0f };
+	std::vector<float> m_detector; // Per frame of the current buffer, linear then dB then gain
+
+	// Limiter
+	__m128 m_truePeakTaps[TRUE_PEAK_TAPS]{};
+	std::vector<float> m_truePeakHistory; // [channel][2 * TRUE_PEAK_TAPS], doubled so the window is contiguous
+	int m_truePeakPosition{ 0 };
+	SlidingMax<float> m_peaks;
+	bool m_limiting{ false }; // Detecting, the limiter was on last buffer
+	bool m_unity{ true };     // Off and fully released, the buffer only goes through the delay line
+	float m_ceiling{ 1.0f };
+	float m_limiterRelease{ 0.0f };
+	float m_heldGain{ 1.0f };       // Deepest cut in the lookahead, released slowly once it passes
+	std::vector<float> m_smoothing; // Last lookahead of held gains, for the moving average
+	double m_smoothingSum{ 0.0 };
+	std::size_t m_smoothingPosition{ 0 };
+	std::vector<float> m_delay; // [frame][channel], the lookahead
+	std::size_t m_delayPosition{ 0 };
+	std::size_t m_lookahead{ 0 };
+};
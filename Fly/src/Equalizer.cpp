@@ -0,0 +1,587 @@
+#include "pch.h"
+
+#include "Equalizer.h"
+
+#include <chrono>
+#include <fstream>
+#include <numbers>
+#include <sstream>
+
+#include "dsp/BiquadDesign.h"
+#include "dsp/FastMath.h"
+
+// ISO octave and third-octave centres, with the Q that makes neighbouring peaks meet around -3 dB
+static constexpr std::array<float, 10> GRAPHIC10_FREQUENCIES = { 31.5f, 63.0f, 125.0f, 250.0f, 500.0f, 1000.0f, 2000.0f, 4000.0f, 8000.0f, 16000.0f };
+static constexpr std::array<float, 31> GRAPHIC31_FREQUENCIES = { 20.0f,   25.0f,   31.5f,   40.0f,   50.0f,   63.0f,   80.0f,   100.0f,  125.0f,  160.0f,  200.0f,
+	                                                             250.0f,  315.0f,  400.0f,  500.0f,  630.0f,  800.0f,  1000.0f, 1250.0f, 1600.0f, 2000.0f, 2500.0f,
+	                                                             3150.0f, 4000.0f, 5000.0f, 6300.0f, 8000.0f, 10000.0f, 12500.0f, 16000.0f, 20000.0f };
+static constexpr float GRAPHIC10_Q = 1.41f;
+static constexpr float GRAPHIC31_Q = 4.32f;
+
+// Below this a peak or shelf is inaudible and the band is skipped
+static constexpr float FLAT_GAIN_DB = 0.05f;
+
+struct NamedToken
+{
+	const char* token; // Preset files
+	const char* name;  // UI
+};
+
+static constexpr std::array<NamedToken, 6> BAND_TYPES = { { { "peak", "Peak" },
+	                                                           { "lowshelf", "Low Shelf" },
+	                                                           { "highshelf", "High Shelf" },
+	                                                           { "notch", "Notch" },
+	                                                           { "highpass", "High Pass" },
+	                                                           { "lowpass", "Low Pass" } } };
+
+static constexpr std::array<NamedToken, 4> MODES = { { { "off", "Off" }, { "graphic10", "10 Band" }, { "graphic31", "31 Band" }, { "parametric", "Parametric" } } };
+
+Equalizer::Equalizer()
+{
+	m_published.reset(m_settings);
+}
+
+Equalizer::~Equalizer()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_designMutex);
+		m_designStop = true;
+	}
+	m_designWake.notify_all();
+	if (m_designThread.joinable())
+	{
+		m_designThread.join();
+	}
+}
+
+void Equalizer::SetMode(Mode mode)
+{
+	// Off only bypasses, the bands stay as they were for when the EQ is switched back on
+	if (mode != Mode::Off && mode != m_layoutMode)
+	{
+		if (m_layoutMode == Mode::Parametric)
+		{
+			m_parametricBands = m_settings.bands;
+			m_parametricBandCount = m_settings.bandCount;
+		}
+
+		if (mode == Mode::Parametric)
+		{
+			m_settings.bands = m_parametricBands;
+			m_settings.bandCount = m_parametricBandCount;
+		}
+		else
+		{
+			LayoutGraphic(m_settings, mode);
+		}
+		m_layoutMode = mode;
+	}
+
+	m_settings.mode = mode;
+	Publish();
+}
+
+void Equalizer::SetBand(size_t index, const Band& band)
+{
+	if (index >= m_settings.bandCount)
+		return;
+
+	m_settings.bands[index] = Sanitize(band);
+	Publish();
+}
+
+bool Equalizer::AddBand(const Band& band)
+{
+	if (m_layoutMode != Mode::Parametric || m_settings.bandCount >= MAX_BANDS)
+		return false;
+
+	m_settings.bandCount++;
+	SetBand(m_settings.bandCount - 1, band);
+	return true;
+}
+
+void Equalizer::RemoveBand(size_t index)
+{
+	if (m_layoutMode != Mode::Parametric || index >= m_settings.bandCount)
+		return;
+
+	std::copy(m_settings.bands.begin() + index + 1, m_settings.bands.begin() + m_settings.bandCount, m_settings.bands.begin() + index);
+	m_settings.bandCount--;
+	Publish();
+}
+
+void Equalizer::SetPreamp(float gainDb)
+{
+	m_settings.preampDb = std::clamp(gainDb, -MAX_GAIN_DB, MAX_GAIN_DB);
+	Publish();
+}
+
+void Equalizer::SetLinearPhase(bool enabled)
+{
+	if (enabled && !m_designThread.joinable())
+	{
+		m_designThread = std::thread(&Equalizer::DesignThreadFunc, this);
+	}
+
+	m_settings.linearPhase = enabled;
+	Publish();
+}
+
+void Equalizer::Flatten()
+{
+	for (size_t i = 0; i < m_settings.bandCount; i++)
+	{
+		m_settings.bands[i].gainDb = 0.0f;
+	}
+	m_settings.preampDb = 0.0f;
+	Publish();
+}
+
+const std::vector<Equalizer::BuiltinPreset>& Equalizer::GetBuiltinPresets()
+{
+	static const std::vector<BuiltinPreset> presets = {
+		{ "Flat", { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 } },
+		{ "Bass Boost", { 6, 5, 4, 2, 0, 0, 0, 0, 0, 0 } },
+		{ "Treble Boost", { 0, 0, 0, 0, 0, 1, 2, 4, 5, 6 } },
+		{ "Vocal", { -2, -2, -1, 1, 3, 3, 2, 1, 0, -1 } },
+		{ "Loudness", { 5, 4, 2, 0, -1, -1, 0, 2, 4, 5 } },
+		{ "Rock", { 4, 3, 2, 0, -1, -1, 1, 2, 3, 4 } },
+		{ "Classical", { 0, 0, 0, 0, 0, 0, -2, -3, -3, -4 } },
+	};
+	return presets;
+}
+
+void Equalizer::ApplyBuiltinPreset(const BuiltinPreset& preset)
+{
+	if (m_layoutMode != Mode::Graphic10 && m_layoutMode != Mode::Graphic31)
+	{
+		SetMode(Mode::Graphic10);
+	}
+	else if (m_settings.mode == Mode::Off)
+	{
+		m_settings.mode = m_layoutMode;
+	}
+
+	// The 31-band layout reads the curve at its own centres, interpolating in octaves
+	for (size_t i = 0; i < m_settings.bandCount; i++)
+	{
+		const float octave = FastMath::Log2(m_settings.bands[i].frequency / GRAPHIC10_FREQUENCIES[0]);
+		const float position = std::clamp(octave, 0.0f, static_cast<float>(GRAPHIC10_FREQUENCIES.size() - 1));
+		const size_t lower = min(static_cast<size_t>(position), GRAPHIC10_FREQUENCIES.size() - 2);
+		const float fraction = position - static_cast<float>(lower);
+		m_settings.bands[i].gainDb = preset.gainsDb[lower] + (preset.gainsDb[lower + 1] - preset.gainsDb[lower]) * fraction;
+	}
+	m_settings.preampDb = 0.0f;
+	Publish();
+}
+
+bool Equalizer::SavePreset(const std::string& path) const
+{
+	std::ofstream file(path);
+	if (!file)
+	{
+		LOG_ERROR("Failed to write EQ preset {}", path);
+		return false;
+	}
+
+	file << "# Fly equalizer preset\n";
+	// Nothing laid out yet saves as an empty parametric curve
+	const Mode mode = m_layoutMode == Mode::Off ? Mode::Parametric : m_layoutMode;
+	file << std::format("mode {}\n", MODES[static_cast<size_t>(mode)].token);
+	file << std::format("preamp {:.2f}\n", m_settings.preampDb);
+	for (size_t i = 0; i < m_settings.bandCount; i++)
+	{
+		const Band& band = m_settings.bands[i];
+		file << std::format("band {} {:.2f} {:.3f} {:.2f} {}\n", BAND_TYPES[static_cast<size_t>(band.type)].token, band.frequency, band.q, band.gainDb, band.enabled ? "on" : "off");
+	}
+
+	LOG_INFO("Saved EQ preset {}", path);
+	return true;
+}
+
+bool Equalizer::LoadPreset(const std::string& path)
+{
+	std::ifstream file(path);
+	if (!file)
+	{
+		LOG_ERROR("Failed to open EQ preset {}", path);
+		return false;
+	}
+
+	Settings loaded;
+	loaded.mode = Mode::Parametric;
+
+	std::string rawLine;
+	size_t lineNumber = 0;
+	while (std::getline(file, rawLine))
+	{
+		lineNumber++;
+		std::istringstream line(rawLine);
+		std::string command;
+		line >> command;
+
+		if (command.empty() || command[0] == '#')
+			continue;
+
+		if (command == "mode")
+		{
+			std::string token;
+			line >> token;
+			auto mode = std::find_if(MODES.begin(), MODES.end(), [&](const NamedToken& info) { return token == info.token; });
+			if (mode == MODES.end() || mode == MODES.begin())
+			{
+				LOG_ERROR("EQ preset {} line {}: unknown mode '{}'", path, lineNumber, token);
+				return false;
+			}
+			loaded.mode = static_cast<Mode>(mode - MODES.begin());
+		}
+		else if (command == "preamp")
+		{
+			line >> loaded.preampDb;
+		}
+		else if (command == "band")
+		{
+			std::string typeToken, state;
+			Band band;
+			line >> typeToken >> band.frequency >> band.q >> band.gainDb >> state;
+			auto type = std::find_if(BAND_TYPES.begin(), BAND_TYPES.end(), [&](const NamedToken& info) { return typeToken == info.token; });
+			if (!line || type == BAND_TYPES.end() || loaded.bandCount >= MAX_BANDS)
+			{
+				LOG_ERROR("EQ preset {} line {}: bad band '{}'", path, lineNumber, rawLine);
+				return false;
+			}
+			band.type = static_cast<BandType>(type - BAND_TYPES.begin());
+			band.enabled = state != "off";
+			loaded.bands[loaded.bandCount++] = band;
+		}
+		else
+		{
+			LOG_WARN("EQ preset {} line {}: ignoring '{}'", path, lineNumber, command);
+		}
+	}
+
+	// Graphic presets only carry gains that have to line up with the fixed layout
+	if (loaded.mode != Mode::Parametric)
+	{
+		Settings layout;
+		LayoutGraphic(layout, loaded.mode);
+		if (layout.bandCount != loaded.bandCount)
+		{
+			LOG_ERROR("EQ preset {} has {} bands, its mode needs {}", path, loaded.bandCount, layout.bandCount);
+			return false;
+		}
+	}
+
+	SetMode(loaded.mode);
+	for (size_t i = 0; i < loaded.bandCount; i++)
+	{
+		m_settings.bands[i] = Sanitize(loaded.bands[i]);
+	}
+	m_settings.bandCount = loaded.bandCount;
+	m_settings.preampDb = std::clamp(loaded.preampDb, -MAX_GAIN_DB, MAX_GAIN_DB);
+	Publish();
+
+	LOG_INFO("Loaded EQ preset {} ({}, {} bands)", path, GetModeName(loaded.mode), loaded.bandCount);
+	return true;
+}
+
+const char* Equalizer::GetBandTypeName(BandType type)
+{
+	return BAND_TYPES[static_cast<size_t>(type)].name;
+}
+
+const char* Equalizer::GetModeName(Mode mode)
+{
+	return MODES[static_cast<size_t>(mode)].name;
+}
+
+void Equalizer::LayoutGraphic(Settings& settings, Mode mode)
+{
+	const float* frequencies = mode == Mode::Graphic31 ? GRAPHIC31_FREQUENCIES.data() : GRAPHIC10_FREQUENCIES.data();
+	settings.bandCount = mode == Mode::Graphic31 ? GRAPHIC31_FREQUENCIES.size() : GRAPHIC10_FREQUENCIES.size();
+	for (size_t i = 0; i < settings.bandCount; i++)
+	{
+		settings.bands[i] = Band{ BandType::Peak, frequencies[i], mode == Mode::Graphic31 ? GRAPHIC31_Q : GRAPHIC10_Q, 0.0f, true };
+	}
+}
+
+Equalizer::Band Equalizer::Sanitize(const Band& band)
+{
+	Band result = band;
+	result.frequency = std::clamp(band.frequency, 10.0f, 22000.0f);
+	result.q = std::clamp(band.q, 0.1f, 18.0f);
+	result.gainDb = std::clamp(band.gainDb, -MAX_GAIN_DB, MAX_GAIN_DB);
+	return result;
+}
+
+bool Equalizer::IsFlat(const Band& band, float sampleRate)
+{
+	// Bands at or past Nyquist can't be realized, a low pass up there would pass everything anyway
+	if (!band.enabled || band.frequency >= sampleRate * 0.49f)
+		return true;
+
+	switch (band.type)
+	{
+		case BandType::Peak:
+		case BandType::LowShelf:
+		case BandType::HighShelf:
+			return std::abs(band.gainDb) < FLAT_GAIN_DB;
+		default:
+			return false;
+	}
+}
+
+BiquadCoefficients Equalizer::Design(const Band& band, float sampleRate)
+{
+	switch (band.type)
+	{
+		case BandType::LowShelf:
+			return BiquadDesign::LowShelf(band.frequency, band.q, band.gainDb, sampleRate);
+		case BandType::HighShelf:
+			return BiquadDesign::HighShelf(band.frequency, band.q, band.gainDb, sampleRate);
+		case BandType::Notch:
+			return BiquadDesign::Notch(band.frequency, band.q, sampleRate);
+		case BandType::HighPass:
+			return BiquadDesign::HighPass(band.frequency, band.q, sampleRate);
+		case BandType::LowPass:
+			return BiquadDesign::LowPass(band.frequency, band.q, sampleRate);
+		default:
+			return BiquadDesign::Peak(band.frequency, band.q, band.gainDb, sampleRate);
+	}
+}
+
+void Equalizer::Publish()
+{
+	m_published.back() = m_settings;
+	m_published.publish();
+
+	if (m_settings.linearPhase)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_designMutex);
+			m_designSettings = m_settings;
+			m_designPending = true;
+		}
+		m_designWake.notify_one();
+	}
+}
+
+void Equalizer::Rebuild(unsigned int channels, unsigned int sampleRate)
+{
+	// Every band owns a section, so a band keeps its filter state while its neighbours come and go
+	if (m_cascade.GetChannelCount() != channels)
+	{
+		m_cascade.Configure(channels, MAX_BANDS);
+	}
+
+	const Settings& settings = m_published.front();
+	const float rate = static_cast<float>(sampleRate);
+	size_t active = 0;
+	for (size_t i = 0; i < MAX_BANDS; i++)
+	{
+		const bool run = settings.mode != Mode::Off && i < settings.bandCount && !IsFlat(settings.bands[i], rate);
+		m_cascade.SetSectionEnabled(i, run);
+		if (run)
+		{
+			m_cascade.SetSection(i, Design(settings.bands[i], rate));
+			active++;
+		}
+	}
+
+	m_preampGain = settings.mode == Mode::Off ? 1.0f : FastMath::DbToLinear(settings.preampDb);
+	m_activeBandCount = active;
+	m_rate = sampleRate;
+	m_designRate = sampleRate;
+
+	// Coming back to linear phase, whatever is left in the convolver is long stale
+	const bool linearPhase = settings.linearPhase && settings.mode != Mode::Off;
+	if (linearPhase && !m_linearPhase)
+	{
+		m_convolver.Reset();
+	}
+	m_linearPhase = linearPhase;
+	if (!m_linearPhase)
+	{
+		m_latency = 0;
+	}
+}
+
+void Equalizer::ProcessLinearPhase(std::vector<float>& buffer, unsigned int channels)
+{
+	int current = m_currentFir.load(std::memory_order_relaxed);
+	const int ready = m_readyFir.load(std::memory_order_acquire);
+
+	// The first FIR of a stream, or one for a new rate or layout, starts cold rather than crossfading
+	const bool restart = ready >= 0 && (current < 0 || m_firs[ready].blockSize != m_convolver.GetBlockSize() || channels != m_convolver.GetChannelCount());
+	if (restart)
+	{
+		m_convolver.Configure(channels, m_firs[ready].blockSize, m_firs[ready].partitions);
+		current = ready;
+		m_currentFir.store(current, std::memory_order_release);
+		m_readyFir.store(-1, std::memory_order_release);
+	}
+
+	// Dry until the worker has delivered the first design
+	if (current < 0)
+		return;
+
+	const PartitionedConvolver::Filter& fir = m_firs[current];
+	if (channels != m_convolver.GetChannelCount())
+	{
+		m_convolver.Configure(channels, fir.blockSize, fir.partitions);
+	}
+
+	const size_t frames = buffer.size() / channels;
+	if (ready >= 0 && !restart)
+	{
+		if (m_convolver.Process(buffer.data(), frames, fir, &m_firs[ready]))
+		{
+			m_currentFir.store(ready, std::memory_order_release);
+			m_readyFir.store(-1, std::memory_order_release);
+		}
+	}
+	else
+	{
+		m_convolver.Process(buffer.data(), frames, fir);
+	}
+
+	// One block of buffering plus the group delay of the symmetric FIR
+	m_latency = m_convolver.GetLatency() + fir.blockSize * fir.partitions / 2;
+}
+
+size_t Equalizer::GetFirLength(unsigned int sampleRate)
+{
+	size_t length = 1024;
+	while (length < sampleRate / 6)
+	{
+		length <<= 1;
+	}
+	return length;
+}
+
+void Equalizer::DesignFir(const Settings& settings, unsigned int sampleRate, PartitionedConvolver::Filter& filter)
+{
+	const size_t length = GetFirLength(sampleRate);
+	const size_t bins = length / 2 + 1;
+	const float rate = static_cast<float>(sampleRate);
+
+	// Magnitude of the whole curve at every bin, the product of what each band's biquad would do
+	struct Rotation
+	{
+		double cos1, sin1, cos2, sin2;
+	};
+	std::vector<Rotation> rotations(bins);
+	for (size_t k = 0; k < bins; k++)
+	{
+		const double w = 2.0 * std::numbers::pi * static_cast<double>(k) / static_cast<double>(length);
+		rotations[k] = { std::cos(w), std::sin(w), std::cos(2.0 * w), std::sin(2.0 * w) };
+	}
+
+	std::vector<double> magnitude(bins, 1.0);
+	for (size_t i = 0; i < settings.bandCount; i++)
+	{
+		if (settings.mode == Mode::Off || IsFlat(settings.bands[i], rate))
+			continue;
+
+		const BiquadCoefficients c = Design(settings.bands[i], rate);
+		for (size_t k = 0; k < bins; k++)
+		{
+			const Rotation& r = rotations[k];
+			const double numRe = c.b0 + c.b1 * r.cos1 + c.b2 * r.cos2;
+			const double numIm = c.b1 * r.sin1 + c.b2 * r.sin2;
+			const double denRe = 1.0 + c.a1 * r.cos1 + c.a2 * r.cos2;
+			const double denIm = c.a1 * r.sin1 + c.a2 * r.sin2;
+			magnitude[k] *= std::sqrt((numRe * numRe + numIm * numIm) / (denRe * denRe + denIm * denIm));
+		}
+	}
+
+	// Zero phase spectrum back to time, centred and windowed into a symmetric FIR with a delay of length / 2
+	FFTPlan plan(length);
+	std::vector<std::complex<float>> spectrum(bins);
+	for (size_t k = 0; k < bins; k++)
+	{
+		spectrum[k] = { static_cast<float>(magnitude[k]), 0.0f };
+	}
+	std::vector<float> impulse(length);
+	plan.Inverse(spectrum.data(), impulse.data());
+
+	std::vector<float> taps(length);
+	for (size_t n = 0; n < length; n++)
+	{
+		const double phase = 2.0 * std::numbers::pi * static_cast<double>(n) / static_cast<double>(length);
+		const double blackman = 0.42 - 0.5 * std::cos(phase) + 0.08 * std::cos(2.0 * phase);
+		taps[n] = impulse[(n + length / 2) % length] * static_cast<float>(blackman);
+	}
+
+	filter.blockSize = length / LINEAR_PHASE_PARTITIONS;
+	FFTPlan blockPlan(filter.blockSize * 2);
+	PartitionedConvolver::Prepare(blockPlan, taps.data(), taps.size(), filter);
+}
+
+void Equalizer::DesignThreadFunc()
+{
+	unsigned int designedRate = 0;
+	while (true)
+	{
+		Settings settings;
+		unsigned int rate = 0;
+		{
+			// The rate is only known to the processor, so it is polled rather than signalled and the audio thread never locks
+			std::unique_lock<std::mutex> lock(m_designMutex);
+			m_designWake.wait_for(lock, std::chrono::milliseconds(50), [&]() { return m_designPending || m_designStop || m_designRate != designedRate; });
+			if (m_designStop)
+				return;
+
+			rate = m_designRate;
+			if (rate == 0 || (!m_designPending && rate == designedRate))
+				continue;
+
+			// A slot only frees up once the processor has taken the previous design
+			while (m_readyFir.load(std::memory_order_acquire) >= 0)
+			{
+				if (m_designWake.wait_for(lock, std::chrono::milliseconds(5), [&]() { return m_designStop; }))
+					return;
+			}
+
+			m_designPending = false;
+			settings = m_designSettings;
+		}
+
+		[[maybe_unused]] auto start = std::chrono::steady_clock::now();
+		const int slot = m_currentFir.load(std::memory_order_acquire) == 0 ? 1 : 0;
+		DesignFir(settings, rate, m_firs[slot]);
+		designedRate = rate;
+		m_readyFir.store(slot, std::memory_order_release);
+
+		LOG_DEBUG("Designed {} tap linear-phase EQ at {} Hz in {} us", GetFirLength(rate), rate,
+		          std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count());
+	}
+}
+
+std::function<void(std::vector<float>&, unsigned int, unsigned int)> Equalizer::CreateProcessor()
+{
+	return [this](std::vector<float>& buffer, unsigned int channels, unsigned int sampleRate)
+	{
+		if (m_published.update() || sampleRate != m_rate || channels != m_cascade.GetChannelCount())
+		{
+			Rebuild(channels, sampleRate);
+		}
+
+		if (m_linearPhase)
+		{
+			ProcessLinearPhase(buffer, channels);
+		}
+		else if (m_cascade.GetEnabledSectionCount() > 0)
+		{
+			m_cascade.Process(buffer.data(), buffer.size() / channels);
+		}
+
+		if (m_preampGain != 1.0f)
+		{
+			for (float& sample: buffer)
+			{
+				sample *= m_preampGain;
+			}
+		}
+	};
+}
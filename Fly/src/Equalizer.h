@@ -0,0 +1,204 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "containers/TripleBuffer.h"
+#include "dsp/BiquadCascade.h"
+#include "dsp/PartitionedConvolver.h"
+
+// Graphic (10 or 31 band) and parametric EQ, run after the tone shelves. Every band is one section
+// of a biquad cascade and bands that would not change the sound are switched off in the cascade,
+// so a mostly flat 31-band curve costs about as much as its few moved sliders.
+//
+// In linear-phase mode the same curve is turned into a symmetric FIR on a worker thread and run
+// with partitioned FFT convolution instead, which keeps the phase intact at the price of latency.
+class Equalizer
+{
+public:
+	enum class Mode
+	{
+		Off,
+		Graphic10,
+		Graphic31,
+		Parametric
+	};
+
+	enum class BandType
+	{
+		Peak,
+		LowShelf,
+		HighShelf,
+		Notch,
+		HighPass,
+		LowPass
+	};
+
+	struct Band
+	{
+		BandType type{ BandType::Peak };
+		float frequency{ 1000.0f }; // Hz
+		float q{ 0.707f };
+		float gainDb{ 0.0f }; // Ignored by notch and pass filters
+		bool enabled{ true };
+	};
+
+	static constexpr size_t MAX_BANDS = 31;
+	static constexpr float MAX_GAIN_DB = 12.0f;
+
+	// Presets shipped with the player, each a 10-band graphic curve
+	struct BuiltinPreset
+	{
+		const char* name;
+		std::array<float, 10> gainsDb;
+	};
+
+	Equalizer();
+	~Equalizer();
+
+	Equalizer(const Equalizer&) = delete;
+	Equalizer& operator=(const Equalizer&) = delete;
+
+	// Switching to a graphic mode lays its bands out flat, parametric bands are kept aside across mode changes
+	void SetMode(Mode mode);
+
+	Mode GetMode() const
+	{
+		return m_settings.mode;
+	}
+
+	size_t GetBandCount() const
+	{
+		return m_settings.bandCount;
+	}
+
+	const Band& GetBand(size_t index) const
+	{
+		return m_settings.bands[index];
+	}
+
+	void SetBand(size_t index, const Band& band);
+
+	// Parametric mode only
+	bool AddBand(const Band& band);
+	void RemoveBand(size_t index);
+
+	void SetPreamp(float gainDb);
+
+	float GetPreamp() const
+	{
+		return m_settings.preampDb;
+	}
+
+	// Redesigns happen in the background, the new FIR is crossfaded in once it is ready
+	void SetLinearPhase(bool enabled);
+
+	bool IsLinearPhase() const
+	{
+		return m_settings.linearPhase;
+	}
+
+	// Frames the output currently trails the input by, zero unless linear phase is running
+	std::size_t GetLatency() const
+	{
+		return m_latency;
+	}
+
+	// Flattens every band and the preamp, keeping the mode
+	void Flatten();
+
+	// Bands the processor is actually running, for showing what the current curve costs
+	size_t GetActiveBandCount() const
+	{
+		return m_activeBandCount;
+	}
+
+	static const std::vector<BuiltinPreset>& GetBuiltinPresets();
+	void ApplyBuiltinPreset(const BuiltinPreset& preset);
+
+	// Plain text, one "band <type> <frequency> <q> <gain> <on|off>" line per band
+	bool SavePreset(const std::string& path) const;
+	bool LoadPreset(const std::string& path);
+
+	static const char* GetBandTypeName(BandType type);
+	static const char* GetModeName(Mode mode);
+
+	// This will make it into a lambda function for the audio streamer
+	std::function<void(std::vector<float>&, unsigned int, unsigned int)> CreateProcessor();
+
+private:
+	struct Settings
+	{
+		Mode mode{ Mode::Off };
+		float preampDb{ 0.0f };
+		std::array<Band, MAX_BANDS> bands{};
+		size_t bandCount{ 0 };
+		bool linearPhase{ false };
+	};
+
+	// The FIR is cut into this many partitions, so per-sample cost stays logarithmic in its length
+	static constexpr size_t LINEAR_PHASE_PARTITIONS = 4;
+
+	// Enough taps for about 6 Hz resolution, the narrowest 31-band filters need that much
+	static size_t GetFirLength(unsigned int sampleRate);
+
+	// Lays out the bands of a graphic mode, all flat
+	static void LayoutGraphic(Settings& settings, Mode mode);
+
+	// Clamps a band to what the UI and the filter designs support
+	static Band Sanitize(const Band& band);
+
+	// Whether a band leaves the signal untouched at this rate and can be skipped
+	static bool IsFlat(const Band& band, float sampleRate);
+	static BiquadCoefficients Design(const Band& band, float sampleRate);
+
+	// Hands the UI copy to the processor
+	void Publish();
+
+	// Retunes the cascade for new settings, rate or channel layout
+	void Rebuild(unsigned int channels, unsigned int sampleRate);
+
+	// Linear-phase path of the processor, picks up newly designed FIRs
+	void ProcessLinearPhase(std::vector<float>& buffer, unsigned int channels);
+
+	// Worker side of linear phase, samples the curve and builds the partitioned FIR
+	void DesignThreadFunc();
+	static void DesignFir(const Settings& settings, unsigned int sampleRate, PartitionedConvolver::Filter& filter);
+
+	// UI side
+	Settings m_settings;
+	Mode m_layoutMode{ Mode::Off }; // Which layout the bands hold, kept while the EQ is off
+	std::array<Band, MAX_BANDS> m_parametricBands{};
+	size_t m_parametricBandCount{ 0 };
+	TripleBuffer<Settings> m_published;
+
+	// Processor side
+	BiquadCascade m_cascade;
+	unsigned int m_rate{ 0 };
+	float m_preampGain{ 1.0f };
+	bool m_linearPhase{ false };
+	PartitionedConvolver m_convolver;
+	std::atomic<size_t> m_activeBandCount{ 0 };
+	std::atomic<size_t> m_latency{ 0 };
+
+	// FIR hand-over. The worker fills whichever slot the processor isn't running and marks it
+	// ready, the processor crossfades to it and frees it up for the next design
+	std::array<PartitionedConvolver::Filter, 2> m_firs;
+	std::atomic<int> m_readyFir{ -1 };
+	std::atomic<int> m_currentFir{ -1 };
+
+	// Design worker, started the first time linear phase is switched on
+	std::thread m_designThread;
+	std::mutex m_designMutex;
+	std::condition_variable m_designWake;
+	Settings m_designSettings;
+	bool m_designPending{ false };
+	bool m_designStop{ false };
+	std::atomic<unsigned int> m_designRate{ 0 }; // Rate of the stream, set by the processor
+};
@@ -0,0 +1,358 @@
+#include "pch.h"
+
+#include "LoudnessNormalizer.h"
+
+#include <charconv>
+#include <fstream>
+#include <memory>
+
+#include "decoders/DecoderRegistry.h"
+
+// Bumped whenever the entry format or the measurement changes, older files are started over
+static constexpr const char* CACHE_HEADER = "FlyLoudness 1";
+
+// Decoded per read, big enough that the decoder rather than the loop overhead sets the pace
+static constexpr unsigned int MEASURE_CHUNK_SECONDS = 1;
+
+namespace
+{
+	template<typename T>
+	bool ParseNumber(std::string_view text, T& value)
+	{
+		auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+		return error == std::errc() && end == text.data() + text.size();
+	}
+
+	// Splits off the text up to the next separator, the rest is left in text
+	std::string_view NextField(std::string_view& text, char separator)
+	{
+		std::size_t position = text.find(separator);
+		std::string_view field = text.substr(0, position);
+		text = position == std::string_view::npos ? std::string_view() : text.substr(position + 1);
+		return field;
+	}
+}
+
+LoudnessNormalizer::~LoudnessNormalizer()
+{
+	// Makes an in-flight measurement give up instead of holding up shutdown
+	m_stopping = true;
+	m_jobs.terminate();
+	for (std::thread& worker: m_workers)
+	{
+		if (worker.joinable())
+		{
+			worker.join();
+		}
+	}
+}
+
+std::string LoudnessNormalizer::GetTrackKey(const Playlist::Track& track)
+{
+	return std::format("{}|{}|{}", track.filepath, track.startSeconds, track.endSeconds);
+}
+
+bool LoudnessNormalizer::GetFileIdentity(const std::string& filename, std::uint64_t& fileSize, long long& modifiedTicks)
+{
+	std::error_code error;
+	fileSize = std::filesystem::file_size(filename, error);
+	if (error)
+		return false;
+
+	auto modified = std::filesystem::last_write_time(filename, error);
+	if (error)
+		return false;
+
+	modifiedTicks = static_cast<long long>(modified.time_since_epoch().count());
+	return true;
+}
+
+float LoudnessNormalizer::ComputeGain(float loudnessLufs, float truePeakDb)
+{
+	// Nothing got past the gates, digital silence stays where it is
+	if (loudnessLufs <= LoudnessMeter::SILENCE_LUFS)
+		return 0.0f;
+
+	return min(TARGET_LUFS - loudnessLufs, MAX_TRUE_PEAK_DB - truePeakDb);
+}
+
+std::string LoudnessNormalizer::FormatEntry(const std::string& key, const Result& result)
+{
+	std::string histogram;
+	for (const HistogramBin& bin: result.histogram)
+	{
+		histogram += std::format("{}{}:{}:{}", histogram.empty() ? "" : " ", bin.index, bin.count, bin.energy);
+	}
+
+	// Paths can't hold tabs, album tags can
+	std::string albumKey = result.albumKey;
+	std::replace(albumKey.begin(), albumKey.end(), '\t', ' ');
+
+	// The key goes last, everything before it is free of tabs
+	return std::format("{}\t{}\t{}\t{}\t{}\t{}\t{}", result.fileSize, result.modifiedTicks, result.loudnessLufs, result.truePeakDb, histogram, albumKey, key);
+}
+
+bool LoudnessNormalizer::ParseEntry(const std::string& line, std::string& key, Result& result)
+{
+	std::string_view text = line;
+	if (!ParseNumber(NextField(text, '\t'), result.fileSize) || !ParseNumber(NextField(text, '\t'), result.modifiedTicks) ||
+	    !ParseNumber(NextField(text, '\t'), result.loudnessLufs) || !ParseNumber(NextField(text, '\t'), result.truePeakDb))
+		return false;
+
+	std::string_view histogram = NextField(text, '\t');
+	result.histogram.clear();
+	while (!histogram.empty())
+	{
+		std::string_view binText = NextField(histogram, ' ');
+		HistogramBin bin;
+		if (!ParseNumber(NextField(binText, ':'), bin.index) || !ParseNumber(NextField(binText, ':'), bin.count) || !ParseNumber(binText, bin.energy) ||
+		    bin.index >= LoudnessMeter::HISTOGRAM_BINS)
+			return false;
+		result.histogram.push_back(bin);
+	}
+
+	result.albumKey = NextField(text, '\t');
+	key = text;
+	return !key.empty();
+}
+
+void LoudnessNormalizer::LoadCache(const std::filesystem::path& cacheFile)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_cacheFile = cacheFile;
+
+	// Entries are only ever appended, a later one for the same track replaces the earlier
+	std::size_t lineCount = 0;
+	bool valid = false;
+	{
+		std::ifstream in(cacheFile);
+		std::string line;
+		valid = std::getline(in, line) && line == CACHE_HEADER;
+		while (valid && std::getline(in, line))
+		{
+			std::string key;
+			Result result;
+			if (ParseEntry(line, key, result))
+			{
+				m_cached[key] = std::move(result);
+				lineCount++;
+			}
+		}
+	}
+
+	// Missing, from another version, or mostly replaced entries, write out what is current
+	if (!valid || lineCount > m_cached.size() * 2)
+	{
+		std::ofstream out(cacheFile, std::ios::trunc);
+		out << CACHE_HEADER << '\n';
+		for (const auto& [key, result]: m_cached)
+		{
+			out << FormatEntry(key, result) << '\n';
+		}
+		if (!out)
+		{
+			LOG_ERROR("Failed to write the loudness cache {}", cacheFile.string());
+		}
+	}
+
+	LOG_INFO("Loudness cache holds {} tracks", m_cached.size());
+}
+
+void LoudnessNormalizer::Analyze(const std::vector<Playlist::Track>& tracks)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	for (const Playlist::Track& track: tracks)
+	{
+		std::string key = GetTrackKey(track);
+		if (!m_queued.insert(key).second)
+			continue;
+
+		m_pending.insert(std::move(key));
+		m_pendingCount++;
+		m_jobs.push(Playlist::Track(track));
+	}
+
+	if (m_workers.empty() && m_pendingCount > 0)
+	{
+		// Half the cores at most, decoding stays out of the way of playback and the UI
+		const unsigned int workerCount = std::clamp(std::thread::hardware_concurrency() / 2, 1u, MAX_WORKERS);
+		for (unsigned int i = 0; i < workerCount; i++)
+		{
+			std::thread& worker = m_workers.emplace_back(&LoudnessNormalizer::WorkerThreadFunc, this);
+			SetThreadDescription(worker.native_handle(), L"LoudnessWorker");
+			SetThreadPriority(worker.native_handle(), THREAD_PRIORITY_BELOW_NORMAL);
+		}
+	}
+}
+
+void LoudnessNormalizer::WorkerThreadFunc()
+{
+	Playlist::Track track;
+	while (m_jobs.pop(track))
+	{
+		if (m_stopping)
+			break;
+
+		const std::string key = GetTrackKey(track);
+		Result result;
+		bool found = false;
+		if (GetFileIdentity(track.filepath, result.fileSize, result.modifiedTicks))
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			auto cached = m_cached.find(key);
+			if (cached != m_cached.end() && cached->second.fileSize == result.fileSize && cached->second.modifiedTicks == result.modifiedTicks)
+			{
+				result = std::move(cached->second);
+				m_cached.erase(cached);
+				found = true;
+			}
+		}
+
+		if (found)
+		{
+			Store(key, std::move(result), false);
+		}
+		else if (Measure(track, result))
+		{
+			Store(key, std::move(result), true);
+		}
+		else
+		{
+			// Not asked for again this session, the file won't decode any better
+			if (!m_stopping)
+			{
+				LOG_WARN("Failed to measure the loudness of {}", track.filepath);
+			}
+
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_pending.erase(key);
+			m_pendingCount--;
+			m_generation++;
+		}
+	}
+}
+
+bool LoudnessNormalizer::Measure(const Playlist::Track& track, Result& result) const
+{
+	std::unique_ptr<AudioDecoder> decoder = DecoderRegistry::Get().Open(track.filepath);
+	if (!decoder)
+		return false;
+
+	const AudioDecoder::Format& format = decoder->GetFormat();
+	if (format.channelCount > LoudnessMeter::MAX_CHANNELS)
+		return false;
+
+	auto start = std::chrono::steady_clock::now();
+
+	// Same range as the streamer plays
+	const std::int64_t startFrame = std::clamp(static_cast<std::int64_t>(std::llround(track.startSeconds * format.sampleRate)), static_cast<std::int64_t>(0), format.frameCount);
+	const std::int64_t endFrame = track.endSeconds < 0.0 ? format.frameCount : std::clamp(static_cast<std::int64_t>(std::llround(track.endSeconds * format.sampleRate)), startFrame, format.frameCount);
+	if (startFrame > 0 && !decoder->Seek(startFrame))
+		return false;
+
+	// A meter is as big as its reading queue, too big for the worker's stack
+	auto meter = std::make_unique<LoudnessMeter>();
+	meter->Configure(format.channelCount, format.sampleRate);
+
+	const std::size_t chunkFrames = static_cast<std::size_t>(format.sampleRate) * MEASURE_CHUNK_SECONDS;
+	std::vector<float> samples(chunkFrames * format.channelCount);
+	std::int64_t frame = startFrame;
+	while (frame < endFrame)
+	{
+		if (m_stopping)
+			return false;
+
+		std::size_t read = decoder->ReadFrames(samples.data(), min(chunkFrames, static_cast<std::size_t>(endFrame - frame)));
+		if (read == 0)
+			break;
+
+		meter->Process(samples.data(), read, frame);
+		frame += static_cast<std::int64_t>(read);
+	}
+
+	result.loudnessLufs = meter->GetIntegratedLoudness();
+	result.truePeakDb = meter->GetMaxTruePeak();
+
+	const LoudnessMeter::Histogram& histogram = meter->GetHistogram();
+	result.histogram.clear();
+	for (int bin = 0; bin < LoudnessMeter::HISTOGRAM_BINS; bin++)
+	{
+		if (histogram.counts[bin] > 0)
+		{
+			result.histogram.push_back({ static_cast<std::uint16_t>(bin), histogram.counts[bin], histogram.energy[bin] });
+		}
+	}
+
+	// The album tag alone would lump every "Greatest Hits" together, the folder tells them apart.
+	// Cue sheet tracks without one still share their file
+	AudioDecoder::Tags tags = DecoderRegistry::Get().ReadTags(track.filepath, *decoder);
+	if (!tags.album.empty())
+	{
+		result.albumKey = std::filesystem::path(track.filepath).parent_path().string() + "|" + tags.album;
+	}
+	else if (track.IsVirtual())
+	{
+		result.albumKey = track.filepath;
+	}
+
+	[[maybe_unused]] auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	[[maybe_unused]] double seconds = static_cast<double>(frame - startFrame) / format.sampleRate;
+	LOG_INFO("Measured {}: {:.1f} LUFS, {:.1f} dBTP in {:.2f} s, {:.0f}x realtime", track.filepath, result.loudnessLufs, result.truePeakDb, elapsed, seconds / max(elapsed, 1e-6));
+	return true;
+}
+
+void LoudnessNormalizer::Store(const std::string& key, Result result, bool measured)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (measured && !m_cacheFile.empty())
+	{
+		std::ofstream out(m_cacheFile, std::ios::app);
+		out << FormatEntry(key, result) << '\n';
+	}
+
+	m_results[key] = std::move(result);
+	m_pending.erase(key);
+	m_pendingCount--;
+	m_generation++;
+}
+
+float LoudnessNormalizer::GetGain(const Playlist::Track& track, Mode mode, const std::vector<Playlist::Track>& playlist) const
+{
+	if (mode == Mode::Off)
+		return 0.0f;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	auto found = m_results.find(GetTrackKey(track));
+	if (found == m_results.end())
+		return 0.0f;
+
+	const Result& measured = found->second;
+	const float trackGain = ComputeGain(measured.loudnessLufs, measured.truePeakDb);
+	if (mode == Mode::Track || measured.albumKey.empty())
+		return trackGain;
+
+	// Anything from the same folder still being measured may belong to the album
+	const std::filesystem::path folder = std::filesystem::path(track.filepath).parent_path();
+	LoudnessMeter::Histogram histogram;
+	float truePeakDb = LoudnessMeter::SILENCE_LUFS;
+	std::unordered_set<std::string> counted;
+	for (const Playlist::Track& other: playlist)
+	{
+		std::string key = GetTrackKey(other);
+		if (m_pending.contains(key) && std::filesystem::path(other.filepath).parent_path() == folder)
+			return trackGain;
+
+		auto result = m_results.find(key);
+		if (result == m_results.end() || result->second.albumKey != measured.albumKey || !counted.insert(std::move(key)).second)
+			continue;
+
+		for (const HistogramBin& bin: result->second.histogram)
+		{
+			histogram.counts[bin.index] += bin.count;
+			histogram.energy[bin.index] += bin.energy;
+		}
+		truePeakDb = max(truePeakDb, result->second.truePeakDb);
+	}
+
+	return ComputeGain(LoudnessMeter::IntegratedLoudness(histogram), truePeakDb);
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "containers/ThreadSafeQueue.h"
+#include "dsp/LoudnessMeter.h"
+#include "PlayList.h"
+
+// ReplayGain style volume normalization to a common loudness. Playlist tracks are measured in the
+// background by a small pool of below-normal priority workers, each decoding straight into a
+// LoudnessMeter as fast as the decoder goes, with no resampling, effects or output in the way.
+// Results are appended to a cache file keyed by the file's size and modification time, so a track
+// is measured once, ever, until the file changes.
+//
+// Album gain gates the summed gating histograms of an album's tracks, which measures the album as
+// if it were played back to back, rather than averaging its track loudnesses.
+class LoudnessNormalizer
+{
+public:
+	enum class Mode
+	{
+		Off,
+		Track,
+		Album
+	};
+
+	static constexpr float TARGET_LUFS = -18.0f;
+	static constexpr float MAX_TRUE_PEAK_DB = 0.0f; // The gain never takes a measured peak past this
+	static constexpr unsigned int MAX_WORKERS = 4;
+
+	LoudnessNormalizer() = default;
+	~LoudnessNormalizer();
+
+	LoudnessNormalizer(const LoudnessNormalizer&) = delete;
+	LoudnessNormalizer& operator=(const LoudnessNormalizer&) = delete;
+
+	// Reads the results of earlier sessions and appends new ones to the file
+	void LoadCache(const std::filesystem::path& cacheFile);
+
+	// Queues every track that was neither measured nor queued before
+	void Analyze(const std::vector<Playlist::Track>& tracks);
+
+	// Tracks queued or being measured
+	std::size_t GetPendingCount() const
+	{
+		return m_pendingCount;
+	}
+
+	// Bumped whenever a result comes in, gains asked for before then may have changed
+	std::uint32_t GetGeneration() const
+	{
+		return m_generation;
+	}
+
+	// Gain in dB that brings the track to the target. Album mode falls back to the track gain until
+	// the rest of the album in the playlist is measured, and both to 0 dB until the track is
+	float GetGain(const Playlist::Track& track, Mode mode, const std::vector<Playlist::Track>& playlist) const;
+
+private:
+	// Gating histogram without its empty bins, a track only covers a few dozen LU of the range
+	struct HistogramBin
+	{
+		std::uint16_t index{ 0 };
+		std::uint32_t count{ 0 };
+		double energy{ 0.0 };
+	};
+
+	struct Result
+	{
+		std::uint64_t fileSize{ 0 };
+		long long modifiedTicks{ 0 };
+		float loudnessLufs{ LoudnessMeter::SILENCE_LUFS };
+		float truePeakDb{ LoudnessMeter::SILENCE_LUFS };
+		std::string albumKey; // Folder and album tag, empty when the track has no album
+		std::vector<HistogramBin> histogram;
+	};
+
+	// Tracks are told apart by their file and range, files by their size and modification time
+	static std::string GetTrackKey(const Playlist::Track& track);
+	static bool GetFileIdentity(const std::string& filename, std::uint64_t& fileSize, long long& modifiedTicks);
+
+	void WorkerThreadFunc();
+	bool Measure(const Playlist::Track& track, Result& result) const;
+	void Store(const std::string& key, Result result, bool measured);
+
+	static std::string FormatEntry(const std::string& key, const Result& result);
+	static bool ParseEntry(const std::string& line, std::string& key, Result& result);
+
+	// Gain for a loudness, held back so the peak stays under MAX_TRUE_PEAK_DB
+	static float ComputeGain(float loudnessLufs, float truePeakDb);
+
+	std::atomic<bool> m_stopping{ false };
+	std::atomic<std::size_t> m_pendingCount{ 0 };
+	std::atomic<std::uint32_t> m_generation{ 0 };
+
+	mutable std::mutex m_mutex; // Guards everything below
+	std::filesystem::path m_cacheFile;
+	std::unordered_map<std::string, Result> m_cached;  // From the cache file, not yet checked against the file
+	std::unordered_map<std::string, Result> m_results; // Checked or measured this session
+	std::unordered_set<std::string> m_queued;          // Ever queued this session, measured or not
+	std::unordered_set<std::string> m_pending;         // Queued and not finished yet
+
+	ThreadSafeQueue<Playlist::Track> m_jobs;
+	std::vector<std::thread> m_workers;
+};
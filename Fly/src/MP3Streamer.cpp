@@ -4,22 +4,33 @@
 
 #include <stdexcept>
 
+#include "decoders/DecoderRegistry.h"
+#include "decoders/MemoryDecoder.h"
+#include "decoders/PcmCache.h"
+
 MP3Streamer::MP3Streamer()
 {
 	// Initialize sample buffer
 	m_sampleBuffer.resize(AUDIO_STREAM_BUFFER_SIZE);
+
+	// The visualizer follows the audible position rather than the decoder, which runs over a second ahead
+	m_visualizer.SetClock([this]() { return std::llround(GetPlayingOffset() * GetSampleRate()); });
 }
 
 MP3Streamer::~MP3Streamer()
 {
+	m_visualizer.SetRunning(false);
+	CancelPreload();
 	Cleanup();
 }
 
 MP3Streamer::MP3Streamer(MP3Streamer&& other) noexcept
-      : AudioStreamer(std::move(other)), m_file(std::exchange(other.m_file, nullptr)), m_fileInfo(other.m_fileInfo), m_sampleBuffer(std::move(other.m_sampleBuffer))
+      : AudioStreamer(std::move(other)), m_decoder(std::move(other.m_decoder)), m_filename(std::move(other.m_filename)), m_decodeFrame(other.m_decodeFrame), m_readFrame(other.m_readFrame), m_sampleBuffer(std::move(other.m_sampleBuffer)), m_track(std::move(other.m_track)), m_decodeRange(std::move(other.m_decodeRange)), m_nextRange(std::move(other.m_nextRange)), m_pendingTrack(std::move(other.m_pendingTrack)), m_fileTags(std::move(other.m_fileTags)), m_hasPendingTrack(other.m_hasPendingTrack.load()), m_rewind(std::move(other.m_rewind)), m_rewindSeconds(other.m_rewindSeconds), m_preloadThreshold(other.m_preloadThreshold)
 {
-	// Clear other's file info
-	std::memset(&other.m_fileInfo, 0, sizeof(SF_INFO));
+	m_visualizer.SetClock([this]() { return std::llround(GetPlayingOffset() * GetSampleRate()); });
+
+	// An in-flight preload belongs to the other streamer's file handle state, let it go
+	other.CancelPreload();
 }
 
 MP3Streamer& MP3Streamer::operator=(MP3Streamer&& other) noexcept
@@ -27,104 +38,352 @@ MP3Streamer& MP3Streamer::operator=(MP3Streamer&& other) noexcept
 	if (this != &other)
 	{
 		AudioStreamer::operator=(std::move(other));
+		CancelPreload();
+		other.CancelPreload();
 		Cleanup();
 
-		m_file = std::exchange(other.m_file, nullptr);
-		m_fileInfo = other.m_fileInfo;
+		m_decoder = std::move(other.m_decoder);
+		m_filename = std::move(other.m_filename);
+		m_decodeFrame = other.m_decodeFrame;
+		m_readFrame = other.m_readFrame;
 		m_sampleBuffer = std::move(other.m_sampleBuffer);
-
-		// Clear other's file info
-		std::memset(&other.m_fileInfo, 0, sizeof(SF_INFO));
+		m_track = std::move(other.m_track);
+		m_decodeRange = std::move(other.m_decodeRange);
+		m_nextRange = std::move(other.m_nextRange);
+		m_pendingTrack = std::move(other.m_pendingTrack);
+		m_fileTags = std::move(other.m_fileTags);
+		m_hasPendingTrack = other.m_hasPendingTrack.load();
+		m_rewind = std::move(other.m_rewind);
+		m_rewindSeconds = other.m_rewindSeconds;
+		m_preloadThreshold = other.m_preloadThreshold;
 	}
 	return *this;
 }
 
 bool MP3Streamer::OpenFromFile(const std::string& filename)
 {
+	return OpenFromFile(filename, TrackRange{});
+}
+
+bool MP3Streamer::OpenFromFile(const std::string& filename, const TrackRange& range)
+{
+	auto streamLock = LockStream();
+
+	// Another virtual track of the open file only needs a seek on the decoder we already have
+	if (m_decoder && filename == m_filename)
+	{
+		m_track = ResolveRange(range);
+		ApplyTrackInfo(m_track);
+		SetPlayingOffset(static_cast<double>(m_track.start) / m_decoder->GetFormat().sampleRate);
+		return true;
+	}
+
 	// Cleanup any existing file
+	CancelPreload();
 	Cleanup();
 
-	// Initialize file info
-	std::memset(&m_fileInfo, 0, sizeof(SF_INFO));
+	// Open the audio file with the best backend for its format
+	m_decoder = DecoderRegistry::Get().Open(filename);
+	if (!m_decoder)
+	{
+		throw std::runtime_error("Failed to open audio file: " + filename);
+	}
+	m_filename = filename;
+	PcmCache::Get().RecordPlay(filename);
 
-	// Open the audio file
-	m_file = sf_open(filename.c_str(), SFM_READ, &m_fileInfo);
-	if (!m_file)
+	// Start decoding at the beginning of the requested range
+	m_track = ResolveRange(range);
+	m_decodeRange = m_track;
+	if (m_track.start > 0)
 	{
-		throw std::runtime_error("Failed to open audio file: " + std::string(sf_strerror(nullptr)));
+		m_decoder->Seek(m_track.start);
 	}
+	m_decodeFrame = m_track.start;
+	m_readFrame = m_track.start;
+
+	// Short clips are decoded into RAM straight away, long looping tracks are moved there in the background
+	float duration = static_cast<float>(m_decoder->GetFormat().frameCount) / m_decoder->GetFormat().sampleRate;
+	if (duration <= m_preloadThreshold)
+	{
+		PreloadNow();
+	}
+	else if (IsLooping())
+	{
+		StartBackgroundPreload();
+	}
+	ConfigureRewind();
+
+	const AudioDecoder::Format& format = m_decoder->GetFormat();
 
 	// Configure audio streamer
 	StreamingConfig config;
-	config.channelCount = static_cast<unsigned int>(m_fileInfo.channels);
-	config.sampleRate = static_cast<unsigned int>(m_fileInfo.samplerate);
+	config.channelCount = format.channelCount;
+	config.sampleRate = format.sampleRate;
+	config.startFrame = static_cast<std::size_t>(m_track.start);
 	Init(config);
 
-	// Setup the trackInfo with null checks
-	const char* title = sf_get_string(m_file, SF_STR_TITLE);
-	m_trackInfo.title = title ? title : filename.substr(filename.find_last_of("/\\") + 1); // If there is no title, use the trimmed filename
+	// Setup the trackInfo, Init() clears it
+	m_fileTags = DecoderRegistry::Get().ReadTags(filename, *m_decoder);
+	ApplyTrackInfo(m_track);
 
-	m_trackInfo.artist = sf_get_string(m_file, SF_STR_ARTIST) ? sf_get_string(m_file, SF_STR_ARTIST) : "";
-	m_trackInfo.album = sf_get_string(m_file, SF_STR_ALBUM) ? sf_get_string(m_file, SF_STR_ALBUM) : "";
-	m_trackInfo.genre = sf_get_string(m_file, SF_STR_GENRE) ? sf_get_string(m_file, SF_STR_GENRE) : "";
-	m_trackInfo.year = sf_get_string(m_file, SF_STR_DATE) ? sf_get_string(m_file, SF_STR_DATE) : "";
+	return true;
+}
+
+MP3Streamer::FrameRange MP3Streamer::ResolveRange(const TrackRange& range) const
+{
+	const AudioDecoder::Format& format = m_decoder->GetFormat();
 
-	m_trackInfo.duration = static_cast<float>(m_fileInfo.frames) / m_fileInfo.samplerate;
-	
+	FrameRange resolved;
+	resolved.start = std::clamp(static_cast<std::int64_t>(std::llround(range.startSeconds * format.sampleRate)), static_cast<std::int64_t>(0), format.frameCount);
+	resolved.end = range.endSeconds < 0.0 ? format.frameCount : std::clamp(static_cast<std::int64_t>(std::llround(range.endSeconds * format.sampleRate)), resolved.start, format.frameCount);
+	resolved.info = range;
+	return resolved;
+}
+
+void MP3Streamer::ApplyTrackInfo(const FrameRange& range)
+{
+	m_trackInfo.title = !range.info.title.empty() ? range.info.title : !m_fileTags.title.empty() ? m_fileTags.title : m_filename.substr(m_filename.find_last_of("/\\") + 1); // If there is no title, use the trimmed filename
+	m_trackInfo.artist = !range.info.artist.empty() ? range.info.artist : m_fileTags.artist;
+	m_trackInfo.album = m_fileTags.album;
+	m_trackInfo.genre = m_fileTags.genre;
+	m_trackInfo.year = m_fileTags.year;
+
+	m_trackInfo.duration = static_cast<float>(range.end - range.start) / m_decoder->GetFormat().sampleRate;
+}
+
+bool MP3Streamer::QueueNextRange(const std::string& filename, const TrackRange& range)
+{
+	auto streamLock = LockStream();
+
+	if (!m_decoder || filename != m_filename)
+		return false;
+
+	FrameRange next = ResolveRange(range);
+	if (next.start != m_decodeRange.end || next.end <= next.start)
+		return false;
+
+	// Already crossed into it, or already queued
+	if (m_pendingTrack || (m_nextRange && m_nextRange->end == next.end))
+		return true;
+
+	m_nextRange = std::move(next);
+	return true;
+}
+
+bool MP3Streamer::PollTrackAdvance()
+{
+	// Called every UI frame, only take the stream lock while a boundary is actually coming up
+	if (!m_hasPendingTrack.load(std::memory_order_acquire))
+		return false;
+
+	auto streamLock = LockStream();
+
+	if (!m_pendingTrack || !m_decoder)
+		return false;
+
+	if (GetPlayingOffset() * m_decoder->GetFormat().sampleRate < static_cast<double>(m_pendingTrack->start))
+		return false;
+
+	m_track = std::move(*m_pendingTrack);
+	m_pendingTrack.reset();
+	m_hasPendingTrack = false;
+	ApplyTrackInfo(m_track);
 	return true;
 }
 
+double MP3Streamer::GetTrackOffset() const
+{
+	if (!m_decoder)
+		return 0.0;
+
+	return max(0.0, GetPlayingOffset() - static_cast<double>(m_track.start) / m_decoder->GetFormat().sampleRate);
+}
+
+void MP3Streamer::SetTrackOffset(double timeOffset)
+{
+	if (!m_decoder)
+		return;
+
+	SetPlayingOffset(timeOffset + static_cast<double>(m_track.start) / m_decoder->GetFormat().sampleRate);
+}
+
 void MP3Streamer::Cleanup()
 {
-	if (m_file)
-	{
-		sf_close(m_file);
-		m_file = nullptr;
-	}
-	std::memset(&m_fileInfo, 0, sizeof(SF_INFO));
+	m_decoder.reset();
+	m_filename.clear();
+	m_decodeFrame = 0;
+	m_readFrame = 0;
+	m_track = {};
+	m_decodeRange = {};
+	m_nextRange.reset();
+	m_pendingTrack.reset();
+	m_hasPendingTrack = false;
+	m_fileTags = {};
+	m_rewind.Configure(0, 0);
 }
 
 void MP3Streamer::Close()
 {
+	auto streamLock = LockStream();
+
 	Stop();
+	CancelPreload();
 	Cleanup();
 }
 
-const AudioStreamer::TrackInfo& MP3Streamer::GetTrackInfo()
+bool MP3Streamer::IsPreloaded() const
 {
-	return m_trackInfo;
+	return dynamic_cast<const MemoryDecoder*>(m_decoder.get()) != nullptr;
+}
+
+void MP3Streamer::SetLooping(bool loop)
+{
+	AudioStreamer::SetLooping(loop);
+
+	if (loop)
+	{
+		StartBackgroundPreload();
+	}
+}
+
+void MP3Streamer::SetRewindWindow(float seconds)
+{
+	auto streamLock = LockStream();
+
+	m_rewindSeconds = max(seconds, 0.0f);
+	ConfigureRewind();
+}
+
+void MP3Streamer::ConfigureRewind()
+{
+	// Anything preloaded can already seek anywhere for free
+	if (!m_decoder || IsPreloaded())
+	{
+		m_rewind.Configure(0, 0);
+		return;
+	}
+
+	const AudioDecoder::Format& format = m_decoder->GetFormat();
+	m_rewind.Configure(format.channelCount, static_cast<std::size_t>(m_rewindSeconds * format.sampleRate));
+	m_rewind.Clear(m_decodeFrame);
+	m_readFrame = m_decodeFrame;
+}
+
+bool MP3Streamer::PreloadNow()
+{
+	if (!m_decoder || IsPreloaded() || !MemoryDecoder::CanPreload(m_decoder->GetFormat()))
+		return false;
+
+	auto memory = std::make_unique<MemoryDecoder>();
+	if (!memory->Load(m_filename, *m_decoder))
+	{
+		// The streaming decoder was moved around by the load, put it back where playback expects it
+		m_decoder->Seek(m_decodeFrame);
+		return false;
+	}
+
+	memory->Seek(m_readFrame);
+	m_decoder = std::move(memory);
+	m_decodeFrame = m_readFrame;
+	ConfigureRewind();
+	return true;
+}
+
+void MP3Streamer::StartBackgroundPreload()
+{
+	std::lock_guard<std::mutex> lock(m_preloadMutex);
+	if (m_pendingPreload.valid() || !m_decoder || IsPreloaded() || !MemoryDecoder::CanPreload(m_decoder->GetFormat()))
+		return;
+
+	// The worker opens its own handles so the streaming decoder keeps playing meanwhile
+	m_cancelPreload = false;
+	m_pendingPreload = std::async(std::launch::async, [this, filename = m_filename]() -> std::unique_ptr<AudioDecoder>
+	{
+		std::unique_ptr<AudioDecoder> source = DecoderRegistry::Get().Open(filename);
+		auto memory = std::make_unique<MemoryDecoder>();
+		if (!source || !memory->Load(filename, *source, &m_cancelPreload))
+			return nullptr;
+
+		return memory;
+	});
 }
 
-const std::vector<float>& MP3Streamer::GetVisualizerData() const
+void MP3Streamer::TakeFinishedPreload()
 {
-	return m_visualizer.GetVisualizerData();
+	std::lock_guard<std::mutex> lock(m_preloadMutex);
+	if (!m_pendingPreload.valid() || m_pendingPreload.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+		return;
+
+	if (std::unique_ptr<AudioDecoder> memory = m_pendingPreload.get())
+	{
+		// Swap sources mid-stream, picking up exactly where playback left off
+		memory->Seek(m_readFrame);
+		m_decoder = std::move(memory);
+		m_decodeFrame = m_readFrame;
+		ConfigureRewind();
+		LOG_INFO("Switched {} to playback from memory", m_filename);
+	}
 }
 
-const std::vector<float>& MP3Streamer::GetBandPeaks() const
+void MP3Streamer::CancelPreload()
 {
-	return m_visualizer.GetBandPeaks();
+	std::lock_guard<std::mutex> lock(m_preloadMutex);
+	if (m_pendingPreload.valid())
+	{
+		m_cancelPreload = true;
+		m_pendingPreload.wait();
+		m_pendingPreload = {};
+	}
 }
 
-void MP3Streamer::Update()
+const AudioStreamer::TrackInfo& MP3Streamer::GetTrackInfo()
 {
-	m_visualizer.Update();
+	return m_trackInfo;
 }
 
 bool MP3Streamer::OnGetData(AudioChunk& chunk)
 {
-	if (!m_file)
+	if (!m_decoder)
 		return false;
 
-	// Read audio data
-	static sf_count_t framesToRead = AUDIO_STREAM_BUFFER_SIZE / m_fileInfo.channels;
-	sf_count_t framesRead = sf_readf_float(m_file, m_sampleBuffer.data(), framesToRead);
+	TakeFinishedPreload();
+
+	const AudioDecoder::Format& format = m_decoder->GetFormat();
+
+	// At the end of a virtual track carry straight on into the queued adjacent one,
+	// the decoder and AL queue never notice the boundary
+	if (m_readFrame >= m_decodeRange.end)
+	{
+		if (!m_nextRange)
+			return false;
+
+		m_decodeRange = std::move(*m_nextRange);
+		m_pendingTrack = m_decodeRange;
+		m_hasPendingTrack.store(true, std::memory_order_release);
+		m_nextRange.reset();
+	}
+
+	// Read audio data, replaying retained audio first if a seek went back into the rewind window
+	std::size_t framesToRead = min(static_cast<std::size_t>(AUDIO_STREAM_BUFFER_SIZE / format.channelCount), static_cast<std::size_t>(m_decodeRange.end - m_readFrame));
+	std::size_t framesRead = 0;
+	if (m_readFrame < m_decodeFrame)
+	{
+		framesRead = m_rewind.Read(m_readFrame, m_sampleBuffer.data(), framesToRead);
+	}
+	else
+	{
+		framesRead = m_decoder->ReadFrames(m_sampleBuffer.data(), framesToRead);
+		m_rewind.Push(m_sampleBuffer.data(), framesRead);
+		m_decodeFrame += static_cast<std::int64_t>(framesRead);
+	}
 
 	if (framesRead > 0)
 	{
 		chunk.samples = m_sampleBuffer.data();
-		chunk.sampleCount = static_cast<std::size_t>(framesRead * m_fileInfo.channels);
-		m_visualizer.PushAudioData(m_sampleBuffer, m_fileInfo.channels, m_fileInfo.samplerate);
-		
+		chunk.sampleCount = framesRead * format.channelCount;
+		m_visualizer.PushAudioData(m_sampleBuffer.data(), framesRead, m_readFrame, format.channelCount, format.sampleRate);
+		m_readFrame += static_cast<std::int64_t>(framesRead);
+
 		return true;
 	}
 
@@ -134,21 +393,39 @@ bool MP3Streamer::OnGetData(AudioChunk& chunk)
 
 void MP3Streamer::OnSeek(double timeOffset)
 {
-	if (!m_file)
+	if (!m_decoder)
 		return;
 
-	sf_count_t frame = static_cast<sf_count_t>(timeOffset * m_fileInfo.samplerate);
+	const AudioDecoder::Format& format = m_decoder->GetFormat();
+	std::int64_t frame = std::llround(timeOffset * format.sampleRate);
 
 	// Clamp the frame position
-	frame = std::clamp(frame, static_cast<sf_count_t>(0), m_fileInfo.frames);
+	frame = std::clamp(frame, static_cast<std::int64_t>(0), format.frameCount);
+
+	// Anything decoded past the audible track is thrown away, so is the range it ran into
+	m_decodeRange = m_track;
+	m_nextRange.reset();
+	m_pendingTrack.reset();
+	m_hasPendingTrack = false;
+
+	// Anything between the rewind window start and the decoder position is still in memory
+	if (frame >= m_rewind.GetStartFrame() && frame <= m_decodeFrame && m_rewind.GetEndFrame() == m_decodeFrame)
+	{
+		LOG_DEBUG("Serving seek to frame {} from the rewind buffer", frame);
+		m_readFrame = frame;
+		return;
+	}
 
 	// Seek to the frame
-	sf_seek(m_file, frame, SEEK_SET);
+	m_decoder->Seek(frame);
+	m_decodeFrame = frame;
+	m_readFrame = frame;
+	m_rewind.Clear(frame);
 }
 
 float MP3Streamer::OnGetDuration() const
 {
-	if (!m_file)
+	if (!m_decoder)
 		return 0;
 
 	return m_trackInfo.duration;
@@ -156,12 +433,12 @@ float MP3Streamer::OnGetDuration() const
 
 std::optional<std::size_t> MP3Streamer::OnLoop()
 {
-	if (!m_file)
+	if (!m_decoder)
 		return std::nullopt;
 
-	// Seek back to start
-	sf_seek(m_file, 0, SEEK_SET);
+	// Seek back to start, a preloaded track (or one short enough to fit the rewind window) loops without touching the disk
+	OnSeek(static_cast<double>(m_track.start) / m_decoder->GetFormat().sampleRate);
 
-	// Return total number of samples processed so far
-	return 0;
+	// Playback continues from the first frame of the track
+	return static_cast<std::size_t>(m_track.start);
 }
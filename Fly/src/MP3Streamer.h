@@ -1,11 +1,17 @@
 #pragma once
 
-#include <sndfile.h>
+#include <atomic>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
 #include <string>
 #include <vector>
 
 #include "AudioStreamer.h"
 #include "AudioVisualizer.h"
+#include "containers/RewindBuffer.h"
+#include "decoders/AudioDecoder.h"
 
 class MP3Streamer : public AudioStreamer
 {
@@ -21,18 +27,69 @@ public:
 	MP3Streamer(MP3Streamer&& other) noexcept;
 	MP3Streamer& operator=(MP3Streamer&& other) noexcept;
 
+	// Section of a file played as a track of its own, e.g. one entry of a cue sheet
+	struct TrackRange
+	{
+		double startSeconds{ 0.0 };
+		double endSeconds{ -1.0 }; // Negative plays to the end of the file
+		std::string title;         // Overrides the file's tags when set
+		std::string artist;
+	};
+
 	// File operations
+	// Opening another range of the file that is already open reuses its decoder
 	bool OpenFromFile(const std::string& filename);
+	bool OpenFromFile(const std::string& filename, const TrackRange& range);
 	void Close();
 
+	// Lets the stream run on into the next range when it starts exactly where the current one ends,
+	// so adjacent virtual tracks play gaplessly off the same decoder and AL queue
+	bool QueueNextRange(const std::string& filename, const TrackRange& range);
+
+	// Returns true once playback has audibly crossed into the queued range, the track info is updated by then
+	bool PollTrackAdvance();
+
+	// Position within the current range, which is the whole file for ordinary tracks
+	double GetTrackOffset() const;
+	void SetTrackOffset(double timeOffset);
+
 	// Get Info
 	const AudioStreamer::TrackInfo& GetTrackInfo();
 
-	// Visualizer (Just calls into the member)
-	const std::vector<float>& GetVisualizerData() const;
-	const std::vector<float>& GetBandPeaks() const;
+	// Tracks up to this long are decoded into RAM when opened instead of streamed from disk
+	void SetPreloadThreshold(float seconds)
+	{
+		m_preloadThreshold = seconds;
+	}
+
+	float GetPreloadThreshold() const
+	{
+		return m_preloadThreshold;
+	}
+
+	bool IsPreloaded() const;
+
+	// Seconds of recently decoded audio kept around so short backward seeks skip the decoder
+	void SetRewindWindow(float seconds);
+
+	float GetRewindWindow() const
+	{
+		return m_rewindSeconds;
+	}
+
+	// Looping tracks are moved into RAM in the background so every loop is served without I/O
+	void SetLooping(bool loop) override;
 
-	void Update();
+	// Visualizer, analyzes what is being heard on its own worker while enabled
+	AudioVisualizer& GetVisualizer()
+	{
+		return m_visualizer;
+	}
+
+	void SetVisualizerEnabled(bool enabled)
+	{
+		m_visualizer.SetRunning(enabled);
+	}
 
 protected:
 	// AudioStreamer interface implementation
@@ -44,9 +101,50 @@ protected:
 private:
 	void Cleanup();
 
-	SNDFILE* m_file{ nullptr };
-	SF_INFO m_fileInfo{};
+	bool PreloadNow();
+	void StartBackgroundPreload();
+	void TakeFinishedPreload();
+	void CancelPreload();
+
+	// A range resolved to frames of the open file
+	struct FrameRange
+	{
+		std::int64_t start{ 0 };
+		std::int64_t end{ 0 };
+		TrackRange info;
+	};
+
+	FrameRange ResolveRange(const TrackRange& range) const;
+	void ApplyTrackInfo(const FrameRange& range);
+
+	std::unique_ptr<AudioDecoder> m_decoder;
+	std::string m_filename;
+	std::int64_t m_decodeFrame{ 0 }; // Next frame the decoder will return
+	std::int64_t m_readFrame{ 0 };   // Next frame handed to the streamer, behind m_decodeFrame while replaying from m_rewind
 	AudioVisualizer m_visualizer;
 
 	std::vector<float> m_sampleBuffer;
+
+	// Virtual tracks. The streaming thread runs ahead of what is audible, so the range being decoded
+	// and the range being heard are tracked separately until playback reaches the boundary
+	FrameRange m_track;                       // Audible
+	FrameRange m_decodeRange;                 // Being decoded
+	std::optional<FrameRange> m_nextRange;    // Queued continuation of m_decodeRange
+	std::optional<FrameRange> m_pendingTrack; // Decoding has entered it, not audible yet
+	AudioDecoder::Tags m_fileTags;
+
+	// Mirrors m_pendingTrack, so polling for the boundary needs no lock while nothing is pending
+	std::atomic<bool> m_hasPendingTrack{ false };
+
+	// Rewind
+	void ConfigureRewind();
+
+	RewindBuffer m_rewind;
+	float m_rewindSeconds{ 30.0f };
+
+	// Preloading
+	float m_preloadThreshold{ 30.0f };
+	std::future<std::unique_ptr<AudioDecoder>> m_pendingPreload;
+	std::atomic<bool> m_cancelPreload{ false };
+	std::mutex m_preloadMutex;
 };
@@ -2,36 +2,352 @@
 
 #include "PitchShifter.h"
 
-void PitchShifter::SetSource(ALuint source)
+#include "dsp/FastMath.h"
+
+static constexpr float TWO_PI = 2.0f * M_PI;
+
+static float WrapPhase(float phase)
 {
-	m_source = source;
+	return phase - TWO_PI * std::round(phase / TWO_PI);
 }
 
 void PitchShifter::SetPitch(float semitones)
 {
-	m_pitchScale = std::pow(2.0f, semitones / 12.0f);
-	if (m_source != 0)
+	m_semitones = std::clamp(semitones, -MAX_SEMITONES, MAX_SEMITONES);
+}
+
+float PitchShifter::GetPitch() const
+{
+	return m_semitones;
+}
+
+void PitchShifter::Reset()
+{
+	m_semitones = 0.0f;
+}
+
+void PitchShifter::Configure(unsigned int channels, unsigned int sampleRate)
+{
+	m_channels = channels;
+	m_sampleRate = sampleRate;
+
+	m_frameSize = 1024;
+	while (m_frameSize < sampleRate / 25)
+	{
+		m_frameSize <<= 1;
+	}
+	m_hop = m_frameSize / OVERLAP;
+	m_bins = m_frameSize / 2 + 1;
+	m_lifter = max(8u, sampleRate / 1000);
+
+	if (!m_plan || m_plan->GetSize() != m_frameSize)
+	{
+		m_plan = std::make_unique<FFTPlan>(m_frameSize);
+	}
+
+	m_window.resize(m_frameSize);
+	for (size_t n = 0; n < m_frameSize; n++)
+	{
+		m_window[n] = 0.5f - 0.5f * std::cos(TWO_PI * static_cast<float>(n) / static_cast<float>(m_frameSize));
+	}
+
+	m_input.assign(channels * m_frameSize, 0.0f);
+	m_pending.resize(channels * m_hop);
+	m_delayed.assign(channels * (m_hop + RESAMPLER_DELAY), 0.0f);
+	m_spectra.resize(channels * m_bins);
+	m_overlap.resize(channels * m_frameSize);
+	m_stretched.resize(channels);
+	for (std::vector<float>& stretched: m_stretched)
+	{
+		stretched.reserve(m_frameSize * 2);
+	}
+
+	m_windowSum.resize(m_frameSize);
+	m_phase.resize(m_bins);
+	m_previousPhase.resize(m_bins);
+	m_synthesisPhase.resize(m_bins);
+	m_magnitude.resize(m_bins);
+	m_rotation.resize(m_bins);
+	m_peaks.reserve(m_bins);
+
+	m_time.resize(m_frameSize);
+	m_envelope.resize(m_bins);
+	m_cepstrum.resize(m_bins);
+
+	m_fill = 0;
+	m_mix = 0.0f;
+	m_shifting = false;
+	m_latency = m_frameSize + RESAMPLER_DELAY;
+
+	LOG_DEBUG("Pitch shifter configured for {} channels at {} Hz, {} sample frames", channels, sampleRate, m_frameSize);
+}
+
+void PitchShifter::Clear()
+{
+	std::fill(m_pending.begin(), m_pending.end(), 0.0f);
+	std::fill(m_overlap.begin(), m_overlap.end(), 0.0f);
+	std::fill(m_windowSum.begin(), m_windowSum.end(), 0.0f);
+	std::fill(m_previousPhase.begin(), m_previousPhase.end(), 0.0f);
+	std::fill(m_synthesisPhase.begin(), m_synthesisPhase.end(), 0.0f);
+
+	// The resampler looks one sample back and two ahead, start it a little into silence
+	for (std::vector<float>& stretched: m_stretched)
 	{
-		alSourcef(m_source, AL_PITCH, m_pitchScale);
+		stretched.assign(4, 0.0f);
 	}
+	m_readIndex = 1;
+	m_readFraction = 0;
+	m_warmup = 0;
 }
 
-float PitchShifter::GetPitch() const
+void PitchShifter::Process(float* samples, size_t frameCount, unsigned int channels, unsigned int sampleRate)
 {
-	if (m_source != 0)
+	if (channels != m_channels || sampleRate != m_sampleRate)
+	{
+		Configure(channels, sampleRate);
+	}
+
+	// Unshifted audio only goes through the delay, the vocoder picks up from the input it already has when shifting starts again
+	const bool shift = std::abs(m_semitones.load()) >= 0.01f;
+	if (shift && !m_shifting)
 	{
-		float pitch;
-		alGetSourcef(m_source, AL_PITCH, &pitch);
-		return std::log2(pitch) * 12.0f;
+		Clear();
+		m_shifting = true;
+	}
+
+	const float step = 1.0f / static_cast<float>(m_hop);
+	const size_t delayedSize = m_hop + RESAMPLER_DELAY;
+	size_t frame = 0;
+	while (frame < frameCount)
+	{
+		// Input joins the newest hop of the frame while the last synthesized hop plays out
+		const size_t count = min(frameCount - frame, m_hop - m_fill);
+		const float target = shift && m_warmup >= OVERLAP ? 1.0f : 0.0f;
+		float mix = m_mix;
+		for (unsigned int channel = 0; channel < channels; channel++)
+		{
+			float* input = m_input.data() + channel * m_frameSize + (m_frameSize - m_hop) + m_fill;
+			const float* pending = m_pending.data() + channel * m_hop + m_fill;
+			const float* delayed = m_delayed.data() + channel * delayedSize + m_fill;
+			mix = m_mix;
+			for (size_t i = 0; i < count; i++)
+			{
+				float& sample = samples[(frame + i) * channels + channel];
+				input[i] = sample;
+				mix = target > mix ? min(mix + step, target) : max(mix - step, target);
+				sample = delayed[i] + (pending[i] - delayed[i]) * mix;
+			}
+		}
+		m_mix = mix;
+
+		m_fill += count;
+		frame += count;
+		if (m_fill == m_hop)
+		{
+			// Once faded back out the vocoder stops, the bypass costs a copy
+			if (m_shifting && !shift && m_mix == 0.0f)
+			{
+				m_shifting = false;
+			}
+			if (m_shifting)
+			{
+				RunFrame();
+				m_warmup++;
+			}
+
+			// The hop leaving the frame is the input one frame back, what the bypass plays next
+			for (unsigned int channel = 0; channel < channels; channel++)
+			{
+				float* input = m_input.data() + channel * m_frameSize;
+				float* delayed = m_delayed.data() + channel * delayedSize;
+				std::copy(delayed + m_hop, delayed + delayedSize, delayed);
+				std::copy(input, input + m_hop, delayed + RESAMPLER_DELAY);
+				std::copy(input + m_hop, input + m_frameSize, input);
+			}
+			m_fill = 0;
+		}
 	}
-	return std::log2(m_pitchScale) * 12.0f;
 }
 
-void PitchShifter::Reset()
+void PitchShifter::RunFrame()
+{
+	// The synthesis hop carries the ratio, so stretching and resampling always agree exactly
+	const float ratio = FastMath::Exp2(m_semitones.load() / 12.0f);
+	const size_t synthesisHop = std::clamp<size_t>(static_cast<size_t>(std::lround(static_cast<float>(m_hop) * ratio)), m_hop / 2, m_hop * 2);
+	const float stretch = static_cast<float>(synthesisHop) / static_cast<float>(m_hop);
+
+	// Analysis, each channel on its own and their sum for the phase tracking
+	for (unsigned int channel = 0; channel < m_channels; channel++)
+	{
+		const float* input = m_input.data() + channel * m_frameSize;
+		for (size_t n = 0; n < m_frameSize; n++)
+		{
+			m_time[n] = input[n] * m_window[n];
+		}
+		m_plan->Forward(m_time.data(), m_spectra.data() + channel * m_bins);
+	}
+
+	for (size_t k = 0; k < m_bins; k++)
+	{
+		std::complex<float> sum = m_spectra[k];
+		for (unsigned int channel = 1; channel < m_channels; channel++)
+		{
+			sum += m_spectra[channel * m_bins + k];
+		}
+		m_magnitude[k] = std::sqrt(sum.real() * sum.real() + sum.imag() * sum.imag());
+		m_phase[k] = std::atan2(sum.imag(), sum.real());
+	}
+
+	m_peaks.clear();
+	for (size_t k = 2; k + 2 < m_bins; k++)
+	{
+		const float m = m_magnitude[k];
+		if (m > m_magnitude[k - 1] && m > m_magnitude[k - 2] && m >= m_magnitude[k + 1] && m >= m_magnitude[k + 2])
+		{
+			m_peaks.push_back(k);
+		}
+	}
+
+	// True frequency of a bin from its phase change over the hop, advanced by the synthesis hop
+	const float binAdvance = TWO_PI * static_cast<float>(m_hop) / static_cast<float>(m_frameSize);
+	auto advance = [&](size_t k)
+	{
+		const float expected = binAdvance * static_cast<float>(k);
+		const float deviation = WrapPhase(m_phase[k] - m_previousPhase[k] - expected);
+		return (expected + deviation) * stretch;
+	};
+
+	if (m_peaks.empty())
+	{
+		for (size_t k = 0; k < m_bins; k++)
+		{
+			m_synthesisPhase[k] = WrapPhase(m_synthesisPhase[k] + advance(k));
+		}
+	}
+	else
+	{
+		// Identity phase locking, every bin keeps its phase offset to the peak whose region it is in
+		size_t start = 0;
+		for (size_t i = 0; i < m_peaks.size(); i++)
+		{
+			const size_t peak = m_peaks[i];
+			const size_t end = i + 1 < m_peaks.size() ? (peak + m_peaks[i + 1]) / 2 + 1 : m_bins;
+			const float peakPhase = WrapPhase(m_synthesisPhase[peak] + advance(peak));
+			for (size_t k = start; k < end; k++)
+			{
+				m_synthesisPhase[k] = WrapPhase(peakPhase + m_phase[k] - m_phase[peak]);
+			}
+			start = end;
+		}
+	}
+	std::copy(m_phase.begin(), m_phase.end(), m_previousPhase.begin());
+
+	const bool preserveFormants = m_preserveFormants;
+	if (preserveFormants)
+	{
+		EstimateEnvelope();
+	}
+
+	// Resampling scales every frequency by the stretch. Whatever would land past Nyquist is dropped
+	// here rather than aliasing, and with formants kept the envelope is pre-warped the opposite way
+	const float cutoff = static_cast<float>(m_bins - 1) / stretch;
+	for (size_t k = 0; k < m_bins; k++)
+	{
+		float gain = static_cast<float>(k) < cutoff ? 1.0f : 0.0f;
+		if (preserveFormants && gain > 0.0f)
+		{
+			const float position = min(static_cast<float>(k) * stretch, static_cast<float>(m_bins - 1));
+			const size_t lower = min(static_cast<size_t>(position), m_bins - 2);
+			const float fraction = position - static_cast<float>(lower);
+			const float target = m_envelope[lower] + (m_envelope[lower + 1] - m_envelope[lower]) * fraction;
+			gain = FastMath::Exp2(std::clamp(target - m_envelope[k], -4.0f, 4.0f));
+		}
+
+		float sinRotation, cosRotation;
+		FastMath::SinCos(m_synthesisPhase[k] - m_phase[k], sinRotation, cosRotation);
+		m_rotation[k] = { cosRotation * gain, sinRotation * gain };
+	}
+
+	// Synthesis, overlap-added at the synthesis hop
+	for (unsigned int channel = 0; channel < m_channels; channel++)
+	{
+		std::complex<float>* spectrum = m_spectra.data() + channel * m_bins;
+		for (size_t k = 0; k < m_bins; k++)
+		{
+			spectrum[k] *= m_rotation[k];
+		}
+		m_plan->Inverse(spectrum, m_time.data());
+
+		float* overlap = m_overlap.data() + channel * m_frameSize;
+		for (size_t n = 0; n < m_frameSize; n++)
+		{
+			overlap[n] += m_time[n] * m_window[n];
+		}
+	}
+	for (size_t n = 0; n < m_frameSize; n++)
+	{
+		m_windowSum[n] += m_window[n] * m_window[n];
+	}
+
+	// The first synthesis hop gets nothing more from later frames, normalize it by the window overlap and move it on
+	for (unsigned int channel = 0; channel < m_channels; channel++)
+	{
+		float* overlap = m_overlap.data() + channel * m_frameSize;
+		std::vector<float>& stretched = m_stretched[channel];
+		for (size_t i = 0; i < synthesisHop; i++)
+		{
+			stretched.push_back(overlap[i] / max(m_windowSum[i], 1e-3f));
+		}
+		std::copy(overlap + synthesisHop, overlap + m_frameSize, overlap);
+		std::fill(overlap + m_frameSize - synthesisHop, overlap + m_frameSize, 0.0f);
+	}
+	std::copy(m_windowSum.begin() + synthesisHop, m_windowSum.end(), m_windowSum.begin());
+	std::fill(m_windowSum.end() - synthesisHop, m_windowSum.end(), 0.0f);
+
+	// Read one analysis hop back out at the stretch ratio, which takes exactly the synthesis hop just added
+	size_t index = m_readIndex;
+	size_t fraction = m_readFraction;
+	const float fractionScale = 1.0f / static_cast<float>(m_hop);
+	for (unsigned int channel = 0; channel < m_channels; channel++)
+	{
+		const float* stretched = m_stretched[channel].data();
+		float* pending = m_pending.data() + channel * m_hop;
+		index = m_readIndex;
+		fraction = m_readFraction;
+		for (size_t i = 0; i < m_hop; i++)
+		{
+			// Catmull-Rom through the four samples around the read position
+			const float t = static_cast<float>(fraction) * fractionScale;
+			const float p0 = stretched[index - 1], p1 = stretched[index], p2 = stretched[index + 1], p3 = stretched[index + 2];
+			pending[i] = p1 + 0.5f * t * (p2 - p0 + t * (2.0f * p0 - 5.0f * p1 + 4.0f * p2 - p3 + t * (3.0f * (p1 - p2) + p3 - p0)));
+
+			fraction += synthesisHop;
+			index += fraction / m_hop;
+			fraction %= m_hop;
+		}
+	}
+
+	for (std::vector<float>& stretched: m_stretched)
+	{
+		stretched.erase(stretched.begin(), stretched.begin() + (index - 1));
+	}
+	m_readIndex = 1;
+	m_readFraction = fraction;
+}
+
+void PitchShifter::EstimateEnvelope()
 {
-	if (m_source != 0)
+	// Low quefrencies of the real cepstrum hold the envelope, the harmonics sit above the cut-off
+	for (size_t k = 0; k < m_bins; k++)
+	{
+		m_cepstrum[k] = { FastMath::Log2(m_magnitude[k] + 1e-9f), 0.0f };
+	}
+	m_plan->Inverse(m_cepstrum.data(), m_time.data());
+	std::fill(m_time.begin() + m_lifter, m_time.end() - (m_lifter - 1), 0.0f);
+	m_plan->Forward(m_time.data(), m_cepstrum.data());
+
+	for (size_t k = 0; k < m_bins; k++)
 	{
-		alSourcef(m_source, AL_PITCH, 1.0f);
+		m_envelope[k] = m_cepstrum[k].real();
 	}
-	m_pitchScale = 1.0f;
 }
@@ -1,18 +1,105 @@
 #pragma once
-#include <AL/al.h>
-#include <cmath>
+#include <atomic>
+#include <complex>
+#include <memory>
+#include <vector>
 
+#include "dsp/FFTPlan.h"
+
+// Shifts pitch without touching tempo, in the effect chain rather than through AL_PITCH so the
+// stream keeps its length and the position maths stays valid. A phase vocoder with identity phase
+// locking stretches the audio by the pitch ratio and a cubic resampler reads it back at the same
+// ratio. Phases are advanced once on the sum of all channels and the same rotation is applied to
+// each, so the stereo image survives the shift. Optionally the spectral envelope is moved back
+// into place, keeping voices from sounding like chipmunks.
 class PitchShifter
 {
-private:
-	float m_pitchScale = 1.0f;
-	ALuint m_source = 0;
-
 public:
-	void SetSource(ALuint source);
-
+	// Semitones, -12 to 12. At 0 the vocoder fades out to the input delayed by the same latency, so
+	// moving in and out of a shift neither clicks nor moves the clock
 	void SetPitch(float semitones);
 	float GetPitch() const;
 
+	void SetFormantPreservation(bool enabled)
+	{
+		m_preserveFormants = enabled;
+	}
+
+	bool GetFormantPreservation() const
+	{
+		return m_preserveFormants;
+	}
+
 	void Reset();
+
+	// In place over frameCount interleaved frames, called on the streaming thread
+	void Process(float* samples, size_t frameCount, unsigned int channels, unsigned int sampleRate);
+
+	// Frames the output trails the input by, one analysis frame plus the resampler's lead-in whether shifting or not
+	size_t GetLatency() const
+	{
+		return m_latency;
+	}
+
+private:
+	static constexpr int OVERLAP = 4;
+	static constexpr float MAX_SEMITONES = 12.0f;
+
+	// The resampler starts this many samples into silence, the bypass delays by the same
+	static constexpr size_t RESAMPLER_DELAY = 3;
+
+	// Sizes everything for the layout, about 40 ms frames whatever the rate
+	void Configure(unsigned int channels, unsigned int sampleRate);
+
+	// Clears the synthesis state, the vocoder starts over on the input already collected
+	void Clear();
+
+	// Analyzes the newest frame, adds its stretched synthesis to the overlap buffers and resamples one hop of output
+	void RunFrame();
+
+	// Smoothed log2 magnitude of the sum spectrum, by cepstral liftering
+	void EstimateEnvelope();
+
+	std::atomic<float> m_semitones{ 0.0f };
+	std::atomic<bool> m_preserveFormants{ false };
+	std::atomic<size_t> m_latency{ 0 };
+	bool m_shifting = false; // Vocoder running, stays on until the mix has faded back to the bypass
+	float m_mix = 0.0f;      // 0 is the delayed input, 1 the vocoder, ramped over a hop
+	size_t m_warmup = 0;     // Frames run since Clear, the mix only moves towards the vocoder after a full overlap
+
+	unsigned int m_channels = 0;
+	unsigned int m_sampleRate = 0;
+	size_t m_frameSize = 0;
+	size_t m_hop = 0; // Analysis hop, synthesis hop follows the pitch ratio
+	size_t m_bins = 0;
+	size_t m_lifter = 0; // Cepstral cut-off, about 1 ms
+	std::unique_ptr<FFTPlan> m_plan;
+	std::vector<float> m_window;
+
+	// Per channel, [channel][...]
+	std::vector<float> m_input;                 // Last frame of input, the newest hop at the end
+	std::vector<float> m_pending;               // Hop of output being played out
+	std::vector<float> m_delayed;               // Bypass output, the hop dropped out of m_input after the resampler delay
+	std::vector<std::complex<float>> m_spectra; // Analysis of the current frame
+	std::vector<float> m_overlap;               // Overlap-add of synthesized frames
+	std::vector<std::vector<float>> m_stretched;
+	size_t m_fill = 0; // Input frames collected towards the next hop
+
+	// Shared by all channels
+	std::vector<float> m_windowSum;
+	std::vector<float> m_phase;
+	std::vector<float> m_previousPhase;
+	std::vector<float> m_synthesisPhase;
+	std::vector<float> m_magnitude;
+	std::vector<std::complex<float>> m_rotation;
+	std::vector<size_t> m_peaks;
+
+	// Resampler position in the stretched signal, index plus numerator over m_hop
+	size_t m_readIndex = 0;
+	size_t m_readFraction = 0;
+
+	// Scratch
+	std::vector<float> m_time;
+	std::vector<float> m_envelope;
+	std::vector<std::complex<float>> m_cepstrum;
 };
@@ -3,18 +3,136 @@
 #include "Playlist.h"
 
 #include <algorithm>
+#include <array>
+#include <fstream>
 #include <random>
 #include <numeric>
+#include <sstream>
 
 void Playlist::AddTrack(const std::string& filepath)
 {
-	m_tracks.push_back(filepath);
+	AddTrack(Track{ filepath });
+}
+
+void Playlist::AddTrack(Track track)
+{
+	m_tracks.push_back(std::move(track));
 	if (m_shuffleEnabled)
 	{
 		UpdateShuffleIndices();
 	}
 }
 
+// Reads a cue value, which is either "quoted" or runs to the end of the line
+static std::string ReadCueValue(std::istringstream& line)
+{
+	std::string value;
+	line >> std::ws;
+	if (line.peek() == '"')
+	{
+		line.get();
+		std::getline(line, value, '"');
+	}
+	else
+	{
+		std::getline(line, value);
+		value.erase(value.find_last_not_of(" \t\r") + 1);
+	}
+	return value;
+}
+
+// Reads the path of a FILE command. The file type follows it, unquoted paths run up to the type
+static std::string ReadCueFile(std::istringstream& line)
+{
+	line >> std::ws;
+	if (line.peek() == '"')
+		return ReadCueValue(line);
+
+	static constexpr std::array<std::string_view, 5> types{ "WAVE", "MP3", "AIFF", "BINARY", "MOTOROLA" };
+	std::string value = ReadCueValue(line);
+	const size_t space = value.find_last_of(" \t");
+	if (space != std::string::npos && std::find(types.begin(), types.end(), std::string_view(value).substr(space + 1)) != types.end())
+	{
+		value.erase(value.find_last_not_of(" \t", space) + 1);
+	}
+	return value;
+}
+
+size_t Playlist::AddCueSheet(const std::string& cuePath)
+{
+	std::ifstream cue(cuePath);
+	if (!cue)
+	{
+		LOG_ERROR("Failed to open cue sheet {}", cuePath);
+		return 0;
+	}
+
+	std::filesystem::path cueDirectory = std::filesystem::path(cuePath).parent_path();
+	std::vector<Track> tracks;
+	std::string albumPerformer;
+	std::string currentFile;
+	bool inTrack = false;
+
+	std::string rawLine;
+	while (std::getline(cue, rawLine))
+	{
+		std::istringstream line(rawLine);
+		std::string command;
+		line >> command;
+
+		if (command == "FILE")
+		{
+			currentFile = (cueDirectory / ReadCueFile(line)).string();
+			inTrack = false;
+		}
+		else if (command == "TRACK")
+		{
+			tracks.push_back(Track{ currentFile });
+			tracks.back().performer = albumPerformer;
+			inTrack = true;
+		}
+		else if (command == "TITLE" && inTrack)
+		{
+			tracks.back().title = ReadCueValue(line);
+		}
+		else if (command == "PERFORMER")
+		{
+			std::string performer = ReadCueValue(line);
+			(inTrack ? tracks.back().performer : albumPerformer) = performer;
+		}
+		else if (command == "INDEX" && inTrack)
+		{
+			// Only INDEX 01 marks where a track starts, INDEX 00 is the pregap before it
+			int number = -1;
+			int minutes = 0, seconds = 0, frames = 0;
+			char separator;
+			line >> number >> minutes >> separator >> seconds >> separator >> frames;
+			if (number == 1 && line)
+			{
+				// Cue times count CD frames, 75 per second
+				tracks.back().startSeconds = minutes * 60.0 + seconds + frames / 75.0;
+			}
+		}
+	}
+
+	// Each track ends where the next one in the same file starts, the last runs to the end of the file
+	for (size_t i = 0; i + 1 < tracks.size(); ++i)
+	{
+		if (tracks[i].filepath == tracks[i + 1].filepath)
+		{
+			tracks[i].endSeconds = tracks[i + 1].startSeconds;
+		}
+	}
+
+	for (Track& track: tracks)
+	{
+		AddTrack(std::move(track));
+	}
+
+	LOG_INFO("Added {} tracks from cue sheet {}", tracks.size(), cuePath);
+	return tracks.size();
+}
+
 void Playlist::RemoveTrack(size_t index)
 {
 	if (index >= m_tracks.size())
@@ -46,27 +164,35 @@ void Playlist::Clear()
 
 bool Playlist::Next()
 {
-	if (m_tracks.empty())
+	std::optional<size_t> next = PeekNext();
+	if (!next)
 		return false;
 
+	m_currentIndex = *next;
+	return true;
+}
+
+std::optional<size_t> Playlist::PeekNext() const
+{
+	if (m_tracks.empty())
+		return std::nullopt;
+
 	if (m_shuffleEnabled)
 	{
 		auto it = std::find(m_shuffleIndices.begin(), m_shuffleIndices.end(), m_currentIndex);
 		if (it != m_shuffleIndices.end() && it + 1 != m_shuffleIndices.end())
 		{
-			m_currentIndex = *(it + 1);
-			return true;
+			return *(it + 1);
 		}
-		return false;
+		return std::nullopt;
 	}
 	else
 	{
 		if (m_currentIndex + 1 < m_tracks.size())
 		{
-			m_currentIndex++;
-			return true;
+			return m_currentIndex + 1;
 		}
-		return false;
+		return std::nullopt;
 	}
 }
 
@@ -115,14 +241,14 @@ size_t Playlist::GetCurrentIndex() const
 	return m_currentIndex;
 }
 
-std::string Playlist::GetCurrentTrack() const
+Playlist::Track Playlist::GetCurrentTrack() const
 {
 	if (m_tracks.empty())
-		return "";
+		return {};
 	return m_tracks[m_currentIndex];
 }
 
-std::vector<std::string> Playlist::GetTracks() const
+const std::vector<Playlist::Track>& Playlist::GetTracks() const
 {
 	return m_tracks;
 }
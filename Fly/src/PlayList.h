@@ -1,22 +1,45 @@
 #pragma once
 
 #include <filesystem>
+#include <optional>
 #include <string>
 #include <vector>
 
 class Playlist
 {
 public:
+	// A whole file, or a virtual track covering part of one (e.g. a cue sheet entry)
+	struct Track
+	{
+		std::string filepath;
+		std::string title;     // Empty for whole files, their tags are used instead
+		std::string performer;
+		double startSeconds{ 0.0 };
+		double endSeconds{ -1.0 }; // Negative for the end of the file
+
+		bool IsVirtual() const
+		{
+			return startSeconds > 0.0 || endSeconds >= 0.0;
+		}
+	};
+
 	Playlist() = default;
 
 	// Add/Remove tracks
 	void AddTrack(const std::string& filepath);
+	void AddTrack(Track track);
+
+	// Adds every track of a .cue sheet as a virtual track, returns the number added
+	size_t AddCueSheet(const std::string& cuePath);
 	void RemoveTrack(size_t index);
 	void Clear();
 
 	// Track management
 	bool Next();
 	bool Previous();
+
+	// Index Next() would move to, without moving
+	std::optional<size_t> PeekNext() const;
 	bool JumpToTrack(size_t index);
 
 	// Playlist properties
@@ -25,15 +48,15 @@ public:
 
 	// Current track info
 	size_t GetCurrentIndex() const;
-	std::string GetCurrentTrack() const;
-	std::vector<std::string> GetTracks() const;
+	Track GetCurrentTrack() const;
+	const std::vector<Track>& GetTracks() const;
 
 	// Shuffle functionality
 	void ToggleShuffle();
 	bool IsShuffleEnabled() const;
 
 private:
-	std::vector<std::string> m_tracks;
+	std::vector<Track> m_tracks;
 	std::vector<size_t> m_shuffleIndices;
 	size_t m_currentIndex = 0;
 	bool m_shuffleEnabled = false;
@@ -2,84 +2,59 @@
 
 #include "RoomReverb.h"
 
-void RoomReverb::SetDecayTime(float value)
+void RoomReverb::SetParameter(float& parameter, float value, ALenum efxParameter)
 {
-	m_decayTime = std::clamp(value, 0.1f, 20.0f);
+	{
+		std::lock_guard<std::mutex> lock(m_parameterMutex);
+		parameter = value;
+	}
+	m_parameterGeneration++;
+
 	if (m_effect)
 	{
-		alEffectf(m_effect, AL_REVERB_DECAY_TIME, m_decayTime);
+		alEffectf(m_effect, efxParameter, value);
 		UpdateEffect();
 	}
 }
 
+void RoomReverb::SetDecayTime(float value)
+{
+	SetParameter(m_decayTime, std::clamp(value, 0.1f, 20.0f), AL_REVERB_DECAY_TIME);
+}
+
 void RoomReverb::SetReflectionsDelay(float value)
 {
-	m_reflectionsDelay = std::clamp(value, 0.0f, 0.3f);
-	if (m_effect)
-	{
-		alEffectf(m_effect, AL_REVERB_REFLECTIONS_DELAY, m_reflectionsDelay);
-		UpdateEffect();
-	}
+	SetParameter(m_reflectionsDelay, std::clamp(value, 0.0f, 0.3f), AL_REVERB_REFLECTIONS_DELAY);
 }
 
 void RoomReverb::SetLateDelay(float value)
 {
-	m_lateDelay = std::clamp(value, 0.0f, 0.1f);
-	if (m_effect)
-	{
-		alEffectf(m_effect, AL_REVERB_LATE_REVERB_DELAY, m_lateDelay);
-		UpdateEffect();
-	}
+	SetParameter(m_lateDelay, std::clamp(value, 0.0f, 0.1f), AL_REVERB_LATE_REVERB_DELAY);
 }
 
 void RoomReverb::SetRoomRolloff(float value)
 {
-	m_roomRolloff = std::clamp(value, 0.0f, 10.0f);
-	if (m_effect)
-	{
-		alEffectf(m_effect, AL_REVERB_ROOM_ROLLOFF_FACTOR, m_roomRolloff);
-		UpdateEffect();
-	}
+	SetParameter(m_roomRolloff, std::clamp(value, 0.0f, 10.0f), AL_REVERB_ROOM_ROLLOFF_FACTOR);
 }
 
 void RoomReverb::SetDecayHFRatio(float value)
 {
-	m_decayHFRatio = std::clamp(value, 0.1f, 2.0f);
-	if (m_effect)
-	{
-		alEffectf(m_effect, AL_REVERB_DECAY_HFRATIO, m_decayHFRatio);
-		UpdateEffect();
-	}
+	SetParameter(m_decayHFRatio, std::clamp(value, 0.1f, 2.0f), AL_REVERB_DECAY_HFRATIO);
 }
 
 void RoomReverb::SetReflectionsGain(float value)
 {
-	m_reflectionsGain = std::clamp(value, 0.0f, 3.16f);
-	if (m_effect)
-	{
-		alEffectf(m_effect, AL_REVERB_REFLECTIONS_GAIN, m_reflectionsGain);
-		UpdateEffect();
-	}
+	SetParameter(m_reflectionsGain, std::clamp(value, 0.0f, 3.16f), AL_REVERB_REFLECTIONS_GAIN);
 }
 
 void RoomReverb::SetLateGain(float value)
 {
-	m_lateGain = std::clamp(value, 0.0f, 10.0f);
-	if (m_effect)
-	{
-		alEffectf(m_effect, AL_REVERB_LATE_REVERB_GAIN, m_lateGain);
-		UpdateEffect();
-	}
+	SetParameter(m_lateGain, std::clamp(value, 0.0f, 10.0f), AL_REVERB_LATE_REVERB_GAIN);
 }
 
 void RoomReverb::SetAirAbsorption(float value)
 {
-	m_airAbsorption = std::clamp(value, 0.892f, 1.0f);
-	if (m_effect)
-	{
-		alEffectf(m_effect, AL_REVERB_AIR_ABSORPTION_GAINHF, m_airAbsorption);
-		UpdateEffect();
-	}
+	SetParameter(m_airAbsorption, std::clamp(value, 0.892f, 1.0f), AL_REVERB_AIR_ABSORPTION_GAINHF);
 }
 
 void RoomReverb::SetDefaultPreset()
@@ -199,8 +174,63 @@ void RoomReverb::UpdateEffect()
 {
 	if (m_slot && m_effect)
 	{
-		alAuxiliaryEffectSloti(m_slot, AL_EFFECTSLOT_EFFECT, m_effect);
+		alAuxiliaryEffectSloti(m_slot, AL_EFFECTSLOT_EFFECT, m_backend == Backend::Efx ? m_effect : AL_EFFECT_NULL);
+	}
+}
+
+void RoomReverb::SetBackend(Backend backend)
+{
+	m_backend = backend;
+	UpdateEffect();
+}
+
+std::function<void(std::vector<float>&, unsigned int, unsigned int)> RoomReverb::CreateProcessor()
+{
+	return [this](std::vector<float>& buffer, unsigned int channels, unsigned int sampleRate)
+	{
+		Process(buffer, channels, sampleRate);
+	};
+}
+
+void RoomReverb::Process(std::vector<float>& buffer, unsigned int channels, unsigned int sampleRate)
+{
+	if (m_backend != Backend::Software || channels == 0 || sampleRate == 0)
+	{
+		m_softwareActive = false;
+		return;
+	}
+
+	const bool configure = channels != m_fdn.GetChannelCount() || sampleRate != m_fdn.GetSampleRate();
+	if (configure)
+	{
+		m_fdn.Configure(channels, sampleRate);
+	}
+	else if (!m_softwareActive)
+	{
+		// A tail left over from the last time the backend was on would come back in mid-song
+		m_fdn.Reset();
 	}
+	m_softwareActive = true;
+
+	const unsigned int generation = m_parameterGeneration;
+	if (configure || generation != m_appliedGeneration)
+	{
+		FdnReverb::Parameters parameters;
+		{
+			std::lock_guard<std::mutex> lock(m_parameterMutex);
+			parameters.decayTime = m_decayTime;
+			parameters.reflectionsDelay = m_reflectionsDelay;
+			parameters.lateDelay = m_lateDelay;
+			parameters.decayHFRatio = m_decayHFRatio;
+			parameters.reflectionsGain = m_reflectionsGain;
+			parameters.lateGain = m_lateGain;
+			parameters.airAbsorption = m_airAbsorption;
+		}
+		m_fdn.SetParameters(parameters);
+		m_appliedGeneration = generation;
+	}
+
+	m_fdn.Process(buffer.data(), buffer.size() / channels);
 }
 
 bool RoomReverb::Init(ALCdevice* device)
@@ -253,8 +283,8 @@ bool RoomReverb::Init(ALCdevice* device)
 	// Air absorption
 	alEffectf(m_effect, AL_REVERB_AIR_ABSORPTION_GAINHF, m_airAbsorption);
 
-	// Attach effect to slot
-	alAuxiliaryEffectSloti(m_slot, AL_EFFECTSLOT_EFFECT, m_effect);
+	// Attach effect to slot, unless the software backend was picked first
+	alAuxiliaryEffectSloti(m_slot, AL_EFFECTSLOT_EFFECT, m_backend == Backend::Efx ? m_effect : AL_EFFECT_NULL);
 	if (alGetError() != AL_NO_ERROR)
 	{
 		Cleanup();
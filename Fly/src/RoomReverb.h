@@ -3,12 +3,31 @@
 #include <AL/alc.h>
 #include <AL/efx.h>
 
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+#include "dsp/FdnReverb.h"
+
+// Room reverb with one set of parameters and presets and two ways to render it. The EFX backend
+// sends the source to an OpenAL reverb slot, which sounds different per OpenAL implementation.
+// The software backend runs an FdnReverb in the effect chain, see CreateProcessor, and gives the
+// same output on every machine.
 class RoomReverb
 {
+public:
+	enum class Backend
+	{
+		Efx,
+		Software
+	};
+
 private:
 	ALuint m_effect = 0;
 	ALuint m_slot = 0;
 	ALCdevice* m_device = nullptr;
+	std::atomic<Backend> m_backend{ Backend::Efx };
 
 	// Current reverb parameters
 	float m_decayTime = 1.0f;         // 0.1 to 20.0 seconds
@@ -29,8 +48,19 @@ private:
 	LPALEFFECTF alEffectf = nullptr;
 	LPALAUXILIARYEFFECTSLOTI alAuxiliaryEffectSloti = nullptr;
 
+	// Parameters are written under the lock on the UI thread, the processor copies them when the generation moves
+	std::mutex m_parameterMutex;
+	std::atomic<unsigned int> m_parameterGeneration{ 0 };
+
+	// Processor side
+	FdnReverb m_fdn;
+	unsigned int m_appliedGeneration{ 0 };
+	bool m_softwareActive{ false };
+
 	bool LoadEFX();
 	void UpdateEffect();
+	void SetParameter(float& parameter, float value, ALenum efxParameter);
+	void Process(std::vector<float>& buffer, unsigned int channels, unsigned int sampleRate);
 
 public:
 	bool Init(ALCdevice* device);
@@ -38,6 +68,25 @@ public:
 	void DetachFromSource(ALuint source);
 	void Cleanup();
 
+	// The EFX slot is emptied while the software backend runs, so only one of them is heard
+	void SetBackend(Backend backend);
+
+	Backend GetBackend() const
+	{
+		return m_backend;
+	}
+
+	// Whether the EFX backend can be used, false if the device has no EFX
+	bool IsEfxAvailable() const
+	{
+		return m_effect != 0 && m_slot != 0;
+	}
+
+	// This will make it into a lambda function for the audio streamer. Adds nothing unless the
+	// software backend is selected. Room rolloff is left to EFX: it scales the send by distance under
+	// the linear clamped model, which stays at unity for the unbounded maximum distance the source uses
+	std::function<void(std::vector<float>&, unsigned int, unsigned int)> CreateProcessor();
+
 	// Getters
 	float GetDecayTime() const
 	{
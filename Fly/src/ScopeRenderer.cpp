@@ -0,0 +1,84 @@
+#include "pch.h"
+
+#include "ScopeRenderer.h"
+
+namespace
+{
+	void WriteRect(ImDrawVert*& vtx, ImDrawIdx*& idx, unsigned int& base, const ImVec2& uv, float x0, float y0, float x1, float y1, ImU32 color)
+	{
+		vtx[0] = { ImVec2(x0, y0), uv, color };
+		vtx[1] = { ImVec2(x1, y0), uv, color };
+		vtx[2] = { ImVec2(x1, y1), uv, color };
+		vtx[3] = { ImVec2(x0, y1), uv, color };
+		idx[0] = static_cast<ImDrawIdx>(base);
+		idx[1] = static_cast<ImDrawIdx>(base + 1);
+		idx[2] = static_cast<ImDrawIdx>(base + 2);
+		idx[3] = static_cast<ImDrawIdx>(base);
+		idx[4] = static_cast<ImDrawIdx>(base + 2);
+		idx[5] = static_cast<ImDrawIdx>(base + 3);
+		vtx += 4;
+		idx += 6;
+		base += 4;
+	}
+}
+
+void ScopeRenderer::DrawMinMaxTrace(ImDrawList* drawList, const ImVec2& pos, const ImVec2& size, const float* mins, const float* maxs, int columns, ImU32 color)
+{
+	if (columns <= 0)
+	{
+		return;
+	}
+
+	drawList->PrimReserve(columns * 6, columns * 4);
+	ImDrawVert* vtx = drawList->_VtxWritePtr;
+	ImDrawIdx* idx = drawList->_IdxWritePtr;
+	unsigned int base = drawList->_VtxCurrentIdx;
+	const ImVec2 uv = drawList->_Data->TexUvWhitePixel;
+
+	const float columnWidth = size.x / columns;
+	const float centerY = pos.y + size.y * 0.5f;
+	const float scale = size.y * 0.5f;
+
+	for (int i = 0; i < columns; i++)
+	{
+		const float x0 = pos.x + columnWidth * i;
+		const float top = centerY - std::clamp(maxs[i], -1.0f, 1.0f) * scale;
+		const float bottom = centerY - std::clamp(mins[i], -1.0f, 1.0f) * scale;
+
+		// At least a pixel tall so flat stretches still show
+		WriteRect(vtx, idx, base, uv, x0, top, x0 + max(columnWidth, 1.0f), max(bottom, top + 1.0f), color);
+	}
+
+	drawList->_VtxWritePtr = vtx;
+	drawList->_IdxWritePtr = idx;
+	drawList->_VtxCurrentIdx = base;
+}
+
+void ScopeRenderer::DrawPoints(ImDrawList* drawList, const ImVec2& pos, const ImVec2& size, const float* points, int count, float dotSize, ImU32 color)
+{
+	if (count <= 0)
+	{
+		return;
+	}
+
+	drawList->PrimReserve(count * 6, count * 4);
+	ImDrawVert* vtx = drawList->_VtxWritePtr;
+	ImDrawIdx* idx = drawList->_IdxWritePtr;
+	unsigned int base = drawList->_VtxCurrentIdx;
+	const ImVec2 uv = drawList->_Data->TexUvWhitePixel;
+
+	const float centerX = pos.x + size.x * 0.5f;
+	const float centerY = pos.y + size.y * 0.5f;
+	const float halfDot = dotSize * 0.5f;
+
+	for (int i = 0; i < count; i++)
+	{
+		const float x = centerX + points[i * 2] * size.x * 0.5f;
+		const float y = centerY - points[i * 2 + 1] * size.y * 0.5f;
+		WriteRect(vtx, idx, base, uv, x - halfDot, y - halfDot, x + halfDot, y + halfDot, color);
+	}
+
+	drawList->_VtxWritePtr = vtx;
+	drawList->_IdxWritePtr = idx;
+	drawList->_VtxCurrentIdx = base;
+}
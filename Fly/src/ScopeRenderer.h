@@ -0,0 +1,13 @@
+#pragma once
+
+// Batched drawing for the time-domain views. Like BarRenderer, everything goes into one reserved
+// block of the draw list, one quad per column or point, so the cost is bounded by the pixel size.
+class ScopeRenderer
+{
+public:
+	// One vertical span per column from min to max, samples in -1..1 with 0 at the middle
+	static void DrawMinMaxTrace(ImDrawList* drawList, const ImVec2& pos, const ImVec2& size, const float* mins, const float* maxs, int columns, ImU32 color);
+
+	// Square dots, points interleaved x/y in -1..1 with y up
+	static void DrawPoints(ImDrawList* drawList, const ImVec2& pos, const ImVec2& size, const float* points, int count, float dotSize, ImU32 color);
+};
@@ -0,0 +1,97 @@
+#include "pch.h"
+
+#include "SpectrogramTexture.h"
+
+#include <hello_imgui/hello_imgui_include_opengl.h>
+
+SpectrogramTexture::~SpectrogramTexture()
+{
+	if (m_texture)
+	{
+		glDeleteTextures(1, &m_texture);
+	}
+}
+
+void SpectrogramTexture::Recreate(const SpectrogramImage& image)
+{
+	if (!m_texture)
+	{
+		glGenTextures(1, &m_texture);
+	}
+
+	m_width = image.GetWidth();
+	m_rows = image.GetRows();
+	m_generation = image.GetGeneration();
+	m_uploadedColumns = 0;
+
+	// Starts black, columns are filled in as they arrive
+	std::vector<std::uint32_t> blank(static_cast<std::size_t>(m_width) * m_rows, IM_COL32(0, 0, 0, 255));
+
+	glBindTexture(GL_TEXTURE_2D, m_texture);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+	// The image is column-major, so it's uploaded as a rows x width texture and drawn transposed.
+	// That way every new column is a single texture row, uploaded straight from the image
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, m_rows, m_width, 0, GL_RGBA, GL_UNSIGNED_BYTE, blank.data());
+}
+
+void SpectrogramTexture::Update(const SpectrogramImage& image)
+{
+	if (image.GetRows() == 0)
+	{
+		return;
+	}
+
+	if (image.GetWidth() != m_width || image.GetRows() != m_rows || image.GetGeneration() != m_generation)
+	{
+		Recreate(image);
+	}
+
+	std::uint64_t total = image.GetTotalColumns();
+	if (total == m_uploadedColumns)
+	{
+		return;
+	}
+
+	// Anything older than one lap of the ring has been overwritten already
+	std::uint64_t first = max(m_uploadedColumns, total > static_cast<std::uint64_t>(m_width) ? total - m_width : 0);
+
+	glBindTexture(GL_TEXTURE_2D, m_texture);
+	for (std::uint64_t column = first; column < total; column++)
+	{
+		int slot = static_cast<int>(column % m_width);
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, slot, m_rows, 1, GL_RGBA, GL_UNSIGNED_BYTE, image.GetColumn(slot));
+	}
+
+	m_uploadedColumns = total;
+}
+
+void SpectrogramTexture::Draw(const SpectrogramImage& image, const ImVec2& size) const
+{
+	if (!m_texture)
+	{
+		ImGui::Dummy(size);
+		return;
+	}
+
+	// Texture x runs along frequency and y along time, so each corner is given its own coordinate
+	// with the time axis starting at the oldest slot. GL_REPEAT wraps it round the ring
+	float oldest = static_cast<float>(image.GetTotalColumns() % m_width) / m_width;
+	if (image.GetTotalColumns() < static_cast<std::uint64_t>(m_width))
+	{
+		oldest = 0.0f;
+	}
+
+	ImVec2 pos = ImGui::GetCursorScreenPos();
+	ImVec2 end(pos.x + size.x, pos.y + size.y);
+	ImTextureID texture = (ImTextureID)(intptr_t)m_texture;
+
+	// Top left is the highest row of the oldest column, bottom right the lowest row of the newest
+	ImGui::GetWindowDrawList()->AddImageQuad(texture, pos, ImVec2(end.x, pos.y), end, ImVec2(pos.x, end.y),
+	                                         ImVec2(1.0f, oldest), ImVec2(1.0f, oldest + 1.0f), ImVec2(0.0f, oldest + 1.0f), ImVec2(0.0f, oldest));
+	ImGui::Dummy(size);
+}
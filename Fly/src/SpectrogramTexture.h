@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdint>
+
+#include "analysis/SpectrogramImage.h"
+
+// GPU mirror of a SpectrogramImage. The texture is the same ring as the image, so each frame
+// only the columns added since the last upload are sent, and scrolling is done by offsetting the
+// texture coordinates with wrapping instead of moving any pixels.
+class SpectrogramTexture
+{
+public:
+	SpectrogramTexture() = default;
+	~SpectrogramTexture();
+
+	// Prevent copying, the texture is owned
+	SpectrogramTexture(const SpectrogramTexture&) = delete;
+	SpectrogramTexture& operator=(const SpectrogramTexture&) = delete;
+
+	// UI thread with the GL context current
+	void Update(const SpectrogramImage& image);
+
+	// Newest column on the right
+	void Draw(const SpectrogramImage& image, const ImVec2& size) const;
+
+private:
+	void Recreate(const SpectrogramImage& image);
+
+	unsigned int m_texture = 0;
+	int m_width = 0;
+	int m_rows = 0;
+	std::uint32_t m_generation = 0;
+	std::uint64_t m_uploadedColumns = 0;
+};
@@ -2,12 +2,13 @@
 
 #include "TonalityControl.h"
 
+#include "dsp/FastMath.h"
+
 // Set bass level (-1.0 to 1.0, where 0.0 is neutral)
 void TonalityControl::SetBass(float level)
 {
 	m_inBass = level;
-	m_bassGain = std::pow(10.0f, level); // Convert to gain
-	m_bassGain = std::clamp(m_bassGain, 0.0f, 2.0f);
+	m_bassTargetDb = FastMath::LinearToDb(std::clamp(FastMath::Exp2(level * FastMath::LOG2_10), 0.0f, 2.0f)); // Convert to gain, kept in dB for the glide
 }
 
 float TonalityControl::GetBass() const
@@ -19,8 +20,7 @@ float TonalityControl::GetBass() const
 void TonalityControl::SetTreble(float level)
 {
 	m_inTreble = level;
-	m_trebleGain = std::pow(10.0f, level); // Convert to gain
-	m_trebleGain = std::clamp(m_trebleGain, 0.0f, 2.0f);
+	m_trebleTargetDb = FastMath::LinearToDb(std::clamp(FastMath::Exp2(level * FastMath::LOG2_10), 0.0f, 2.0f)); // Convert to gain, kept in dB for the glide
 }
 
 float TonalityControl::GetTreble() const
@@ -38,37 +38,70 @@ float TonalityControl::GetPitch() const
 	return m_pitchShifter.GetPitch();
 }
 
+bool TonalityControl::UpdateCoefficients(unsigned int sampleRate, size_t frames)
+{
+	// Lower bass frequency for deeper effect
+	const float bassFreq = 80.0f; // Lowered from 100Hz to 80Hz
+	const float bassQ = 0.5f;     // Lower Q for wider effect
+
+	// Higher treble frequency for brighter effect
+	const float trebleFreq = 12000.0f; // Raised from 10kHz to 12kHz
+	const float trebleQ = 0.5f;        // Lower Q for wider effect
+
+	const float targetBassDb = m_bassTargetDb.load(std::memory_order_relaxed);
+	const float targetTrebleDb = m_trebleTargetDb.load(std::memory_order_relaxed);
+	const bool rateChanged = sampleRate != m_coefficientRate;
+	if (!rateChanged && targetBassDb == m_currentBassDb && targetTrebleDb == m_currentTrebleDb)
+	{
+		return false;
+	}
+
+	// Glide in the dB domain, so a slider move sounds even across the range. Snapping at the end
+	// lets the processor go idle, and the very first buffer starts right on target
+	auto glide = [&](float current, float target)
+	{
+		if (rateChanged && m_coefficientRate == 0)
+			return target;
+		float step = 1.0f - FastMath::Exp2(-static_cast<float>(frames) * FastMath::LOG2_E / (RAMP_TIME_SECONDS * sampleRate));
+		float next = current + (target - current) * step;
+		return std::abs(target - next) < 0.01f ? target : next;
+	};
+	m_currentBassDb = glide(m_currentBassDb, targetBassDb);
+	m_currentTrebleDb = glide(m_currentTrebleDb, targetTrebleDb);
+	m_coefficientRate = sampleRate;
+
+	const float rate = static_cast<float>(sampleRate);
+	m_bassCoefficients = CalculateShelfCoefficients(bassFreq, bassQ, FastMath::DbToLinear(m_currentBassDb), rate, true);
+	m_trebleCoefficients = CalculateShelfCoefficients(trebleFreq, trebleQ, FastMath::DbToLinear(m_currentTrebleDb), rate, false);
+	return true;
+}
+
 std::function<void(std::vector<float>&, unsigned int, unsigned int)> TonalityControl::CreateProcessor()
 {
 	return [this](std::vector<float>& buffer, unsigned int channels, unsigned int sampleRate)
 	{
-		if (m_bassState.size() != channels)
+		if (m_shelves.GetChannelCount() != channels)
 		{
-			m_bassState.resize(channels);
-			m_trebleState.resize(channels);
+			// Fresh state starts as pass-through, force the shelves to be retuned
+			m_shelves.Configure(channels, 2);
+			m_coefficientRate = 0;
 		}
 
-		// Lower bass frequency for deeper effect
-		const float bassFreq = 80.0f; // Lowered from 100Hz to 80Hz
-		const float bassQ = 0.5f;     // Lower Q for wider effect
-
-		// Higher treble frequency for brighter effect
-		const float trebleFreq = 12000.0f; // Raised from 10kHz to 12kHz
-		const float trebleQ = 0.5f;        // Lower Q for wider effect
-
-		auto [b0_bass, b1_bass, b2_bass, a1_bass, a2_bass] = CalculateShelfCoefficients(bassFreq, bassQ, m_bassGain, static_cast<float>(sampleRate), true);
-		auto [b0_treble, b1_treble, b2_treble, a1_treble, a2_treble] = CalculateShelfCoefficients(trebleFreq, trebleQ, m_trebleGain, static_cast<float>(sampleRate), false);
-
-		// Process EQ
-		for (size_t i = 0; i < buffer.size(); i += channels)
+		// Process EQ, a sub-block at a time so a changing gain is ramped rather than stepped
+		const size_t frames = buffer.size() / channels;
+		for (size_t start = 0; start < frames; start += RAMP_BLOCK_FRAMES)
 		{
-			for (unsigned int ch = 0; ch < channels; ch++)
+			const size_t count = min(RAMP_BLOCK_FRAMES, frames - start);
+			if (UpdateCoefficients(sampleRate, count))
 			{
-				float& sample = buffer[i + ch];
-				float bass_out = ProcessSample(sample, b0_bass, b1_bass, b2_bass, a1_bass, a2_bass, m_bassState[ch]);
-				sample = ProcessSample(bass_out, b0_treble, b1_treble, b2_treble, a1_treble, a2_treble, m_trebleState[ch]);
+				m_shelves.SetSection(BASS_SECTION, m_bassCoefficients);
+				m_shelves.SetSection(TREBLE_SECTION, m_trebleCoefficients);
 			}
+
+			m_shelves.Process(buffer.data() + start * channels, count);
 		}
+
+		m_pitchShifter.Process(buffer.data(), frames, channels, sampleRate);
 	};
 }
 
@@ -131,59 +164,40 @@ void TonalityControl::SetRandomPreset()
 
 // Calculate coefficients for shelf filter
 
-std::tuple<float, float, float, float, float> TonalityControl::CalculateShelfCoefficients(float frequency, float Q, float gain, float sampleRate, bool isLowShelf)
+TonalityControl::Coefficients TonalityControl::CalculateShelfCoefficients(float frequency, float Q, float gain, float sampleRate, bool isLowShelf)
 {
 	const float omega = 2.0f * M_PI * frequency / sampleRate;
-	const float alpha = std::sin(omega) / (2.0f * Q);
+	float sin_w, cos_w;
+	FastMath::SinCos(omega, sin_w, cos_w);
 	const float A = std::sqrt(gain);
 	const float beta = std::sqrt(A) / Q;
 
 	float b0, b1, b2, a0, a1, a2;
 
+	const float ap1 = A + 1.0f;
+	const float am1 = A - 1.0f;
 	if (isLowShelf)
 	{
 		// Lowshelf coefficients
-		const float ap1 = A + 1.0f;
-		const float am1 = A - 1.0f;
-		const float cos_w = std::cos(omega);
-
-		b0 = A * (ap1 - am1 * cos_w + beta * std::sin(omega));
+		b0 = A * (ap1 - am1 * cos_w + beta * sin_w);
 		b1 = 2.0f * A * (am1 - ap1 * cos_w);
-		b2 = A * (ap1 - am1 * cos_w - beta * std::sin(omega));
-		a0 = ap1 + am1 * cos_w + beta * std::sin(omega);
+		b2 = A * (ap1 - am1 * cos_w - beta * sin_w);
+		a0 = ap1 + am1 * cos_w + beta * sin_w;
 		a1 = -2.0f * (am1 + ap1 * cos_w);
-		a2 = ap1 + am1 * cos_w - beta * std::sin(omega);
+		a2 = ap1 + am1 * cos_w - beta * sin_w;
 	}
 	else
 	{
 		// Highshelf coefficients
-		const float ap1 = A + 1.0f;
-		const float am1 = A - 1.0f;
-		const float cos_w = std::cos(omega);
-
-		b0 = A * (ap1 + am1 * cos_w + beta * std::sin(omega));
+		b0 = A * (ap1 + am1 * cos_w + beta * sin_w);
 		b1 = -2.0f * A * (am1 + ap1 * cos_w);
-		b2 = A * (ap1 + am1 * cos_w - beta * std::sin(omega));
-		a0 = ap1 - am1 * cos_w + beta * std::sin(omega);
+		b2 = A * (ap1 + am1 * cos_w - beta * sin_w);
+		a0 = ap1 - am1 * cos_w + beta * sin_w;
 		a1 = 2.0f * (am1 - ap1 * cos_w);
-		a2 = ap1 - am1 * cos_w - beta * std::sin(omega);
+		a2 = ap1 - am1 * cos_w - beta * sin_w;
 	}
 
 	// Normalize coefficients
 	const float norm = 1.0f / a0;
-	return { b0 * norm, b1 * norm, b2 * norm, a1 * norm, a2 * norm };
-}
-
-// Process a single sample through the filter
-float TonalityControl::ProcessSample(float input, float b0, float b1, float b2, float a1, float a2, FilterState& state)
-{
-	const float output = b0 * input + b1 * state.x1 + b2 * state.x2 - a1 * state.y1 - a2 * state.y2;
-
-	// Update state
-	state.x2 = state.x1;
-	state.x1 = input;
-	state.y2 = state.y1;
-	state.y1 = output;
-
-	return output;
+	return Coefficients{ b0 * norm, b1 * norm, b2 * norm, a1 * norm, a2 * norm };
 }
@@ -1,34 +1,40 @@
 #pragma once
+#include <atomic>
+
 #include "PitchShifter.h"
+#include "dsp/BiquadCascade.h"
 
 class TonalityControl
 {
 private:
-	// Filter coefficients and state
-	struct FilterState
-	{
-		float x1{ 0 }, x2{ 0 }; // Input history
-		float y1{ 0 }, y2{ 0 }; // Output history
-	};
+	using Coefficients = BiquadCoefficients;
+
+	// Bass then treble shelf
+	static constexpr size_t BASS_SECTION = 0;
+	static constexpr size_t TREBLE_SECTION = 1;
 
-	float m_bassGain{ 1.0f };
-	float m_trebleGain{ 1.0f };
+	// Shelves are retuned in sub-blocks of this many frames while a gain glides to a new setting
+	static constexpr size_t RAMP_BLOCK_FRAMES = 32;
+	static constexpr float RAMP_TIME_SECONDS = 0.03f;
+
+	// Targets, written by the UI and read by the processor. Stored in dB, so the processor's idle check is two loads and compares
+	std::atomic<float> m_bassTargetDb{ 0.0f };
+	std::atomic<float> m_trebleTargetDb{ 0.0f };
 	float m_inBass{ 0.0f };   // Range: -1.0 to 1.0
 	float m_inTreble{ 0.0f }; // Range: -1.0 to 1.0
 
-	std::vector<FilterState> m_bassState;
-	std::vector<FilterState> m_trebleState;
+	// Processor side. Coefficients are only recomputed while a gain is still gliding or the rate changed
+	float m_currentBassDb{ 0.0f };
+	float m_currentTrebleDb{ 0.0f };
+	unsigned int m_coefficientRate{ 0 };
+	Coefficients m_bassCoefficients;
+	Coefficients m_trebleCoefficients;
+
+	BiquadCascade m_shelves;
 
-	ALuint m_source{ 0 };
 	PitchShifter m_pitchShifter;
 
 public:
-	void SetSource(ALuint source)
-	{
-		m_source = source;
-		m_pitchShifter.SetSource(source);
-	}
-
 	// Set bass level (-1.0 to 1.0, where 0.0 is neutral)
 	void SetBass(float level);
 	float GetBass() const;
@@ -37,10 +43,27 @@ public:
 	void SetTreble(float level);
 	float GetTreble() const;
 
-	// Set pitch level (-1.0 to 1.0, where 0.0 is neutral)
+	// Set pitch shift in semitones (-12.0 to 12.0, where 0.0 is neutral)
 	void SetPitch(float level);
 	float GetPitch() const;
 
+	// Keeps the spectral envelope in place while shifting, so voices keep their character
+	void SetFormantPreservation(bool enabled)
+	{
+		m_pitchShifter.SetFormantPreservation(enabled);
+	}
+
+	bool GetFormantPreservation() const
+	{
+		return m_pitchShifter.GetFormantPreservation();
+	}
+
+	// Frames the pitch shifter holds back, the same whether it is shifting or not
+	size_t GetLatency() const
+	{
+		return m_pitchShifter.GetLatency();
+	}
+
 	// This will make it into a lambda function for the audio streamer
 	std::function<void(std::vector<float>&, unsigned int, unsigned int)> CreateProcessor();
 	
@@ -53,9 +76,9 @@ public:
 	void SetRandomPreset();
 
 private:
-	// Calculate coefficients for shelf filter
-	std::tuple<float, float, float, float, float> CalculateShelfCoefficients(float frequency, float Q, float gain, float sampleRate, bool isLowShelf);
+	// Moves the gains towards their targets and retunes the shelves if anything changed, returns false when idle
+	bool UpdateCoefficients(unsigned int sampleRate, size_t frames);
 
-	// Process a single sample through the filter
-	float ProcessSample(float input, float b0, float b1, float b2, float a1, float a2, FilterState& state);
+	// Calculate coefficients for shelf filter
+	Coefficients CalculateShelfCoefficients(float frequency, float Q, float gain, float sampleRate, bool isLowShelf);
 };
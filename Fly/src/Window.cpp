@@ -2,25 +2,116 @@
 
 #include "Window.h"
 
+#include <chrono>
 #include <hello_imgui/hello_imgui.h>
 #include <imgui_internal.h>
 
+#include "decoders/DecoderRegistry.h"
+#include "decoders/PcmCache.h"
+
+// EQ presets live next to the player, one .eq file each
+static std::filesystem::path GetEqPresetDirectory()
+{
+	return std::filesystem::current_path() / "presets";
+}
+
+static std::filesystem::path GetImpulseDirectory()
+{
+	return std::filesystem::current_path() / "impulses";
+}
+
+static std::filesystem::path GetLoudnessCachePath()
+{
+	return std::filesystem::current_path() / "loudness.cache";
+}
+
+// Everything a backend can decode, plus cue sheets which the playlist splits into virtual tracks
+static std::vector<std::string> GetPlaylistExtensions()
+{
+	std::vector<std::string> extensions = DecoderRegistry::Get().GetSupportedExtensions();
+	extensions.push_back(".cue");
+	return extensions;
+}
+
 Window::Window(HelloImGui::RunnerParams& params)
-      : m_dialog(m_showFileDialog, m_selectedFile), m_roomReverb(m_audioStreamer.GetRoomReverb())
+      : m_dialog(m_showFileDialog, m_selectedFile, GetPlaylistExtensions()), m_roomReverb(m_audioStreamer.GetRoomReverb())
 {
 	params.callbacks.SetupImGuiStyle = [this]() { GuiSetup(); };
 
 	m_tonalityControl.SetBass(0.0f);   // Neutral bass (-1 to 1)
 	m_tonalityControl.SetTreble(0.0f); // Neutral treble (-1 to 1)
-	m_audioStreamer.SetEffectProcessor(m_tonalityControl.CreateProcessor());
-	m_tonalityControl.SetSource(m_audioStreamer.GetSource());
+
+	// Tone shelves first, then the EQ on top of them, the rooms so they hear the shaped signal, and
+	// dynamics last to catch whatever all of that boosted
+	auto tonality = m_tonalityControl.CreateProcessor();
+	auto equalizer = m_equalizer.CreateProcessor();
+	auto convolution = m_convolutionReverb.CreateProcessor();
+	auto room = m_roomReverb.CreateProcessor();
+	auto dynamics = m_dynamics.CreateProcessor();
+	m_audioStreamer.SetEffectProcessor(
+	        [tonality, equalizer, convolution, room, dynamics](std::vector<float>& buffer, unsigned int channels, unsigned int sampleRate)
+	        {
+		        tonality(buffer, channels, sampleRate);
+		        equalizer(buffer, channels, sampleRate);
+		        convolution(buffer, channels, sampleRate);
+		        room(buffer, channels, sampleRate);
+		        dynamics(buffer, channels, sampleRate);
+	        });
+	m_audioStreamer.SetEffectLatency(
+	        [this]() { return m_tonalityControl.GetLatency() + m_equalizer.GetLatency() + m_convolutionReverb.GetLatency() + m_dynamics.GetLatency(); });
+	m_audioStreamer.SetEffectTail([this]() { return m_convolutionReverb.GetTailLength(); });
+
+	m_normalizer.LoadCache(GetLoudnessCachePath());
 }
 
 void Window::Update()
 {
-	if (m_viusalizerEnabled)
+	m_audioStreamer.SetVisualizerEnabled(m_viusalizerEnabled);
+
+	// Adjacent virtual tracks of one file run on gaplessly, the streamer just needs to know what comes next
+	if (m_playlist.GetCurrentTrack().IsVirtual() && !m_audioStreamer.IsLooping())
+	{
+		if (std::optional<size_t> next = m_playlist.PeekNext())
+		{
+			const Playlist::Track& track = m_playlist.GetTracks()[*next];
+			m_audioStreamer.QueueNextRange(track.filepath, { track.startSeconds, track.endSeconds, track.title, track.performer });
+		}
+	}
+
+	if (m_audioStreamer.PollTrackAdvance())
+	{
+		m_playlist.Next();
+	}
+
+	// A gapless advance only gets here once the next track is heard, the buffers decoded ahead of
+	// it still carry the previous gain. Tracks of one cue sheet share their album gain though. The
+	// streamer glides to a new gain, so a measurement finishing mid-track or a mode switch never steps
+	const std::uint32_t generation = m_normalizer.GetGeneration();
+	if (m_playlist.GetCurrentIndex() != m_gainTrackIndex || m_playlist.Size() != m_gainPlaylistSize || generation != m_gainGeneration || m_normalizationMode != m_gainMode)
+	{
+		m_gainTrackIndex = m_playlist.GetCurrentIndex();
+		m_gainPlaylistSize = m_playlist.Size();
+		m_gainGeneration = generation;
+		m_gainMode = m_normalizationMode;
+		if (!m_playlist.IsEmpty())
+		{
+			m_audioStreamer.SetNormalizationGain(m_normalizer.GetGain(m_playlist.GetCurrentTrack(), m_normalizationMode, m_playlist.GetTracks()));
+		}
+	}
+}
+
+void Window::OpenTrack(const Playlist::Track& track)
+{
+	// Set before opening so the first buffers are decoded at the track's gain
+	m_audioStreamer.SetNormalizationGain(m_normalizer.GetGain(track, m_normalizationMode, m_playlist.GetTracks()));
+	m_audioStreamer.OpenFromFile(track.filepath, { track.startSeconds, track.endSeconds, track.title, track.performer });
+}
+
+void Window::AnalyzePlaylist()
+{
+	if (m_normalizationMode != LoudnessNormalizer::Mode::Off)
 	{
-		m_audioStreamer.Update();
+		m_normalizer.Analyze(m_playlist.GetTracks());
 	}
 }
 
@@ -47,9 +138,24 @@ void Window::Render()
 		m_dialog.Render(mainContentHeight);
 		if (!m_selectedFile.empty())
 		{
-			m_audioStreamer.OpenFromFile(m_selectedFile);
-			m_audioStreamer.Play();
-			m_playlist.AddTrack(m_selectedFile);
+			size_t firstNew = m_playlist.Size();
+			if (std::filesystem::path(m_selectedFile).extension() == ".cue")
+			{
+				m_playlist.AddCueSheet(m_selectedFile);
+			}
+			else
+			{
+				m_playlist.AddTrack(m_selectedFile);
+			}
+			AnalyzePlaylist();
+
+			if (m_playlist.JumpToTrack(firstNew))
+			{
+				const Playlist::Track& track = m_playlist.GetTracks()[firstNew];
+				OpenTrack(track);
+				m_audioStreamer.Play();
+				PcmCache::Get().QueueFill(track.filepath);
+			}
 			m_selectedFile.clear();
 		}
 	}
@@ -80,14 +186,19 @@ void Window::RenderPlaylistPanel(float width, float height)
 	const auto& tracks = m_playlist.GetTracks();
 	for (size_t i = 0; i < tracks.size(); i++)
 	{
-		std::string filename = std::filesystem::path(tracks[i]).filename().string();
-		// Remove the file extension
-		filename = filename.substr(0, filename.find_last_of('.'));
+		std::string filename = tracks[i].title;
+		if (filename.empty())
+		{
+			filename = std::filesystem::path(tracks[i].filepath).filename().string();
+			// Remove the file extension
+			filename = filename.substr(0, filename.find_last_of('.'));
+		}
 
-		// Selectable track
-		if (ImGui::Selectable(filename.c_str(), m_playlist.GetCurrentIndex() == i))
+		// Selectable track, ImGui needs unique labels and cue titles can repeat
+		if (ImGui::Selectable((filename + "##" + std::to_string(i)).c_str(), m_playlist.GetCurrentIndex() == i))
 		{
-			m_audioStreamer.OpenFromFile(tracks[i]);
+			m_playlist.JumpToTrack(i);
+			OpenTrack(tracks[i]);
 			m_audioStreamer.Play();
 		}
 	}
@@ -96,7 +207,7 @@ void Window::RenderPlaylistPanel(float width, float height)
 	// Playlist controls
 	ImGui::BeginChild("PlaylistControls", ImVec2(width, controlsHeight), true);
 
-	float buttonWidth = (width - ImGui::GetStyle().ItemSpacing.x * 4) * 0.5f;
+	float buttonWidth = (width - ImGui::GetStyle().ItemSpacing.x * 5) / 3.0f;
 	float buttonHeight = controlsHeight - ImGui::GetStyle().ItemSpacing.y * 3;
 
 	if (ImGui::Button((ICON_LC_PLUS "##AddFile"), ImVec2(buttonWidth, buttonHeight)))
@@ -117,6 +228,24 @@ void Window::RenderPlaylistPanel(float width, float height)
 		m_playlist.RemoveTrack(lastIndex);
 	}
 
+	ImGui::SameLine();
+	// Keep decoded copies of replayed playlist tracks on disk, filled in the background while idle
+	bool cacheEnabled = PcmCache::Get().IsEnabled();
+	ImGui::PushStyleColor(ImGuiCol_Button, cacheEnabled ? ImGui::GetStyle().Colors[ImGuiCol_ButtonHovered] : ImGui::GetStyle().Colors[ImGuiCol_Button]);
+	if (ImGui::Button((ICON_LC_HARD_DRIVE "##PcmCache"), ImVec2(buttonWidth, buttonHeight)))
+	{
+		PcmCache::Get().SetEnabled(!cacheEnabled);
+		for (const Playlist::Track& track: m_playlist.GetTracks())
+		{
+			PcmCache::Get().QueueFill(track.filepath);
+		}
+	}
+	ImGui::PopStyleColor();
+	if (ImGui::IsItemHovered())
+	{
+		ImGui::SetTooltip("Cache decoded audio on disk");
+	}
+
 	ImGui::EndChild();
 }
 
@@ -129,7 +258,11 @@ void Window::RenderControlsPanel(float height)
 		RenderTrackInfo();
 		RenderVisualizer();
 		RenderAudioFilters();
+		RenderEqualizer();
 		RenderRoomProps();
+		RenderConvolutionReverb();
+		RenderNormalization();
+		RenderDynamics();
 		RenderSpatialControl();
 	}
 	else
@@ -161,7 +294,7 @@ void Window::RenderControlsPanel(float height)
 		ImGui::Spacing();
 
 		// Supported formats text
-		const char* formatsText = "Supported formats: MP3 (To come: WAV, OGG, FLAC)";
+		const char* formatsText = "Supported formats: MP3, FLAC, WAV, OGG, AIFF, OPUS";
 		textWidth = ImGui::CalcTextSize(formatsText).x;
 		ImGui::SetCursorPosX((windowWidth - textWidth) * 0.5f);
 		ImGui::TextColored(ImGui::GetStyle().Colors[ImGuiCol_TextDisabled], "%s", formatsText);
@@ -319,7 +452,7 @@ void Window::RenderProgressBar()
 	static bool isDragging = false;
 	static float dragProgress = 0.0f;
 
-	double currentTime = m_audioStreamer.GetPlayingOffset();
+	double currentTime = m_audioStreamer.GetTrackOffset();
 	float duration = m_audioStreamer.GetDuration();
 
 	// Calculate current progress and round to 1 decimal place to reduce jitter
@@ -359,7 +492,7 @@ void Window::RenderProgressBar()
 		// User finished dragging - update position
 		isDragging = false;
 		float seekTime = (dragProgress / 100.0f) * duration;
-		m_audioStreamer.SetPlayingOffset(seekTime);
+		m_audioStreamer.SetTrackOffset(seekTime);
 		lastProgress = dragProgress;
 	}
 
@@ -369,7 +502,7 @@ void Window::RenderProgressBar()
 void Window::RenderTimeDisplay()
 {
 	// Get current playback time and total duration
-	double currentTime = m_audioStreamer.GetPlayingOffset();
+	double currentTime = m_audioStreamer.GetTrackOffset();
 	double duration = m_audioStreamer.GetDuration();
 
 	// Format both times
@@ -382,7 +515,7 @@ void Window::RenderTimeDisplay()
 
 void Window::RenderPlaybackControls()
 {
-	float controlWidth = (ImGui::GetContentRegionAvail().x - ImGui::GetStyle().ItemSpacing.x * 4) / 5;
+	float controlWidth = (ImGui::GetContentRegionAvail().x - ImGui::GetStyle().ItemSpacing.x * 6) / 7;
 	float buttonHeight = 35;
 
 	ImGui::PushStyleVar(ImGuiStyleVar_ButtonTextAlign, ImVec2(0.5f, 0.5f));
@@ -390,7 +523,13 @@ void Window::RenderPlaybackControls()
 	if (ImGui::Button(("  " ICON_LC_SKIP_BACK "  "), ImVec2(controlWidth, buttonHeight)))
 	{
 		m_playlist.Previous();
-		m_audioStreamer.OpenFromFile(m_playlist.GetCurrentTrack());
+		OpenTrack(m_playlist.GetCurrentTrack());
+	}
+	ImGui::SameLine();
+	// Jump back a few seconds, usually served from the streamer's rewind buffer
+	if (ImGui::Button(("  " ICON_LC_REWIND "  "), ImVec2(controlWidth, buttonHeight)))
+	{
+		m_audioStreamer.SetTrackOffset(max(0.0, m_audioStreamer.GetTrackOffset() - 10.0));
 	}
 	ImGui::SameLine();
 	if (ImGui::Button(m_audioStreamer.GetStatus() == AudioStreamer::Status::Playing ? ("  " ICON_LC_PAUSE "  ") : ("  " ICON_LC_PLAY "  "), ImVec2(controlWidth, buttonHeight)))
@@ -409,7 +548,7 @@ void Window::RenderPlaybackControls()
 	if (ImGui::Button(("  " ICON_LC_SKIP_FORWARD "  "), ImVec2(controlWidth, buttonHeight)))
 	{
 		m_playlist.Next();
-		m_audioStreamer.OpenFromFile(m_playlist.GetCurrentTrack());
+		OpenTrack(m_playlist.GetCurrentTrack());
 	}
 	ImGui::SameLine();
 	// Change the color of the shuffle button if active
@@ -419,6 +558,14 @@ void Window::RenderPlaybackControls()
 		m_playlist.ToggleShuffle();
 	}
 	ImGui::PopStyleColor();
+	ImGui::SameLine();
+	// Same for the repeat button, looping tracks get moved into memory by the streamer
+	ImGui::PushStyleColor(ImGuiCol_Button, m_audioStreamer.IsLooping() ? ImGui::GetStyle().Colors[ImGuiCol_ButtonHovered] : ImGui::GetStyle().Colors[ImGuiCol_Button]);
+	if (ImGui::Button(("  " ICON_LC_REPEAT "  "), ImVec2(controlWidth, buttonHeight)))
+	{
+		m_audioStreamer.SetLooping(!m_audioStreamer.IsLooping());
+	}
+	ImGui::PopStyleColor();
 
 	ImGui::PopStyleVar();
 }
@@ -469,6 +616,7 @@ void Window::RenderAudioFilters()
 	maxLabelWidth = max(maxLabelWidth, ImGui::CalcTextSize(ICON_LC_AUDIO_WAVEFORM "  Bass").x);
 	maxLabelWidth = max(maxLabelWidth, ImGui::CalcTextSize(ICON_LC_ACTIVITY "  Treble").x);
 	maxLabelWidth = max(maxLabelWidth, ImGui::CalcTextSize(ICON_LC_FAST_FORWARD "  Pitch").x);
+	maxLabelWidth = max(maxLabelWidth, ImGui::CalcTextSize(ICON_LC_GAUGE "  Speed").x);
 	maxLabelWidth += ImGui::GetStyle().ItemSpacing.x; // Add some padding
 
 	// Bass Control
@@ -514,6 +662,24 @@ void Window::RenderAudioFilters()
 		m_tonalityControl.SetPitch(pitch);
 	}
 
+	bool keepFormants = m_tonalityControl.GetFormantPreservation();
+	if (ImGui::Checkbox("Keep Formants", &keepFormants))
+	{
+		m_tonalityControl.SetFormantPreservation(keepFormants);
+	}
+
+	// Speed Control, tempo only, the pitch stays where it is
+	ImGui::AlignTextToFramePadding();
+	ImGui::Text(ICON_LC_GAUGE "  Speed");
+	ImGui::SameLine(maxLabelWidth);
+	float speed = m_audioStreamer.GetPlaybackSpeed();
+	ImGui::SetNextItemWidth(-1);
+	if (ImGui::SliderFloat("##Speed", &speed, 0.5f, 2.0f, "%.2fx"))
+	{
+		// Snap to 1x, where the stretcher copies straight through
+		m_audioStreamer.SetPlaybackSpeed(std::abs(speed - 1.0f) < 0.02f ? 1.0f : speed);
+	}
+
 	// Presets Section
 	ImGui::Spacing();
 
@@ -554,13 +720,229 @@ void Window::RenderAudioFilters()
 	ImGui::EndGroup();
 }
 
+void Window::RenderEqualizer()
+{
+	ImGui::BeginGroup();
+
+	ImGui::Separator();
+	ImGui::AlignTextToFramePadding();
+	ImGui::Text(ICON_LC_SLIDERS_VERTICAL "  Equalizer");
+
+	const char* modes[] = { Equalizer::GetModeName(Equalizer::Mode::Off), Equalizer::GetModeName(Equalizer::Mode::Graphic10),
+		                    Equalizer::GetModeName(Equalizer::Mode::Graphic31), Equalizer::GetModeName(Equalizer::Mode::Parametric) };
+	int mode = static_cast<int>(m_equalizer.GetMode());
+	const float comboWidth = 110.0f;
+	ImGui::SameLine(ImGui::GetContentRegionAvail().x - comboWidth);
+	ImGui::SetNextItemWidth(comboWidth);
+	if (ImGui::Combo("##EqMode", &mode, modes, IM_ARRAYSIZE(modes)))
+	{
+		m_equalizer.SetMode(static_cast<Equalizer::Mode>(mode));
+	}
+
+	if (m_equalizer.GetMode() == Equalizer::Mode::Off)
+	{
+		ImGui::EndGroup();
+		return;
+	}
+
+	// Presets, the built-in curves and whatever has been saved
+	ImGui::SetNextItemWidth(150.0f);
+	if (ImGui::BeginCombo("##EqPresets", "Presets"))
+	{
+		for (const Equalizer::BuiltinPreset& preset: Equalizer::GetBuiltinPresets())
+		{
+			if (ImGui::Selectable(preset.name))
+			{
+				m_equalizer.ApplyBuiltinPreset(preset);
+			}
+		}
+
+		if (!m_eqPresetFiles.empty())
+		{
+			ImGui::Separator();
+		}
+		for (const std::filesystem::path& file: m_eqPresetFiles)
+		{
+			if (ImGui::Selectable(file.stem().string().c_str()))
+			{
+				m_equalizer.LoadPreset(file.string());
+			}
+		}
+		ImGui::EndCombo();
+	}
+	else
+	{
+		m_eqPresetFiles.clear();
+		std::error_code ec;
+		for (const auto& entry: std::filesystem::directory_iterator(GetEqPresetDirectory(), ec))
+		{
+			if (entry.is_regular_file() && entry.path().extension() == ".eq")
+			{
+				m_eqPresetFiles.push_back(entry.path());
+			}
+		}
+	}
+
+	ImGui::SameLine();
+	ImGui::SetNextItemWidth(120.0f);
+	ImGui::InputTextWithHint("##EqPresetName", "Preset name", m_eqPresetName, sizeof(m_eqPresetName));
+	ImGui::SameLine();
+	if (ImGui::Button(ICON_LC_SAVE "##EqSave") && m_eqPresetName[0] != '\0')
+	{
+		std::error_code ec;
+		std::filesystem::create_directories(GetEqPresetDirectory(), ec);
+		m_equalizer.SavePreset((GetEqPresetDirectory() / (std::string(m_eqPresetName) + ".eq")).string());
+	}
+	ImGui::SameLine();
+	if (ImGui::Button(ICON_LC_ROTATE_CCW "##EqFlatten"))
+	{
+		m_equalizer.Flatten();
+	}
+	if (ImGui::IsItemHovered())
+	{
+		ImGui::SetTooltip("Flatten");
+	}
+	ImGui::SameLine();
+	bool linearPhase = m_equalizer.IsLinearPhase();
+	if (ImGui::Checkbox("Linear Phase", &linearPhase))
+	{
+		m_equalizer.SetLinearPhase(linearPhase);
+	}
+	if (ImGui::IsItemHovered())
+	{
+		const unsigned int sampleRate = m_audioStreamer.GetSampleRate();
+		ImGui::SetTooltip("FIR equalizer, keeps phase intact but delays the audio by %.0f ms",
+		                  sampleRate > 0 ? 1000.0 * static_cast<double>(m_equalizer.GetLatency()) / sampleRate : 0.0);
+	}
+
+	float preamp = m_equalizer.GetPreamp();
+	ImGui::SetNextItemWidth(-1);
+	if (ImGui::SliderFloat("##EqPreamp", &preamp, -Equalizer::MAX_GAIN_DB, Equalizer::MAX_GAIN_DB, "Preamp %.1f dB"))
+	{
+		m_equalizer.SetPreamp(preamp);
+	}
+
+	const size_t bandCount = m_equalizer.GetBandCount();
+	if (m_equalizer.GetMode() == Equalizer::Mode::Parametric)
+	{
+		const char* types[] = { Equalizer::GetBandTypeName(Equalizer::BandType::Peak),     Equalizer::GetBandTypeName(Equalizer::BandType::LowShelf),
+			                    Equalizer::GetBandTypeName(Equalizer::BandType::HighShelf), Equalizer::GetBandTypeName(Equalizer::BandType::Notch),
+			                    Equalizer::GetBandTypeName(Equalizer::BandType::HighPass),  Equalizer::GetBandTypeName(Equalizer::BandType::LowPass) };
+
+		const float spacing = ImGui::GetStyle().ItemSpacing.x;
+		std::optional<size_t> removed;
+		for (size_t i = 0; i < bandCount; i++)
+		{
+			ImGui::PushID(static_cast<int>(i));
+			Equalizer::Band band = m_equalizer.GetBand(i);
+			bool changed = ImGui::Checkbox("##Enabled", &band.enabled);
+
+			ImGui::SameLine();
+			int type = static_cast<int>(band.type);
+			ImGui::SetNextItemWidth(100.0f);
+			if (ImGui::Combo("##Type", &type, types, IM_ARRAYSIZE(types)))
+			{
+				band.type = static_cast<Equalizer::BandType>(type);
+				changed = true;
+			}
+
+			// Frequency, Q and, where the type has one, gain share what is left of the row
+			const bool hasGain = band.type == Equalizer::BandType::Peak || band.type == Equalizer::BandType::LowShelf || band.type == Equalizer::BandType::HighShelf;
+			const float removeWidth = ImGui::GetFrameHeight();
+			const float sliderWidth = (ImGui::GetContentRegionAvail().x - 100.0f - removeWidth - spacing * 5) / (hasGain ? 3.0f : 2.0f);
+
+			ImGui::SameLine();
+			ImGui::SetNextItemWidth(sliderWidth);
+			changed |= ImGui::SliderFloat("##Frequency", &band.frequency, 10.0f, 22000.0f, "%.0f Hz", ImGuiSliderFlags_Logarithmic);
+			ImGui::SameLine();
+			ImGui::SetNextItemWidth(sliderWidth);
+			changed |= ImGui::SliderFloat("##Q", &band.q, 0.1f, 18.0f, "Q %.2f", ImGuiSliderFlags_Logarithmic);
+			if (hasGain)
+			{
+				ImGui::SameLine();
+				ImGui::SetNextItemWidth(sliderWidth);
+				changed |= ImGui::SliderFloat("##Gain", &band.gainDb, -Equalizer::MAX_GAIN_DB, Equalizer::MAX_GAIN_DB, "%.1f dB");
+			}
+
+			ImGui::SameLine();
+			if (ImGui::Button(ICON_LC_X "##Remove", ImVec2(removeWidth, 0)))
+			{
+				removed = i;
+			}
+
+			if (changed)
+			{
+				m_equalizer.SetBand(i, band);
+			}
+			ImGui::PopID();
+		}
+
+		if (removed)
+		{
+			m_equalizer.RemoveBand(*removed);
+		}
+
+		if (bandCount < Equalizer::MAX_BANDS && ImGui::Button(ICON_LC_PLUS "  Add Band"))
+		{
+			m_equalizer.AddBand(Equalizer::Band{});
+		}
+	}
+	else if (bandCount > 0)
+	{
+		// One vertical slider per band, the frequency shows on hover
+		const float spacing = ImGui::GetStyle().ItemSpacing.x * 0.5f;
+		const float sliderWidth = max(4.0f, (ImGui::GetContentRegionAvail().x - spacing * (bandCount - 1)) / bandCount);
+		ImGui::PushStyleVar(ImGuiStyleVar_ItemSpacing, ImVec2(spacing, ImGui::GetStyle().ItemSpacing.y));
+		for (size_t i = 0; i < bandCount; i++)
+		{
+			ImGui::PushID(static_cast<int>(i));
+			Equalizer::Band band = m_equalizer.GetBand(i);
+			if (i > 0)
+			{
+				ImGui::SameLine();
+			}
+			if (ImGui::VSliderFloat("##Gain", ImVec2(sliderWidth, 120.0f), &band.gainDb, -Equalizer::MAX_GAIN_DB, Equalizer::MAX_GAIN_DB, ""))
+			{
+				m_equalizer.SetBand(i, band);
+			}
+			if (ImGui::IsItemHovered())
+			{
+				ImGui::SetTooltip(band.frequency >= 1000.0f ? "%.1f kHz: %+.1f dB" : "%.0f Hz: %+.1f dB", band.frequency >= 1000.0f ? band.frequency / 1000.0f : band.frequency, band.gainDb);
+			}
+			ImGui::PopID();
+		}
+		ImGui::PopStyleVar();
+	}
+
+	// Flat bands are skipped by the processor, so this is what the curve actually costs
+	ImGui::TextDisabled("%zu of %zu bands active", m_equalizer.GetActiveBandCount(), bandCount);
+
+	ImGui::EndGroup();
+}
+
 void Window::RenderRoomProps()
 {
 	ImGui::BeginGroup();
 
 	ImGui::Separator();
+	ImGui::AlignTextToFramePadding();
 	ImGui::Text(ICON_LC_WAVES "  Reverb Properties");
 
+	// EFX sounds like the OpenAL implementation makes it, the software reverb is the same everywhere
+	const char* backends[] = { "OpenAL EFX", "Software" };
+	int backend = static_cast<int>(m_roomReverb.GetBackend());
+	const float backendWidth = 110.0f;
+	ImGui::SameLine(ImGui::GetContentRegionAvail().x - backendWidth);
+	ImGui::SetNextItemWidth(backendWidth);
+	if (ImGui::Combo("##ReverbBackend", &backend, backends, IM_ARRAYSIZE(backends)))
+	{
+		m_roomReverb.SetBackend(static_cast<RoomReverb::Backend>(backend));
+	}
+	if (ImGui::IsItemHovered() && !m_roomReverb.IsEfxAvailable())
+	{
+		ImGui::SetTooltip("The output device has no EFX, only the software reverb is heard");
+	}
+
 	// Calculate max label width for alignment
 	float maxLabelWidth = 0.0f;
 	maxLabelWidth = max(maxLabelWidth, ImGui::CalcTextSize(ICON_LC_HOURGLASS "  Decay Time").x);
@@ -713,86 +1095,476 @@ void Window::RenderRoomProps()
 	ImGui::EndGroup();
 }
 
-void Window::RenderVisualizer()
+void Window::RenderConvolutionReverb()
 {
-	m_viusalizerEnabled = false;
-	if (ImGui::CollapsingHeader("Visualizer##CollapsingHeader"))
+	ImGui::BeginGroup();
+
+	ImGui::Separator();
+	ImGui::AlignTextToFramePadding();
+	ImGui::Text(ICON_LC_CHURCH "  Convolution Reverb");
+
+	bool enabled = m_convolutionReverb.IsEnabled();
+	const float checkboxWidth = ImGui::GetFrameHeight();
+	ImGui::SameLine(ImGui::GetContentRegionAvail().x - checkboxWidth);
+	if (ImGui::Checkbox("##ConvolutionEnabled", &enabled))
 	{
-		m_viusalizerEnabled = true;
-		float VISUALIZER_HEIGHT = 100.0f;
-		const float MIN_BAR_HEIGHT = 2.0f;
-		const float BAR_SPACING = 2.0f; // Increased spacing
+		m_convolutionReverb.SetEnabled(enabled);
+	}
 
-		ImGui::BeginChild("Visualizer", ImVec2(0, VISUALIZER_HEIGHT), true, ImGuiWindowFlags_NoScrollbar | ImGuiWindowFlags_NoScrollWithMouse);
+	if (!m_convolutionReverb.IsEnabled())
+	{
+		ImGui::EndGroup();
+		return;
+	}
 
-		const std::vector<float>& vizData = m_audioStreamer.GetVisualizerData();
-		const std::vector<float>& peakData = m_audioStreamer.GetBandPeaks();
+	// Impulse responses, whatever audio sits in the impulses folder
+	const std::string& irName = m_convolutionReverb.GetImpulseResponseName();
+	ImGui::SetNextItemWidth(-1);
+	if (ImGui::BeginCombo("##ImpulseResponse", irName.empty() ? "No impulse response" : irName.c_str()))
+	{
+		if (m_impulseFiles.empty())
+		{
+			ImGui::TextDisabled("Put .wav, .flac, .aiff or .ogg files in %s", GetImpulseDirectory().string().c_str());
+		}
+		for (const std::filesystem::path& file: m_impulseFiles)
+		{
+			const std::string name = file.stem().string();
+			if (ImGui::Selectable(name.c_str(), name == irName))
+			{
+				m_convolutionReverb.LoadImpulseResponse(file.string());
+			}
+		}
+		ImGui::EndCombo();
+	}
+	else
+	{
+		m_impulseFiles.clear();
+		std::error_code ec;
+		for (const auto& entry: std::filesystem::directory_iterator(GetImpulseDirectory(), ec))
+		{
+			std::string extension = entry.path().extension().string();
+			std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+			if (entry.is_regular_file() && (extension == ".wav" || extension == ".flac" || extension == ".aiff" || extension == ".ogg"))
+			{
+				m_impulseFiles.push_back(entry.path());
+			}
+		}
+	}
+
+	float mix = m_convolutionReverb.GetMix() * 100.0f;
+	ImGui::SetNextItemWidth(-1);
+	if (ImGui::SliderFloat("##ConvolutionMix", &mix, 0.0f, 100.0f, "Mix %.0f%%"))
+	{
+		m_convolutionReverb.SetMix(mix / 100.0f);
+	}
 
-		if (vizData.empty())
+	// Block size trades latency for CPU, shown as the delay it adds
+	const unsigned int sampleRate = m_audioStreamer.GetSampleRate();
+	const std::size_t blockSize = m_convolutionReverb.GetBlockSize();
+	auto formatBlock = [sampleRate](std::size_t frames)
+	{
+		return std::format("{} frames, {:.1f} ms", frames, sampleRate > 0 ? 1000.0 * static_cast<double>(frames) / sampleRate : 0.0);
+	};
+	ImGui::SetNextItemWidth(-1);
+	if (ImGui::BeginCombo("##ConvolutionBlock", formatBlock(blockSize).c_str()))
+	{
+		for (std::size_t frames = ConvolutionReverb::MIN_BLOCK_SIZE; frames <= ConvolutionReverb::MAX_BLOCK_SIZE; frames <<= 1)
 		{
-			ImGui::EndChild();
-			return;
+			if (ImGui::Selectable(formatBlock(frames).c_str(), frames == blockSize))
+			{
+				m_convolutionReverb.SetBlockSize(frames);
+			}
 		}
+		ImGui::EndCombo();
+	}
+	if (ImGui::IsItemHovered())
+	{
+		ImGui::SetTooltip("Smaller blocks delay the audio less and cost more CPU");
+	}
 
-		VISUALIZER_HEIGHT -= ImGui::GetStyle().WindowPadding.y * 2;
+	if (!irName.empty())
+	{
+		ImGui::TextDisabled("%.2f s impulse response", m_convolutionReverb.GetImpulseResponseSeconds());
+	}
 
-		// Calculate dimensions
-		ImVec2 contentRegion = ImGui::GetContentRegionAvail();
-		float availWidth = contentRegion.x;
-		float barWidth = (availWidth - (BAR_SPACING * (vizData.size() - 1))) / vizData.size();
-		float centerY = VISUALIZER_HEIGHT / 2.0f;
+	ImGui::EndGroup();
+}
+
+void Window::RenderNormalization()
+{
+	ImGui::BeginGroup();
 
-		// Get colors from ImGui style
-		const ImGuiStyle& style = ImGui::GetStyle();
-		ImVec4 barColor = style.Colors[ImGuiCol_ButtonActive];
-		ImVec4 peakColor = ImVec4(barColor.x * 1.2f, barColor.y * 1.2f, barColor.z * 1.2f, 1.0f);
+	ImGui::Separator();
+	ImGui::AlignTextToFramePadding();
+	ImGui::Text(ICON_LC_SCALE "  Normalization");
+
+	// Track evens out every track, album keeps the differences between the tracks of an album
+	const char* modes[] = { "Off", "Track", "Album" };
+	int mode = static_cast<int>(m_normalizationMode);
+	const float comboWidth = 110.0f;
+	ImGui::SameLine(ImGui::GetContentRegionAvail().x - comboWidth);
+	ImGui::SetNextItemWidth(comboWidth);
+	if (ImGui::Combo("##NormalizationMode", &mode, modes, IM_ARRAYSIZE(modes)))
+	{
+		m_normalizationMode = static_cast<LoudnessNormalizer::Mode>(mode);
+		AnalyzePlaylist();
+	}
+	if (ImGui::IsItemHovered())
+	{
+		ImGui::SetTooltip("Plays tracks at %.0f LUFS, measured in the background", LoudnessNormalizer::TARGET_LUFS);
+	}
 
-		ImGui::PushStyleVar(ImGuiStyleVar_ItemSpacing, ImVec2(BAR_SPACING, 0));
+	if (m_normalizationMode != LoudnessNormalizer::Mode::Off)
+	{
+		ImGui::AlignTextToFramePadding();
+		ImGui::Text("Gain");
+		ImGui::SameLine();
+		ImGui::TextDisabled("%+.1f dB", m_audioStreamer.GetNormalizationGain());
 
-		for (size_t i = 0; i < vizData.size(); i++)
+		const std::size_t pending = m_normalizer.GetPendingCount();
+		if (pending > 0)
 		{
-			// Apply non-linear scaling for better visual dynamics
-			float value = std::pow(vizData[i], 0.7f); // Adjust power for different curve
-			float peak = std::pow(peakData[i], 0.7f);
+			ImGui::SameLine();
+			ImGui::TextDisabled(ICON_LC_LOADER "  %zu tracks to measure", pending);
+		}
+	}
 
-			float rawHeight = value * (VISUALIZER_HEIGHT * 0.95f);
-			float height = max(rawHeight, MIN_BAR_HEIGHT);
-			float halfHeight = height / 2.0f;
+	ImGui::EndGroup();
+}
 
-			ImGui::PushID(static_cast<int>(i));
+void Window::RenderDynamics()
+{
+	ImGui::BeginGroup();
 
-			ImVec2 cursorPos = ImGui::GetCursorScreenPos();
-			ImDrawList* drawList = ImGui::GetWindowDrawList();
+	ImGui::Separator();
+	ImGui::AlignTextToFramePadding();
+	ImGui::Text(ICON_LC_ACTIVITY "  Dynamics");
 
-			// Calculate vertical positions
-			float topY = cursorPos.y + centerY - halfHeight;
-			float bottomY = cursorPos.y + centerY + halfHeight;
+	Dynamics::Settings settings = m_dynamics.GetSettings();
+	bool changed = false;
 
-			// Draw gradient bar
-			ImVec4 gradientTop = ImVec4(barColor.x * 1.2f, barColor.y * 1.2f, barColor.z * 1.2f, barColor.w);
-			ImVec4 gradientBottom = barColor;
+	// Calculate max label width for alignment
+	float maxLabelWidth = 0.0f;
+	maxLabelWidth = max(maxLabelWidth, ImGui::CalcTextSize("Threshold").x);
+	maxLabelWidth = max(maxLabelWidth, ImGui::CalcTextSize("Ratio").x);
+	maxLabelWidth = max(maxLabelWidth, ImGui::CalcTextSize("Attack").x);
+	maxLabelWidth = max(maxLabelWidth, ImGui::CalcTextSize("Release").x);
+	maxLabelWidth = max(maxLabelWidth, ImGui::CalcTextSize("Makeup").x);
+	maxLabelWidth = max(maxLabelWidth, ImGui::CalcTextSize("Ceiling").x);
+	maxLabelWidth += ImGui::GetStyle().ItemSpacing.x;
 
-			drawList->AddRectFilledMultiColor(ImVec2(cursorPos.x, topY), ImVec2(cursorPos.x + barWidth, bottomY), ImGui::GetColorU32(gradientTop), ImGui::GetColorU32(gradientTop), ImGui::GetColorU32(gradientBottom), ImGui::GetColorU32(gradientBottom));
+	auto slider = [&](const char* label, const char* id, float* value, float low, float high, const char* format, ImGuiSliderFlags flags = 0)
+	{
+		ImGui::AlignTextToFramePadding();
+		ImGui::Text("%s", label);
+		ImGui::SameLine(maxLabelWidth);
+		ImGui::SetNextItemWidth(-1);
+		changed |= ImGui::SliderFloat(id, value, low, high, format, flags);
+	};
 
-			// Draw peak indicator
-			float peakHeight = peak * (VISUALIZER_HEIGHT * 0.95f);
-			float peakY = cursorPos.y + centerY - (peakHeight / 2.0f);
-			drawList->AddRectFilled(ImVec2(cursorPos.x, peakY), ImVec2(cursorPos.x + barWidth, peakY + 1.0f), ImGui::GetColorU32(peakColor));
+	// Reduction meters show the last buffer processed, which runs a little ahead of what is heard
+	changed |= ImGui::Checkbox(ICON_LC_SHRINK "  Compressor", &settings.compressorEnabled);
+	if (settings.compressorEnabled)
+	{
+		ImGui::SameLine();
+		ImGui::TextDisabled("%.1f dB", m_dynamics.GetCompressorReduction());
+		slider("Threshold", "##CompThreshold", &settings.thresholdDb, -60.0f, 0.0f, "%.1f dB");
+		slider("Ratio", "##CompRatio", &settings.ratio, 1.0f, 20.0f, "%.1f:1", ImGuiSliderFlags_Logarithmic);
+		slider("Attack", "##CompAttack", &settings.attackMs, 0.1f, 200.0f, "%.1f ms", ImGuiSliderFlags_Logarithmic);
+		slider("Release", "##CompRelease", &settings.releaseMs, 10.0f, 2000.0f, "%.0f ms", ImGuiSliderFlags_Logarithmic);
+		slider("Makeup", "##CompMakeup", &settings.makeupDb, 0.0f, 24.0f, "%.1f dB");
+	}
+
+	changed |= ImGui::Checkbox(ICON_LC_BRICK_WALL "  Limiter", &settings.limiterEnabled);
+	if (ImGui::IsItemHovered())
+	{
+		const unsigned int sampleRate = m_audioStreamer.GetSampleRate();
+		ImGui::SetTooltip("Keeps true peaks under the ceiling instead of clipping, looking %.0f ms ahead",
+		                  sampleRate > 0 ? 1000.0 * static_cast<double>(m_dynamics.GetLatency()) / sampleRate : Dynamics::LOOKAHEAD_MS);
+	}
+	if (settings.limiterEnabled)
+	{
+		ImGui::SameLine();
+		ImGui::TextDisabled("%.1f dB", m_dynamics.GetLimiterReduction());
+		slider("Ceiling", "##LimitCeiling", &settings.ceilingDb, -12.0f, 0.0f, "%.1f dBTP");
+		slider("Release", "##LimitRelease", &settings.limiterReleaseMs, 10.0f, 1000.0f, "%.0f ms", ImGuiSliderFlags_Logarithmic);
+	}
+
+	if (changed)
+	{
+		m_dynamics.SetSettings(settings);
+	}
+
+	ImGui::EndGroup();
+}
 
-			ImGui::Dummy(ImVec2(barWidth, VISUALIZER_HEIGHT));
-			if (i < vizData.size() - 1)
+void Window::RenderVisualizer()
+{
+	m_viusalizerEnabled = false;
+	if (ImGui::CollapsingHeader("Visualizer##CollapsingHeader"))
+	{
+		m_viusalizerEnabled = true;
+
+		VisualizerTab selected = VisualizerTab::Bars;
+		if (ImGui::BeginTabBar("VisualizerTabs"))
+		{
+			if (ImGui::BeginTabItem(ICON_LC_CHART_BAR "  Bars"))
 			{
-				ImGui::SameLine();
+				RenderBarSpectrum();
+				ImGui::EndTabItem();
+			}
+			if (ImGui::BeginTabItem(ICON_LC_AUDIO_WAVEFORM "  Spectrogram"))
+			{
+				selected = VisualizerTab::Spectrogram;
+				RenderSpectrogram();
+				ImGui::EndTabItem();
+			}
+			if (ImGui::BeginTabItem(ICON_LC_ACTIVITY "  Scope"))
+			{
+				selected = VisualizerTab::Oscilloscope;
+				RenderOscilloscope();
+				ImGui::EndTabItem();
+			}
+			if (ImGui::BeginTabItem(ICON_LC_ORBIT "  Stereo"))
+			{
+				selected = VisualizerTab::Goniometer;
+				RenderGoniometer();
+				ImGui::EndTabItem();
+			}
+			if (ImGui::BeginTabItem(ICON_LC_GAUGE "  Loudness"))
+			{
+				selected = VisualizerTab::Loudness;
+				RenderLoudness();
+				ImGui::EndTabItem();
 			}
+			ImGui::EndTabBar();
+		}
+		SelectVisualizerTab(selected);
+	}
+}
 
-			ImGui::PopID();
+void Window::SelectVisualizerTab(VisualizerTab tab)
+{
+	if (tab == m_visualizerTab)
+	{
+		return;
+	}
+
+	// Only the view on screen is fed, the bars are built in and always run
+	auto viewFor = [this](VisualizerTab viewTab) -> std::shared_ptr<AnalysisView>
+	{
+		switch (viewTab)
+		{
+		case VisualizerTab::Spectrogram:
+			return m_spectrogram;
+		case VisualizerTab::Oscilloscope:
+			return m_oscilloscope;
+		case VisualizerTab::Goniometer:
+			return m_goniometer;
+		default:
+			return nullptr;
 		}
+	};
 
-		ImGui::PopStyleVar();
+	AudioVisualizer& visualizer = m_audioStreamer.GetVisualizer();
+	if (std::shared_ptr<AnalysisView> previous = viewFor(m_visualizerTab))
+	{
+		visualizer.RemoveView(previous);
+	}
+	if (std::shared_ptr<AnalysisView> next = viewFor(tab))
+	{
+		visualizer.AddView(next);
+	}
+
+	// The spectrogram wants finer frequency resolution than the bars, 4096 points still fits a 60 Hz hop easily
+	visualizer.SetFftSize(tab == VisualizerTab::Spectrogram ? SPECTROGRAM_FFT_SIZE : BARS_FFT_SIZE);
+	m_visualizerTab = tab;
+}
+
+void Window::RenderBarSpectrum()
+{
+	const float VISUALIZER_HEIGHT = 100.0f;
+
+	ImGui::BeginChild("Visualizer", ImVec2(0, VISUALIZER_HEIGHT), true, ImGuiWindowFlags_NoScrollbar | ImGuiWindowFlags_NoScrollWithMouse);
+
+	const BarSpectrumView::Bars& bars = m_audioStreamer.GetVisualizer().GetBars().AcquireBars();
+	if (bars.levels.empty())
+	{
 		ImGui::EndChild();
+		return;
+	}
+
+	// Get colors from ImGui style
+	const ImGuiStyle& style = ImGui::GetStyle();
+	ImVec4 barColor = style.Colors[ImGuiCol_ButtonActive];
+	ImVec4 gradientTop = ImVec4(barColor.x * 1.2f, barColor.y * 1.2f, barColor.z * 1.2f, barColor.w);
+	ImVec4 peakColor = ImVec4(barColor.x * 1.2f, barColor.y * 1.2f, barColor.z * 1.2f, 1.0f);
+	m_barRenderer.SetColors(ImGui::GetColorU32(gradientTop), ImGui::GetColorU32(barColor), ImGui::GetColorU32(peakColor));
+
+	ImVec2 size = ImGui::GetContentRegionAvail();
+	m_barRenderer.Draw(ImGui::GetWindowDrawList(), ImGui::GetCursorScreenPos(), size, bars.levels.data(), bars.peaks.data(), static_cast<int>(bars.levels.size()));
+	ImGui::Dummy(size);
+
+	ImGui::EndChild();
+}
+
+void Window::RenderSpectrogram()
+{
+	const float SPECTROGRAM_HEIGHT = 160.0f;
+
+	m_spectrogramImage.Consume(*m_spectrogram);
+	m_spectrogramTexture.Update(m_spectrogramImage);
+
+	ImGui::BeginChild("Spectrogram", ImVec2(0, SPECTROGRAM_HEIGHT), true, ImGuiWindowFlags_NoScrollbar | ImGuiWindowFlags_NoScrollWithMouse);
+	m_spectrogramTexture.Draw(m_spectrogramImage, ImGui::GetContentRegionAvail());
+	ImGui::EndChild();
+
+	int scale = static_cast<int>(m_spectrogram->GetScale());
+	const char* scales[] = { "Log", "Mel" };
+	ImGui::SetNextItemWidth(100.0f);
+	if (ImGui::Combo("Scale##Spectrogram", &scale, scales, IM_ARRAYSIZE(scales)))
+	{
+		m_spectrogram->SetScale(static_cast<SpectrogramView::Scale>(scale));
+	}
+
+	ImGui::SameLine();
+	if (ImGui::Button(ICON_LC_SAVE "  Save Image"))
+	{
+		std::filesystem::path dir = std::filesystem::temp_directory_path() / "Fly";
+		std::error_code ec;
+		std::filesystem::create_directories(dir, ec);
+		std::string path = (dir / std::format("spectrogram-{}.ppm", std::chrono::system_clock::now().time_since_epoch().count())).string();
+		if (m_spectrogramImage.WritePPM(path))
+		{
+			m_lastSpectrogramPath = path;
+		}
+	}
+	if (!m_lastSpectrogramPath.empty() && ImGui::IsItemHovered())
+	{
+		ImGui::SetTooltip("Last saved to %s", m_lastSpectrogramPath.c_str());
+	}
+}
+
+void Window::RenderOscilloscope()
+{
+	const float SCOPE_HEIGHT = 140.0f;
+
+	ImGui::BeginChild("Oscilloscope", ImVec2(0, SCOPE_HEIGHT), true, ImGuiWindowFlags_NoScrollbar | ImGuiWindowFlags_NoScrollWithMouse);
+
+	ImVec2 pos = ImGui::GetCursorScreenPos();
+	ImVec2 size = ImGui::GetContentRegionAvail();
+	ImDrawList* drawList = ImGui::GetWindowDrawList();
+	const ImGuiStyle& style = ImGui::GetStyle();
+
+	// Decimate to the width actually drawn, one column per pixel
+	m_oscilloscope->SetColumns(static_cast<int>(size.x));
+	const OscilloscopeView::Trace& trace = m_oscilloscope->AcquireTrace();
+
+	drawList->AddLine(ImVec2(pos.x, pos.y + size.y * 0.5f), ImVec2(pos.x + size.x, pos.y + size.y * 0.5f), ImGui::GetColorU32(ImGuiCol_Separator));
+	ImU32 traceColor = ImGui::GetColorU32(trace.triggered ? style.Colors[ImGuiCol_ButtonActive] : style.Colors[ImGuiCol_TextDisabled]);
+	ScopeRenderer::DrawMinMaxTrace(drawList, pos, size, trace.mins.data(), trace.maxs.data(), static_cast<int>(trace.mins.size()), traceColor);
+	ImGui::Dummy(size);
+
+	ImGui::EndChild();
+
+	float timeSpan = m_oscilloscope->GetTimeSpan();
+	ImGui::SetNextItemWidth(150.0f);
+	if (ImGui::SliderFloat("Time##Scope", &timeSpan, 1.0f, 50.0f, "%.0f ms"))
+	{
+		m_oscilloscope->SetTimeSpan(timeSpan);
+	}
+
+	ImGui::SameLine();
+	float triggerLevel = m_oscilloscope->GetTriggerLevel();
+	ImGui::SetNextItemWidth(150.0f);
+	if (ImGui::SliderFloat("Trigger##Scope", &triggerLevel, -1.0f, 1.0f, "%.2f"))
+	{
+		m_oscilloscope->SetTriggerLevel(triggerLevel);
 	}
 }
 
+void Window::RenderGoniometer()
+{
+	const float GONIOMETER_SIZE = 200.0f;
+
+	ImGui::BeginChild("Goniometer", ImVec2(0, GONIOMETER_SIZE), true, ImGuiWindowFlags_NoScrollbar | ImGuiWindowFlags_NoScrollWithMouse);
+
+	ImVec2 avail = ImGui::GetContentRegionAvail();
+	float side = min(avail.x, avail.y);
+	ImVec2 pos = ImGui::GetCursorScreenPos();
+	pos.x += (avail.x - side) * 0.5f;
+	ImDrawList* drawList = ImGui::GetWindowDrawList();
+	const ImGuiStyle& style = ImGui::GetStyle();
+
+	m_goniometer->SetResolution(static_cast<int>(side));
+	const GoniometerView::Scope& scope = m_goniometer->AcquireScope();
+
+	// Axes, mono runs straight up, left and right channels on the diagonals
+	ImU32 axisColor = ImGui::GetColorU32(ImGuiCol_Separator);
+	drawList->AddLine(ImVec2(pos.x + side * 0.5f, pos.y), ImVec2(pos.x + side * 0.5f, pos.y + side), axisColor);
+	drawList->AddLine(ImVec2(pos.x, pos.y + side * 0.5f), ImVec2(pos.x + side, pos.y + side * 0.5f), axisColor);
+	drawList->AddLine(pos, ImVec2(pos.x + side, pos.y + side), axisColor);
+	drawList->AddLine(ImVec2(pos.x + side, pos.y), ImVec2(pos.x, pos.y + side), axisColor);
+
+	ScopeRenderer::DrawPoints(drawList, pos, ImVec2(side, side), scope.points.data(), static_cast<int>(scope.points.size() / 2), 1.5f, ImGui::GetColorU32(style.Colors[ImGuiCol_ButtonActive]));
+	ImGui::Dummy(avail);
+
+	ImGui::EndChild();
+
+	// Correlation meter, -1 on the left to +1 on the right
+	ImGui::Text("Correlation %+.2f", scope.correlation);
+	ImGui::SameLine();
+	ImVec2 barPos = ImGui::GetCursorScreenPos();
+	float barWidth = ImGui::GetContentRegionAvail().x;
+	float barHeight = ImGui::GetTextLineHeight();
+	float markerX = barPos.x + (std::clamp(scope.correlation, -1.0f, 1.0f) + 1.0f) * 0.5f * barWidth;
+	drawList = ImGui::GetWindowDrawList();
+	drawList->AddRectFilled(barPos, ImVec2(barPos.x + barWidth, barPos.y + barHeight), ImGui::GetColorU32(ImGuiCol_FrameBg));
+	drawList->AddLine(ImVec2(barPos.x + barWidth * 0.5f, barPos.y), ImVec2(barPos.x + barWidth * 0.5f, barPos.y + barHeight), ImGui::GetColorU32(ImGuiCol_Separator));
+	drawList->AddRectFilled(ImVec2(markerX - 2.0f, barPos.y), ImVec2(markerX + 2.0f, barPos.y + barHeight), ImGui::GetColorU32(scope.correlation < 0.0f ? ImGuiCol_PlotHistogramHovered : ImGuiCol_ButtonActive));
+	ImGui::Dummy(ImVec2(barWidth, barHeight));
+}
+
+void Window::RenderLoudness()
+{
+	const LoudnessMeter::Reading& reading = m_audioStreamer.AcquireLoudness();
+
+	// Horizontal meter over -60..0 LUFS with the EBU R128 target marked
+	const float MIN_LUFS = -60.0f;
+	const float TARGET_LUFS = -23.0f;
+	auto meter = [](const char* label, float value, float minValue, float maxValue, float marker, bool warn)
+	{
+		ImGui::Text("%-12s", label);
+		ImGui::SameLine();
+
+		ImVec2 pos = ImGui::GetCursorScreenPos();
+		float width = ImGui::GetContentRegionAvail().x - 90.0f;
+		float height = ImGui::GetTextLineHeight();
+		float fill = std::clamp((value - minValue) / (maxValue - minValue), 0.0f, 1.0f);
+		float markerX = pos.x + std::clamp((marker - minValue) / (maxValue - minValue), 0.0f, 1.0f) * width;
+
+		ImDrawList* drawList = ImGui::GetWindowDrawList();
+		drawList->AddRectFilled(pos, ImVec2(pos.x + width, pos.y + height), ImGui::GetColorU32(ImGuiCol_FrameBg));
+		drawList->AddRectFilled(pos, ImVec2(pos.x + width * fill, pos.y + height), ImGui::GetColorU32(warn ? ImGuiCol_PlotHistogramHovered : ImGuiCol_ButtonActive));
+		drawList->AddLine(ImVec2(markerX, pos.y), ImVec2(markerX, pos.y + height), ImGui::GetColorU32(ImGuiCol_Text));
+		ImGui::Dummy(ImVec2(width, height));
+
+		ImGui::SameLine();
+		if (value <= LoudnessMeter::SILENCE_LUFS)
+			ImGui::Text("   -inf");
+		else
+			ImGui::Text("%7.1f", value);
+	};
+
+	meter("Momentary", reading.momentaryLufs, MIN_LUFS, 0.0f, TARGET_LUFS, reading.momentaryLufs > TARGET_LUFS);
+	meter("Short-term", reading.shortTermLufs, MIN_LUFS, 0.0f, TARGET_LUFS, reading.shortTermLufs > TARGET_LUFS);
+	meter("Integrated", reading.integratedLufs, MIN_LUFS, 0.0f, TARGET_LUFS, reading.integratedLufs > TARGET_LUFS);
+	meter("True peak", reading.truePeakDb, MIN_LUFS, 3.0f, -1.0f, reading.truePeakDb > -1.0f);
+	meter("Correlation", reading.correlation, -1.0f, 1.0f, 0.0f, reading.correlation < 0.0f);
+
+	ImGui::TextColored(ImGui::GetStyle().Colors[ImGuiCol_TextDisabled], "Max true peak %.1f dBTP", reading.maxTruePeakDb);
+}
+
 void Window::RenderSpatialControl()
 {
 	ImGui::Spacing();
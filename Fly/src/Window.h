@@ -1,10 +1,21 @@
 #pragma once
 
+#include "BarRenderer.h"
+#include "ConvolutionReverb.h"
+#include "Dynamics.h"
+#include "Equalizer.h"
 #include "FileDialog.h"
 #include "IconsLucide.h"
+#include "LoudnessNormalizer.h"
 #include "MP3Streamer.h"
 #include "PlayList.h"
+#include "ScopeRenderer.h"
+#include "SpectrogramTexture.h"
 #include "TonalityControl.h"
+#include "analysis/GoniometerView.h"
+#include "analysis/OscilloscopeView.h"
+#include "analysis/SpectrogramImage.h"
+#include "analysis/SpectrogramView.h"
 
 namespace HelloImGui
 {
@@ -22,6 +33,11 @@ public:
 private:
 	void GuiSetup();
 
+	void OpenTrack(const Playlist::Track& track);
+
+	// Measures whatever the playlist gained since, while normalization is on
+	void AnalyzePlaylist();
+
 	void RenderPlaylistPanel(float width, float height);
 	void RenderControlsPanel(float height);
 	void RenderBottomPanel(float height);
@@ -32,8 +48,17 @@ private:
 	void RenderPlaybackControls();
 	void RenderVolumeControl();
 	void RenderAudioFilters();
+	void RenderEqualizer();
 	void RenderRoomProps();
+	void RenderConvolutionReverb();
+	void RenderNormalization();
+	void RenderDynamics();
 	void RenderVisualizer();
+	void RenderBarSpectrum();
+	void RenderSpectrogram();
+	void RenderOscilloscope();
+	void RenderGoniometer();
+	void RenderLoudness();
 	void RenderSpatialControl();
 
 	std::string FormatTime(double seconds);
@@ -42,13 +67,56 @@ private:
 	MP3Streamer m_audioStreamer;
 	Playlist m_playlist;
 	TonalityControl m_tonalityControl;
+	Equalizer m_equalizer;
+	ConvolutionReverb m_convolutionReverb;
+	Dynamics m_dynamics;
 	RoomReverb& m_roomReverb;
 
+	// Gain follows the current track, and changes again as measurements come in
+	LoudnessNormalizer m_normalizer;
+	LoudnessNormalizer::Mode m_normalizationMode = LoudnessNormalizer::Mode::Off;
+	std::size_t m_gainTrackIndex = 0;
+	std::size_t m_gainPlaylistSize = 0;
+	std::uint32_t m_gainGeneration = 0;
+	LoudnessNormalizer::Mode m_gainMode = LoudnessNormalizer::Mode::Off;
+
+	// EQ preset files, rescanned whenever the preset list is opened
+	std::vector<std::filesystem::path> m_eqPresetFiles;
+	char m_eqPresetName[64] = "";
+
+	// Impulse responses, rescanned whenever the list is opened
+	std::vector<std::filesystem::path> m_impulseFiles;
+
 	bool m_showFileDialog = false;
 	std::string m_selectedFile;
 	FileDialog m_dialog;
 
 	bool m_viusalizerEnabled = false;
+	BarRenderer m_barRenderer;
+
+	// Visualizer views other than the bars, each only fed while its tab is open
+	enum class VisualizerTab
+	{
+		Bars,
+		Spectrogram,
+		Oscilloscope,
+		Goniometer,
+		Loudness
+	};
+
+	void SelectVisualizerTab(VisualizerTab tab);
+
+	VisualizerTab m_visualizerTab = VisualizerTab::Bars;
+
+	static constexpr int BARS_FFT_SIZE = 2048;
+	static constexpr int SPECTROGRAM_FFT_SIZE = 4096;
+	std::shared_ptr<SpectrogramView> m_spectrogram = std::make_shared<SpectrogramView>();
+	SpectrogramImage m_spectrogramImage;
+	SpectrogramTexture m_spectrogramTexture;
+	std::string m_lastSpectrogramPath;
+
+	std::shared_ptr<OscilloscopeView> m_oscilloscope = std::make_shared<OscilloscopeView>();
+	std::shared_ptr<GoniometerView> m_goniometer = std::make_shared<GoniometerView>();
 
 	// Spatial audio animation state
     bool m_isRotating = false;
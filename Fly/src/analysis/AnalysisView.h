@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Everything derived from one analysis hop. All views are fed the same frame, so the FFT runs
+// once per hop no matter how many views are shown.
+struct AnalysisFrame
+{
+	const float* samples{ nullptr }; // Mono window centered on the playing position
+	std::size_t sampleCount{ 0 };
+	const float* magnitudes{ nullptr }; // Linear magnitude of the Hann windowed FFT, DC to below Nyquist.
+	                                    // Normalized so a full-scale sine peaks at 1.0 whatever the FFT size
+	std::size_t binCount{ 0 };
+	// Interleaved left/right before downmixing or limiting, also centered on the playing position.
+	// Null while the history doesn't cover the window yet
+	const float* stereo{ nullptr };
+	std::size_t stereoFrameCount{ 0 };
+	int fftSize{ 0 };
+	int sampleRate{ 0 };
+	std::int64_t playingFrame{ 0 };
+};
+
+// A consumer of analysis frames. Process runs on the analysis worker, views publish their
+// results for the UI thread themselves (see TripleBuffer) so rendering never waits on analysis.
+class AnalysisView
+{
+public:
+	virtual ~AnalysisView() = default;
+
+	virtual void Process(const AnalysisFrame& frame) = 0;
+};
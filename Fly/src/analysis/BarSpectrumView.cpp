@@ -0,0 +1,138 @@
+#include "pch.h"
+
+#include "BarSpectrumView.h"
+
+#include "dsp/FastMath.h"
+
+BarSpectrumView::BarSpectrumView()
+{
+	// Moderate compression curve, applied to the normalized dB level of every band
+	for (int i = 0; i <= DISPLAY_CURVE_STEPS; i++)
+	{
+		m_displayCurve[i] = std::pow(static_cast<float>(i) / DISPLAY_CURVE_STEPS, 1.2f);
+	}
+}
+
+void BarSpectrumView::BuildBandTable(int sampleRate, int fftSize, std::size_t binCount)
+{
+	// Tuned so the dB range below fits the visualizer samples (which peak around 0.60). This is the
+	// original 0.05 input scale on an unnormalized 2048 point FFT, expressed on normalized magnitudes
+	const float inputScale = 25.6f;
+
+	const float rate = static_cast<float>(sampleRate);
+	const float minFreq = 20.0f;
+	const float maxFreq = 20000.0f;
+	const int lastBin = static_cast<int>(min(binCount, static_cast<std::size_t>(fftSize / 2))) - 1;
+
+	std::vector<float> weights(lastBin + 1);
+	m_binWeights.resize(lastBin + 1);
+	for (int bin = 0; bin <= lastBin; bin++)
+	{
+		float freq = bin * rate / fftSize;
+		// Very light frequency weighting
+		float weight = 1.0f;
+		if (freq < 100.0f)
+			weight = 1.1f; // Slight bass boost
+		if (freq > 10000.0f)
+			weight = 1.05f; // Slight treble boost
+		weights[bin] = weight;
+		m_binWeights[bin] = weight * inputScale;
+	}
+
+	for (int band = 0; band < NUM_BANDS; band++)
+	{
+		float freq1 = minFreq * std::pow(maxFreq / minFreq, static_cast<float>(band) / NUM_BANDS);
+		float freq2 = minFreq * std::pow(maxFreq / minFreq, static_cast<float>(band + 1) / NUM_BANDS);
+
+		BandRange& range = m_bandRanges[band];
+		range.firstBin = std::clamp(static_cast<int>(freq1 * fftSize / rate), 0, lastBin);
+		range.lastBin = std::clamp(static_cast<int>(freq2 * fftSize / rate), 0, lastBin);
+
+		float weightSum = 0.0f;
+		for (int bin = range.firstBin; bin <= range.lastBin; bin++)
+		{
+			weightSum += weights[bin];
+		}
+		range.inverseWeightSum = weightSum > 0.0f ? 1.0f / weightSum : 0.0f;
+	}
+
+	m_tableSampleRate = sampleRate;
+	m_tableFftSize = fftSize;
+	LOG_DEBUG("Rebuilt bar spectrum band table for {} Hz", sampleRate);
+}
+
+void BarSpectrumView::Process(const AnalysisFrame& frame)
+{
+	static const float RISE_SPEED = 0.7f;
+	static const float FALL_SPEED = 0.15f;
+	static const float PEAK_FALL_SPEED = 0.08f;
+	static const float MIN_DB = -60.0f;
+	static const float MAX_DB = -6.0f;
+
+	if (frame.sampleRate != m_tableSampleRate || frame.fftSize != m_tableFftSize)
+	{
+		BuildBandTable(frame.sampleRate, frame.fftSize, frame.binCount);
+	}
+
+	Bars& bars = m_output.back();
+
+	for (int band = 0; band < NUM_BANDS; band++)
+	{
+		const BandRange& range = m_bandRanges[band];
+
+		float sum = 0.0f;
+		for (int bin = range.firstBin; bin <= range.lastBin; bin++)
+		{
+			sum += frame.magnitudes[bin] * m_binWeights[bin];
+		}
+
+		float avgMagnitude = sum * range.inverseWeightSum;
+
+		// Dynamics processing
+		float db = FastMath::LinearToDb(avgMagnitude + 1e-6f);
+		db = std::clamp(db, MIN_DB, MAX_DB);
+
+		// Apply the compression curve, interpolating the precomputed table
+		float position = (db - MIN_DB) / (MAX_DB - MIN_DB) * DISPLAY_CURVE_STEPS;
+		int index = min(static_cast<int>(position), DISPLAY_CURVE_STEPS - 1);
+		float normalizedMag = m_displayCurve[index] + (m_displayCurve[index + 1] - m_displayCurve[index]) * (position - index);
+		// Scale to leave headroom
+		normalizedMag *= 0.8f;
+
+		// Temporal smoothing
+		float magnitude = m_prevMagnitudes[band];
+		float delta = normalizedMag - magnitude;
+		if (delta > 0)
+		{
+			magnitude += delta * RISE_SPEED;
+		}
+		else
+		{
+			magnitude += delta * FALL_SPEED;
+		}
+
+		// Peak tracking
+		if (magnitude > m_bandPeaks[band])
+		{
+			m_bandPeaks[band] = magnitude;
+		}
+		else
+		{
+			m_bandPeaks[band] *= (1.0f - PEAK_FALL_SPEED);
+		}
+
+		// Final safety clamp
+		m_prevMagnitudes[band] = std::clamp(magnitude, 0.0f, 0.85f);
+
+		bars.levels[band] = m_prevMagnitudes[band];
+		bars.peaks[band] = m_bandPeaks[band];
+	}
+
+	m_output.publish();
+}
+
+const BarSpectrumView::Bars& BarSpectrumView::AcquireBars()
+{
+	m_output.update();
+	return m_output.front();
+}
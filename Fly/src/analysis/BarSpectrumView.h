@@ -0,0 +1,54 @@
+#pragma once
+
+#include <array>
+#include <vector>
+
+#include "AnalysisView.h"
+#include "containers/TripleBuffer.h"
+
+// The classic bar display: FFT bins averaged into log-spaced bands, mapped to a compressed
+// dB scale and smoothed over time with falling peak markers.
+class BarSpectrumView : public AnalysisView
+{
+public:
+	static constexpr int NUM_BANDS = 23;
+
+	struct Bars
+	{
+		std::vector<float> levels = std::vector<float>(NUM_BANDS);
+		std::vector<float> peaks = std::vector<float>(NUM_BANDS);
+	};
+
+	BarSpectrumView();
+
+	void Process(const AnalysisFrame& frame) override;
+
+	// UI thread, fetches the newest published bars and returns them. The reference stays valid
+	// until the next call, so call this once per frame and read levels and peaks from it
+	const Bars& AcquireBars();
+
+private:
+	// Bins averaged into each band, rebuilt only when the sample rate or FFT size changes
+	struct BandRange
+	{
+		int firstBin;
+		int lastBin;
+		float inverseWeightSum;
+	};
+
+	static constexpr int DISPLAY_CURVE_STEPS = 256;
+
+	void BuildBandTable(int sampleRate, int fftSize, std::size_t binCount);
+
+	int m_tableSampleRate = 0;
+	int m_tableFftSize = 0;
+	std::array<BandRange, NUM_BANDS> m_bandRanges{};
+	std::vector<float> m_binWeights;
+	std::array<float, DISPLAY_CURVE_STEPS + 1> m_displayCurve{}; // Compression curve sampled over 0..1
+
+	// Smoothing state, owned by the worker
+	std::array<float, NUM_BANDS> m_prevMagnitudes{};
+	std::array<float, NUM_BANDS> m_bandPeaks{};
+
+	TripleBuffer<Bars> m_output;
+};
@@ -0,0 +1,70 @@
+#include "pch.h"
+
+#include "GoniometerView.h"
+
+void GoniometerView::SetResolution(int pixels)
+{
+	m_resolution = std::clamp(pixels, 16, 2048);
+}
+
+void GoniometerView::Process(const AnalysisFrame& frame)
+{
+	if (!frame.stereo)
+	{
+		return;
+	}
+
+	// The audio that became audible since the last hop, give or take
+	const std::size_t center = frame.stereoFrameCount / 2;
+	const std::size_t span = min(static_cast<std::size_t>(frame.sampleRate * PERSISTENCE_MS / 1000.0f), center);
+	const float* samples = frame.stereo + (center - span) * 2;
+
+	// Rotated 45 degrees, the 1/sqrt(2) keeps full-scale mono at the edge
+	const float rotation = 0.70710678f;
+	const float half = m_resolution * 0.5f;
+	const float toGrid = half * rotation;
+
+	Scope& scope = m_output.back();
+	scope.points.clear();
+
+	int lastX = (std::numeric_limits<int>::min)();
+	int lastY = (std::numeric_limits<int>::min)();
+	double sumLR = 0.0;
+	double sumLL = 0.0;
+	double sumRR = 0.0;
+
+	for (std::size_t i = 0; i < span; i++)
+	{
+		const float left = samples[i * 2];
+		const float right = samples[i * 2 + 1];
+		sumLR += left * right;
+		sumLL += left * left;
+		sumRR += right * right;
+
+		// Snap to the pixel grid, consecutive samples landing on the same pixel add nothing
+		int x = static_cast<int>(std::clamp((right - left) * toGrid, -half, half));
+		int y = static_cast<int>(std::clamp((left + right) * toGrid, -half, half));
+		if ((x == lastX && y == lastY) || scope.points.size() >= MAX_POINTS * 2)
+		{
+			continue;
+		}
+		lastX = x;
+		lastY = y;
+		scope.points.push_back(x / half);
+		scope.points.push_back(y / half);
+	}
+
+	// Silence reads as neutral rather than jumping around
+	double energy = std::sqrt(sumLL * sumRR);
+	float correlation = energy > 1e-9 ? static_cast<float>(sumLR / energy) : 0.0f;
+	m_correlation += (correlation - m_correlation) * 0.3f;
+	scope.correlation = m_correlation;
+
+	m_output.publish();
+}
+
+const GoniometerView::Scope& GoniometerView::AcquireScope()
+{
+	m_output.update();
+	return m_output.front();
+}
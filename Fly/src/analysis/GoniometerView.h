@@ -0,0 +1,38 @@
+#pragma once
+
+#include <atomic>
+#include <vector>
+
+#include "AnalysisView.h"
+#include "containers/TripleBuffer.h"
+
+// Stereo Lissajous display with a phase correlation meter. Samples are plotted with mid on the
+// vertical axis and side on the horizontal one, so mono is a vertical line and out of phase
+// material spreads sideways. Points are snapped to the drawn resolution and repeats dropped, so
+// the point count is bounded by the pixels covered rather than by the sample rate.
+class GoniometerView : public AnalysisView
+{
+public:
+	struct Scope
+	{
+		std::vector<float> points; // Interleaved x/y in -1..1, y up
+		float correlation = 0.0f;  // -1 out of phase, 0 unrelated, +1 mono
+	};
+
+	void Process(const AnalysisFrame& frame) override;
+
+	// Size in pixels of the square it's drawn in, takes effect on the next hop
+	void SetResolution(int pixels);
+
+	// UI thread, same rules as BarSpectrumView::AcquireBars
+	const Scope& AcquireScope();
+
+private:
+	static constexpr int MAX_POINTS = 8192;
+	static constexpr float PERSISTENCE_MS = 30.0f; // Audio shown per hop, a little over one hop
+
+	std::atomic<int> m_resolution{ 200 };
+	float m_correlation = 0.0f; // Smoothed across hops
+
+	TripleBuffer<Scope> m_output;
+};
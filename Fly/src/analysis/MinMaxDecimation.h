@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+
+// Reduces a run of samples to one min/max pair per output column, which is all a trace can show
+// at that width anyway. Drawing a vertical span per column keeps every peak visible (plain
+// subsampling would alias them away) while the segment count is bounded by the width, not the
+// sample rate. Samples are read with a stride so one channel of interleaved audio can be used.
+inline void DecimateMinMax(const float* samples, std::size_t count, std::size_t stride, int columns, float* mins, float* maxs)
+{
+	if (columns <= 0)
+		return;
+
+	if (count == 0)
+	{
+		for (int column = 0; column < columns; column++)
+		{
+			mins[column] = 0.0f;
+			maxs[column] = 0.0f;
+		}
+		return;
+	}
+
+	// Fixed point step so column edges don't drift, each column gets at least one sample
+	const std::size_t step = (count << 16) / static_cast<std::size_t>(columns);
+	std::size_t position = 0;
+	for (int column = 0; column < columns; column++)
+	{
+		std::size_t first = position >> 16;
+		position += step;
+		std::size_t last = min(max(position >> 16, first + 1), count);
+		first = min(first, count - 1);
+
+		float low = samples[first * stride];
+		float high = low;
+		for (std::size_t i = first + 1; i < last; i++)
+		{
+			float sample = samples[i * stride];
+			low = sample < low ? sample : low;
+			high = sample > high ? sample : high;
+		}
+		mins[column] = low;
+		maxs[column] = high;
+	}
+}
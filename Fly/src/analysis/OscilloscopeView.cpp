@@ -0,0 +1,83 @@
+#include "pch.h"
+
+#include "OscilloscopeView.h"
+
+#include "MinMaxDecimation.h"
+
+OscilloscopeView::OscilloscopeView()
+{
+	m_mid.reserve(32768);
+}
+
+void OscilloscopeView::SetColumns(int columns)
+{
+	m_columns = std::clamp(columns, 1, MAX_COLUMNS);
+}
+
+void OscilloscopeView::SetTimeSpan(float milliseconds)
+{
+	m_timeSpanMs = std::clamp(milliseconds, 1.0f, 50.0f);
+}
+
+void OscilloscopeView::SetTriggerLevel(float level)
+{
+	m_triggerLevel = std::clamp(level, -1.0f, 1.0f);
+}
+
+std::ptrdiff_t OscilloscopeView::FindTrigger(std::size_t first, std::size_t last, float level) const
+{
+	// The signal has to dip below the level by a margin before a crossing counts, so noise riding
+	// on the level doesn't trigger over and over
+	const float hysteresis = 0.01f;
+	bool armed = false;
+	for (std::size_t i = first; i < last; i++)
+	{
+		if (m_mid[i] < level - hysteresis)
+		{
+			armed = true;
+		}
+		else if (armed && m_mid[i] >= level)
+		{
+			return static_cast<std::ptrdiff_t>(i);
+		}
+	}
+	return -1;
+}
+
+void OscilloscopeView::Process(const AnalysisFrame& frame)
+{
+	if (!frame.stereo)
+	{
+		return;
+	}
+
+	const std::size_t frameCount = frame.stereoFrameCount;
+	const std::size_t center = frameCount / 2;
+	const std::size_t span = std::clamp(static_cast<std::size_t>(frame.sampleRate * m_timeSpanMs / 1000.0f), static_cast<std::size_t>(16), center);
+
+	// Mid signal of the part that can be shown, [center - span, center + span)
+	m_mid.resize(frameCount);
+	for (std::size_t i = center - span; i < center + span; i++)
+	{
+		m_mid[i] = (frame.stereo[i * 2] + frame.stereo[i * 2 + 1]) * 0.5f;
+	}
+
+	// Trigger in the span before the playing position so a full trace always follows it
+	std::ptrdiff_t trigger = FindTrigger(center - span, center, m_triggerLevel);
+	std::size_t start = trigger >= 0 ? static_cast<std::size_t>(trigger) : center - span / 2;
+
+	const int columns = m_columns;
+	Trace& trace = m_output.back();
+	trace.mins.resize(columns);
+	trace.maxs.resize(columns);
+	trace.triggered = trigger >= 0;
+	DecimateMinMax(m_mid.data() + start, span, 1, columns, trace.mins.data(), trace.maxs.data());
+
+	m_output.publish();
+}
+
+const OscilloscopeView::Trace& OscilloscopeView::AcquireTrace()
+{
+	m_output.update();
+	return m_output.front();
+}
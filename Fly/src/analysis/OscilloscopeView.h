@@ -0,0 +1,56 @@
+#pragma once
+
+#include <atomic>
+#include <vector>
+
+#include "AnalysisView.h"
+#include "containers/TripleBuffer.h"
+
+// Time-domain trace of the mid signal. Each hop looks for a rising edge through the trigger level
+// near the playing position and starts the trace there, so periodic material stands still instead
+// of crawling across the screen. The trace is min/max decimated to the width it's drawn at.
+class OscilloscopeView : public AnalysisView
+{
+public:
+	struct Trace
+	{
+		std::vector<float> mins;
+		std::vector<float> maxs;
+		bool triggered = false;
+	};
+
+	OscilloscopeView();
+
+	void Process(const AnalysisFrame& frame) override;
+
+	// Take effect on the next hop
+	void SetColumns(int columns);
+	void SetTimeSpan(float milliseconds);
+	void SetTriggerLevel(float level);
+
+	float GetTimeSpan() const
+	{
+		return m_timeSpanMs;
+	}
+
+	float GetTriggerLevel() const
+	{
+		return m_triggerLevel;
+	}
+
+	// UI thread, same rules as BarSpectrumView::AcquireBars
+	const Trace& AcquireTrace();
+
+private:
+	static constexpr int MAX_COLUMNS = 4096;
+
+	std::ptrdiff_t FindTrigger(std::size_t first, std::size_t last, float level) const;
+
+	std::atomic<int> m_columns{ 512 };
+	std::atomic<float> m_timeSpanMs{ 20.0f };
+	std::atomic<float> m_triggerLevel{ 0.0f };
+
+	std::vector<float> m_mid; // Scratch, kept so a hop never allocates
+
+	TripleBuffer<Trace> m_output;
+};
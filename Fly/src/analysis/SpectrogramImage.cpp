@@ -0,0 +1,84 @@
+#include "pch.h"
+
+#include "SpectrogramImage.h"
+
+#include <fstream>
+
+SpectrogramImage::SpectrogramImage(int width)
+      : m_width(max(width, 1))
+{
+}
+
+void SpectrogramImage::Clear()
+{
+	m_totalColumns = 0;
+	m_generation++;
+	std::fill(m_pixels.begin(), m_pixels.end(), IM_COL32(0, 0, 0, 255));
+}
+
+int SpectrogramImage::Consume(SpectrogramView& view)
+{
+	int added = 0;
+	while (const SpectrogramView::Column* column = view.PeekColumn())
+	{
+		if (column->rows != m_rows)
+		{
+			m_rows = column->rows;
+			m_pixels.resize(static_cast<std::size_t>(m_width) * m_rows);
+			Clear();
+		}
+
+		int slot = static_cast<int>(m_totalColumns % m_width);
+		std::copy_n(column->pixels.data(), m_rows, m_pixels.begin() + static_cast<std::ptrdiff_t>(slot) * m_rows);
+		m_totalColumns++;
+		added++;
+
+		view.PopColumn();
+	}
+	return added;
+}
+
+bool SpectrogramImage::WritePPM(const std::string& path) const
+{
+	const int columns = static_cast<int>(min(m_totalColumns, static_cast<std::uint64_t>(m_width)));
+	if (columns == 0 || m_rows == 0)
+	{
+		LOG_WARN("Spectrogram is empty, nothing to write to {}", path);
+		return false;
+	}
+
+	std::ofstream file(path, std::ios::binary);
+	if (!file)
+	{
+		LOG_ERROR("Failed to open {} for writing", path);
+		return false;
+	}
+
+	file << "P6\n" << columns << " " << m_rows << "\n255\n";
+
+	// Oldest column sits in the slot that will be overwritten next once the ring is full
+	const int firstSlot = m_totalColumns > static_cast<std::uint64_t>(m_width) ? static_cast<int>(m_totalColumns % m_width) : 0;
+	std::vector<char> line(static_cast<std::size_t>(columns) * 3);
+
+	// Highest frequency on top
+	for (int row = m_rows - 1; row >= 0; row--)
+	{
+		for (int x = 0; x < columns; x++)
+		{
+			std::uint32_t pixel = GetColumn((firstSlot + x) % m_width)[row];
+			line[x * 3 + 0] = static_cast<char>((pixel >> IM_COL32_R_SHIFT) & 0xFF);
+			line[x * 3 + 1] = static_cast<char>((pixel >> IM_COL32_G_SHIFT) & 0xFF);
+			line[x * 3 + 2] = static_cast<char>((pixel >> IM_COL32_B_SHIFT) & 0xFF);
+		}
+		file.write(line.data(), static_cast<std::streamsize>(line.size()));
+	}
+
+	if (!file)
+	{
+		LOG_ERROR("Failed writing spectrogram to {}", path);
+		return false;
+	}
+
+	LOG_INFO("Wrote {}x{} spectrogram to {}", columns, m_rows, path);
+	return true;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "SpectrogramView.h"
+
+// CPU side of the spectrogram: a ring of the most recent columns, stored column-major so each
+// new column is one contiguous run of pixels. Needs no graphics context, so the image can be
+// built and dumped headless; SpectrogramTexture mirrors it onto the GPU for display.
+class SpectrogramImage
+{
+public:
+	explicit SpectrogramImage(int width = 512);
+
+	// Drains the columns the view has finished since the last call, returns how many were added.
+	// A change in row count restarts the image
+	int Consume(SpectrogramView& view);
+
+	void Clear();
+
+	int GetWidth() const
+	{
+		return m_width;
+	}
+
+	int GetRows() const
+	{
+		return m_rows;
+	}
+
+	// Columns written since the last Clear, the ring slot of column n is n % width
+	std::uint64_t GetTotalColumns() const
+	{
+		return m_totalColumns;
+	}
+
+	// Incremented whenever the image restarts, so mirrors know to start over
+	std::uint32_t GetGeneration() const
+	{
+		return m_generation;
+	}
+
+	const std::uint32_t* GetColumn(int slot) const
+	{
+		return m_pixels.data() + static_cast<std::size_t>(slot) * m_rows;
+	}
+
+	// Writes the filled part of the ring, oldest column on the left, as a binary PPM
+	bool WritePPM(const std::string& path) const;
+
+private:
+	int m_width;
+	int m_rows = 0;
+	std::uint64_t m_totalColumns = 0;
+	std::uint32_t m_generation = 0;
+	std::vector<std::uint32_t> m_pixels; // width x rows RGBA
+};
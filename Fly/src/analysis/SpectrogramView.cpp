@@ -0,0 +1,199 @@
+#include "pch.h"
+
+#include "SpectrogramView.h"
+
+#include "dsp/FastMath.h"
+
+namespace
+{
+	float HzToMel(float hz)
+	{
+		return 2595.0f * std::log10(1.0f + hz / 700.0f);
+	}
+
+	float MelToHz(float mel)
+	{
+		return 700.0f * (std::pow(10.0f, mel / 2595.0f) - 1.0f);
+	}
+}
+
+SpectrogramView::SpectrogramView(int rows, Scale scale)
+      : m_requestedRows(std::clamp(rows, 16, MAX_ROWS)), m_requestedScale(scale)
+{
+	BuildColormap();
+}
+
+void SpectrogramView::SetRows(int rows)
+{
+	m_requestedRows = std::clamp(rows, 16, MAX_ROWS);
+}
+
+void SpectrogramView::SetScale(Scale scale)
+{
+	m_requestedScale = scale;
+}
+
+void SpectrogramView::SetRange(float minDb, float maxDb)
+{
+	if (maxDb - minDb < 1.0f)
+	{
+		return;
+	}
+	m_minDb = minDb;
+	m_maxDb = maxDb;
+}
+
+void SpectrogramView::BuildColormap()
+{
+	// Dark purple through red to pale yellow, perceptually ordered so quiet detail stays readable
+	struct Stop
+	{
+		float position;
+		float r, g, b;
+	};
+	static const Stop stops[] = {
+		{ 0.00f, 0.0f, 0.0f, 4.0f },
+		{ 0.25f, 80.0f, 18.0f, 123.0f },
+		{ 0.50f, 183.0f, 55.0f, 121.0f },
+		{ 0.75f, 252.0f, 137.0f, 97.0f },
+		{ 1.00f, 252.0f, 253.0f, 191.0f },
+	};
+	const int stopCount = static_cast<int>(std::size(stops));
+
+	for (int i = 0; i < COLORMAP_SIZE; i++)
+	{
+		float t = static_cast<float>(i) / (COLORMAP_SIZE - 1);
+		int stop = 0;
+		while (stop < stopCount - 2 && t > stops[stop + 1].position)
+		{
+			stop++;
+		}
+		const Stop& a = stops[stop];
+		const Stop& b = stops[stop + 1];
+		float blend = (t - a.position) / (b.position - a.position);
+		m_colormap[i] = IM_COL32(static_cast<int>(a.r + (b.r - a.r) * blend), static_cast<int>(a.g + (b.g - a.g) * blend),
+		                         static_cast<int>(a.b + (b.b - a.b) * blend), 255);
+	}
+}
+
+void SpectrogramView::BuildFilterbank(int sampleRate, int fftSize, std::size_t binCount)
+{
+	const float rate = static_cast<float>(sampleRate);
+	const float binHz = rate / fftSize;
+	const int lastBin = static_cast<int>(binCount) - 1;
+	const float minFreq = 30.0f;
+	const float maxFreq = min(20000.0f, rate * 0.5f);
+
+	// rows + 2 edges, filter r rises from edge r to a peak at r + 1 and falls to r + 2
+	std::vector<float> edges(m_rows + 2);
+	for (int i = 0; i < m_rows + 2; i++)
+	{
+		float t = static_cast<float>(i) / (m_rows + 1);
+		if (m_scale == Scale::Mel)
+		{
+			float minMel = HzToMel(minFreq);
+			edges[i] = MelToHz(minMel + (HzToMel(maxFreq) - minMel) * t);
+		}
+		else
+		{
+			edges[i] = minFreq * std::pow(maxFreq / minFreq, t);
+		}
+	}
+
+	m_filters.resize(m_rows);
+	m_filterWeights.clear();
+
+	for (int row = 0; row < m_rows; row++)
+	{
+		const float low = edges[row];
+		const float center = edges[row + 1];
+		const float high = edges[row + 2];
+
+		FilterRow& filter = m_filters[row];
+		filter.weightOffset = static_cast<int>(m_filterWeights.size());
+		filter.firstBin = std::clamp(static_cast<int>(std::ceil(low / binHz)), 0, lastBin);
+		int endBin = std::clamp(static_cast<int>(std::floor(high / binHz)), 0, lastBin);
+
+		float weightSum = 0.0f;
+		for (int bin = filter.firstBin; bin <= endBin; bin++)
+		{
+			float freq = bin * binHz;
+			float weight = freq <= center ? (freq - low) / (center - low) : (high - freq) / (high - center);
+			m_filterWeights.push_back(max(weight, 0.0f));
+			weightSum += m_filterWeights.back();
+		}
+		filter.binCount = endBin - filter.firstBin + 1;
+
+		if (weightSum <= 0.0f)
+		{
+			// Low rows are narrower than a bin, interpolate the two bins around the center instead
+			m_filterWeights.resize(filter.weightOffset);
+			float position = std::clamp(center / binHz, 0.0f, static_cast<float>(max(lastBin - 1, 0)));
+			filter.firstBin = static_cast<int>(position);
+			filter.binCount = min(2, lastBin - filter.firstBin + 1);
+			float frac = position - filter.firstBin;
+			m_filterWeights.push_back(1.0f - frac);
+			if (filter.binCount == 2)
+				m_filterWeights.push_back(frac);
+			continue;
+		}
+
+		// Unit area, so broadband noise reads the same level in wide and narrow rows
+		float inverseSum = 1.0f / weightSum;
+		for (int i = 0; i < filter.binCount; i++)
+		{
+			m_filterWeights[filter.weightOffset + i] *= inverseSum;
+		}
+	}
+
+	m_tableSampleRate = sampleRate;
+	m_tableFftSize = fftSize;
+	LOG_DEBUG("Rebuilt spectrogram filterbank: {} rows, {} weights", m_rows, m_filterWeights.size());
+}
+
+void SpectrogramView::Process(const AnalysisFrame& frame)
+{
+	const int rows = m_requestedRows;
+	const Scale scale = m_requestedScale;
+	if (rows != m_rows || scale != m_scale || frame.sampleRate != m_tableSampleRate || frame.fftSize != m_tableFftSize)
+	{
+		m_rows = rows;
+		m_scale = scale;
+		BuildFilterbank(frame.sampleRate, frame.fftSize, frame.binCount);
+	}
+
+	Column* column = m_columns.beginPush();
+	if (!column)
+	{
+		return;
+	}
+
+	const float minDb = m_minDb;
+	const float colorScale = (COLORMAP_SIZE - 1) / (m_maxDb - minDb);
+	const float* weights = m_filterWeights.data();
+
+	for (int row = 0; row < m_rows; row++)
+	{
+		const FilterRow& filter = m_filters[row];
+		const float* magnitudes = frame.magnitudes + filter.firstBin;
+		const float* rowWeights = weights + filter.weightOffset;
+
+		// Weighted power, mapped through dB onto the colormap below
+		float power = 0.0f;
+		for (int i = 0; i < filter.binCount; i++)
+		{
+			power += rowWeights[i] * magnitudes[i] * magnitudes[i];
+		}
+		m_rowLevels[row] = power + 1e-12f;
+	}
+
+	FastMath::PowerToDb(m_rowLevels.data(), m_rowLevels.data(), m_rows);
+	for (int row = 0; row < m_rows; row++)
+	{
+		int index = std::clamp(static_cast<int>((m_rowLevels[row] - minDb) * colorScale), 0, COLORMAP_SIZE - 1);
+		column->pixels[row] = m_colormap[index];
+	}
+	column->rows = m_rows;
+
+	m_columns.commitPush();
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+#include "AnalysisView.h"
+#include "containers/SpscQueue.h"
+
+// Scrolling time/frequency display. Every hop the spectrum is folded into rows by a sparse
+// triangular filterbank on a log or mel axis, mapped to dB and colored, and the finished column
+// is queued for the UI. Drawing the columns is left to SpectrogramImage.
+class SpectrogramView : public AnalysisView
+{
+public:
+	static constexpr int MAX_ROWS = 512;
+
+	enum class Scale
+	{
+		Log,
+		Mel
+	};
+
+	// One hop worth of pixels, RGBA packed as ImGui/OpenGL expect them, lowest frequency first
+	struct Column
+	{
+		std::array<std::uint32_t, MAX_ROWS> pixels;
+		int rows = 0;
+	};
+
+	explicit SpectrogramView(int rows = 256, Scale scale = Scale::Log);
+
+	void Process(const AnalysisFrame& frame) override;
+
+	// Take effect on the next hop
+	void SetRows(int rows);
+	void SetScale(Scale scale);
+
+	int GetRows() const
+	{
+		return m_requestedRows;
+	}
+
+	Scale GetScale() const
+	{
+		return m_requestedScale;
+	}
+
+	// Levels mapped onto the colormap, in dBFS
+	void SetRange(float minDb, float maxDb);
+
+	// UI thread, the next finished column or nullptr. Call PopColumn once done with it
+	const Column* PeekColumn()
+	{
+		return m_columns.front();
+	}
+
+	void PopColumn()
+	{
+		m_columns.pop();
+	}
+
+private:
+	// Nonzero span of one triangular filter, its weights live in m_filterWeights
+	struct FilterRow
+	{
+		int firstBin;
+		int binCount;
+		int weightOffset;
+	};
+
+	static constexpr int COLORMAP_SIZE = 256;
+
+	void BuildFilterbank(int sampleRate, int fftSize, std::size_t binCount);
+	void BuildColormap();
+
+	// Filterbank, rebuilt only when the layout, sample rate or FFT size changes
+	int m_rows = 0;
+	Scale m_scale = Scale::Log;
+	int m_tableSampleRate = 0;
+	int m_tableFftSize = 0;
+	std::vector<FilterRow> m_filters;
+	std::vector<float> m_filterWeights;
+
+	std::atomic<int> m_requestedRows;
+	std::atomic<Scale> m_requestedScale;
+	std::atomic<float> m_minDb{ -90.0f };
+	std::atomic<float> m_maxDb{ -10.0f };
+
+	std::array<std::uint32_t, COLORMAP_SIZE> m_colormap{};
+	std::array<float, MAX_ROWS> m_rowLevels{}; // Scratch, row power then dB
+
+	// Dropped when the UI isn't draining, e.g. while the spectrogram tab is hidden
+	SpscQueue<Column, 64> m_columns;
+};
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// Fixed-size history of decoded interleaved PCM, addressed by absolute stream frame.
+// Frames are appended in stream order, once full the oldest frames are overwritten.
+// Not thread safe, the owner is expected to serialize access (the stream lock).
+class RewindBuffer
+{
+public:
+	void Configure(unsigned int channels, std::size_t capacityFrames)
+	{
+		m_channels = channels;
+		m_capacityFrames = capacityFrames;
+		m_data.assign(capacityFrames * channels, 0.0f);
+		Clear(0);
+	}
+
+	// Empties the buffer, the next pushed frame will be startFrame
+	void Clear(std::int64_t startFrame)
+	{
+		m_startFrame = startFrame;
+		m_endFrame = startFrame;
+	}
+
+	void Push(const float* frames, std::size_t frameCount)
+	{
+		if (m_capacityFrames == 0)
+			return;
+
+		// Only the newest capacity's worth of a large push can survive anyway
+		if (frameCount > m_capacityFrames)
+		{
+			frames += (frameCount - m_capacityFrames) * m_channels;
+			m_endFrame += static_cast<std::int64_t>(frameCount - m_capacityFrames);
+			frameCount = m_capacityFrames;
+		}
+
+		std::size_t writePos = static_cast<std::size_t>(m_endFrame % static_cast<std::int64_t>(m_capacityFrames));
+		std::size_t firstPart = min(frameCount, m_capacityFrames - writePos);
+		std::memcpy(m_data.data() + writePos * m_channels, frames, firstPart * m_channels * sizeof(float));
+		std::memcpy(m_data.data(), frames + firstPart * m_channels, (frameCount - firstPart) * m_channels * sizeof(float));
+
+		m_endFrame += static_cast<std::int64_t>(frameCount);
+		m_startFrame = max(m_startFrame, m_endFrame - static_cast<std::int64_t>(m_capacityFrames));
+	}
+
+	bool Contains(std::int64_t frame) const
+	{
+		return frame >= m_startFrame && frame < m_endFrame;
+	}
+
+	// Copies up to frameCount frames starting at an absolute stream frame, returns the number copied
+	std::size_t Read(std::int64_t frame, float* out, std::size_t frameCount) const
+	{
+		if (!Contains(frame))
+			return 0;
+
+		frameCount = min(frameCount, static_cast<std::size_t>(m_endFrame - frame));
+		std::size_t readPos = static_cast<std::size_t>(frame % static_cast<std::int64_t>(m_capacityFrames));
+		std::size_t firstPart = min(frameCount, m_capacityFrames - readPos);
+		std::memcpy(out, m_data.data() + readPos * m_channels, firstPart * m_channels * sizeof(float));
+		std::memcpy(out + firstPart * m_channels, m_data.data(), (frameCount - firstPart) * m_channels * sizeof(float));
+		return frameCount;
+	}
+
+	std::int64_t GetStartFrame() const
+	{
+		return m_startFrame;
+	}
+
+	std::int64_t GetEndFrame() const
+	{
+		return m_endFrame;
+	}
+
+private:
+	std::vector<float> m_data;
+	unsigned int m_channels{ 0 };
+	std::size_t m_capacityFrames{ 0 };
+	std::int64_t m_startFrame{ 0 };
+	std::int64_t m_endFrame{ 0 };
+};
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+// Maximum of the last N pushed values in amortized constant time, as a monotonic deque. Entries are
+// kept in decreasing order with the push they came from: a new value drops every entry it is not
+// smaller than from the back, and the front expires once it falls out of the window. The deque lives
+// in a ring of N entries sized by Configure, so pushing never allocates.
+// Not thread safe, the owner is expected to serialize access.
+template<typename T>
+class SlidingMax
+{
+public:
+	// Window in pushes, at least one. Clears
+	void Configure(std::size_t window)
+	{
+		m_window = window > 0 ? window : 1;
+		m_entries.assign(m_window, Entry{});
+		Clear();
+	}
+
+	void Clear()
+	{
+		m_head = 0;
+		m_count = 0;
+		m_pushes = 0;
+	}
+
+	std::size_t GetWindow() const
+	{
+		return m_window;
+	}
+
+	// Adds a value and returns the maximum of the window ending with it
+	T Push(T value)
+	{
+		// Nothing at the back that is not larger can be the maximum again while the new value is in the window
+		while (m_count > 0 && m_entries[Index(m_count - 1)].value <= value)
+		{
+			m_count--;
+		}
+
+		// One push in means at most one out, only the front can be that old
+		if (m_count > 0 && m_entries[m_head].push + m_window <= m_pushes)
+		{
+			m_head = Index(1);
+			m_count--;
+		}
+
+		m_entries[Index(m_count)] = { value, m_pushes };
+		m_count++;
+		m_pushes++;
+		return m_entries[m_head].value;
+	}
+
+private:
+	struct Entry
+	{
+		T value{};
+		std::size_t push{ 0 };
+	};
+
+	std::size_t Index(std::size_t offset) const
+	{
+		const std::size_t index = m_head + offset;
+		return index < m_window ? index : index - m_window;
+	}
+
+	std::vector<Entry> m_entries;
+	std::size_t m_window{ 1 };
+	std::size_t m_head{ 0 };
+	std::size_t m_count{ 0 };
+	std::size_t m_pushes{ 0 };
+};
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+// Wait-free single-producer/single-consumer queue over a fixed set of preallocated slots.
+// Slots are filled and drained in place, so large elements are never copied and neither side
+// ever blocks or allocates. When the queue is full the producer is told so and can drop its data.
+template<typename T, std::size_t Capacity>
+class SpscQueue
+{
+	static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+	SpscQueue()
+	      : slots(Capacity)
+	{
+	}
+
+	// Prevent copying and moving, the two threads hold on to the slots
+	SpscQueue(const SpscQueue&) = delete;
+	SpscQueue& operator=(const SpscQueue&) = delete;
+
+	// Producer: the slot to fill next, or nullptr if the consumer hasn't caught up
+	T* beginPush()
+	{
+		std::size_t currentTail = tail.load(std::memory_order_relaxed);
+		if (currentTail - head.load(std::memory_order_acquire) == Capacity)
+			return nullptr;
+
+		return &slots[currentTail & (Capacity - 1)];
+	}
+
+	// Producer: publishes the slot returned by beginPush
+	void commitPush()
+	{
+		tail.store(tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+	}
+
+	// Consumer: the oldest filled slot, or nullptr if empty
+	T* front()
+	{
+		std::size_t currentHead = head.load(std::memory_order_relaxed);
+		if (currentHead == tail.load(std::memory_order_acquire))
+			return nullptr;
+
+		return &slots[currentHead & (Capacity - 1)];
+	}
+
+	// Consumer: hands the slot returned by front back to the producer
+	void pop()
+	{
+		head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+	}
+
+	std::size_t size() const
+	{
+		return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+	}
+
+private:
+	std::vector<T> slots;
+
+	// On separate cache lines so the two threads don't false-share
+	alignas(64) std::atomic<std::size_t> head{ 0 };
+	alignas(64) std::atomic<std::size_t> tail{ 0 };
+};
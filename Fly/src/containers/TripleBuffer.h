@@ -0,0 +1,61 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+// Lock-free hand-over of the latest value from one writer thread to one reader thread.
+// The writer fills back() and publishes it, the reader picks up the newest published value
+// with update() and reads front() until the next update. Each side always owns a buffer of
+// its own, so neither ever waits or sees a half-written value, intermediate values are skipped.
+template<typename T>
+class TripleBuffer
+{
+public:
+	TripleBuffer() = default;
+
+	// Prevent copying
+	TripleBuffer(const TripleBuffer&) = delete;
+	TripleBuffer& operator=(const TripleBuffer&) = delete;
+
+	// Writer side
+	T& back()
+	{
+		return buffers[backIndex];
+	}
+
+	void publish()
+	{
+		backIndex = middle.exchange(backIndex | FRESH_BIT, std::memory_order_acq_rel) & INDEX_MASK;
+	}
+
+	// Reader side, returns true if a newer value was published since the last call
+	bool update()
+	{
+		if ((middle.load(std::memory_order_relaxed) & FRESH_BIT) == 0)
+			return false;
+
+		frontIndex = middle.exchange(frontIndex, std::memory_order_acq_rel) & INDEX_MASK;
+		return true;
+	}
+
+	const T& front() const
+	{
+		return buffers[frontIndex];
+	}
+
+	// Gives every buffer the same initial value, only safe before both threads start
+	void reset(const T& value)
+	{
+		buffers.fill(value);
+	}
+
+private:
+	static constexpr std::uint8_t INDEX_MASK = 0x3;
+	static constexpr std::uint8_t FRESH_BIT = 0x4;
+
+	std::array<T, 3> buffers{};
+	std::uint8_t backIndex = 0;
+	std::uint8_t frontIndex = 1;
+	std::atomic<std::uint8_t> middle{ 2 };
+};
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// Decoded length of one MPEG-1 Layer III frame
+constexpr std::int64_t MP3_FRAME_SAMPLES = 1152;
+
+// Common interface for every decoding backend. Decoders produce interleaved
+// float frames in the range -1.0 to 1.0, which is the layout AudioStreamer expects.
+class AudioDecoder
+{
+public:
+	struct Format
+	{
+		unsigned int channelCount{ 0 };
+		unsigned int sampleRate{ 0 };
+		std::int64_t frameCount{ 0 };
+	};
+
+	struct Tags
+	{
+		std::string title;
+		std::string artist;
+		std::string album;
+		std::string genre;
+		std::string year;
+	};
+
+	virtual ~AudioDecoder() = default;
+
+	virtual bool Open(const std::string& filename) = 0;
+	virtual void Close() = 0;
+
+	// Reads up to frameCount interleaved frames into out, returns the number of frames read
+	virtual std::size_t ReadFrames(float* out, std::size_t frameCount) = 0;
+	virtual bool Seek(std::int64_t frame) = 0;
+
+	// Frames to decode and discard before a seek target so the decoder state is primed,
+	// e.g. the MP3 bit reservoir and MDCT overlap reach back into earlier frames
+	virtual std::int64_t GetSeekPreroll() const
+	{
+		return 0;
+	}
+
+	// Backends that don't parse metadata leave the tags untouched and return false
+	virtual bool ReadTags(Tags& tags) const
+	{
+		return false;
+	}
+
+	virtual const char* GetName() const = 0;
+
+	bool IsOpen() const
+	{
+		return m_format.channelCount > 0;
+	}
+
+	const Format& GetFormat() const
+	{
+		return m_format;
+	}
+
+protected:
+	Format m_format{};
+};
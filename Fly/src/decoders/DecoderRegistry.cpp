@@ -0,0 +1,162 @@
+#include "pch.h"
+
+#include "DecoderRegistry.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+#include "DrFlacDecoder.h"
+#include "DrMp3Decoder.h"
+#include "PcmCache.h"
+#include "SndFileDecoder.h"
+
+namespace
+{
+	bool StartsWith(const DecoderRegistry::ProbeHeader& header, const char* magic, std::size_t offset = 0)
+	{
+		std::size_t length = std::strlen(magic);
+		return offset + length <= header.size() && std::memcmp(header.data() + offset, magic, length) == 0;
+	}
+
+	bool IsMp3Header(const DecoderRegistry::ProbeHeader& header)
+	{
+		// Either an ID3v2 tag or a bare MPEG audio frame sync (11 set bits, layer III)
+		if (StartsWith(header, "ID3"))
+			return true;
+
+		return header[0] == 0xFF && (header[1] & 0xE0) == 0xE0 && (header[1] & 0x06) == 0x02;
+	}
+
+	bool IsFlacHeader(const DecoderRegistry::ProbeHeader& header)
+	{
+		return StartsWith(header, "fLaC");
+	}
+
+	std::string GetLowercaseExtension(const std::string& filename)
+	{
+		std::string extension = std::filesystem::path(filename).extension().string();
+		std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+		return extension;
+	}
+} // namespace
+
+DecoderRegistry& DecoderRegistry::Get()
+{
+	static DecoderRegistry registry;
+	return registry;
+}
+
+DecoderRegistry::DecoderRegistry()
+{
+	// Native backends first, they decode directly to float and avoid libsndfile's conversion layers.
+	// The DecoderBackends benchmark in FlyTests fails if this order stops picking the fastest
+	Register({ "dr_mp3", { ".mp3" }, IsMp3Header, [] { return std::make_unique<DrMp3Decoder>(); } });
+	Register({ "dr_flac", { ".flac" }, IsFlacHeader, [] { return std::make_unique<DrFlacDecoder>(); } });
+
+	m_fallback = { "libsndfile", { ".wav", ".flac", ".ogg", ".mp3", ".aiff", ".opus" }, nullptr, [] { return std::make_unique<SndFileDecoder>(); } };
+}
+
+void DecoderRegistry::Register(Backend backend)
+{
+	LOG_DEBUG("Registering decoder backend {}", backend.name);
+	m_backends.push_back(std::move(backend));
+}
+
+std::vector<const DecoderRegistry::Backend*> DecoderRegistry::FindCandidates(const std::string& filename) const
+{
+	ProbeHeader header{};
+	std::ifstream file(std::filesystem::path(filename), std::ios::binary);
+	if (file)
+	{
+		file.read(reinterpret_cast<char*>(header.data()), header.size());
+	}
+
+	std::string extension = GetLowercaseExtension(filename);
+
+	std::vector<const Backend*> candidates;
+	auto addCandidate = [&candidates](const Backend* backend)
+	{
+		if (std::find(candidates.begin(), candidates.end(), backend) == candidates.end())
+		{
+			candidates.push_back(backend);
+		}
+	};
+
+	// Content beats the file name, a mislabelled file should still reach the right decoder
+	for (const Backend& backend: m_backends)
+	{
+		if (backend.probe && backend.probe(header))
+		{
+			addCandidate(&backend);
+		}
+	}
+
+	for (const Backend& backend: m_backends)
+	{
+		if (std::find(backend.extensions.begin(), backend.extensions.end(), extension) != backend.extensions.end())
+		{
+			addCandidate(&backend);
+		}
+	}
+
+	addCandidate(&m_fallback);
+	return candidates;
+}
+
+std::unique_ptr<AudioDecoder> DecoderRegistry::Open(const std::string& filename) const
+{
+	if (std::unique_ptr<AudioDecoder> cached = PcmCache::Get().Open(filename))
+	{
+		LOG_INFO("Opened {} from the PCM cache", filename);
+		return cached;
+	}
+	return OpenUncached(filename);
+}
+
+std::unique_ptr<AudioDecoder> DecoderRegistry::OpenUncached(const std::string& filename) const
+{
+	for (const Backend* backend: FindCandidates(filename))
+	{
+		std::unique_ptr<AudioDecoder> decoder = backend->create();
+		if (decoder->Open(filename))
+		{
+			LOG_INFO("Opened {} with the {} backend", filename, backend->name);
+			return decoder;
+		}
+	}
+
+	LOG_ERROR("No decoder backend could open {}", filename);
+	return nullptr;
+}
+
+AudioDecoder::Tags DecoderRegistry::ReadTags(const std::string& filename, const AudioDecoder& decoder) const
+{
+	AudioDecoder::Tags tags;
+	if (decoder.ReadTags(tags))
+		return tags;
+
+	// The native backends only decode audio, so borrow libsndfile's metadata parsing
+	SndFileDecoder tagReader;
+	if (tagReader.Open(filename))
+	{
+		tagReader.ReadTags(tags);
+	}
+	return tags;
+}
+
+std::vector<std::string> DecoderRegistry::GetSupportedExtensions() const
+{
+	std::vector<std::string> extensions = m_fallback.extensions;
+	for (const Backend& backend: m_backends)
+	{
+		for (const std::string& extension: backend.extensions)
+		{
+			if (std::find(extensions.begin(), extensions.end(), extension) == extensions.end())
+			{
+				extensions.push_back(extension);
+			}
+		}
+	}
+	return extensions;
+}
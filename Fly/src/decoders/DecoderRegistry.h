@@ -0,0 +1,59 @@
+#pragma once
+
+#include <array>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "AudioDecoder.h"
+
+// Picks a decoding backend for a file. Backends are matched on their magic bytes first
+// and on the file extension second, in registration order, so the preferred (fastest)
+// backend for a format should be registered first. libsndfile is the catch-all fallback.
+class DecoderRegistry
+{
+public:
+	static constexpr std::size_t PROBE_SIZE = 16;
+
+	using ProbeHeader = std::array<unsigned char, PROBE_SIZE>;
+	using Factory = std::function<std::unique_ptr<AudioDecoder>()>;
+	using Probe = std::function<bool(const ProbeHeader&)>;
+
+	struct Backend
+	{
+		std::string name;
+		std::vector<std::string> extensions; // Lowercase, including the dot
+		Probe probe;
+		Factory create;
+	};
+
+	static DecoderRegistry& Get();
+
+	void Register(Backend backend);
+
+	// Opens the file from the PCM cache when it holds a decoded copy, otherwise with the first
+	// backend that accepts it. Returns nullptr if none could
+	std::unique_ptr<AudioDecoder> Open(const std::string& filename) const;
+
+	// Same as Open but always decodes the source file
+	std::unique_ptr<AudioDecoder> OpenUncached(const std::string& filename) const;
+
+	// Reads tags with the given decoder, falling back to libsndfile's metadata reader
+	AudioDecoder::Tags ReadTags(const std::string& filename, const AudioDecoder& decoder) const;
+
+	const std::vector<Backend>& GetBackends() const
+	{
+		return m_backends;
+	}
+
+	std::vector<std::string> GetSupportedExtensions() const;
+
+private:
+	DecoderRegistry();
+
+	std::vector<const Backend*> FindCandidates(const std::string& filename) const;
+
+	std::vector<Backend> m_backends;
+	Backend m_fallback;
+};
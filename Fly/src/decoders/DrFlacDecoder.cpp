@@ -0,0 +1,54 @@
+#include "pch.h"
+
+// Compile the single-header implementation into this translation unit only
+#define DR_FLAC_IMPLEMENTATION
+#include "DrFlacDecoder.h"
+
+DrFlacDecoder::~DrFlacDecoder()
+{
+	Close();
+}
+
+bool DrFlacDecoder::Open(const std::string& filename)
+{
+	Close();
+
+	m_flac = drflac_open_file(filename.c_str(), nullptr);
+	if (!m_flac)
+	{
+		LOG_WARN("dr_flac failed to open {}", filename);
+		return false;
+	}
+
+	m_format.channelCount = m_flac->channels;
+	m_format.sampleRate = m_flac->sampleRate;
+	m_format.frameCount = static_cast<std::int64_t>(m_flac->totalPCMFrameCount);
+	return true;
+}
+
+void DrFlacDecoder::Close()
+{
+	if (m_flac)
+	{
+		drflac_close(m_flac);
+		m_flac = nullptr;
+	}
+	m_format = {};
+}
+
+std::size_t DrFlacDecoder::ReadFrames(float* out, std::size_t frameCount)
+{
+	if (!m_flac)
+		return 0;
+
+	return static_cast<std::size_t>(drflac_read_pcm_frames_f32(m_flac, frameCount, out));
+}
+
+bool DrFlacDecoder::Seek(std::int64_t frame)
+{
+	if (!m_flac)
+		return false;
+
+	frame = std::clamp(frame, static_cast<std::int64_t>(0), m_format.frameCount);
+	return drflac_seek_to_pcm_frame(m_flac, static_cast<drflac_uint64>(frame));
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <dr_flac.h>
+
+#include "AudioDecoder.h"
+
+// Native FLAC backend built on dr_flac, decodes straight to interleaved float
+class DrFlacDecoder : public AudioDecoder
+{
+public:
+	~DrFlacDecoder() override;
+
+	bool Open(const std::string& filename) override;
+	void Close() override;
+
+	std::size_t ReadFrames(float* out, std::size_t frameCount) override;
+	bool Seek(std::int64_t frame) override;
+
+	const char* GetName() const override
+	{
+		return "dr_flac";
+	}
+
+private:
+	drflac* m_flac{ nullptr };
+};
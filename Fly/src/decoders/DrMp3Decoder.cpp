@@ -0,0 +1,82 @@
+#include "pch.h"
+
+// Compile the single-header implementation into this translation unit only
+#define DR_MP3_IMPLEMENTATION
+#include "DrMp3Decoder.h"
+
+// One seek point per this many MP3 frames, roughly every 1.3 s at 44.1 kHz
+static constexpr drmp3_uint32 SEEK_POINT_STRIDE_FRAMES = 50;
+
+DrMp3Decoder::~DrMp3Decoder()
+{
+	Close();
+}
+
+bool DrMp3Decoder::Open(const std::string& filename)
+{
+	Close();
+
+	if (!drmp3_init_file(&m_mp3, filename.c_str(), nullptr))
+	{
+		LOG_WARN("dr_mp3 failed to open {}", filename);
+		return false;
+	}
+	m_initialized = true;
+
+	// Counting frames walks the frame headers without synthesis, which is cheap compared to decoding
+	drmp3_uint64 mp3FrameCount = 0;
+	drmp3_uint64 pcmFrameCount = 0;
+	if (!drmp3_get_mp3_and_pcm_frame_count(&m_mp3, &mp3FrameCount, &pcmFrameCount))
+	{
+		LOG_WARN("dr_mp3 failed to count frames in {}", filename);
+		Close();
+		return false;
+	}
+
+	// Without a seek table every seek would decode from the start of the file
+	drmp3_uint32 seekPointCount = static_cast<drmp3_uint32>(mp3FrameCount / SEEK_POINT_STRIDE_FRAMES) + 1;
+	m_seekTable.resize(seekPointCount);
+	if (drmp3_calculate_seek_points(&m_mp3, &seekPointCount, m_seekTable.data()))
+	{
+		m_seekTable.resize(seekPointCount);
+		drmp3_bind_seek_table(&m_mp3, seekPointCount, m_seekTable.data());
+	}
+	else
+	{
+		LOG_WARN("dr_mp3 could not build a seek table for {}, seeking will be slow", filename);
+		m_seekTable.clear();
+	}
+
+	m_format.channelCount = m_mp3.channels;
+	m_format.sampleRate = m_mp3.sampleRate;
+	m_format.frameCount = static_cast<std::int64_t>(pcmFrameCount);
+	return true;
+}
+
+void DrMp3Decoder::Close()
+{
+	if (m_initialized)
+	{
+		drmp3_uninit(&m_mp3);
+		m_initialized = false;
+	}
+	m_seekTable.clear();
+	m_format = {};
+}
+
+std::size_t DrMp3Decoder::ReadFrames(float* out, std::size_t frameCount)
+{
+	if (!m_initialized)
+		return 0;
+
+	return static_cast<std::size_t>(drmp3_read_pcm_frames_f32(&m_mp3, frameCount, out));
+}
+
+bool DrMp3Decoder::Seek(std::int64_t frame)
+{
+	if (!m_initialized)
+		return false;
+
+	frame = std::clamp(frame, static_cast<std::int64_t>(0), m_format.frameCount);
+	return drmp3_seek_to_pcm_frame(&m_mp3, static_cast<drmp3_uint64>(frame));
+}
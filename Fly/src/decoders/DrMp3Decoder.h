@@ -0,0 +1,34 @@
+#pragma once
+
+#include <dr_mp3.h>
+#include <vector>
+
+#include "AudioDecoder.h"
+
+// Native MP3 backend built on dr_mp3, decodes straight to interleaved float
+class DrMp3Decoder : public AudioDecoder
+{
+public:
+	~DrMp3Decoder() override;
+
+	bool Open(const std::string& filename) override;
+	void Close() override;
+
+	std::size_t ReadFrames(float* out, std::size_t frameCount) override;
+	bool Seek(std::int64_t frame) override;
+
+	std::int64_t GetSeekPreroll() const override
+	{
+		return 2 * MP3_FRAME_SAMPLES;
+	}
+
+	const char* GetName() const override
+	{
+		return "dr_mp3";
+	}
+
+private:
+	drmp3 m_mp3{};
+	std::vector<drmp3_seek_point> m_seekTable;
+	bool m_initialized{ false };
+};
@@ -0,0 +1,174 @@
+#include "pch.h"
+
+#include "MemoryDecoder.h"
+
+#include <algorithm>
+#include <cstring>
+#include <thread>
+
+#include "DecoderRegistry.h"
+
+// Ranges shorter than this aren't worth the cost of opening another decoder
+static constexpr std::int64_t MIN_FRAMES_PER_THREAD = 1 << 18;
+static constexpr unsigned int MAX_DECODE_THREADS = 8;
+
+bool MemoryDecoder::CanPreload(const Format& format)
+{
+	if (format.frameCount <= 0 || format.channelCount == 0)
+		return false;
+
+	return static_cast<std::size_t>(format.frameCount) * format.channelCount * sizeof(float) <= MAX_PRELOAD_BYTES;
+}
+
+bool MemoryDecoder::Open(const std::string& filename)
+{
+	Close();
+
+	std::unique_ptr<AudioDecoder> source = DecoderRegistry::Get().Open(filename);
+	return source && Load(filename, *source);
+}
+
+void MemoryDecoder::Close()
+{
+	m_pcm.reset();
+	m_position = 0;
+	m_tags = {};
+	m_format = {};
+}
+
+bool MemoryDecoder::Load(const std::string& filename, AudioDecoder& source, const std::atomic<bool>* cancel)
+{
+	Close();
+
+	const Format& format = source.GetFormat();
+	if (!CanPreload(format))
+	{
+		LOG_WARN("{} is too large or has an unknown length, not preloading", filename);
+		return false;
+	}
+
+	auto start = std::chrono::steady_clock::now();
+
+	auto pcm = std::make_shared<std::vector<float>>(static_cast<std::size_t>(format.frameCount) * format.channelCount);
+	m_pcm = pcm;
+	m_format = format;
+	m_tags = DecoderRegistry::Get().ReadTags(filename, source);
+
+	unsigned int hardwareThreads = max(1u, std::thread::hardware_concurrency());
+	unsigned int threadCount = static_cast<unsigned int>(std::clamp<std::int64_t>(format.frameCount / MIN_FRAMES_PER_THREAD, 1, min(hardwareThreads, MAX_DECODE_THREADS)));
+	std::int64_t framesPerThread = (format.frameCount + threadCount - 1) / threadCount;
+
+	// Every range gets its own decoder handle, the caller's handle decodes the first range
+	std::vector<std::thread> workers;
+	std::vector<char> results(threadCount, 0);
+	for (unsigned int i = 1; i < threadCount; ++i)
+	{
+		std::int64_t rangeStart = i * framesPerThread;
+		std::int64_t rangeEnd = min(rangeStart + framesPerThread, format.frameCount);
+		workers.emplace_back([this, &filename, &results, i, rangeStart, rangeEnd, cancel]()
+		{
+			std::unique_ptr<AudioDecoder> decoder = DecoderRegistry::Get().Open(filename);
+			results[i] = decoder && DecodeRange(filename, decoder.get(), rangeStart, rangeEnd, cancel);
+		});
+		SetThreadDescription(workers.back().native_handle(), L"DecodeWorker");
+	}
+
+	results[0] = DecodeRange(filename, &source, 0, min(framesPerThread, format.frameCount), cancel);
+
+	for (std::thread& worker: workers)
+	{
+		worker.join();
+	}
+
+	if (std::find(results.begin(), results.end(), 0) != results.end())
+	{
+		Close();
+		return false;
+	}
+
+	[[maybe_unused]] auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+	LOG_INFO("Preloaded {} frames of {} on {} threads in {} ms", format.frameCount, filename, threadCount, elapsed);
+	return true;
+}
+
+bool MemoryDecoder::DecodeRange(const std::string& filename, AudioDecoder* decoder, std::int64_t start, std::int64_t end, const std::atomic<bool>* cancel)
+{
+	const std::size_t channels = m_format.channelCount;
+	if (decoder->GetFormat().channelCount != channels)
+	{
+		LOG_ERROR("Decoder for {} reported a different channel layout", filename);
+		return false;
+	}
+
+	// Start a little early and throw the preroll away so the first kept frame is decoded correctly
+	std::int64_t primedStart = max(static_cast<std::int64_t>(0), start - decoder->GetSeekPreroll());
+	if (!decoder->Seek(primedStart))
+	{
+		LOG_ERROR("Failed to seek to frame {} in {}", primedStart, filename);
+		return false;
+	}
+
+	// m_pcm is only shared read-only once loading finishes, each range writes its own slice
+	float* pcm = const_cast<float*>(m_pcm->data());
+
+	std::vector<float> discard;
+	std::int64_t preroll = start - primedStart;
+	while (preroll > 0)
+	{
+		discard.resize(static_cast<std::size_t>(preroll) * channels);
+		std::size_t read = decoder->ReadFrames(discard.data(), static_cast<std::size_t>(preroll));
+		if (read == 0)
+			return false;
+		preroll -= static_cast<std::int64_t>(read);
+	}
+
+	static constexpr std::size_t READ_FRAMES = 16384;
+	std::int64_t position = start;
+	while (position < end)
+	{
+		if (cancel && cancel->load())
+			return false;
+
+		std::size_t toRead = static_cast<std::size_t>(min(static_cast<std::int64_t>(READ_FRAMES), end - position));
+		std::size_t read = decoder->ReadFrames(pcm + position * channels, toRead);
+		if (read == 0)
+		{
+			// The header's length was an estimate, the rest of the range stays silent
+			LOG_WARN("{} ended at frame {}, expected {}", filename, position, end);
+			break;
+		}
+		position += static_cast<std::int64_t>(read);
+	}
+
+	return true;
+}
+
+std::size_t MemoryDecoder::ReadFrames(float* out, std::size_t frameCount)
+{
+	if (!m_pcm)
+		return 0;
+
+	std::size_t available = static_cast<std::size_t>(m_format.frameCount - m_position);
+	std::size_t toCopy = min(frameCount, available);
+	std::memcpy(out, m_pcm->data() + m_position * m_format.channelCount, toCopy * m_format.channelCount * sizeof(float));
+	m_position += static_cast<std::int64_t>(toCopy);
+	return toCopy;
+}
+
+bool MemoryDecoder::Seek(std::int64_t frame)
+{
+	if (!m_pcm)
+		return false;
+
+	m_position = std::clamp(frame, static_cast<std::int64_t>(0), m_format.frameCount);
+	return true;
+}
+
+bool MemoryDecoder::ReadTags(Tags& tags) const
+{
+	if (!m_pcm)
+		return false;
+
+	tags = m_tags;
+	return true;
+}
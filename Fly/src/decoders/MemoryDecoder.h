@@ -0,0 +1,43 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "AudioDecoder.h"
+
+// Serves a whole track from RAM. Loading decodes the file once, splitting it into
+// independent frame ranges that are decoded in parallel, after which reads, seeks and
+// loops never touch the disk.
+class MemoryDecoder : public AudioDecoder
+{
+public:
+	// Tracks beyond this size are streamed instead, a stereo 44.1 kHz hour is ~1.2 GB of float
+	static constexpr std::size_t MAX_PRELOAD_BYTES = 512ull * 1024 * 1024;
+
+	bool Open(const std::string& filename) override;
+	void Close() override;
+
+	// Decodes everything from an already opened source decoder, which is left at an undefined position.
+	// Setting cancel makes the load give up early and return false.
+	bool Load(const std::string& filename, AudioDecoder& source, const std::atomic<bool>* cancel = nullptr);
+
+	std::size_t ReadFrames(float* out, std::size_t frameCount) override;
+	bool Seek(std::int64_t frame) override;
+
+	bool ReadTags(Tags& tags) const override;
+
+	const char* GetName() const override
+	{
+		return "memory";
+	}
+
+	static bool CanPreload(const Format& format);
+
+private:
+	bool DecodeRange(const std::string& filename, AudioDecoder* decoder, std::int64_t start, std::int64_t end, const std::atomic<bool>* cancel);
+
+	std::shared_ptr<const std::vector<float>> m_pcm;
+	std::int64_t m_position{ 0 };
+	Tags m_tags;
+};
@@ -0,0 +1,356 @@
+#include "pch.h"
+
+#include "PcmCache.h"
+
+#include <algorithm>
+#include <fstream>
+#include <lz4.h>
+#include <vector>
+
+#include "DecoderRegistry.h"
+#include "PcmCacheDecoder.h"
+
+// Hashing a whole album on every lookup would cost more than decoding it, so the key covers the
+// file size plus its first and last chunk, the modification time catches in-place edits
+static constexpr std::size_t HASH_CHUNK_BYTES = 64 * 1024;
+static constexpr const char* ENTRY_EXTENSION = ".flypcm";
+
+static std::uint64_t HashFile(const std::filesystem::path& path, std::uint64_t fileSize)
+{
+	constexpr std::uint64_t FNV_OFFSET = 14695981039346656037ull;
+	constexpr std::uint64_t FNV_PRIME = 1099511628211ull;
+
+	std::uint64_t hash = FNV_OFFSET;
+	auto mix = [&hash](const unsigned char* data, std::size_t size)
+	{
+		for (std::size_t i = 0; i < size; ++i)
+		{
+			hash = (hash ^ data[i]) * FNV_PRIME;
+		}
+	};
+
+	mix(reinterpret_cast<const unsigned char*>(&fileSize), sizeof(fileSize));
+
+	std::ifstream file(path, std::ios::binary);
+	std::vector<char> chunk(HASH_CHUNK_BYTES);
+
+	file.read(chunk.data(), static_cast<std::streamsize>(chunk.size()));
+	mix(reinterpret_cast<const unsigned char*>(chunk.data()), static_cast<std::size_t>(file.gcount()));
+
+	if (fileSize > HASH_CHUNK_BYTES)
+	{
+		file.clear();
+		file.seekg(-static_cast<std::streamoff>(min(fileSize - HASH_CHUNK_BYTES, static_cast<std::uint64_t>(HASH_CHUNK_BYTES))), std::ios::end);
+		file.read(chunk.data(), static_cast<std::streamsize>(chunk.size()));
+		mix(reinterpret_cast<const unsigned char*>(chunk.data()), static_cast<std::size_t>(file.gcount()));
+	}
+	return hash;
+}
+
+PcmCache& PcmCache::Get()
+{
+	static PcmCache instance;
+	return instance;
+}
+
+PcmCache::PcmCache()
+{
+	std::error_code error;
+	m_directory = std::filesystem::temp_directory_path(error) / "Fly" / "PcmCache";
+}
+
+PcmCache::~PcmCache()
+{
+	// Makes an in-flight Store give up instead of holding up shutdown
+	m_enabled = false;
+	m_fillQueue.terminate();
+	if (m_workerThread.joinable())
+	{
+		m_workerThread.join();
+	}
+}
+
+void PcmCache::SetEnabled(bool enabled)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_enabled = enabled;
+
+	if (!enabled)
+	{
+		m_fillQueue.clear();
+		return;
+	}
+
+	std::error_code error;
+	std::filesystem::create_directories(m_directory, error);
+	if (error)
+	{
+		LOG_ERROR("Failed to create the PCM cache directory {}: {}", m_directory.string(), error.message());
+		m_enabled = false;
+		return;
+	}
+
+	if (!m_workerThread.joinable())
+	{
+		m_workerThread = std::thread(&PcmCache::WorkerThreadFunc, this);
+		SetThreadDescription(m_workerThread.native_handle(), L"PcmCacheWorker");
+		SetThreadPriority(m_workerThread.native_handle(), THREAD_PRIORITY_IDLE);
+	}
+	LOG_INFO("PCM cache enabled in {}", m_directory.string());
+}
+
+void PcmCache::SetDirectory(const std::filesystem::path& directory)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_directory = directory;
+}
+
+void PcmCache::SetMaxBytes(std::uint64_t maxBytes)
+{
+	m_maxBytes = maxBytes;
+	if (m_enabled)
+	{
+		EnforceSizeLimit();
+	}
+}
+
+std::filesystem::path PcmCache::GetEntryPath(const std::string& filename) const
+{
+	std::error_code error;
+	std::filesystem::path source(filename);
+	std::uint64_t fileSize = std::filesystem::file_size(source, error);
+	if (error)
+		return {};
+
+	auto modified = std::filesystem::last_write_time(source, error);
+	if (error)
+		return {};
+
+	std::uint64_t hash = HashFile(source, fileSize);
+	long long modifiedTicks = static_cast<long long>(modified.time_since_epoch().count());
+	return m_directory / std::format("{:016x}-{:x}{}", hash, modifiedTicks, ENTRY_EXTENSION);
+}
+
+std::unique_ptr<AudioDecoder> PcmCache::Open(const std::string& filename)
+{
+	if (!m_enabled)
+		return nullptr;
+
+	std::filesystem::path entryPath;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		entryPath = GetEntryPath(filename);
+	}
+
+	std::error_code error;
+	if (entryPath.empty() || !std::filesystem::exists(entryPath, error))
+		return nullptr;
+
+	auto decoder = std::make_unique<PcmCacheDecoder>();
+	if (!decoder->Open(entryPath.string()))
+	{
+		std::filesystem::remove(entryPath, error);
+		return nullptr;
+	}
+
+	// Bump the entry so eviction sees it as recently used
+	std::filesystem::last_write_time(entryPath, std::filesystem::file_time_type::clock::now(), error);
+	return decoder;
+}
+
+void PcmCache::RecordPlay(const std::string& filename)
+{
+	// Counted while the cache is off too, so switching it on can fill what was already replayed
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (++m_playCounts[filename] == PLAYS_BEFORE_CACHING && m_enabled)
+	{
+		m_fillQueue.push(std::string(filename));
+	}
+}
+
+void PcmCache::QueueFill(const std::string& filename)
+{
+	if (!m_enabled)
+		return;
+
+	// Opening a file or the whole playlist lands here every time, only replayed tracks are worth the disk
+	std::lock_guard<std::mutex> lock(m_mutex);
+	auto playCount = m_playCounts.find(filename);
+	if (playCount == m_playCounts.end() || playCount->second < PLAYS_BEFORE_CACHING)
+		return;
+
+	m_fillQueue.push(std::string(filename));
+}
+
+bool PcmCache::Store(const std::string& filename)
+{
+	std::filesystem::path entryPath;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		entryPath = GetEntryPath(filename);
+	}
+
+	std::error_code error;
+	if (entryPath.empty())
+		return false;
+	if (std::filesystem::exists(entryPath, error))
+		return true;
+
+	std::unique_ptr<AudioDecoder> source = DecoderRegistry::Get().OpenUncached(filename);
+	if (!source)
+		return false;
+
+	auto start = std::chrono::steady_clock::now();
+	const AudioDecoder::Format& format = source->GetFormat();
+
+	// Written under a temporary name and renamed at the end so readers never see a partial entry
+	std::filesystem::path tempPath = entryPath;
+	tempPath += ".tmp";
+	std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+	if (!out)
+	{
+		LOG_ERROR("Failed to create PCM cache entry {}", tempPath.string());
+		return false;
+	}
+
+	PcmCacheDecoder::Header header;
+	header.magic = PcmCacheDecoder::MAGIC;
+	header.version = PcmCacheDecoder::VERSION;
+	header.channelCount = format.channelCount;
+	header.sampleRate = format.sampleRate;
+	header.blockFrames = format.sampleRate * BLOCK_SECONDS;
+	out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+	std::size_t blockSamples = static_cast<std::size_t>(header.blockFrames) * format.channelCount;
+	std::vector<float> samples(blockSamples);
+	std::vector<unsigned char> shuffled(blockSamples * sizeof(float));
+	std::vector<char> compressed(static_cast<std::size_t>(LZ4_compressBound(static_cast<int>(shuffled.size()))));
+	std::vector<PcmCacheDecoder::BlockEntry> index;
+
+	std::uint64_t offset = sizeof(header);
+	bool aborted = false;
+	while (true)
+	{
+		if (!m_enabled)
+		{
+			aborted = true;
+			break;
+		}
+
+		// Fill a whole block, decoders may return short reads before the end of the file
+		std::size_t frames = 0;
+		while (frames < header.blockFrames)
+		{
+			std::size_t read = source->ReadFrames(samples.data() + frames * format.channelCount, header.blockFrames - frames);
+			if (read == 0)
+				break;
+			frames += read;
+		}
+		if (frames == 0)
+			break;
+
+		std::size_t sampleCount = frames * format.channelCount;
+		PcmCacheDecoder::ShuffleBytes(samples.data(), sampleCount, shuffled.data());
+		int compressedSize = LZ4_compress_default(reinterpret_cast<const char*>(shuffled.data()), compressed.data(), static_cast<int>(sampleCount * sizeof(float)), static_cast<int>(compressed.size()));
+		if (compressedSize <= 0)
+		{
+			LOG_ERROR("LZ4 failed to compress a block of {}", filename);
+			aborted = true;
+			break;
+		}
+
+		out.write(compressed.data(), compressedSize);
+		index.push_back({ offset, static_cast<std::uint32_t>(compressedSize), static_cast<std::uint32_t>(frames) });
+		offset += static_cast<std::uint64_t>(compressedSize);
+		header.frameCount += static_cast<std::int64_t>(frames);
+	}
+
+	if (!aborted)
+	{
+		header.blockCount = index.size();
+		header.indexOffset = offset;
+		out.write(reinterpret_cast<const char*>(index.data()), static_cast<std::streamsize>(index.size() * sizeof(PcmCacheDecoder::BlockEntry)));
+		out.seekp(0);
+		out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	}
+	out.close();
+
+	if (aborted || !out || header.frameCount == 0)
+	{
+		std::filesystem::remove(tempPath, error);
+		return false;
+	}
+
+	std::filesystem::rename(tempPath, entryPath, error);
+	if (error)
+	{
+		LOG_ERROR("Failed to finalize PCM cache entry {}: {}", entryPath.string(), error.message());
+		std::filesystem::remove(tempPath, error);
+		return false;
+	}
+
+	[[maybe_unused]] auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+	[[maybe_unused]] double ratio = static_cast<double>(offset) / (static_cast<double>(header.frameCount) * format.channelCount * sizeof(float));
+	LOG_INFO("Cached {} ({} frames, {:.0f}% of raw size) in {} ms", filename, header.frameCount, ratio * 100.0, elapsed.count());
+
+	EnforceSizeLimit();
+	return true;
+}
+
+void PcmCache::EnforceSizeLimit()
+{
+	struct Entry
+	{
+		std::filesystem::path path;
+		std::uint64_t size;
+		std::filesystem::file_time_type lastUsed;
+	};
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	std::vector<Entry> entries;
+	std::uint64_t totalBytes = 0;
+	std::error_code error;
+	for (const auto& file: std::filesystem::directory_iterator(m_directory, error))
+	{
+		if (file.path().extension() != ENTRY_EXTENSION)
+			continue;
+
+		Entry entry{ file.path(), file.file_size(error), file.last_write_time(error) };
+		if (error)
+			continue;
+
+		totalBytes += entry.size;
+		entries.push_back(std::move(entry));
+	}
+
+	if (totalBytes <= m_maxBytes)
+		return;
+
+	// Least recently used first
+	std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) { return a.lastUsed < b.lastUsed; });
+
+	for (const Entry& entry: entries)
+	{
+		if (totalBytes <= m_maxBytes)
+			break;
+
+		if (std::filesystem::remove(entry.path, error))
+		{
+			totalBytes -= entry.size;
+			LOG_DEBUG("Evicted PCM cache entry {}", entry.path.string());
+		}
+	}
+}
+
+void PcmCache::WorkerThreadFunc()
+{
+	std::string filename;
+	while (m_fillQueue.pop(filename))
+	{
+		if (m_enabled)
+		{
+			Store(filename);
+		}
+	}
+}
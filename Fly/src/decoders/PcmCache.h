@@ -0,0 +1,69 @@
+#pragma once
+
+#include <atomic>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+#include "AudioDecoder.h"
+#include "containers/ThreadSafeQueue.h"
+
+// Optional on-disk cache of decoded PCM for heavily replayed tracks. Entries are keyed by a hash
+// of the source file and its modification time, so edited files miss naturally, and the total
+// size is bounded with least-recently-used eviction (an entry's file time is bumped on every hit).
+// Entries are written by a single idle-priority worker, never on the streaming thread.
+class PcmCache
+{
+public:
+	// Plays of the same file before it is worth caching
+	static constexpr unsigned int PLAYS_BEFORE_CACHING = 2;
+	static constexpr std::uint64_t DEFAULT_MAX_BYTES = 4ull * 1024 * 1024 * 1024;
+	static constexpr unsigned int BLOCK_SECONDS = 1;
+
+	static PcmCache& Get();
+
+	~PcmCache();
+
+	void SetEnabled(bool enabled);
+
+	bool IsEnabled() const
+	{
+		return m_enabled;
+	}
+
+	void SetDirectory(const std::filesystem::path& directory);
+	void SetMaxBytes(std::uint64_t maxBytes);
+
+	// Returns a decoder over the cached PCM of filename, or nullptr on a miss
+	std::unique_ptr<AudioDecoder> Open(const std::string& filename);
+
+	// Counts a playback of filename and queues it for caching once it has been replayed enough
+	void RecordPlay(const std::string& filename);
+
+	// Queues filename to be decoded into the cache in the background, used to fill it while idle.
+	// Files played fewer than PLAYS_BEFORE_CACHING times are skipped
+	void QueueFill(const std::string& filename);
+
+	// Decodes filename into the cache on the calling thread
+	bool Store(const std::string& filename);
+
+private:
+	PcmCache();
+
+	std::filesystem::path GetEntryPath(const std::string& filename) const;
+	void EnforceSizeLimit();
+	void WorkerThreadFunc();
+
+	std::atomic<bool> m_enabled{ false };
+	std::filesystem::path m_directory;
+	std::atomic<std::uint64_t> m_maxBytes{ DEFAULT_MAX_BYTES };
+
+	std::mutex m_mutex; // Guards the directory, play counts and worker startup
+	std::unordered_map<std::string, unsigned int> m_playCounts;
+
+	ThreadSafeQueue<std::string> m_fillQueue;
+	std::thread m_workerThread;
+};
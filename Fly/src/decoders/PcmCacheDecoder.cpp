@@ -0,0 +1,154 @@
+#include "pch.h"
+
+#include "PcmCacheDecoder.h"
+
+#include <cstring>
+#include <lz4.h>
+
+void PcmCacheDecoder::ShuffleBytes(const float* samples, std::size_t sampleCount, unsigned char* out)
+{
+	const unsigned char* bytes = reinterpret_cast<const unsigned char*>(samples);
+	for (std::size_t plane = 0; plane < sizeof(float); ++plane)
+	{
+		unsigned char* planeOut = out + plane * sampleCount;
+		for (std::size_t i = 0; i < sampleCount; ++i)
+		{
+			planeOut[i] = bytes[i * sizeof(float) + plane];
+		}
+	}
+}
+
+void PcmCacheDecoder::UnshuffleBytes(const unsigned char* in, std::size_t sampleCount, float* samples)
+{
+	unsigned char* bytes = reinterpret_cast<unsigned char*>(samples);
+	for (std::size_t plane = 0; plane < sizeof(float); ++plane)
+	{
+		const unsigned char* planeIn = in + plane * sampleCount;
+		for (std::size_t i = 0; i < sampleCount; ++i)
+		{
+			bytes[i * sizeof(float) + plane] = planeIn[i];
+		}
+	}
+}
+
+PcmCacheDecoder::~PcmCacheDecoder()
+{
+	Close();
+}
+
+bool PcmCacheDecoder::Open(const std::string& filename)
+{
+	Close();
+
+	m_file.open(filename, std::ios::binary);
+	if (!m_file)
+		return false;
+
+	Header header;
+	m_file.read(reinterpret_cast<char*>(&header), sizeof(header));
+	if (!m_file || header.magic != MAGIC || header.version != VERSION || header.channelCount == 0 || header.blockFrames == 0)
+	{
+		LOG_WARN("Ignoring invalid PCM cache entry {}", filename);
+		Close();
+		return false;
+	}
+
+	m_index.resize(static_cast<std::size_t>(header.blockCount));
+	m_file.seekg(static_cast<std::streamoff>(header.indexOffset));
+	m_file.read(reinterpret_cast<char*>(m_index.data()), static_cast<std::streamsize>(m_index.size() * sizeof(BlockEntry)));
+	if (!m_file)
+	{
+		LOG_WARN("PCM cache entry {} is truncated", filename);
+		Close();
+		return false;
+	}
+
+	m_blockFrames = header.blockFrames;
+	m_format.channelCount = header.channelCount;
+	m_format.sampleRate = header.sampleRate;
+	m_format.frameCount = header.frameCount;
+
+	std::size_t blockSamples = static_cast<std::size_t>(m_blockFrames) * m_format.channelCount;
+	m_block.resize(blockSamples);
+	m_shuffled.resize(blockSamples * sizeof(float));
+	return true;
+}
+
+void PcmCacheDecoder::Close()
+{
+	if (m_file.is_open())
+	{
+		m_file.close();
+	}
+	m_file.clear();
+	m_index.clear();
+	m_blockFrames = 0;
+	m_position = 0;
+	m_loadedBlock = (std::numeric_limits<std::size_t>::max)();
+	m_format = {};
+}
+
+bool PcmCacheDecoder::LoadBlock(std::size_t block)
+{
+	if (block == m_loadedBlock)
+		return true;
+
+	const BlockEntry& entry = m_index[block];
+	m_compressed.resize(entry.compressedSize);
+	m_file.clear();
+	m_file.seekg(static_cast<std::streamoff>(entry.offset));
+	m_file.read(m_compressed.data(), entry.compressedSize);
+	if (!m_file)
+	{
+		LOG_ERROR("Failed to read PCM cache block {}", block);
+		return false;
+	}
+
+	int expectedBytes = static_cast<int>(static_cast<std::size_t>(entry.frameCount) * m_format.channelCount * sizeof(float));
+	int bytes = LZ4_decompress_safe(m_compressed.data(), reinterpret_cast<char*>(m_shuffled.data()), static_cast<int>(entry.compressedSize), expectedBytes);
+	if (bytes != expectedBytes)
+	{
+		LOG_ERROR("PCM cache block {} is corrupt", block);
+		return false;
+	}
+
+	UnshuffleBytes(m_shuffled.data(), static_cast<std::size_t>(entry.frameCount) * m_format.channelCount, m_block.data());
+	m_loadedBlock = block;
+	return true;
+}
+
+std::size_t PcmCacheDecoder::ReadFrames(float* out, std::size_t frameCount)
+{
+	if (!IsOpen())
+		return 0;
+
+	std::size_t framesRead = 0;
+	while (framesRead < frameCount && m_position < m_format.frameCount)
+	{
+		std::size_t block = static_cast<std::size_t>(m_position / m_blockFrames);
+		if (block >= m_index.size() || !LoadBlock(block))
+			break;
+
+		std::size_t offset = static_cast<std::size_t>(m_position % m_blockFrames);
+		std::size_t available = m_index[block].frameCount - min(offset, static_cast<std::size_t>(m_index[block].frameCount));
+		if (available == 0)
+			break;
+
+		std::size_t count = min(frameCount - framesRead, available);
+		std::memcpy(out + framesRead * m_format.channelCount, m_block.data() + offset * m_format.channelCount, count * m_format.channelCount * sizeof(float));
+
+		framesRead += count;
+		m_position += static_cast<std::int64_t>(count);
+	}
+	return framesRead;
+}
+
+bool PcmCacheDecoder::Seek(std::int64_t frame)
+{
+	if (!IsOpen() || frame < 0 || frame > m_format.frameCount)
+		return false;
+
+	// Every frame is stored verbatim, so seeks are exact and only cost at most one block inflate
+	m_position = frame;
+	return true;
+}
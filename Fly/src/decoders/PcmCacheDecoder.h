@@ -0,0 +1,69 @@
+#pragma once
+
+#include <array>
+#include <fstream>
+#include <limits>
+#include <vector>
+
+#include "AudioDecoder.h"
+
+// Reads a decoded PCM cache entry written by PcmCache. The file holds fixed-duration blocks of
+// interleaved float frames, each byte-plane shuffled and LZ4 compressed, followed by a block
+// index, so any frame can be reached by inflating a single block.
+class PcmCacheDecoder : public AudioDecoder
+{
+public:
+	static constexpr std::array<char, 8> MAGIC = { 'F', 'L', 'Y', 'P', 'C', 'M', '\0', '\1' };
+	static constexpr std::uint32_t VERSION = 1;
+
+	struct Header
+	{
+		std::array<char, 8> magic{};
+		std::uint32_t version{ 0 };
+		std::uint32_t channelCount{ 0 };
+		std::uint32_t sampleRate{ 0 };
+		std::uint32_t blockFrames{ 0 };
+		std::int64_t frameCount{ 0 };
+		std::uint64_t blockCount{ 0 };
+		std::uint64_t indexOffset{ 0 };
+	};
+
+	struct BlockEntry
+	{
+		std::uint64_t offset{ 0 };
+		std::uint32_t compressedSize{ 0 };
+		std::uint32_t frameCount{ 0 };
+	};
+
+	// Groups the n-th byte of every sample together, the sign/exponent bytes of neighbouring
+	// samples are nearly identical which gives LZ4 long runs to work with
+	static void ShuffleBytes(const float* samples, std::size_t sampleCount, unsigned char* out);
+	static void UnshuffleBytes(const unsigned char* in, std::size_t sampleCount, float* samples);
+
+	~PcmCacheDecoder() override;
+
+	bool Open(const std::string& filename) override;
+	void Close() override;
+
+	std::size_t ReadFrames(float* out, std::size_t frameCount) override;
+	bool Seek(std::int64_t frame) override;
+
+	const char* GetName() const override
+	{
+		return "pcm_cache";
+	}
+
+private:
+	bool LoadBlock(std::size_t block);
+
+	std::ifstream m_file;
+	std::vector<BlockEntry> m_index;
+	std::uint32_t m_blockFrames{ 0 };
+	std::int64_t m_position{ 0 };
+
+	// Scratch for the block currently being read from
+	std::vector<char> m_compressed;
+	std::vector<unsigned char> m_shuffled;
+	std::vector<float> m_block;
+	std::size_t m_loadedBlock{ (std::numeric_limits<std::size_t>::max)() };
+};
@@ -0,0 +1,79 @@
+#include "pch.h"
+
+#include "SndFileDecoder.h"
+
+SndFileDecoder::~SndFileDecoder()
+{
+	Close();
+}
+
+bool SndFileDecoder::Open(const std::string& filename)
+{
+	Close();
+
+	m_file = sf_open(filename.c_str(), SFM_READ, &m_fileInfo);
+	if (!m_file)
+	{
+		LOG_WARN("libsndfile failed to open {}: {}", filename, sf_strerror(nullptr));
+		return false;
+	}
+
+	m_format.channelCount = static_cast<unsigned int>(m_fileInfo.channels);
+	m_format.sampleRate = static_cast<unsigned int>(m_fileInfo.samplerate);
+	m_format.frameCount = m_fileInfo.frames;
+	return true;
+}
+
+void SndFileDecoder::Close()
+{
+	if (m_file)
+	{
+		sf_close(m_file);
+		m_file = nullptr;
+	}
+	std::memset(&m_fileInfo, 0, sizeof(SF_INFO));
+	m_format = {};
+}
+
+std::size_t SndFileDecoder::ReadFrames(float* out, std::size_t frameCount)
+{
+	if (!m_file)
+		return 0;
+
+	sf_count_t framesRead = sf_readf_float(m_file, out, static_cast<sf_count_t>(frameCount));
+	return framesRead > 0 ? static_cast<std::size_t>(framesRead) : 0;
+}
+
+bool SndFileDecoder::Seek(std::int64_t frame)
+{
+	if (!m_file)
+		return false;
+
+	frame = std::clamp(frame, static_cast<std::int64_t>(0), static_cast<std::int64_t>(m_fileInfo.frames));
+	return sf_seek(m_file, frame, SEEK_SET) >= 0;
+}
+
+std::int64_t SndFileDecoder::GetSeekPreroll() const
+{
+	// Only MPEG streams carry decoder state across frames, PCM and FLAC frames are independent
+	return (m_fileInfo.format & SF_FORMAT_TYPEMASK) == SF_FORMAT_MPEG ? 2 * MP3_FRAME_SAMPLES : 0;
+}
+
+bool SndFileDecoder::ReadTags(Tags& tags) const
+{
+	if (!m_file)
+		return false;
+
+	auto readString = [this](int type) -> std::string
+	{
+		const char* value = sf_get_string(m_file, type);
+		return value ? value : "";
+	};
+
+	tags.title = readString(SF_STR_TITLE);
+	tags.artist = readString(SF_STR_ARTIST);
+	tags.album = readString(SF_STR_ALBUM);
+	tags.genre = readString(SF_STR_GENRE);
+	tags.year = readString(SF_STR_DATE);
+	return true;
+}
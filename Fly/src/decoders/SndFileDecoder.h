@@ -0,0 +1,30 @@
+#pragma once
+
+#include <sndfile.h>
+
+#include "AudioDecoder.h"
+
+// Generic fallback backend, handles every format libsndfile was built with
+class SndFileDecoder : public AudioDecoder
+{
+public:
+	~SndFileDecoder() override;
+
+	bool Open(const std::string& filename) override;
+	void Close() override;
+
+	std::size_t ReadFrames(float* out, std::size_t frameCount) override;
+	bool Seek(std::int64_t frame) override;
+	std::int64_t GetSeekPreroll() const override;
+
+	bool ReadTags(Tags& tags) const override;
+
+	const char* GetName() const override
+	{
+		return "libsndfile";
+	}
+
+private:
+	SNDFILE* m_file{ nullptr };
+	SF_INFO m_fileInfo{};
+};
@@ -0,0 +1,137 @@
+#include "pch.h"
+
+#include "BiquadCascade.h"
+
+#include <emmintrin.h>
+#include <pmmintrin.h>
+
+void BiquadCascade::Configure(unsigned int channels, std::size_t sections)
+{
+	m_channels = channels;
+	m_sections = sections;
+	m_groups = (channels + 3) / 4;
+
+	m_coefficients.resize(sections);
+	m_enabled.clear();
+	m_enabled.reserve(sections);
+	for (std::size_t i = 0; i < sections; i++)
+	{
+		SetSection(i, BiquadCoefficients{});
+		m_enabled.push_back(i);
+	}
+
+	m_state.assign(m_groups * sections, State{ _mm_setzero_ps(), _mm_setzero_ps() });
+}
+
+void BiquadCascade::SetSection(std::size_t section, const BiquadCoefficients& c)
+{
+	if (section >= m_sections)
+		return;
+
+	m_coefficients[section] = { _mm_set1_ps(c.b0), _mm_set1_ps(c.b1), _mm_set1_ps(c.b2), _mm_set1_ps(c.a1), _mm_set1_ps(c.a2) };
+}
+
+void BiquadCascade::SetSectionEnabled(std::size_t section, bool enabled)
+{
+	if (section >= m_sections)
+		return;
+
+	auto position = std::lower_bound(m_enabled.begin(), m_enabled.end(), section);
+	const bool isEnabled = position != m_enabled.end() && *position == section;
+	if (enabled == isEnabled)
+		return;
+
+	if (!enabled)
+	{
+		m_enabled.erase(position);
+		return;
+	}
+
+	// Capacity was reserved for every section, so this never allocates
+	m_enabled.insert(position, section);
+	for (std::size_t group = 0; group < m_groups; group++)
+	{
+		m_state[group * m_sections + section] = State{ _mm_setzero_ps(), _mm_setzero_ps() };
+	}
+}
+
+void BiquadCascade::Reset()
+{
+	std::fill(m_state.begin(), m_state.end(), State{ _mm_setzero_ps(), _mm_setzero_ps() });
+}
+
+__m128 BiquadCascade::Tick(__m128 x, State* state) const
+{
+	for (std::size_t i: m_enabled)
+	{
+		const Section& c = m_coefficients[i];
+		__m128& s1 = state[i].s1;
+		__m128& s2 = state[i].s2;
+
+		// y = b0 x + s1, s1 = b1 x - a1 y + s2, s2 = b2 x - a2 y
+		__m128 y = _mm_add_ps(_mm_mul_ps(c.b0, x), s1);
+		s1 = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(c.b1, x), _mm_mul_ps(c.a1, y)), s2);
+		s2 = _mm_sub_ps(_mm_mul_ps(c.b2, x), _mm_mul_ps(c.a2, y));
+		x = y;
+	}
+	return x;
+}
+
+void BiquadCascade::Process(float* samples, std::size_t frameCount)
+{
+	if (m_enabled.empty() || m_channels == 0)
+		return;
+
+	// Flush denormals whatever the caller's mode, the state decays into them after every fade and
+	// each one costs a microcode assist per section
+	const unsigned int csr = _mm_getcsr();
+	_mm_setcsr(csr | _MM_FLUSH_ZERO_ON | _MM_DENORMALS_ZERO_ON);
+
+	const unsigned int channels = m_channels;
+
+	// The common layouts load straight from the interleaved buffer, the rest go through a padded register
+	if (channels == 2)
+	{
+		State* state = m_state.data();
+		for (std::size_t frame = 0; frame < frameCount; frame++)
+		{
+			double* pair = reinterpret_cast<double*>(samples + frame * 2);
+			__m128 x = _mm_castpd_ps(_mm_load_sd(pair));
+			_mm_store_sd(pair, _mm_castps_pd(Tick(x, state)));
+		}
+	}
+	else if (channels == 1)
+	{
+		State* state = m_state.data();
+		for (std::size_t frame = 0; frame < frameCount; frame++)
+		{
+			_mm_store_ss(samples + frame, Tick(_mm_load_ss(samples + frame), state));
+		}
+	}
+	else
+	{
+		for (std::size_t frame = 0; frame < frameCount; frame++)
+		{
+			float* input = samples + frame * channels;
+			for (std::size_t group = 0; group < m_groups; group++)
+			{
+				State* state = m_state.data() + group * m_sections;
+				float* lanes = input + group * 4;
+				const unsigned int laneCount = min(4u, channels - static_cast<unsigned int>(group) * 4);
+
+				if (laneCount == 4)
+				{
+					_mm_storeu_ps(lanes, Tick(_mm_loadu_ps(lanes), state));
+					continue;
+				}
+
+				alignas(16) float padded[4] = {};
+				std::copy_n(lanes, laneCount, padded);
+				_mm_store_ps(padded, Tick(_mm_load_ps(padded), state));
+				std::copy_n(padded, laneCount, lanes);
+			}
+		}
+	}
+
+	_mm_setcsr(csr);
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include <xmmintrin.h>
+
+// Normalized biquad coefficients, a0 == 1
+struct BiquadCoefficients
+{
+	float b0{ 1 }, b1{ 0 }, b2{ 0 }, a1{ 0 }, a2{ 0 };
+};
+
+// A chain of biquad sections run over interleaved audio of any channel count. Channels are
+// processed four at a time in SSE lanes, so each section costs the same for one to four
+// channels. Sections are transposed direct form II, which needs two state values per
+// channel and holds up well when coefficients change between blocks. State is stored
+// structure-of-arrays, one register per lane group per section.
+class BiquadCascade
+{
+public:
+	// Allocates state for the layout and resets it, every section starts as a pass-through
+	void Configure(unsigned int channels, std::size_t sections);
+
+	// The same filter for every channel. Safe to call between Process calls, state is kept
+	void SetSection(std::size_t section, const BiquadCoefficients& coefficients);
+
+	// A disabled section is skipped entirely, so the cost of a pass scales with the enabled ones.
+	// Re-enabling a section clears its state rather than resuming from stale history
+	void SetSectionEnabled(std::size_t section, bool enabled);
+
+	void Reset();
+
+	// In place over frameCount interleaved frames
+	void Process(float* samples, std::size_t frameCount);
+
+	unsigned int GetChannelCount() const
+	{
+		return m_channels;
+	}
+
+	std::size_t GetSectionCount() const
+	{
+		return m_sections;
+	}
+
+	std::size_t GetEnabledSectionCount() const
+	{
+		return m_enabled.size();
+	}
+
+private:
+	struct Section
+	{
+		__m128 b0, b1, b2, a1, a2;
+	};
+
+	struct State
+	{
+		__m128 s1, s2;
+	};
+
+	// Runs every enabled section over one register of four channels
+	__m128 Tick(__m128 x, State* state) const;
+
+	unsigned int m_channels = 0;
+	std::size_t m_sections = 0;
+	std::size_t m_groups = 0;
+	std::vector<Section> m_coefficients;
+	std::vector<State> m_state; // [group][section]
+	std::vector<std::size_t> m_enabled; // Section indices in processing order
+};
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "BiquadCascade.h"
+#include "FastMath.h"
+
+// Audio EQ cookbook (R. Bristow-Johnson) designs, normalized for BiquadCascade. Frequencies are
+// in Hz and must be below Nyquist, Q sets the bandwidth and gains are in dB.
+namespace BiquadDesign
+{
+	namespace Detail
+	{
+		struct Prototype
+		{
+			float cosW;
+			float alpha;
+		};
+
+		inline Prototype Warp(float frequency, float q, float sampleRate)
+		{
+			float sinW, cosW;
+			FastMath::SinCos(2.0f * M_PI * frequency / sampleRate, sinW, cosW);
+			return { cosW, sinW / (2.0f * q) };
+		}
+
+		inline BiquadCoefficients Normalize(float b0, float b1, float b2, float a0, float a1, float a2)
+		{
+			const float norm = 1.0f / a0;
+			return { b0 * norm, b1 * norm, b2 * norm, a1 * norm, a2 * norm };
+		}
+	}
+
+	inline BiquadCoefficients Peak(float frequency, float q, float gainDb, float sampleRate)
+	{
+		auto [cosW, alpha] = Detail::Warp(frequency, q, sampleRate);
+		const float A = FastMath::DbToLinear(gainDb * 0.5f);
+		return Detail::Normalize(1.0f + alpha * A, -2.0f * cosW, 1.0f - alpha * A, 1.0f + alpha / A, -2.0f * cosW, 1.0f - alpha / A);
+	}
+
+	inline BiquadCoefficients LowShelf(float frequency, float q, float gainDb, float sampleRate)
+	{
+		auto [cosW, alpha] = Detail::Warp(frequency, q, sampleRate);
+		const float A = FastMath::DbToLinear(gainDb * 0.5f);
+		const float ap1 = A + 1.0f;
+		const float am1 = A - 1.0f;
+		const float beta = 2.0f * std::sqrt(A) * alpha;
+		return Detail::Normalize(A * (ap1 - am1 * cosW + beta), 2.0f * A * (am1 - ap1 * cosW), A * (ap1 - am1 * cosW - beta),
+		                         ap1 + am1 * cosW + beta, -2.0f * (am1 + ap1 * cosW), ap1 + am1 * cosW - beta);
+	}
+
+	inline BiquadCoefficients HighShelf(float frequency, float q, float gainDb, float sampleRate)
+	{
+		auto [cosW, alpha] = Detail::Warp(frequency, q, sampleRate);
+		const float A = FastMath::DbToLinear(gainDb * 0.5f);
+		const float ap1 = A + 1.0f;
+		const float am1 = A - 1.0f;
+		const float beta = 2.0f * std::sqrt(A) * alpha;
+		return Detail::Normalize(A * (ap1 + am1 * cosW + beta), -2.0f * A * (am1 + ap1 * cosW), A * (ap1 + am1 * cosW - beta),
+		                         ap1 - am1 * cosW + beta, 2.0f * (am1 - ap1 * cosW), ap1 - am1 * cosW - beta);
+	}
+
+	inline BiquadCoefficients Notch(float frequency, float q, float sampleRate)
+	{
+		auto [cosW, alpha] = Detail::Warp(frequency, q, sampleRate);
+		return Detail::Normalize(1.0f, -2.0f * cosW, 1.0f, 1.0f + alpha, -2.0f * cosW, 1.0f - alpha);
+	}
+
+	inline BiquadCoefficients LowPass(float frequency, float q, float sampleRate)
+	{
+		auto [cosW, alpha] = Detail::Warp(frequency, q, sampleRate);
+		const float b = (1.0f - cosW) * 0.5f;
+		return Detail::Normalize(b, 2.0f * b, b, 1.0f + alpha, -2.0f * cosW, 1.0f - alpha);
+	}
+
+	inline BiquadCoefficients HighPass(float frequency, float q, float sampleRate)
+	{
+		auto [cosW, alpha] = Detail::Warp(frequency, q, sampleRate);
+		const float b = (1.0f + cosW) * 0.5f;
+		return Detail::Normalize(b, -2.0f * b, b, 1.0f + alpha, -2.0f * cosW, 1.0f - alpha);
+	}
+}
@@ -0,0 +1,140 @@
+#include "pch.h"
+
+#include "FFTPlan.h"
+
+#include <numbers>
+#include <stdexcept>
+
+FFTPlan::FFTPlan(std::size_t size)
+      : m_size(size), m_half(size / 2)
+{
+	if (size < 2 || (size & (size - 1)) != 0)
+	{
+		throw std::invalid_argument("FFT size must be a power of two");
+	}
+
+	// Tables are built in double so large sizes don't accumulate rounding error
+	unsigned int bits = 0;
+	while ((std::size_t(1) << bits) < m_half)
+	{
+		bits++;
+	}
+
+	m_bitReverse.resize(m_half);
+	for (std::size_t i = 0; i < m_half; ++i)
+	{
+		std::uint32_t reversed = 0;
+		for (unsigned int bit = 0; bit < bits; ++bit)
+		{
+			reversed |= static_cast<std::uint32_t>((i >> bit) & 1) << (bits - 1 - bit);
+		}
+		m_bitReverse[i] = reversed;
+	}
+
+	m_twiddleRe.resize(m_half);
+	m_twiddleIm.resize(m_half);
+	for (std::size_t span = 1; span < m_half; span <<= 1)
+	{
+		for (std::size_t j = 0; j < span; ++j)
+		{
+			double angle = -std::numbers::pi * static_cast<double>(j) / static_cast<double>(span);
+			m_twiddleRe[span + j] = static_cast<float>(std::cos(angle));
+			m_twiddleIm[span + j] = static_cast<float>(std::sin(angle));
+		}
+	}
+
+	m_splitTwiddles.resize(m_half);
+	for (std::size_t k = 0; k < m_half; ++k)
+	{
+		double angle = -2.0 * std::numbers::pi * static_cast<double>(k) / static_cast<double>(m_size);
+		m_splitTwiddles[k] = { static_cast<float>(std::cos(angle)), static_cast<float>(std::sin(angle)) };
+	}
+
+	m_re.resize(m_half);
+	m_im.resize(m_half);
+}
+
+void FFTPlan::Transform(bool inverse)
+{
+	float* re = m_re.data();
+	float* im = m_im.data();
+	const float sign = inverse ? -1.0f : 1.0f;
+
+	for (std::size_t span = 1; span < m_half; span <<= 1)
+	{
+		const float* twiddleRe = m_twiddleRe.data() + span;
+		const float* twiddleIm = m_twiddleIm.data() + span;
+
+		for (std::size_t block = 0; block < m_half; block += span * 2)
+		{
+			float* aRe = re + block;
+			float* aIm = im + block;
+			float* bRe = aRe + span;
+			float* bIm = aIm + span;
+
+			for (std::size_t j = 0; j < span; ++j)
+			{
+				float wRe = twiddleRe[j];
+				float wIm = twiddleIm[j] * sign;
+				float vRe = bRe[j] * wRe - bIm[j] * wIm;
+				float vIm = bRe[j] * wIm + bIm[j] * wRe;
+				bRe[j] = aRe[j] - vRe;
+				bIm[j] = aIm[j] - vIm;
+				aRe[j] += vRe;
+				aIm[j] += vIm;
+			}
+		}
+	}
+}
+
+void FFTPlan::Forward(const float* in, std::complex<float>* out)
+{
+	// Pack pairs of real samples into complex values, scattering straight into bit-reversed order
+	for (std::size_t i = 0; i < m_half; ++i)
+	{
+		std::uint32_t target = m_bitReverse[i];
+		m_re[target] = in[2 * i];
+		m_im[target] = in[2 * i + 1];
+	}
+
+	Transform(false);
+
+	// Split the packed spectrum into the transforms of the even and odd samples and recombine them
+	out[0] = { m_re[0] + m_im[0], 0.0f };
+	out[m_half] = { m_re[0] - m_im[0], 0.0f };
+	for (std::size_t k = 1; k < m_half; ++k)
+	{
+		std::complex<float> z(m_re[k], m_im[k]);
+		std::complex<float> mirrored(m_re[m_half - k], -m_im[m_half - k]);
+
+		std::complex<float> even = (z + mirrored) * 0.5f;
+		std::complex<float> odd = (z - mirrored) * std::complex<float>(0.0f, -0.5f);
+		out[k] = even + m_splitTwiddles[k] * odd;
+	}
+}
+
+void FFTPlan::Inverse(const std::complex<float>* in, float* out)
+{
+	// Undo the split, rebuilding the packed half-size spectrum in bit-reversed order
+	for (std::size_t k = 0; k < m_half; ++k)
+	{
+		std::complex<float> mirrored = std::conj(in[m_half - k]);
+
+		std::complex<float> even = (in[k] + mirrored) * 0.5f;
+		std::complex<float> odd = (in[k] - mirrored) * 0.5f * std::conj(m_splitTwiddles[k]);
+		std::complex<float> z = even + std::complex<float>(0.0f, 1.0f) * odd;
+
+		std::uint32_t target = m_bitReverse[k];
+		m_re[target] = z.real();
+		m_im[target] = z.imag();
+	}
+
+	Transform(true);
+
+	const float scale = 1.0f / static_cast<float>(m_half);
+	for (std::size_t i = 0; i < m_half; ++i)
+	{
+		out[2 * i] = m_re[i] * scale;
+		out[2 * i + 1] = m_im[i] * scale;
+	}
+}
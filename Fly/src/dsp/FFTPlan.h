@@ -0,0 +1,49 @@
+#pragma once
+
+#include <complex>
+#include <cstdint>
+#include <vector>
+
+// Precomputed real-input FFT of a fixed power-of-two size. The real signal is packed into a
+// complex transform of half the size (even samples real, odd samples imaginary), which is
+// then split into the positive-frequency half of the spectrum. Bit-reversal and twiddle
+// tables are built once, and the butterflies run on split real/imaginary arrays with
+// per-stage contiguous twiddles so the inner loops vectorize.
+// A plan owns its scratch memory, so use one plan per thread.
+class FFTPlan
+{
+public:
+	explicit FFTPlan(std::size_t size);
+
+	std::size_t GetSize() const
+	{
+		return m_size;
+	}
+
+	// Number of bins produced by Forward, DC to Nyquist inclusive
+	std::size_t GetBinCount() const
+	{
+		return m_size / 2 + 1;
+	}
+
+	// Transforms size real samples into GetBinCount() complex bins
+	void Forward(const float* in, std::complex<float>* out);
+
+	// Transforms GetBinCount() bins back into size real samples, scaled so Inverse(Forward(x)) == x
+	void Inverse(const std::complex<float>* in, float* out);
+
+private:
+	// In-place complex transform of the half-size work arrays, which are already in bit-reversed order
+	void Transform(bool inverse);
+
+	std::size_t m_size;
+	std::size_t m_half;
+
+	std::vector<std::uint32_t> m_bitReverse;
+	std::vector<float> m_twiddleRe; // Stage with butterfly span h uses entries [h, 2h)
+	std::vector<float> m_twiddleIm;
+	std::vector<std::complex<float>> m_splitTwiddles; // exp(-2 pi i k / size), for unpacking the real spectrum
+
+	std::vector<float> m_re;
+	std::vector<float> m_im;
+};
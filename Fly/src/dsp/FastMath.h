@@ -0,0 +1,261 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include <emmintrin.h>
+
+// Bounded-error replacements for the libm calls in the per-sample and per-band paths, each with
+// an SSE2 variant working on four floats and an array form on top of that. Arguments are clamped
+// to the float range rather than producing inf/NaN.
+//
+// Maximum errors against libm in double precision, checked by FlyTests (tests/FastMathTests.cpp):
+//   Exp2          relative 1.2e-7, x in [-126, 126]
+//   Log2          absolute 1.5e-7 for x in [0.5, 2], relative 1e-7 elsewhere (normal x > 0,
+//                 denormals read as 2^-126)
+//   Pow           relative 1.5e-6 for x in [0.01, 100], y in [-3, 3]
+//   DbToLinear    relative 8e-7 for -120 to +20 dB
+//   LinearToDb    absolute 1.5e-5 dB for 1e-6 to 10, PowerToDb half that
+//   Tanh          absolute 1.2e-7
+//   SinCos        absolute 5e-7 for |x| < 8192
+// Roughly 6x the throughput of std::tanh in the array form.
+namespace FastMath
+{
+	inline constexpr float LOG2_10 = 3.32192809488736f;
+	inline constexpr float LOG2_E = 1.44269504088896f;
+	inline constexpr float DB_PER_LOG2 = 6.02059991327962f; // 20 * log10(2)
+
+	// ---- Four lanes ----
+
+	// 2^x, x clamped to [-126, 126]
+	inline __m128 Exp2(__m128 x)
+	{
+		x = _mm_min_ps(_mm_max_ps(x, _mm_set1_ps(-126.0f)), _mm_set1_ps(126.0f));
+
+		// Split into the nearest integer and a fraction in [-0.5, 0.5]
+		__m128i whole = _mm_cvtps_epi32(x);
+		__m128 f = _mm_sub_ps(x, _mm_cvtepi32_ps(whole));
+
+		// 2^f, Cephes exp2f polynomial
+		__m128 p = _mm_set1_ps(1.535336188319500e-4f);
+		p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(1.339887440266574e-3f));
+		p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(9.618437357674640e-3f));
+		p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(5.550332471162809e-2f));
+		p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(2.402264791363012e-1f));
+		p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(6.931472028550421e-1f));
+		p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(1.0f));
+
+		// Scale by 2^whole through the exponent bits
+		__m128i scale = _mm_slli_epi32(_mm_add_epi32(whole, _mm_set1_epi32(127)), 23);
+		return _mm_mul_ps(p, _mm_castsi128_ps(scale));
+	}
+
+	// log2(x) for x > 0
+	inline __m128 Log2(__m128 x)
+	{
+		x = _mm_max_ps(x, _mm_set1_ps(1.17549435e-38f));
+
+		// x = m * 2^e with m in [sqrt(0.5), sqrt(2)) keeps the series argument small
+		__m128i bits = _mm_castps_si128(x);
+		__m128i exponent = _mm_sub_epi32(_mm_srli_epi32(bits, 23), _mm_set1_epi32(127));
+		__m128 m = _mm_castsi128_ps(_mm_or_si128(_mm_and_si128(bits, _mm_set1_epi32(0x007FFFFF)), _mm_set1_epi32(0x3F800000)));
+		__m128 large = _mm_cmpge_ps(m, _mm_set1_ps(1.41421356f));
+		m = _mm_or_ps(_mm_andnot_ps(large, m), _mm_and_ps(large, _mm_mul_ps(m, _mm_set1_ps(0.5f))));
+		exponent = _mm_sub_epi32(exponent, _mm_castps_si128(large)); // +1 where halved
+
+		// log2(m) = 2/ln2 * atanh(t), t = (m - 1) / (m + 1), |t| < 0.172
+		__m128 t = _mm_div_ps(_mm_sub_ps(m, _mm_set1_ps(1.0f)), _mm_add_ps(m, _mm_set1_ps(1.0f)));
+		__m128 t2 = _mm_mul_ps(t, t);
+		__m128 p = _mm_set1_ps(2.0f / 9.0f);
+		p = _mm_add_ps(_mm_mul_ps(p, t2), _mm_set1_ps(2.0f / 7.0f));
+		p = _mm_add_ps(_mm_mul_ps(p, t2), _mm_set1_ps(2.0f / 5.0f));
+		p = _mm_add_ps(_mm_mul_ps(p, t2), _mm_set1_ps(2.0f / 3.0f));
+		p = _mm_add_ps(_mm_mul_ps(p, t2), _mm_set1_ps(2.0f));
+		p = _mm_mul_ps(_mm_mul_ps(p, t), _mm_set1_ps(LOG2_E));
+
+		return _mm_add_ps(p, _mm_cvtepi32_ps(exponent));
+	}
+
+	// x^y for x > 0
+	inline __m128 Pow(__m128 x, __m128 y)
+	{
+		return Exp2(_mm_mul_ps(y, Log2(x)));
+	}
+
+	inline __m128 DbToLinear(__m128 db)
+	{
+		return Exp2(_mm_mul_ps(db, _mm_set1_ps(1.0f / DB_PER_LOG2)));
+	}
+
+	// Amplitude to dB
+	inline __m128 LinearToDb(__m128 x)
+	{
+		return _mm_mul_ps(Log2(x), _mm_set1_ps(DB_PER_LOG2));
+	}
+
+	// Power (squared amplitude) to dB
+	inline __m128 PowerToDb(__m128 x)
+	{
+		return _mm_mul_ps(Log2(x), _mm_set1_ps(DB_PER_LOG2 * 0.5f));
+	}
+
+	inline __m128 Tanh(__m128 x)
+	{
+		// tanh(x) = sign(x) * (1 - 2 / (e^2|x| + 1)), flat beyond |x| = 9 in float
+		const __m128 signMask = _mm_set1_ps(-0.0f);
+		__m128 sign = _mm_and_ps(x, signMask);
+		__m128 a = _mm_min_ps(_mm_andnot_ps(signMask, x), _mm_set1_ps(9.0f));
+		__m128 e = Exp2(_mm_mul_ps(a, _mm_set1_ps(2.0f * LOG2_E)));
+		__m128 large = _mm_sub_ps(_mm_set1_ps(1.0f), _mm_div_ps(_mm_set1_ps(2.0f), _mm_add_ps(e, _mm_set1_ps(1.0f))));
+
+		// Near zero the subtraction above cancels, the odd series is exact enough there
+		__m128 a2 = _mm_mul_ps(a, a);
+		__m128 small = _mm_set1_ps(-17.0f / 315.0f);
+		small = _mm_add_ps(_mm_mul_ps(small, a2), _mm_set1_ps(2.0f / 15.0f));
+		small = _mm_add_ps(_mm_mul_ps(small, a2), _mm_set1_ps(-1.0f / 3.0f));
+		small = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(small, a2), a), a);
+
+		__m128 useSmall = _mm_cmplt_ps(a, _mm_set1_ps(0.0625f));
+		__m128 result = _mm_or_ps(_mm_and_ps(useSmall, small), _mm_andnot_ps(useSmall, large));
+		return _mm_or_ps(result, sign);
+	}
+
+	inline void SinCos(__m128 x, __m128& sinOut, __m128& cosOut)
+	{
+		// Quadrant from the nearest multiple of pi/2, reduced in two steps so the remainder keeps its precision
+		__m128i quadrant = _mm_cvtps_epi32(_mm_mul_ps(x, _mm_set1_ps(0.636619772f)));
+		__m128 q = _mm_cvtepi32_ps(quadrant);
+		__m128 r = _mm_sub_ps(x, _mm_mul_ps(q, _mm_set1_ps(1.5703125f)));
+		r = _mm_sub_ps(r, _mm_mul_ps(q, _mm_set1_ps(4.83826794897e-4f)));
+		__m128 r2 = _mm_mul_ps(r, r);
+
+		// Taylor on [-pi/4, pi/4]
+		__m128 s = _mm_set1_ps(-1.0f / 5040.0f);
+		s = _mm_add_ps(_mm_mul_ps(s, r2), _mm_set1_ps(1.0f / 120.0f));
+		s = _mm_add_ps(_mm_mul_ps(s, r2), _mm_set1_ps(-1.0f / 6.0f));
+		s = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(s, r2), r), r);
+
+		__m128 c = _mm_set1_ps(1.0f / 40320.0f);
+		c = _mm_add_ps(_mm_mul_ps(c, r2), _mm_set1_ps(-1.0f / 720.0f));
+		c = _mm_add_ps(_mm_mul_ps(c, r2), _mm_set1_ps(1.0f / 24.0f));
+		c = _mm_add_ps(_mm_mul_ps(c, r2), _mm_set1_ps(-0.5f));
+		c = _mm_add_ps(_mm_mul_ps(c, r2), _mm_set1_ps(1.0f));
+
+		// Odd quadrants swap sine and cosine, quadrants 2 and 3 negate sine, 1 and 2 negate cosine
+		__m128 swap = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(quadrant, _mm_set1_epi32(1)), _mm_set1_epi32(1)));
+		__m128 sinValue = _mm_or_ps(_mm_and_ps(swap, c), _mm_andnot_ps(swap, s));
+		__m128 cosValue = _mm_or_ps(_mm_and_ps(swap, s), _mm_andnot_ps(swap, c));
+
+		__m128 sinSign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(quadrant, _mm_set1_epi32(2)), 30));
+		__m128 cosSign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(_mm_add_epi32(quadrant, _mm_set1_epi32(1)), _mm_set1_epi32(2)), 30));
+		sinOut = _mm_xor_ps(sinValue, sinSign);
+		cosOut = _mm_xor_ps(cosValue, cosSign);
+	}
+
+	// ---- Scalar, same approximations through lane 0 ----
+
+	inline float Exp2(float x)
+	{
+		return _mm_cvtss_f32(Exp2(_mm_set_ss(x)));
+	}
+
+	inline float Log2(float x)
+	{
+		return _mm_cvtss_f32(Log2(_mm_set_ss(x)));
+	}
+
+	inline float Pow(float x, float y)
+	{
+		return _mm_cvtss_f32(Pow(_mm_set_ss(x), _mm_set_ss(y)));
+	}
+
+	inline float DbToLinear(float db)
+	{
+		return _mm_cvtss_f32(DbToLinear(_mm_set_ss(db)));
+	}
+
+	inline float LinearToDb(float x)
+	{
+		return _mm_cvtss_f32(LinearToDb(_mm_set_ss(x)));
+	}
+
+	inline float PowerToDb(float x)
+	{
+		return _mm_cvtss_f32(PowerToDb(_mm_set_ss(x)));
+	}
+
+	inline float Tanh(float x)
+	{
+		return _mm_cvtss_f32(Tanh(_mm_set_ss(x)));
+	}
+
+	inline void SinCos(float x, float& sinOut, float& cosOut)
+	{
+		__m128 s, c;
+		SinCos(_mm_set_ss(x), s, c);
+		sinOut = _mm_cvtss_f32(s);
+		cosOut = _mm_cvtss_f32(c);
+	}
+
+	// ---- Arrays, in place is fine ----
+
+	namespace Detail
+	{
+		template<typename Function>
+		inline void Apply(const float* in, float* out, std::size_t count, Function function)
+		{
+			std::size_t i = 0;
+			for (; i + 4 <= count; i += 4)
+			{
+				_mm_storeu_ps(out + i, function(_mm_loadu_ps(in + i)));
+			}
+
+			// Tail through a padded register so it gets exactly the same approximation
+			if (i < count)
+			{
+				alignas(16) float tail[4] = {};
+				std::memcpy(tail, in + i, (count - i) * sizeof(float));
+				_mm_store_ps(tail, function(_mm_load_ps(tail)));
+				std::memcpy(out + i, tail, (count - i) * sizeof(float));
+			}
+		}
+	}
+
+	inline void Exp2(const float* in, float* out, std::size_t count)
+	{
+		Detail::Apply(in, out, count, [](__m128 x) { return Exp2(x); });
+	}
+
+	inline void Log2(const float* in, float* out, std::size_t count)
+	{
+		Detail::Apply(in, out, count, [](__m128 x) { return Log2(x); });
+	}
+
+	// x^y for every x, one exponent
+	inline void Pow(const float* in, float* out, std::size_t count, float y)
+	{
+		const __m128 exponent = _mm_set1_ps(y);
+		Detail::Apply(in, out, count, [exponent](__m128 x) { return Pow(x, exponent); });
+	}
+
+	inline void DbToLinear(const float* in, float* out, std::size_t count)
+	{
+		Detail::Apply(in, out, count, [](__m128 x) { return DbToLinear(x); });
+	}
+
+	inline void LinearToDb(const float* in, float* out, std::size_t count)
+	{
+		Detail::Apply(in, out, count, [](__m128 x) { return LinearToDb(x); });
+	}
+
+	inline void PowerToDb(const float* in, float* out, std::size_t count)
+	{
+		Detail::Apply(in, out, count, [](__m128 x) { return PowerToDb(x); });
+	}
+
+	inline void Tanh(const float* in, float* out, std::size_t count)
+	{
+		Detail::Apply(in, out, count, [](__m128 x) { return Tanh(x); });
+	}
+}
@@ -0,0 +1,258 @@
+#include "pch.h"
+
+#include "FdnReverb.h"
+
+#include "FastMath.h"
+
+#include <bit>
+
+#include <pmmintrin.h>
+
+namespace
+{
+	// What the EFX reverb scales its whole output by at the default AL_REVERB_GAIN
+	constexpr float OUTPUT_GAIN = 0.32f;
+	constexpr float SPEED_OF_SOUND = 343.3f;
+	constexpr float HF_REFERENCE = 5000.0f;
+	constexpr float MAX_REFLECTIONS_DELAY = 0.3f;
+	constexpr float MAX_LATE_DELAY = 0.1f;
+
+	// Tap times after the reflections delay, one pattern per channel parity, and their weights.
+	// Alternating signs keep the reflections from piling up into a comb
+	constexpr float EARLY_SECONDS[2][4] = { { 0.0f, 0.0043f, 0.0087f, 0.0131f }, { 0.0017f, 0.0061f, 0.0103f, 0.0149f } };
+	constexpr float EARLY_WEIGHTS[4] = { 0.6f, -0.5f, 0.45f, -0.42f };
+
+	// Line lengths with no common factors, 30 to 70 ms, so the echoes never line up again
+	constexpr float LINE_SECONDS[FdnReverb::LINES] = { 0.0297f, 0.0371f, 0.0411f, 0.0437f, 0.0503f, 0.0571f, 0.0617f, 0.0683f };
+
+	// How the channel mix is spread into the lines, not a Hadamard row so it reaches all of them on the first pass
+	constexpr float INPUT_SIGNS[FdnReverb::LINES] = { 1.0f, -1.0f, 1.0f, 1.0f, -1.0f, 1.0f, -1.0f, -1.0f };
+
+	const float INV_SQRT_LINES = 1.0f / std::sqrt(static_cast<float>(FdnReverb::LINES));
+
+	std::size_t SecondsToFrames(float seconds, float rate)
+	{
+		return static_cast<std::size_t>(seconds * rate + 0.5f);
+	}
+
+	// 8 point Walsh-Hadamard transform of lanes a0..a3 b0..b3, unscaled
+	void Hadamard(__m128& a, __m128& b)
+	{
+		const __m128 sum = _mm_add_ps(a, b);
+		const __m128 difference = _mm_sub_ps(a, b);
+
+		auto butterflies = [](__m128 x)
+		{
+			// Pairs two apart, then neighbours
+			const __m128 pairSigns = _mm_setr_ps(1.0f, 1.0f, -1.0f, -1.0f);
+			x = _mm_add_ps(_mm_movelh_ps(x, x), _mm_mul_ps(_mm_movehl_ps(x, x), pairSigns));
+			const __m128 neighbourSigns = _mm_setr_ps(1.0f, -1.0f, 1.0f, -1.0f);
+			return _mm_add_ps(_mm_shuffle_ps(x, x, _MM_SHUFFLE(2, 2, 0, 0)), _mm_mul_ps(_mm_shuffle_ps(x, x, _MM_SHUFFLE(3, 3, 1, 1)), neighbourSigns));
+		};
+		a = butterflies(sum);
+		b = butterflies(difference);
+	}
+} // namespace
+
+void FdnReverb::Configure(unsigned int channels, unsigned int sampleRate)
+{
+	m_channels = max(channels, 1u);
+	m_sampleRate = sampleRate;
+	const float rate = static_cast<float>(sampleRate);
+
+	for (std::size_t pattern = 0; pattern < 2; pattern++)
+	{
+		for (std::size_t tap = 0; tap < EARLY_TAPS; tap++)
+		{
+			m_earlyOffsets[pattern][tap] = SecondsToFrames(EARLY_SECONDS[pattern][tap], rate);
+		}
+	}
+
+	// Long enough for the furthest reflection tap and the longest late delay
+	const std::size_t longestDelay = SecondsToFrames(MAX_REFLECTIONS_DELAY + max(MAX_LATE_DELAY, EARLY_SECONDS[1][EARLY_TAPS - 1]), rate) + 1;
+	const std::size_t historyFrames = std::bit_ceil(longestDelay + 1);
+	m_history.assign(historyFrames * m_channels, 0.0f);
+	m_historyMask = historyFrames - 1;
+
+	std::size_t longestLine = 1;
+	for (std::size_t line = 0; line < LINES; line++)
+	{
+		m_lineLengths[line] = max(SecondsToFrames(LINE_SECONDS[line], rate), static_cast<std::size_t>(1));
+		longestLine = max(longestLine, m_lineLengths[line]);
+	}
+	m_lineSize = std::bit_ceil(longestLine + 1);
+	m_lines.assign(LINES * m_lineSize, 0.0f);
+
+	// Rows 1 to 7 of the Hadamard matrix sum to zero and are orthogonal, so each channel hears a
+	// different blend of the same lines and nothing of the channel mix comes straight through
+	m_outputSigns.resize(static_cast<std::size_t>(m_channels) * LINES);
+	for (unsigned int channel = 0; channel < m_channels; channel++)
+	{
+		const unsigned int row = channel % static_cast<unsigned int>(LINES - 1) + 1;
+		for (unsigned int line = 0; line < LINES; line++)
+		{
+			const bool negative = std::popcount(row & line) % 2 != 0;
+			m_outputSigns[channel * LINES + line] = (negative ? -1.0f : 1.0f) * INV_SQRT_LINES;
+		}
+	}
+
+	Reset();
+	SetParameters(m_parameters);
+}
+
+void FdnReverb::Reset()
+{
+	std::fill(m_history.begin(), m_history.end(), 0.0f);
+	std::fill(m_lines.begin(), m_lines.end(), 0.0f);
+	m_historyWrite = 0;
+	m_lineWrite = 0;
+	m_state[0] = _mm_setzero_ps();
+	m_state[1] = _mm_setzero_ps();
+}
+
+void FdnReverb::SetParameters(const Parameters& parameters)
+{
+	m_parameters = parameters;
+	if (m_sampleRate == 0)
+		return;
+
+	const float rate = static_cast<float>(m_sampleRate);
+	const std::size_t reflectionsFrames = SecondsToFrames(std::clamp(parameters.reflectionsDelay, 0.0f, MAX_REFLECTIONS_DELAY), rate);
+	for (std::size_t pattern = 0; pattern < 2; pattern++)
+	{
+		for (std::size_t tap = 0; tap < EARLY_TAPS; tap++)
+		{
+			m_earlyDelays[pattern][tap] = reflectionsFrames + m_earlyOffsets[pattern][tap];
+		}
+	}
+	m_lateInputDelay = reflectionsFrames + SecondsToFrames(std::clamp(parameters.lateDelay, 0.0f, MAX_LATE_DELAY), rate);
+	m_earlyGain = OUTPUT_GAIN * parameters.reflectionsGain;
+
+	// Above the reference the decay is shorter or longer by the HF ratio, but never longer than it
+	// takes air absorption alone to take 60 dB off over the distance sound travels meanwhile
+	const float decayTime = max(parameters.decayTime, 0.01f);
+	float hfDecayTime = decayTime * parameters.decayHFRatio;
+	if (parameters.airAbsorption < 1.0f)
+	{
+		const float log10Absorption = FastMath::Log2(parameters.airAbsorption) / FastMath::LOG2_10;
+		hfDecayTime = min(hfDecayTime, -3.0f / (SPEED_OF_SOUND * log10Absorption));
+	}
+	hfDecayTime = max(hfDecayTime, 0.01f);
+
+	// Per line gain for one trip round it, so every line loses 60 dB over the decay time
+	auto decayGain = [rate](std::size_t length, float seconds)
+	{
+		return FastMath::Exp2(-3.0f * FastMath::LOG2_10 * static_cast<float>(length) / (seconds * rate));
+	};
+
+	float shelfSin, shelfCos;
+	FastMath::SinCos(M_PI * min(HF_REFERENCE, 0.45f * rate) / rate, shelfSin, shelfCos);
+	const float shelfTan = shelfSin / shelfCos;
+
+	alignas(16) float b0[LINES], b1[LINES], a1[LINES];
+	for (std::size_t line = 0; line < LINES; line++)
+	{
+		const float lowGain = decayGain(m_lineLengths[line], decayTime);
+		const float highGain = decayGain(m_lineLengths[line], hfDecayTime);
+
+		// First order high shelf, unity at DC and highGain / lowGain at Nyquist
+		const float shelfGain = highGain / lowGain;
+		const float c = shelfGain >= 1.0f ? (shelfTan - 1.0f) / (shelfTan + 1.0f) : (shelfGain * shelfTan - 1.0f) / (shelfGain * shelfTan + 1.0f);
+		const float halfBoost = 0.5f * (shelfGain - 1.0f);
+		b0[line] = lowGain * (1.0f + halfBoost * (1.0f - c));
+		b1[line] = lowGain * (c - halfBoost * (1.0f - c));
+		a1[line] = c;
+	}
+	for (std::size_t half = 0; half < 2; half++)
+	{
+		m_b0[half] = _mm_load_ps(b0 + half * 4);
+		m_b1[half] = _mm_load_ps(b1 + half * 4);
+		m_a1[half] = _mm_load_ps(a1 + half * 4);
+	}
+
+	// A longer decay rings for longer rather than louder, the tail carries about as much energy as went in
+	float meanLength = 0.0f;
+	for (std::size_t length: m_lineLengths)
+	{
+		meanLength += static_cast<float>(length) / static_cast<float>(LINES);
+	}
+	const float meanGain = FastMath::Exp2(-3.0f * FastMath::LOG2_10 * meanLength / (decayTime * rate));
+	m_lateOutputGain = OUTPUT_GAIN * parameters.lateGain * std::sqrt(1.0f - meanGain * meanGain);
+}
+
+void FdnReverb::Process(float* samples, std::size_t frameCount)
+{
+	if (m_sampleRate == 0)
+		return;
+
+	// Flush denormals whatever the caller's mode, the tail decays into them and results must not depend on it
+	const unsigned int csr = _mm_getcsr();
+	_mm_setcsr(csr | _MM_FLUSH_ZERO_ON | _MM_DENORMALS_ZERO_ON);
+
+	const std::size_t lineMask = m_lineSize - 1;
+	const __m128 inputSigns[2] = { _mm_mul_ps(_mm_loadu_ps(INPUT_SIGNS), _mm_set1_ps(INV_SQRT_LINES)),
+		                           _mm_mul_ps(_mm_loadu_ps(INPUT_SIGNS + 4), _mm_set1_ps(INV_SQRT_LINES)) };
+	const __m128 mixScale = _mm_set1_ps(INV_SQRT_LINES);
+	const float channelScale = 1.0f / static_cast<float>(m_channels);
+
+	alignas(16) float lineOutput[LINES];
+	alignas(16) float lineInput[LINES];
+	for (std::size_t n = 0; n < frameCount; n++)
+	{
+		float* frame = samples + n * m_channels;
+		std::copy(frame, frame + m_channels, m_history.data() + m_historyWrite * m_channels);
+
+		const float* lateSource = m_history.data() + ((m_historyWrite - m_lateInputDelay) & m_historyMask) * m_channels;
+		float lateInput = 0.0f;
+		for (unsigned int channel = 0; channel < m_channels; channel++)
+		{
+			lateInput += lateSource[channel];
+		}
+		lateInput *= channelScale;
+
+		for (std::size_t line = 0; line < LINES; line++)
+		{
+			lineOutput[line] = m_lines[line * m_lineSize + ((m_lineWrite - m_lineLengths[line]) & lineMask)];
+		}
+
+		// Decay and shelf per line, then the Hadamard mix back into the lines with the new input
+		__m128 y[2];
+		for (std::size_t half = 0; half < 2; half++)
+		{
+			const __m128 x = _mm_load_ps(lineOutput + half * 4);
+			y[half] = _mm_add_ps(_mm_mul_ps(m_b0[half], x), m_state[half]);
+			m_state[half] = _mm_sub_ps(_mm_mul_ps(m_b1[half], x), _mm_mul_ps(m_a1[half], y[half]));
+		}
+		__m128 mixed[2] = { y[0], y[1] };
+		Hadamard(mixed[0], mixed[1]);
+		const __m128 input = _mm_set1_ps(lateInput);
+		_mm_store_ps(lineInput, _mm_add_ps(_mm_mul_ps(mixed[0], mixScale), _mm_mul_ps(input, inputSigns[0])));
+		_mm_store_ps(lineInput + 4, _mm_add_ps(_mm_mul_ps(mixed[1], mixScale), _mm_mul_ps(input, inputSigns[1])));
+		for (std::size_t line = 0; line < LINES; line++)
+		{
+			m_lines[line * m_lineSize + m_lineWrite] = lineInput[line];
+		}
+
+		for (unsigned int channel = 0; channel < m_channels; channel++)
+		{
+			const float* signs = m_outputSigns.data() + channel * LINES;
+			__m128 late = _mm_add_ps(_mm_mul_ps(y[0], _mm_loadu_ps(signs)), _mm_mul_ps(y[1], _mm_loadu_ps(signs + 4)));
+			late = _mm_add_ps(late, _mm_movehl_ps(late, late));
+			late = _mm_add_ss(late, _mm_shuffle_ps(late, late, _MM_SHUFFLE(1, 1, 1, 1)));
+
+			const std::array<std::size_t, EARLY_TAPS>& delays = m_earlyDelays[channel % 2];
+			float early = 0.0f;
+			for (std::size_t tap = 0; tap < EARLY_TAPS; tap++)
+			{
+				early += EARLY_WEIGHTS[tap] * m_history[((m_historyWrite - delays[tap]) & m_historyMask) * m_channels + channel];
+			}
+
+			frame[channel] += m_earlyGain * early + m_lateOutputGain * _mm_cvtss_f32(late);
+		}
+
+		m_historyWrite = (m_historyWrite + 1) & m_historyMask;
+		m_lineWrite = (m_lineWrite + 1) & lineMask;
+	}
+
+	_mm_setcsr(csr);
+}
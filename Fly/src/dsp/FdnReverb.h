@@ -0,0 +1,89 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <vector>
+
+#include <xmmintrin.h>
+
+// Algorithmic reverb with the EFX reverb's controls, for when the result has to be the same
+// everywhere rather than whatever the OpenAL implementation makes of it. Early reflections are four
+// taps per channel after the reflections delay. The late reverb is a feedback delay network of 8
+// lines fed the channel mix, starting the late delay after the first reflection.
+//
+// The network runs across its delay lines in two SSE registers: per line decay with a first
+// order high shelf for the HF ratio, then an 8 point Hadamard mix as the feedback matrix. All
+// coefficients come from FastMath rather than libm and Process runs with denormals flushed, so the
+// output only depends on the input and the parameters, bit for bit, on any machine.
+class FdnReverb
+{
+public:
+	static constexpr std::size_t LINES = 8;
+
+	// Same meaning and ranges as the EFX reverb properties of the same names
+	struct Parameters
+	{
+		float decayTime = 1.0f;         // 0.1 to 20 seconds, for the level to drop 60 dB
+		float reflectionsDelay = 0.02f; // 0 to 0.3 seconds
+		float lateDelay = 0.03f;        // 0 to 0.1 seconds after the first reflection
+		float decayHFRatio = 1.0f;      // 0.1 to 2, decay time above 5 kHz over decayTime
+		float reflectionsGain = 0.05f;  // 0 to 3.16
+		float lateGain = 0.05f;         // 0 to 10
+		float airAbsorption = 0.994f;   // 0.892 to 1, HF gain per metre, limits the HF decay time
+	};
+
+	// Sizes the delays for the layout and resets
+	void Configure(unsigned int channels, unsigned int sampleRate);
+
+	// Clears the delays, what was ringing stops
+	void Reset();
+
+	// Takes effect from the next Process, the state is kept
+	void SetParameters(const Parameters& parameters);
+
+	unsigned int GetChannelCount() const
+	{
+		return m_channels;
+	}
+
+	unsigned int GetSampleRate() const
+	{
+		return m_sampleRate;
+	}
+
+	// Adds the reverb to frameCount interleaved frames, in place
+	void Process(float* samples, std::size_t frameCount);
+
+private:
+	static constexpr std::size_t EARLY_TAPS = 4;
+
+	unsigned int m_channels = 0;
+	unsigned int m_sampleRate = 0;
+	Parameters m_parameters;
+
+	// Input history, [frame][channel], for the reflections and the late input
+	std::vector<float> m_history;
+	std::size_t m_historyMask = 0;
+	std::size_t m_historyWrite = 0;
+
+	// Early reflections, channels alternate between two tap patterns so stereo stays wide
+	std::array<std::array<std::size_t, EARLY_TAPS>, 2> m_earlyDelays{};
+	std::array<std::array<std::size_t, EARLY_TAPS>, 2> m_earlyOffsets{}; // From the reflections delay
+	std::size_t m_lateInputDelay = 0;
+	float m_earlyGain = 0.0f;
+	float m_lateOutputGain = 0.0f;
+
+	// Delay lines, [line][frame], all the same power of two length
+	std::vector<float> m_lines;
+	std::size_t m_lineSize = 0;
+	std::size_t m_lineWrite = 0;
+	std::array<std::size_t, LINES> m_lineLengths{};
+
+	// Per line loop filter, y = b0 x + s, s = b1 x - a1 y, decay gain folded into b0 and b1
+	__m128 m_b0[2]{};
+	__m128 m_b1[2]{};
+	__m128 m_a1[2]{};
+	__m128 m_state[2]{};
+
+	std::vector<float> m_outputSigns; // [channel][line], a Hadamard row per channel
+};
@@ -0,0 +1,346 @@
+#include "pch.h"
+
+#include "LoudnessMeter.h"
+
+#include <numbers>
+
+#include "FastMath.h"
+
+namespace
+{
+	__m128d LoadPair(const float* frame, unsigned int first, unsigned int channels)
+	{
+		double second = first + 1 < channels ? frame[first + 1] : 0.0;
+		return _mm_set_pd(second, frame[first]);
+	}
+
+	double SumPair(__m128d pair)
+	{
+		return _mm_cvtsd_f64(_mm_add_sd(pair, _mm_unpackhi_pd(pair, pair)));
+	}
+}
+
+LoudnessMeter::LoudnessMeter()
+{
+	// Windowed sinc interpolator, each phase normalized to unity gain at DC
+	const int length = TRUE_PEAK_TAPS * 4;
+	const double center = (length - 1) * 0.5;
+	std::array<double, length> taps{};
+	for (int i = 0; i < length; i++)
+	{
+		double x = (i - center) / 4.0;
+		double sinc = x == 0.0 ? 1.0 : std::sin(std::numbers::pi * x) / (std::numbers::pi * x);
+		double phase = 2.0 * std::numbers::pi * i / (length - 1);
+		double blackman = 0.42 - 0.5 * std::cos(phase) + 0.08 * std::cos(2.0 * phase);
+		taps[i] = sinc * blackman;
+	}
+
+	std::array<double, 4> phaseSums{};
+	for (int i = 0; i < length; i++)
+	{
+		phaseSums[i % 4] += taps[i];
+	}
+
+	// Output phase p at input n is the sum over k of taps[4k + p] * x[n - k]
+	for (int k = 0; k < TRUE_PEAK_TAPS; k++)
+	{
+		m_truePeakTaps[k] = _mm_set_ps(static_cast<float>(taps[4 * k + 3] / phaseSums[3]), static_cast<float>(taps[4 * k + 2] / phaseSums[2]),
+		                               static_cast<float>(taps[4 * k + 1] / phaseSums[1]), static_cast<float>(taps[4 * k] / phaseSums[0]));
+	}
+}
+
+float LoudnessMeter::EnergyToLufs(double energy)
+{
+	if (energy <= 0.0)
+		return SILENCE_LUFS;
+
+	return max(static_cast<float>(-0.691 + 10.0 * std::log10(energy)), SILENCE_LUFS);
+}
+
+void LoudnessMeter::Configure(unsigned int channels, unsigned int sampleRate)
+{
+	if (m_blockCount > 0)
+	{
+		LOG_INFO("Stream loudness: {:.1f} LUFS integrated, {:.1f} dBTP max true peak", GetIntegratedLoudness(), m_maxTruePeakDb);
+	}
+
+	m_channels = min(channels, static_cast<unsigned int>(MAX_CHANNELS));
+	m_sampleRate = sampleRate;
+	m_blockFrames = max(static_cast<std::size_t>(std::lround(sampleRate / 10.0)), static_cast<std::size_t>(1));
+
+	// BS.1770 K-weighting for any sample rate, from the analog prototypes
+	const double rate = static_cast<double>(sampleRate);
+	auto setCoefficients = [](BiquadPair& filter, double b0, double b1, double b2, double a1, double a2)
+	{
+		filter.b0 = _mm_set1_pd(b0);
+		filter.b1 = _mm_set1_pd(b1);
+		filter.b2 = _mm_set1_pd(b2);
+		filter.a1 = _mm_set1_pd(a1);
+		filter.a2 = _mm_set1_pd(a2);
+	};
+
+	{
+		const double f0 = 1681.974450955533;
+		const double gainDb = 3.999843853973347;
+		const double q = 0.7071752369554196;
+		const double k = std::tan(std::numbers::pi * f0 / rate);
+		const double vh = std::pow(10.0, gainDb / 20.0);
+		const double vb = std::pow(vh, 0.4996667741545416);
+		const double a0 = 1.0 + k / q + k * k;
+		for (BiquadPair& filter: m_shelf)
+		{
+			setCoefficients(filter, (vh + vb * k / q + k * k) / a0, 2.0 * (k * k - vh) / a0, (vh - vb * k / q + k * k) / a0, 2.0 * (k * k - 1.0) / a0, (1.0 - k / q + k * k) / a0);
+		}
+	}
+	{
+		const double f0 = 38.13547087602444;
+		const double q = 0.5003270373238773;
+		const double k = std::tan(std::numbers::pi * f0 / rate);
+		const double a0 = 1.0 + k / q + k * k;
+		for (BiquadPair& filter: m_highPass)
+		{
+			setCoefficients(filter, 1.0, -2.0, 1.0, 2.0 * (k * k - 1.0) / a0, (1.0 - k / q + k * k) / a0);
+		}
+	}
+
+	// Surround channels of a 5.1 stream count 1.41x, the LFE not at all
+	std::array<double, MAX_CHANNELS> weights{};
+	for (unsigned int ch = 0; ch < m_channels; ch++)
+	{
+		weights[ch] = 1.0;
+	}
+	if (m_channels == 6)
+	{
+		weights[3] = 0.0;
+		weights[4] = 1.41;
+		weights[5] = 1.41;
+	}
+	for (int pair = 0; pair < CHANNEL_PAIRS; pair++)
+	{
+		m_channelWeights[pair] = _mm_set_pd(weights[pair * 2 + 1], weights[pair * 2]);
+	}
+
+	m_histogram.counts.fill(0);
+	m_histogram.energy.fill(0.0);
+	m_maxTruePeakDb = SILENCE_LUFS;
+	m_blockCount = 0;
+	m_expectedFrame = -1;
+	ResetFilters();
+}
+
+void LoudnessMeter::ResetFilters()
+{
+	for (int pair = 0; pair < CHANNEL_PAIRS; pair++)
+	{
+		m_shelf[pair].s1 = m_shelf[pair].s2 = _mm_setzero_pd();
+		m_highPass[pair].s1 = m_highPass[pair].s2 = _mm_setzero_pd();
+		m_blockEnergy[pair] = _mm_setzero_pd();
+	}
+	for (std::array<float, TRUE_PEAK_TAPS * 2>& history: m_truePeakHistory)
+	{
+		history.fill(0.0f);
+	}
+	m_truePeakPosition = 0;
+
+	m_blockFill = 0;
+	m_blockPeak = _mm_setzero_ps();
+	m_blockLR = m_blockLL = m_blockRR = 0.0;
+	m_energyHistory.fill(0.0);
+	for (std::array<double, 3>& sums: m_correlationHistory)
+	{
+		sums.fill(0.0);
+	}
+	m_blocksSinceReset = 0;
+}
+
+void LoudnessMeter::Process(const float* samples, std::size_t frameCount, std::int64_t startFrame)
+{
+	if (m_channels == 0 || m_blockFrames == 0)
+		return;
+
+	if (startFrame != m_expectedFrame)
+	{
+		// Seek, loop or new track, what was in the filters has nothing to do with what follows
+		ResetFilters();
+		m_latestEpoch = ++m_epoch;
+	}
+	m_expectedFrame = startFrame + static_cast<std::int64_t>(frameCount);
+
+	const unsigned int channels = m_channels;
+	const int pairs = static_cast<int>((channels + 1) / 2);
+	const __m128 signMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+
+	for (std::size_t frame = 0; frame < frameCount; frame++)
+	{
+		const float* input = samples + frame * channels;
+
+		// K-weighted energy, two channels at a time
+		for (int pair = 0; pair < pairs; pair++)
+		{
+			__m128d x = LoadPair(input, pair * 2, channels);
+
+			BiquadPair& shelf = m_shelf[pair];
+			__m128d y = _mm_add_pd(_mm_mul_pd(shelf.b0, x), shelf.s1);
+			shelf.s1 = _mm_add_pd(_mm_sub_pd(_mm_mul_pd(shelf.b1, x), _mm_mul_pd(shelf.a1, y)), shelf.s2);
+			shelf.s2 = _mm_sub_pd(_mm_mul_pd(shelf.b2, x), _mm_mul_pd(shelf.a2, y));
+
+			BiquadPair& highPass = m_highPass[pair];
+			__m128d z = _mm_add_pd(_mm_mul_pd(highPass.b0, y), highPass.s1);
+			highPass.s1 = _mm_add_pd(_mm_sub_pd(_mm_mul_pd(highPass.b1, y), _mm_mul_pd(highPass.a1, z)), highPass.s2);
+			highPass.s2 = _mm_sub_pd(_mm_mul_pd(highPass.b2, y), _mm_mul_pd(highPass.a2, z));
+
+			m_blockEnergy[pair] = _mm_add_pd(m_blockEnergy[pair], _mm_mul_pd(_mm_mul_pd(z, z), m_channelWeights[pair]));
+		}
+
+		// True-peak, all four interpolated phases of a channel in one register
+		const int position = m_truePeakPosition;
+		for (unsigned int ch = 0; ch < channels; ch++)
+		{
+			float* history = m_truePeakHistory[ch].data();
+			history[position] = input[ch];
+			history[position + TRUE_PEAK_TAPS] = input[ch];
+
+			// history[position + TRUE_PEAK_TAPS - k] is x[n - k]
+			const float* newest = history + position + TRUE_PEAK_TAPS;
+			__m128 acc = _mm_setzero_ps();
+			for (int k = 0; k < TRUE_PEAK_TAPS; k++)
+			{
+				acc = _mm_add_ps(acc, _mm_mul_ps(m_truePeakTaps[k], _mm_set1_ps(newest[-k])));
+			}
+			m_blockPeak = _mm_max_ps(m_blockPeak, _mm_and_ps(acc, signMask));
+		}
+		m_truePeakPosition = position + 1 == TRUE_PEAK_TAPS ? 0 : position + 1;
+
+		if (channels >= 2)
+		{
+			const double left = input[0];
+			const double right = input[1];
+			m_blockLR += left * right;
+			m_blockLL += left * left;
+			m_blockRR += right * right;
+		}
+
+		if (++m_blockFill == m_blockFrames)
+		{
+			FinishBlock(startFrame + static_cast<std::int64_t>(frame) + 1);
+		}
+	}
+}
+
+void LoudnessMeter::FinishBlock(std::int64_t endFrame)
+{
+	double energy = 0.0;
+	for (int pair = 0; pair < CHANNEL_PAIRS; pair++)
+	{
+		energy += SumPair(m_blockEnergy[pair]);
+		m_blockEnergy[pair] = _mm_setzero_pd();
+	}
+	energy /= static_cast<double>(m_blockFrames);
+
+	alignas(16) float peaks[4];
+	_mm_store_ps(peaks, m_blockPeak);
+	float peak = max(max(peaks[0], peaks[1]), max(peaks[2], peaks[3]));
+	m_blockPeak = _mm_setzero_ps();
+
+	const int slot = static_cast<int>(m_blockCount % SHORT_TERM_BLOCKS);
+	m_energyHistory[slot] = energy;
+	m_correlationHistory[m_blockCount % MOMENTARY_BLOCKS] = { m_blockLR, m_blockLL, m_blockRR };
+	m_blockLR = m_blockLL = m_blockRR = 0.0;
+	m_blockCount++;
+	m_blocksSinceReset++;
+	m_blockFill = 0;
+
+	// Windows over the newest blocks, shorter while the stream has only just started
+	auto windowEnergy = [this, slot](int blocks)
+	{
+		blocks = min(blocks, m_blocksSinceReset);
+		double sum = 0.0;
+		for (int i = 0; i < blocks; i++)
+		{
+			sum += m_energyHistory[(slot - i + SHORT_TERM_BLOCKS) % SHORT_TERM_BLOCKS];
+		}
+		return blocks > 0 ? sum / blocks : 0.0;
+	};
+	const double momentaryEnergy = windowEnergy(MOMENTARY_BLOCKS);
+
+	// Gating blocks are the 400 ms windows with 75% overlap, i.e. one per 100 ms block
+	const float momentary = EnergyToLufs(momentaryEnergy);
+	if (m_blocksSinceReset >= MOMENTARY_BLOCKS && momentary >= HISTOGRAM_MIN_LUFS)
+	{
+		int bin = min(static_cast<int>((momentary - HISTOGRAM_MIN_LUFS) * 10.0f), HISTOGRAM_BINS - 1);
+		m_histogram.counts[bin]++;
+		m_histogram.energy[bin] += momentaryEnergy;
+	}
+
+	const float truePeakDb = peak > 0.0f ? max(FastMath::LinearToDb(peak), SILENCE_LUFS) : SILENCE_LUFS;
+	m_maxTruePeakDb = max(m_maxTruePeakDb, truePeakDb);
+
+	Reading* reading = m_readings.beginPush();
+	if (!reading)
+	{
+		// Nobody is watching the meter, the UI drops old readings when it catches up anyway
+		return;
+	}
+
+	double lr = 0.0, ll = 0.0, rr = 0.0;
+	for (const std::array<double, 3>& sums: m_correlationHistory)
+	{
+		lr += sums[0];
+		ll += sums[1];
+		rr += sums[2];
+	}
+	const double norm = std::sqrt(ll * rr);
+
+	reading->momentaryLufs = momentary;
+	reading->shortTermLufs = EnergyToLufs(windowEnergy(SHORT_TERM_BLOCKS));
+	reading->integratedLufs = GetIntegratedLoudness();
+	reading->truePeakDb = truePeakDb;
+	reading->maxTruePeakDb = m_maxTruePeakDb;
+	reading->correlation = norm > 1e-12 ? static_cast<float>(lr / norm) : 0.0f;
+	reading->endFrame = endFrame;
+	reading->epoch = m_epoch;
+	m_readings.commitPush();
+}
+
+float LoudnessMeter::IntegratedLoudness(const Histogram& histogram)
+{
+	// Relative gate sits 10 LU below the loudness of everything above the absolute gate
+	double energy = 0.0;
+	std::uint64_t count = 0;
+	for (int bin = 0; bin < HISTOGRAM_BINS; bin++)
+	{
+		energy += histogram.energy[bin];
+		count += histogram.counts[bin];
+	}
+	if (count == 0)
+		return SILENCE_LUFS;
+
+	const float relativeGate = EnergyToLufs(energy / static_cast<double>(count)) - 10.0f;
+	const int firstBin = std::clamp(static_cast<int>(std::ceil((relativeGate - HISTOGRAM_MIN_LUFS) * 10.0f)), 0, HISTOGRAM_BINS - 1);
+
+	energy = 0.0;
+	count = 0;
+	for (int bin = firstBin; bin < HISTOGRAM_BINS; bin++)
+	{
+		energy += histogram.energy[bin];
+		count += histogram.counts[bin];
+	}
+	return count > 0 ? EnergyToLufs(energy / static_cast<double>(count)) : SILENCE_LUFS;
+}
+
+const LoudnessMeter::Reading& LoudnessMeter::AcquireReading(std::int64_t playingFrame)
+{
+	const std::uint32_t latestEpoch = m_latestEpoch;
+	while (const Reading* reading = m_readings.front())
+	{
+		// Readings from before a seek describe audio that was thrown away
+		bool stale = reading->epoch != latestEpoch;
+		if (!stale && reading->endFrame > playingFrame)
+			break;
+
+		if (!stale)
+			m_current = *reading;
+		m_readings.pop();
+	}
+	return m_current;
+}
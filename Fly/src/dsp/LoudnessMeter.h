@@ -0,0 +1,132 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+#include <emmintrin.h>
+
+#include "containers/SpscQueue.h"
+
+// EBU R128 / ITU-R BS.1770 loudness, true-peak and stereo correlation of the signal sent to the
+// output. Process runs on the streaming thread: it never allocates or locks, the K-weighting runs
+// two channels per SSE2 register in double precision and the 4x true-peak interpolator computes
+// all four phases in one SSE register. Every 100 ms block a Reading is queued, stamped with the
+// stream frame it ends at, so the UI can show the one that matches what is being heard even
+// though decoding runs well ahead of playback.
+class LoudnessMeter
+{
+public:
+	static constexpr int MAX_CHANNELS = 8;
+	static constexpr float SILENCE_LUFS = -120.0f; // Reported for digital silence instead of -inf
+
+	// Gating histogram, 0.1 LU bins from the -70 LUFS absolute gate up
+	static constexpr float HISTOGRAM_MIN_LUFS = -70.0f;
+	static constexpr int HISTOGRAM_BINS = 800;
+
+	// Gating blocks since the stream was configured. Histograms of several streams add up to the
+	// gating of them played back to back, which is how album loudness is measured
+	struct Histogram
+	{
+		std::array<std::uint32_t, HISTOGRAM_BINS> counts{};
+		std::array<double, HISTOGRAM_BINS> energy{};
+	};
+
+	struct Reading
+	{
+		float momentaryLufs = SILENCE_LUFS;  // 400 ms window
+		float shortTermLufs = SILENCE_LUFS;  // 3 s window
+		float integratedLufs = SILENCE_LUFS; // Gated, since the stream was configured
+		float truePeakDb = SILENCE_LUFS;     // Highest inter-sample peak of the last block, dBTP
+		float maxTruePeakDb = SILENCE_LUFS;  // Highest since the stream was configured
+		float correlation = 0.0f;            // Of the first two channels over the momentary window
+		std::int64_t endFrame = 0;
+		std::uint32_t epoch = 0; // Bumped at every discontinuity in the stream
+	};
+
+	LoudnessMeter();
+
+	// Streaming side. Starts a new measurement, logging a summary of the previous one
+	void Configure(unsigned int channels, unsigned int sampleRate);
+
+	// Streaming side, interleaved samples starting at a stream frame. A jump in stream position
+	// restarts the filters and windows but keeps integrating
+	void Process(const float* samples, std::size_t frameCount, std::int64_t startFrame);
+
+	// UI side. Consumes the readings up to the frame being heard and returns the latest of them
+	const Reading& AcquireReading(std::int64_t playingFrame);
+
+	// Streaming side, for measuring a whole stream without the UI
+	const Histogram& GetHistogram() const
+	{
+		return m_histogram;
+	}
+
+	float GetIntegratedLoudness() const
+	{
+		return IntegratedLoudness(m_histogram);
+	}
+
+	float GetMaxTruePeak() const
+	{
+		return m_maxTruePeakDb;
+	}
+
+	// Gated loudness of a histogram, SILENCE_LUFS when nothing got past the absolute gate
+	static float IntegratedLoudness(const Histogram& histogram);
+
+private:
+	static constexpr int CHANNEL_PAIRS = MAX_CHANNELS / 2;
+	static constexpr int SHORT_TERM_BLOCKS = 30; // 100 ms blocks
+	static constexpr int MOMENTARY_BLOCKS = 4;
+	static constexpr int TRUE_PEAK_TAPS = 12; // Per phase, 48 tap interpolator
+
+	// Transposed direct form II, one lane per channel
+	struct BiquadPair
+	{
+		__m128d b0, b1, b2, a1, a2;
+		__m128d s1, s2;
+	};
+
+	void ResetFilters();
+	void FinishBlock(std::int64_t endFrame);
+	static float EnergyToLufs(double energy);
+
+	unsigned int m_channels = 0;
+	unsigned int m_sampleRate = 0;
+	std::size_t m_blockFrames = 0;
+
+	// K-weighting: high shelf then high-pass, per channel pair
+	BiquadPair m_shelf[CHANNEL_PAIRS]{};
+	BiquadPair m_highPass[CHANNEL_PAIRS]{};
+	__m128d m_channelWeights[CHANNEL_PAIRS]{};
+
+	// True-peak, coefficients laid out phase-major per tap so one multiply covers all four phases
+	__m128 m_truePeakTaps[TRUE_PEAK_TAPS]{};
+	std::array<std::array<float, TRUE_PEAK_TAPS * 2>, MAX_CHANNELS> m_truePeakHistory{}; // Doubled, so the window is contiguous
+	int m_truePeakPosition = 0;
+
+	// Current block
+	std::size_t m_blockFill = 0;
+	__m128d m_blockEnergy[CHANNEL_PAIRS]{};
+	__m128 m_blockPeak{};
+	double m_blockLR = 0.0, m_blockLL = 0.0, m_blockRR = 0.0;
+
+	// Finished blocks, as rings
+	std::array<double, SHORT_TERM_BLOCKS> m_energyHistory{};
+	std::array<std::array<double, 3>, MOMENTARY_BLOCKS> m_correlationHistory{};
+	int m_blocksSinceReset = 0;
+	std::int64_t m_blockCount = 0;
+
+	// Integrated
+	Histogram m_histogram;
+	float m_maxTruePeakDb = SILENCE_LUFS;
+
+	std::int64_t m_expectedFrame = -1;
+	std::uint32_t m_epoch = 0;
+	std::atomic<std::uint32_t> m_latestEpoch{ 0 };
+
+	// Streaming thread to UI
+	SpscQueue<Reading, 128> m_readings;
+	Reading m_current;
+};
@@ -0,0 +1,162 @@
+#include "pch.h"
+
+#include "PartitionedConvolver.h"
+
+void PartitionedConvolver::Prepare(FFTPlan& plan, const float* taps, std::size_t tapCount, Filter& filter)
+{
+	const std::size_t blockSize = filter.blockSize;
+	const std::size_t bins = blockSize + 1;
+	filter.partitions = (tapCount + blockSize - 1) / blockSize;
+	filter.spectra.resize(filter.partitions * bins);
+
+	// Each partition is zero padded to the transform size, so the product with an input block only wraps into the half that is thrown away
+	std::vector<float> padded(blockSize * 2, 0.0f);
+	for (std::size_t p = 0; p < filter.partitions; p++)
+	{
+		const std::size_t count = min(blockSize, tapCount - p * blockSize);
+		std::copy_n(taps + p * blockSize, count, padded.begin());
+		std::fill(padded.begin() + count, padded.end(), 0.0f);
+		plan.Forward(padded.data(), filter.spectra.data() + p * bins);
+	}
+}
+
+void PartitionedConvolver::Configure(unsigned int channels, std::size_t blockSize, std::size_t maxPartitions)
+{
+	m_channels = channels;
+	m_blockSize = blockSize;
+	m_bins = blockSize + 1;
+	m_maxPartitions = maxPartitions;
+	if (!m_plan || m_plan->GetSize() != blockSize * 2)
+	{
+		m_plan = std::make_unique<FFTPlan>(blockSize * 2);
+	}
+
+	m_previous.resize(channels * blockSize);
+	m_input.resize(channels * blockSize);
+	m_output.resize(channels * blockSize);
+	m_delay.resize(channels * maxPartitions * m_bins);
+	m_time.resize(blockSize * 2);
+	m_accumulator.resize(m_bins);
+	m_result.resize(blockSize * 2);
+	m_resultNext.resize(blockSize * 2);
+	Reset();
+}
+
+void PartitionedConvolver::Reset()
+{
+	std::fill(m_previous.begin(), m_previous.end(), 0.0f);
+	std::fill(m_input.begin(), m_input.end(), 0.0f);
+	std::fill(m_output.begin(), m_output.end(), 0.0f);
+	std::fill(m_delay.begin(), m_delay.end(), std::complex<float>{});
+	m_delayHead = 0;
+	m_position = 0;
+}
+
+bool PartitionedConvolver::Process(float* samples, std::size_t frameCount, const Filter& filter, const Filter* next)
+{
+	if (m_channels == 0 || filter.blockSize != m_blockSize || (next && next->blockSize != m_blockSize))
+		return false;
+
+	bool switched = false;
+	for (std::size_t frame = 0; frame < frameCount; frame++)
+	{
+		float* frameSamples = samples + frame * m_channels;
+		for (unsigned int channel = 0; channel < m_channels; channel++)
+		{
+			const std::size_t index = channel * m_blockSize + m_position;
+			m_input[index] = frameSamples[channel];
+			frameSamples[channel] = m_output[index];
+		}
+
+		if (++m_position == m_blockSize)
+		{
+			m_position = 0;
+			RunBlock(switched ? *next : filter, switched ? nullptr : next);
+			switched = switched || next != nullptr;
+		}
+	}
+	return switched;
+}
+
+void PartitionedConvolver::ProcessBlock(const float* input, float* output, const Filter& filter)
+{
+	if (m_channels == 0 || filter.blockSize != m_blockSize)
+		return;
+
+	for (std::size_t frame = 0; frame < m_blockSize; frame++)
+	{
+		for (unsigned int channel = 0; channel < m_channels; channel++)
+		{
+			m_input[channel * m_blockSize + frame] = input[frame * m_channels + channel];
+		}
+	}
+
+	RunBlock(filter, nullptr);
+
+	for (std::size_t frame = 0; frame < m_blockSize; frame++)
+	{
+		for (unsigned int channel = 0; channel < m_channels; channel++)
+		{
+			output[frame * m_channels + channel] = m_output[channel * m_blockSize + frame];
+		}
+	}
+}
+
+void PartitionedConvolver::RunBlock(const Filter& filter, const Filter* next)
+{
+	// Step the delay line back one slot, the new block goes where the oldest was
+	m_delayHead = (m_delayHead + m_maxPartitions - 1) % m_maxPartitions;
+
+	for (unsigned int channel = 0; channel < m_channels; channel++)
+	{
+		float* previous = m_previous.data() + channel * m_blockSize;
+		float* input = m_input.data() + channel * m_blockSize;
+		std::copy_n(previous, m_blockSize, m_time.begin());
+		std::copy_n(input, m_blockSize, m_time.begin() + m_blockSize);
+		std::copy_n(input, m_blockSize, previous);
+
+		std::complex<float>* slot = m_delay.data() + (channel * m_maxPartitions + m_delayHead) * m_bins;
+		m_plan->Forward(m_time.data(), slot);
+
+		float* output = m_output.data() + channel * m_blockSize;
+		Convolve(channel, filter, m_result);
+		if (!next)
+		{
+			std::copy_n(m_result.begin() + m_blockSize, m_blockSize, output);
+			continue;
+		}
+
+		// Both filters run over this one block and the output fades linearly from one to the other
+		Convolve(channel, *next, m_resultNext);
+		const float step = 1.0f / static_cast<float>(m_blockSize);
+		for (std::size_t i = 0; i < m_blockSize; i++)
+		{
+			const float fade = (static_cast<float>(i) + 0.5f) * step;
+			const float from = m_result[m_blockSize + i];
+			output[i] = from + (m_resultNext[m_blockSize + i] - from) * fade;
+		}
+	}
+}
+
+void PartitionedConvolver::Convolve(unsigned int channel, const Filter& filter, std::vector<float>& result)
+{
+	std::fill(m_accumulator.begin(), m_accumulator.end(), std::complex<float>{});
+
+	// Partition p of the filter meets the input block from p blocks ago. Split real and imaginary
+	// parts are written out so the loop vectorizes without the NaN handling of complex multiply
+	const std::size_t partitions = min(filter.partitions, m_maxPartitions);
+	float* accumulator = reinterpret_cast<float*>(m_accumulator.data());
+	for (std::size_t p = 0; p < partitions; p++)
+	{
+		const std::size_t slot = (m_delayHead + p) % m_maxPartitions;
+		const float* x = reinterpret_cast<const float*>(m_delay.data() + (channel * m_maxPartitions + slot) * m_bins);
+		const float* h = reinterpret_cast<const float*>(filter.spectra.data() + p * m_bins);
+		for (std::size_t k = 0; k < m_bins * 2; k += 2)
+		{
+			accumulator[k] += x[k] * h[k] - x[k + 1] * h[k + 1];
+			accumulator[k + 1] += x[k] * h[k + 1] + x[k + 1] * h[k];
+		}
+	}
+
+	m_plan->Inverse(m_accumulator.data(), result.data());
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <complex>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include "FFTPlan.h"
+
+// Uniformly partitioned overlap-save convolution of interleaved audio with one FIR shared by all
+// channels. The FIR is cut into block-sized partitions whose spectra are multiplied against a
+// frequency-domain delay line of past input blocks, so each block costs one forward and one
+// inverse FFT of twice the block size plus one complex multiply-add per bin and partition.
+// Output lags the input by one block.
+class PartitionedConvolver
+{
+public:
+	// Frequency-domain FIR, built by Prepare away from the audio thread and then handed over
+	struct Filter
+	{
+		std::size_t blockSize = 0;
+		std::size_t partitions = 0;
+		std::vector<std::complex<float>> spectra; // [partition][bin]
+	};
+
+	// Splits tapCount taps into filter.blockSize partitions and transforms each, plan must be twice the block size
+	static void Prepare(FFTPlan& plan, const float* taps, std::size_t tapCount, Filter& filter);
+
+	// Allocates the delay line for filters of up to maxPartitions and clears it
+	void Configure(unsigned int channels, std::size_t blockSize, std::size_t maxPartitions);
+	void Reset();
+
+	// Convolves frameCount interleaved frames in place. With a next filter, the first block completed
+	// in this call crossfades from filter to next, after which next is in use and true is returned
+	bool Process(float* samples, std::size_t frameCount, const Filter& filter, const Filter* next = nullptr);
+
+	// Convolves exactly one block of interleaved frames, output gets that block's own result without
+	// the one block lag. For callers that already work in whole blocks, not to be mixed with Process
+	void ProcessBlock(const float* input, float* output, const Filter& filter);
+
+	unsigned int GetChannelCount() const
+	{
+		return m_channels;
+	}
+
+	std::size_t GetBlockSize() const
+	{
+		return m_blockSize;
+	}
+
+	// Frames the output trails the input by
+	std::size_t GetLatency() const
+	{
+		return m_blockSize;
+	}
+
+private:
+	// Transforms the block just collected and runs it through the filter(s)
+	void RunBlock(const Filter& filter, const Filter* next);
+
+	// Sums the delay line of one channel against filter and transforms it back into result
+	void Convolve(unsigned int channel, const Filter& filter, std::vector<float>& result);
+
+	unsigned int m_channels = 0;
+	std::size_t m_blockSize = 0;
+	std::size_t m_bins = 0;
+	std::size_t m_maxPartitions = 0;
+	std::unique_ptr<FFTPlan> m_plan;
+
+	// Per channel, [channel][...]
+	std::vector<float> m_previous;            // Block before the one being collected
+	std::vector<float> m_input;               // Block being collected
+	std::vector<float> m_output;              // Block being played out
+	std::vector<std::complex<float>> m_delay; // [channel][partition][bin], newest at m_delayHead
+	std::size_t m_delayHead = 0;
+	std::size_t m_position = 0;
+
+	// Scratch
+	std::vector<float> m_time;
+	std::vector<std::complex<float>> m_accumulator;
+	std::vector<float> m_result;
+	std::vector<float> m_resultNext;
+};
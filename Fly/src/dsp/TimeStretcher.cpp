@@ -0,0 +1,283 @@
+#include "pch.h"
+
+#include "TimeStretcher.h"
+
+#include <emmintrin.h>
+
+void TimeStretcher::Configure(unsigned int channels, unsigned int sampleRate)
+{
+	m_channels = max(channels, 1u);
+	m_sampleRate = sampleRate;
+
+	// 20 ms frames, a multiple of 8 so the half frame correlates in whole SSE registers
+	m_frameSize = max(64u, (sampleRate / 50) & ~7u);
+	m_hop = m_frameSize / 2;
+	m_tolerance = max(8u, sampleRate / 200);
+
+	// Periodic Hann, which sums to exactly one at half a frame of overlap
+	m_window.resize(m_frameSize);
+	for (std::size_t n = 0; n < m_frameSize; n++)
+	{
+		m_window[n] = 0.5f - 0.5f * std::cos(2.0f * M_PI * static_cast<float>(n) / static_cast<float>(m_frameSize));
+	}
+
+	m_overlap.resize(m_hop * m_channels);
+	m_frame.resize(m_frameSize * m_channels);
+	m_target.resize(m_hop);
+	m_candidates.resize(m_tolerance * 2 + m_hop);
+
+	Reset();
+
+	LOG_DEBUG("Time stretcher configured for {} channels at {} Hz, {} frame window", channels, sampleRate, m_frameSize);
+}
+
+void TimeStretcher::Reset()
+{
+	m_input.clear();
+	m_inputStart = 0;
+	m_inputEnd = 0;
+	m_flushing = false;
+	m_finished = false;
+
+	m_position = 0.0;
+	m_continuation = -1;
+	std::fill(m_overlap.begin(), m_overlap.end(), 0.0f);
+
+	m_output.clear();
+	m_outputRead = 0;
+	m_blocks.clear();
+	m_blockPulled = 0;
+}
+
+void TimeStretcher::SetSpeed(float speed)
+{
+	m_speed = std::clamp(speed, MIN_SPEED, MAX_SPEED);
+}
+
+void TimeStretcher::Push(const float* samples, std::size_t frameCount)
+{
+	m_input.insert(m_input.end(), samples, samples + frameCount * m_channels);
+	m_inputEnd += static_cast<std::int64_t>(frameCount);
+	Run();
+}
+
+void TimeStretcher::Flush()
+{
+	m_flushing = true;
+	Run();
+}
+
+bool TimeStretcher::IsDrained() const
+{
+	return m_finished && GetAvailable() == 0;
+}
+
+double TimeStretcher::GetOutputPosition() const
+{
+	if (m_blocks.empty())
+		return m_position;
+
+	const Block& block = m_blocks.front();
+	return block.position + static_cast<double>(m_blockPulled) * block.step;
+}
+
+double TimeStretcher::GetInputSpan(std::size_t frameCount) const
+{
+	double span = 0.0;
+	std::size_t pulled = m_blockPulled;
+	for (const Block& block: m_blocks)
+	{
+		if (frameCount == 0)
+			break;
+
+		const std::size_t take = min(frameCount, block.frames - pulled);
+		span += static_cast<double>(take) * block.step;
+		frameCount -= take;
+		pulled = 0;
+	}
+
+	return span + static_cast<double>(frameCount) * m_speed;
+}
+
+std::size_t TimeStretcher::Pull(float* samples, std::size_t maxFrames)
+{
+	const std::size_t frames = min(maxFrames, GetAvailable());
+	const std::size_t count = frames * m_channels;
+	std::copy(m_output.begin() + m_outputRead, m_output.begin() + m_outputRead + count, samples);
+	m_outputRead += count;
+
+	if (m_outputRead == m_output.size())
+	{
+		m_output.clear();
+		m_outputRead = 0;
+	}
+
+	std::size_t remaining = frames;
+	while (remaining > 0 && !m_blocks.empty())
+	{
+		const std::size_t take = min(remaining, m_blocks.front().frames - m_blockPulled);
+		m_blockPulled += take;
+		remaining -= take;
+		if (m_blockPulled == m_blocks.front().frames)
+		{
+			m_blocks.pop_front();
+			m_blockPulled = 0;
+		}
+	}
+
+	return frames;
+}
+
+void TimeStretcher::Run()
+{
+	// Make room first, unread output only moves when more than half of it has been pulled
+	if (m_outputRead > 0 && m_outputRead * 2 >= m_output.size())
+	{
+		m_output.erase(m_output.begin(), m_output.begin() + m_outputRead);
+		m_outputRead = 0;
+	}
+
+	while (RunFrame())
+	{
+	}
+
+	// Input the next frame can no longer reach is dropped in one go rather than every frame
+	std::int64_t keep = std::llround(m_position) - static_cast<std::int64_t>(m_tolerance);
+	if (m_continuation >= 0)
+	{
+		keep = min(keep, m_continuation);
+	}
+	const std::int64_t drop = min(keep, m_inputEnd) - m_inputStart;
+	if (drop > 0)
+	{
+		m_input.erase(m_input.begin(), m_input.begin() + drop * m_channels);
+		m_inputStart += drop;
+	}
+}
+
+bool TimeStretcher::RunFrame()
+{
+	if (m_finished)
+		return false;
+
+	const std::int64_t nominal = std::llround(m_position);
+	const std::size_t halfSamples = m_hop * m_channels;
+
+	// Past the end of flushed input, all that is left is the second half of the last frame
+	if (m_flushing && nominal >= m_inputEnd)
+	{
+		m_output.insert(m_output.end(), m_overlap.begin(), m_overlap.end());
+		m_blocks.push_back({ m_position, m_speed, m_hop });
+		m_finished = true;
+		return true;
+	}
+
+	// At 1x nothing needs searching, frames simply follow on from the last one
+	const bool straight = m_speed == 1.0f && m_continuation >= 0;
+	const std::int64_t searchEnd = straight ? m_continuation : nominal + static_cast<std::int64_t>(m_tolerance);
+	if (!m_flushing && searchEnd + static_cast<std::int64_t>(m_frameSize) > m_inputEnd)
+		return false;
+
+	std::int64_t start = nominal;
+	if (straight)
+	{
+		start = m_continuation;
+	}
+	else if (m_continuation >= 0)
+	{
+		start = nominal + FindBestOffset(nominal);
+	}
+
+	// The first half completes the last frame's overlap and goes out, the second half waits for the next frame
+	ReadInput(start, m_frameSize, m_frame.data());
+	const std::size_t outputSize = m_output.size();
+	m_output.resize(outputSize + halfSamples);
+	float* output = m_output.data() + outputSize;
+	for (std::size_t n = 0; n < m_hop; n++)
+	{
+		const float rising = m_window[n];
+		const float falling = m_window[n + m_hop];
+		for (unsigned int channel = 0; channel < m_channels; channel++)
+		{
+			const std::size_t i = n * m_channels + channel;
+			output[i] = m_overlap[i] + m_frame[i] * rising;
+			m_overlap[i] = m_frame[i + halfSamples] * falling;
+		}
+	}
+
+	m_blocks.push_back({ m_position, m_speed, m_hop });
+	m_continuation = start + static_cast<std::int64_t>(m_hop);
+	m_position += static_cast<double>(m_hop) * m_speed;
+	return true;
+}
+
+std::int64_t TimeStretcher::FindBestOffset(std::int64_t nominal)
+{
+	// What the last frame would have carried on with, against every candidate start around the nominal one
+	const std::int64_t first = nominal - static_cast<std::int64_t>(m_tolerance);
+	const std::size_t lags = m_tolerance * 2 + 1;
+	ReadMix(m_continuation, m_hop, m_target.data());
+	ReadMix(first, lags - 1 + m_hop, m_candidates.data());
+
+	std::size_t bestLag = m_tolerance;
+	float bestScore = -std::numeric_limits<float>::infinity();
+	for (std::size_t lag = 0; lag < lags; lag++)
+	{
+		// Correlation and candidate energy in one pass, four samples at a time
+		const float* candidate = m_candidates.data() + lag;
+		__m128 correlation = _mm_setzero_ps();
+		__m128 energy = _mm_setzero_ps();
+		for (std::size_t n = 0; n < m_hop; n += 4)
+		{
+			const __m128 x = _mm_loadu_ps(candidate + n);
+			correlation = _mm_add_ps(correlation, _mm_mul_ps(x, _mm_loadu_ps(m_target.data() + n)));
+			energy = _mm_add_ps(energy, _mm_mul_ps(x, x));
+		}
+
+		// Horizontal sums, correlation in the low half and energy in the high half
+		__m128 sums = _mm_add_ps(_mm_unpacklo_ps(correlation, energy), _mm_unpackhi_ps(correlation, energy));
+		sums = _mm_add_ps(sums, _mm_movehl_ps(sums, sums));
+		alignas(16) float totals[4];
+		_mm_store_ps(totals, sums);
+
+		const float score = totals[0] / std::sqrt(totals[1] + 1e-9f);
+		if (score > bestScore)
+		{
+			bestScore = score;
+			bestLag = lag;
+		}
+	}
+
+	return static_cast<std::int64_t>(bestLag) - static_cast<std::int64_t>(m_tolerance);
+}
+
+void TimeStretcher::ReadInput(std::int64_t start, std::size_t frameCount, float* out) const
+{
+	const std::int64_t end = start + static_cast<std::int64_t>(frameCount);
+	const std::int64_t from = std::clamp(start, m_inputStart, m_inputEnd);
+	const std::int64_t to = std::clamp(end, m_inputStart, m_inputEnd);
+
+	std::fill(out, out + frameCount * m_channels, 0.0f);
+	if (to > from)
+	{
+		std::copy(m_input.begin() + (from - m_inputStart) * m_channels, m_input.begin() + (to - m_inputStart) * m_channels, out + (from - start) * m_channels);
+	}
+}
+
+void TimeStretcher::ReadMix(std::int64_t start, std::size_t frameCount, float* out) const
+{
+	for (std::size_t n = 0; n < frameCount; n++)
+	{
+		const std::int64_t frame = start + static_cast<std::int64_t>(n);
+		float sum = 0.0f;
+		if (frame >= m_inputStart && frame < m_inputEnd)
+		{
+			const float* input = m_input.data() + (frame - m_inputStart) * m_channels;
+			for (unsigned int channel = 0; channel < m_channels; channel++)
+			{
+				sum += input[channel];
+			}
+		}
+		out[n] = sum;
+	}
+}
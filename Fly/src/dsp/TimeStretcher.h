@@ -0,0 +1,130 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+// Changes tempo without touching pitch, by WSOLA on interleaved audio. Hann frames of about 20 ms
+// are overlap-added at half a frame apart on the output and taken from the input at that hop times
+// the speed. Each frame is shifted by up to 5 ms to wherever it best continues the previous one,
+// found by normalized cross-correlation of the channel mix with SSE, so waveforms line up and
+// nothing phasey is heard. At 1x the frames are copied straight through.
+//
+// Input and output run at different rates, so every pulled frame carries the input position it
+// was taken from. Positions count input frames since the last Reset.
+class TimeStretcher
+{
+public:
+	static constexpr float MIN_SPEED = 0.5f;
+	static constexpr float MAX_SPEED = 2.0f;
+
+	// Sizes the frames for the layout and resets
+	void Configure(unsigned int channels, unsigned int sampleRate);
+
+	// Drops all input and output, positions start again from zero
+	void Reset();
+
+	unsigned int GetChannelCount() const
+	{
+		return m_channels;
+	}
+
+	unsigned int GetSampleRate() const
+	{
+		return m_sampleRate;
+	}
+
+	// Takes effect from the next frame, clamped to MIN_SPEED to MAX_SPEED
+	void SetSpeed(float speed);
+
+	float GetSpeed() const
+	{
+		return m_speed;
+	}
+
+	void Push(const float* samples, std::size_t frameCount);
+
+	// No more input is coming, the rest of the input is stretched out and the output runs dry after it
+	void Flush();
+
+	bool IsFlushing() const
+	{
+		return m_flushing;
+	}
+
+	// Output frames ready to be pulled
+	std::size_t GetAvailable() const
+	{
+		return (m_output.size() - m_outputRead) / m_channels;
+	}
+
+	// Flushing and everything has been pulled
+	bool IsDrained() const;
+
+	// Input frames pushed since the last Reset
+	std::int64_t GetInputFrames() const
+	{
+		return m_inputEnd;
+	}
+
+	// Input position the next pulled frame was taken from
+	double GetOutputPosition() const;
+
+	// Input frames covered by the next frameCount output frames
+	double GetInputSpan(std::size_t frameCount) const;
+
+	std::size_t Pull(float* samples, std::size_t maxFrames);
+
+private:
+	// Output frames of one frame, all taken from the input at one speed
+	struct Block
+	{
+		double position; // Input position of the first frame
+		double step;     // Input frames per output frame
+		std::size_t frames;
+	};
+
+	// Runs frames while the input reaches far enough, each adds one half frame of output
+	void Run();
+	bool RunFrame();
+
+	// Offset from the nominal position that best continues the previous frame
+	std::int64_t FindBestOffset(std::int64_t nominal);
+
+	// Copies input frames [start, start + frameCount), zero outside what is held
+	void ReadInput(std::int64_t start, std::size_t frameCount, float* out) const;
+
+	// Channel mix of input frames [start, start + frameCount), zero outside what is held
+	void ReadMix(std::int64_t start, std::size_t frameCount, float* out) const;
+
+	unsigned int m_channels = 1;
+	unsigned int m_sampleRate = 0;
+	float m_speed = 1.0f;
+	std::size_t m_frameSize = 0; // Frames of the Hann window, the output hop is half of it
+	std::size_t m_hop = 0;
+	std::size_t m_tolerance = 0; // Largest shift from the nominal position, either way
+	std::vector<float> m_window;
+
+	// Input, interleaved, m_input[0] is input position m_inputStart
+	std::vector<float> m_input;
+	std::int64_t m_inputStart = 0;
+	std::int64_t m_inputEnd = 0;
+	bool m_flushing = false;
+	bool m_finished = false; // Flushed and the last half frame has gone out
+
+	double m_position = 0.0;          // Nominal input position of the next frame
+	std::int64_t m_continuation = -1; // Where the last frame would naturally carry on, -1 before the first
+	std::vector<float> m_overlap;     // Second half of the last frame, windowed
+
+	// Output, interleaved, and the input positions it came from
+	std::vector<float> m_output;
+	std::size_t m_outputRead = 0; // Samples of m_output already pulled
+	std::deque<Block> m_blocks;
+	std::size_t m_blockPulled = 0; // Frames of the front block already pulled
+
+	// Scratch
+	std::vector<float> m_frame;
+	std::vector<float> m_target;
+	std::vector<float> m_candidates;
+};
@@ -0,0 +1,193 @@
+#include "pch.h"
+
+#include "Test.h"
+#include "TestSignals.h"
+
+#include "BarRenderer.h"
+
+// BarRenderer in a headless ImGui context: the quads it writes against the curve worked out with
+// std::pow, and a whole UI frame with the bars in it next to the per-bar ImGui items it replaced,
+// in vertices and CPU time per frame
+namespace
+{
+	constexpr float CURVE_EXPONENT = 0.7f;
+	constexpr float HEIGHT = 100.0f;
+	constexpr float MIN_HEIGHT = 2.0f;
+	constexpr float SPACING = 2.0f;
+
+	// An ImGui context with a built font atlas and no backend, enough to run frames and read their draw data
+	class HeadlessImGui
+	{
+	public:
+		HeadlessImGui()
+		      : m_context(ImGui::CreateContext())
+		{
+			ImGuiIO& io = ImGui::GetIO();
+			io.DisplaySize = ImVec2(4096.0f, 1024.0f);
+			io.DeltaTime = 1.0f / 60.0f;
+			io.IniFilename = nullptr;
+			unsigned char* pixels = nullptr;
+			int width = 0, height = 0;
+			io.Fonts->GetTexDataAsRGBA32(&pixels, &width, &height);
+		}
+
+		~HeadlessImGui()
+		{
+			ImGui::DestroyContext(m_context);
+		}
+
+		HeadlessImGui(const HeadlessImGui&) = delete;
+		HeadlessImGui& operator=(const HeadlessImGui&) = delete;
+
+		// One frame with a borderless window wide enough for every bar, returns the vertices it submitted
+		template<typename Body>
+		int Frame(Body&& body)
+		{
+			ImGui::NewFrame();
+			ImGui::SetNextWindowPos(ImVec2(0.0f, 0.0f));
+			ImGui::SetNextWindowSize(ImVec2(ImGui::GetIO().DisplaySize.x, HEIGHT));
+			ImGui::Begin("Bars", nullptr, ImGuiWindowFlags_NoDecoration | ImGuiWindowFlags_NoSavedSettings);
+			body();
+			ImGui::End();
+			ImGui::Render();
+			return ImGui::GetDrawData()->TotalVtxCount;
+		}
+
+	private:
+		ImGuiContext* m_context;
+	};
+
+	// Levels spread over the whole range, ends included, peaks a little above
+	void MakeLevels(std::size_t count, std::vector<float>& levels, std::vector<float>& peaks)
+	{
+		const std::vector<float> noise = Test::MakeNoise(count);
+		levels.resize(count);
+		peaks.resize(count);
+		for (std::size_t i = 0; i < count; i++)
+		{
+			levels[i] = noise[i] + 0.5f;
+			peaks[i] = min(levels[i] + 0.1f, 1.0f);
+		}
+		levels[0] = 0.0f;
+		levels[count - 1] = 1.0f;
+	}
+
+	// What Window::RenderBarSpectrum did before BarRenderer, an ImGui item and two rectangles per bar
+	void DrawPerBar(const std::vector<float>& levels, const std::vector<float>& peaks)
+	{
+		const ImVec4 barColor(0.3f, 0.5f, 0.8f, 1.0f);
+		const float height = ImGui::GetContentRegionAvail().y;
+		const float count = static_cast<float>(levels.size());
+		const float barWidth = (ImGui::GetContentRegionAvail().x - SPACING * (count - 1.0f)) / count;
+		const float centerY = height / 2.0f;
+
+		ImGui::PushStyleVar(ImGuiStyleVar_ItemSpacing, ImVec2(SPACING, 0));
+		for (std::size_t i = 0; i < levels.size(); i++)
+		{
+			const float value = std::pow(levels[i], CURVE_EXPONENT);
+			const float peak = std::pow(peaks[i], CURVE_EXPONENT);
+			const float halfHeight = max(value * (height * 0.95f), MIN_HEIGHT) / 2.0f;
+
+			ImGui::PushID(static_cast<int>(i));
+			const ImVec2 cursorPos = ImGui::GetCursorScreenPos();
+			ImDrawList* drawList = ImGui::GetWindowDrawList();
+			const ImVec4 gradientTop(barColor.x * 1.2f, barColor.y * 1.2f, barColor.z * 1.2f, barColor.w);
+			drawList->AddRectFilledMultiColor(ImVec2(cursorPos.x, cursorPos.y + centerY - halfHeight), ImVec2(cursorPos.x + barWidth, cursorPos.y + centerY + halfHeight),
+			                                  ImGui::GetColorU32(gradientTop), ImGui::GetColorU32(gradientTop), ImGui::GetColorU32(barColor), ImGui::GetColorU32(barColor));
+
+			const float peakY = cursorPos.y + centerY - peak * (height * 0.95f) / 2.0f;
+			drawList->AddRectFilled(ImVec2(cursorPos.x, peakY), ImVec2(cursorPos.x + barWidth, peakY + 1.0f), ImGui::GetColorU32(gradientTop));
+
+			ImGui::Dummy(ImVec2(barWidth, height));
+			if (i < levels.size() - 1)
+			{
+				ImGui::SameLine();
+			}
+			ImGui::PopID();
+		}
+		ImGui::PopStyleVar();
+	}
+} // namespace
+
+TEST(BarRendererGeometry)
+{
+	// Each bar is a quad centered on the middle, its half height the curved level or half the
+	// minimum, then a one pixel peak line above it
+	constexpr std::size_t COUNT = 256;
+	std::vector<float> levels, peaks;
+	MakeLevels(COUNT, levels, peaks);
+
+	HeadlessImGui imgui;
+	BarRenderer renderer(CURVE_EXPONENT);
+	renderer.SetSpacing(SPACING);
+	renderer.SetMinHeight(MIN_HEIGHT);
+	const ImVec2 pos(10.0f, 20.0f), size(1024.0f, HEIGHT);
+
+	int first = 0, last = 0;
+	std::vector<ImDrawVert> vertices;
+	imgui.Frame(
+	        [&]()
+	        {
+		        ImDrawList* drawList = ImGui::GetWindowDrawList();
+		        first = drawList->VtxBuffer.Size;
+		        renderer.Draw(drawList, pos, size, levels.data(), peaks.data(), static_cast<int>(COUNT));
+		        last = drawList->VtxBuffer.Size;
+		        vertices.assign(drawList->VtxBuffer.Data + first, drawList->VtxBuffer.Data + last);
+	        });
+	CHECK(renderer.GetLastVertexCount() == static_cast<int>(COUNT * 8));
+	CHECK(last - first == renderer.GetLastVertexCount());
+
+	if (vertices.size() != COUNT * 8)
+		return;
+
+	const float barWidth = (size.x - SPACING * static_cast<float>(COUNT - 1)) / static_cast<float>(COUNT);
+	const float centerY = pos.y + size.y * 0.5f;
+	const float scale = size.y * 0.95f * 0.5f;
+	float worst = 0.0f;
+	for (std::size_t i = 0; i < COUNT; i++)
+	{
+		const ImDrawVert* bar = vertices.data() + i * 8;
+		const float x0 = pos.x + (barWidth + SPACING) * static_cast<float>(i);
+		const float halfHeight = max(std::pow(levels[i], CURVE_EXPONENT) * scale, MIN_HEIGHT * 0.5f);
+		const float peakY = centerY - std::pow(peaks[i], CURVE_EXPONENT) * scale;
+		worst = max(worst, std::abs(bar[0].pos.x - x0));
+		worst = max(worst, std::abs(bar[2].pos.x - (x0 + barWidth)));
+		worst = max(worst, std::abs(bar[0].pos.y - (centerY - halfHeight)));
+		worst = max(worst, std::abs(bar[2].pos.y - (centerY + halfHeight)));
+		worst = max(worst, std::abs(bar[4].pos.y - peakY));
+		worst = max(worst, std::abs(bar[6].pos.y - (peakY + 1.0f)));
+	}
+	CHECK_MESSAGE(worst < 1e-3f, "bars are off by {:.2e} pixels", worst);
+}
+
+BENCHMARK(BarRendererFrame)
+{
+	// A whole UI frame, NewFrame to Render, with nothing else in it. The vertices include the window background
+	HeadlessImGui imgui;
+	for (const std::size_t count: { 23, 256, 1024 })
+	{
+		std::vector<float> levels, peaks;
+		MakeLevels(count, levels, peaks);
+
+		BarRenderer renderer(CURVE_EXPONENT);
+		renderer.SetSpacing(SPACING);
+		renderer.SetMinHeight(MIN_HEIGHT);
+		int batchedVertices = 0;
+		const double batchedSeconds = Test::Time(
+		        [&]()
+		        {
+			        batchedVertices = imgui.Frame(
+			                [&]()
+			                {
+				                const ImVec2 size = ImGui::GetContentRegionAvail();
+				                renderer.Draw(ImGui::GetWindowDrawList(), ImGui::GetCursorScreenPos(), size, levels.data(), peaks.data(), static_cast<int>(count));
+				                ImGui::Dummy(size);
+			                });
+		        });
+		Test::Report(std::format("BarRenderer {} bars, {} vertices", count, batchedVertices), batchedSeconds, 1.0, "frame");
+
+		int perBarVertices = 0;
+		const double perBarSeconds = Test::Time([&]() { perBarVertices = imgui.Frame([&]() { DrawPerBar(levels, peaks); }); });
+		Test::Report(std::format("Per-bar items {} bars, {} vertices", count, perBarVertices), perBarSeconds, 1.0, "frame");
+	}
+}
@@ -0,0 +1,186 @@
+#include "pch.h"
+
+#include "Test.h"
+#include "TestSignals.h"
+
+#include "ConvolutionReverb.h"
+
+#include <thread>
+
+// ConvolutionReverb against a direct convolution with the same response, across the split between
+// the head and the tail and with buffers cut at odd sizes, and its cost per frame by response length
+// and block size. The response is prepared on another thread, so every case waits for it first
+namespace
+{
+	// Decaying noise, a different one per channel, the way a recorded room looks
+	std::vector<float> MakeResponse(double seconds, unsigned int channels = Test::CHANNELS)
+	{
+		const std::size_t frames = static_cast<std::size_t>(seconds * Test::SAMPLE_RATE);
+		std::vector<float> samples = Test::MakeNoise(frames * channels, 3);
+		for (std::size_t frame = 0; frame < frames; frame++)
+		{
+			const float decay = std::exp(-6.9f * static_cast<float>(frame) / static_cast<float>(frames));
+			for (unsigned int channel = 0; channel < channels; channel++)
+			{
+				samples[frame * channels + channel] *= decay;
+			}
+		}
+		return samples;
+	}
+
+	// The same unit energy in the loudest channel the reverb scales the response to
+	std::vector<double> Normalize(const std::vector<float>& samples, unsigned int channels)
+	{
+		std::vector<double> energy(channels, 0.0);
+		for (std::size_t i = 0; i < samples.size(); i++)
+		{
+			energy[i % channels] += static_cast<double>(samples[i]) * samples[i];
+		}
+		const double scale = 1.0 / std::sqrt(*std::max_element(energy.begin(), energy.end()));
+		std::vector<double> normalized(samples.size());
+		for (std::size_t i = 0; i < samples.size(); i++)
+		{
+			normalized[i] = samples[i] * scale;
+		}
+		return normalized;
+	}
+
+	// Feeds silence until the convolution for the stream is in, false if it takes longer than the timeout
+	bool WaitForConvolution(const ConvolutionReverb& reverb, const std::function<void(std::vector<float>&, unsigned int, unsigned int)>& processor, std::size_t latency,
+	                        double timeoutSeconds = 30.0)
+	{
+		std::vector<float> silence;
+		const auto start = std::chrono::steady_clock::now();
+		while (reverb.GetLatency() != latency)
+		{
+			if (std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() > timeoutSeconds)
+				return false;
+
+			silence.assign(256 * Test::CHANNELS, 0.0f);
+			processor(silence, Test::CHANNELS, Test::SAMPLE_RATE);
+			std::this_thread::sleep_for(std::chrono::milliseconds(5));
+		}
+		return true;
+	}
+} // namespace
+
+TEST(ConvolutionReverbMatchesDirect)
+{
+	// Half a second at 64 frame blocks reaches well past what the head covers, so the windows check
+	// the head alone, the hand-over to the tail and the tail alone
+	const std::vector<float> response = MakeResponse(0.5);
+	const std::vector<double> taps = Normalize(response, Test::CHANNELS);
+	const std::size_t tapFrames = taps.size() / Test::CHANNELS;
+
+	ConvolutionReverb reverb;
+	reverb.SetBlockSize(64);
+	reverb.SetMix(1.0f);
+	reverb.SetEnabled(true);
+	CHECK(reverb.SetImpulseResponse(response, Test::CHANNELS, Test::SAMPLE_RATE, "Decay"));
+	auto processor = reverb.CreateProcessor();
+	CHECK(WaitForConvolution(reverb, processor, 64));
+	CHECK(reverb.GetTailLength() == tapFrames);
+
+	// Calls of every size up to a whole stream buffer, none of them a multiple of a block
+	const std::size_t frames = Test::SAMPLE_RATE * 2;
+	const std::vector<float> input = Test::MakeNoise(frames * Test::CHANNELS, 5);
+	std::vector<float> output;
+	std::vector<float> buffer;
+	const std::size_t sizes[] = { 1000, 16384, 37, 5001, 12345, 64, 777 };
+	for (std::size_t frame = 0, call = 0; frame < frames; call++)
+	{
+		const std::size_t count = min(sizes[call % std::size(sizes)], frames - frame);
+		buffer.assign(input.begin() + static_cast<std::ptrdiff_t>(frame * Test::CHANNELS), input.begin() + static_cast<std::ptrdiff_t>((frame + count) * Test::CHANNELS));
+		processor(buffer, Test::CHANNELS, Test::SAMPLE_RATE);
+		output.insert(output.end(), buffer.begin(), buffer.end());
+		frame += count;
+	}
+
+	// Everything before came in as silence, so the output is the input convolved and delayed by a head block
+	double worst = 0.0;
+	for (const std::size_t begin: { 2000, 16700, 40000, 90000 })
+	{
+		for (std::size_t frame = begin; frame < begin + 512; frame++)
+		{
+			for (unsigned int channel = 0; channel < Test::CHANNELS; channel++)
+			{
+				double expected = 0.0;
+				const std::size_t last = min(frame - 64, tapFrames - 1);
+				for (std::size_t tap = 0; tap <= last; tap++)
+				{
+					expected += taps[tap * Test::CHANNELS + channel] * input[(frame - 64 - tap) * Test::CHANNELS + channel];
+				}
+				worst = max(worst, std::abs(expected - static_cast<double>(output[frame * Test::CHANNELS + channel])));
+			}
+		}
+	}
+	CHECK_MESSAGE(worst < 1e-4, "differs from the direct convolution by {:.2e}", worst);
+}
+
+TEST(ConvolutionReverbBlockSizeChange)
+{
+	// A new block size is prepared while the old convolution keeps running, the output never drops to dry
+	ConvolutionReverb reverb;
+	reverb.SetBlockSize(128);
+	reverb.SetMix(1.0f);
+	reverb.SetEnabled(true);
+	reverb.SetImpulseResponse(MakeResponse(1.0), Test::CHANNELS, Test::SAMPLE_RATE, "Decay");
+	auto processor = reverb.CreateProcessor();
+	CHECK(WaitForConvolution(reverb, processor, 128));
+
+	reverb.SetBlockSize(1024);
+	std::vector<float> buffer;
+	const auto start = std::chrono::steady_clock::now();
+	std::size_t switchedAfter = 0;
+	for (std::size_t call = 0; reverb.GetLatency() != 1024; call++)
+	{
+		CHECK_MESSAGE(reverb.GetLatency() == 128, "latency {} while switching", reverb.GetLatency());
+		if (reverb.GetLatency() != 128 || std::chrono::steady_clock::now() - start > std::chrono::seconds(30))
+			break;
+
+		buffer = Test::MakeNoise(1024 * Test::CHANNELS);
+		processor(buffer, Test::CHANNELS, Test::SAMPLE_RATE);
+		switchedAfter = call + 1;
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	CHECK_MESSAGE(reverb.GetLatency() == 1024, "still at {} after {} calls", reverb.GetLatency(), switchedAfter);
+}
+
+BENCHMARK(ConvolutionReverbThroughput)
+{
+	// Whole stream buffers of noise, per frame. Back to back the calls catch up with the worker, so
+	// this is what both threads manage together, far faster than the stream asks for. Preparing is
+	// the time from handing the response over to the first buffer that runs it
+	const std::size_t frames = AUDIO_STREAM_BUFFER_SIZE / Test::CHANNELS;
+	for (const double seconds: { 1.0, 3.0, 10.0 })
+	{
+		const std::vector<float> response = MakeResponse(seconds);
+		for (const std::size_t blockSize: { 128, 512, 2048 })
+		{
+			ConvolutionReverb reverb;
+			reverb.SetBlockSize(blockSize);
+			reverb.SetEnabled(true);
+			auto processor = reverb.CreateProcessor();
+			const auto start = std::chrono::steady_clock::now();
+			reverb.SetImpulseResponse(response, Test::CHANNELS, Test::SAMPLE_RATE, "Decay");
+			CHECK(WaitForConvolution(reverb, processor, blockSize, 120.0));
+			const double prepare = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+			std::vector<float> buffer = Test::MakeNoise(frames * Test::CHANNELS);
+			double longest = 0.0;
+			const double callSeconds = Test::Time(
+			        [&]()
+			        {
+				        const auto callStart = std::chrono::steady_clock::now();
+				        processor(buffer, Test::CHANNELS, Test::SAMPLE_RATE);
+				        const double call = std::chrono::duration<double>(std::chrono::steady_clock::now() - callStart).count();
+				        longest = max(longest, call);
+				        Test::Consume(buffer[0]);
+			        },
+			        1.0);
+			Test::Report(std::format("{:.0f} s response, {} frame blocks, {:.0f}x realtime, longest call {:.2f} ms, prepared in {:.0f} ms", seconds, blockSize,
+			                         static_cast<double>(frames) / Test::SAMPLE_RATE / callSeconds, longest * 1e3, prepare * 1e3),
+			             callSeconds, static_cast<double>(frames), "frame");
+		}
+	}
+}
@@ -0,0 +1,195 @@
+#include "pch.h"
+
+#include "Test.h"
+
+#include <random>
+#include <sndfile.h>
+
+#include "decoders/DecoderRegistry.h"
+#include "decoders/DrFlacDecoder.h"
+#include "decoders/DrMp3Decoder.h"
+#include "decoders/PcmCache.h"
+#include "decoders/SndFileDecoder.h"
+
+// Decode and seek speed of every backend that can open a file, and whether DecoderRegistry picks
+// the fastest of them, then the same file stored in and read back from the PCM cache. Runs on the
+// files given after --input, otherwise on a WAV and a FLAC file written with libsndfile. MP3 needs
+// real files, this libsndfile build cannot encode it
+namespace
+{
+	constexpr std::size_t READ_FRAMES = 4096;
+	constexpr std::size_t SEEKS = 64;
+	constexpr std::size_t SEEK_READ_FRAMES = 1024;
+
+	// A registry choice this close to the fastest backend is noise, not a wrong order
+	constexpr double ORDER_TOLERANCE = 0.9;
+
+	using DecoderFactory = std::unique_ptr<AudioDecoder> (*)();
+
+	const DecoderFactory BACKENDS[] = {
+		[]() -> std::unique_ptr<AudioDecoder> { return std::make_unique<DrMp3Decoder>(); },
+		[]() -> std::unique_ptr<AudioDecoder> { return std::make_unique<DrFlacDecoder>(); },
+		[]() -> std::unique_ptr<AudioDecoder> { return std::make_unique<SndFileDecoder>(); },
+	};
+
+	// A minute of chords and a little noise, something a lossless encoder has to work at
+	bool WriteTestFile(const std::filesystem::path& path, int format)
+	{
+		constexpr int SAMPLE_RATE = 44100;
+		constexpr std::size_t FRAMES = 60 * SAMPLE_RATE;
+
+		SF_INFO info{};
+		info.samplerate = SAMPLE_RATE;
+		info.channels = 2;
+		info.format = format;
+		SNDFILE* file = sf_open(path.string().c_str(), SFM_WRITE, &info);
+		if (!file)
+			return false;
+
+		std::mt19937 random(42);
+		std::uniform_real_distribution<float> noise(-0.01f, 0.01f);
+		std::vector<float> samples(FRAMES * 2);
+		for (std::size_t frame = 0; frame < FRAMES; frame++)
+		{
+			const double time = static_cast<double>(frame) / SAMPLE_RATE;
+			const double root = 110.0 * std::pow(2.0, static_cast<double>(frame / (2 * SAMPLE_RATE) % 5) / 12.0);
+			const double chord = std::sin(2.0 * M_PI * root * time) + 0.5 * std::sin(2.0 * M_PI * root * 1.5 * time) + 0.3 * std::sin(2.0 * M_PI * root * 2.52 * time);
+			samples[frame * 2] = static_cast<float>(0.3 * chord) + noise(random);
+			samples[frame * 2 + 1] = static_cast<float>(0.3 * chord) + noise(random);
+		}
+		sf_writef_float(file, samples.data(), static_cast<sf_count_t>(FRAMES));
+		sf_close(file);
+		return true;
+	}
+
+	std::vector<std::filesystem::path> GetBenchmarkFiles()
+	{
+		if (!Test::GetInputFiles().empty())
+			return Test::GetInputFiles();
+
+		const std::filesystem::path directory = std::filesystem::temp_directory_path() / "FlyTests";
+		std::filesystem::create_directories(directory);
+
+		std::vector<std::filesystem::path> files;
+		for (const auto& [name, format]: { std::pair{ "bench.wav", SF_FORMAT_WAV | SF_FORMAT_PCM_16 }, std::pair{ "bench.flac", SF_FORMAT_FLAC | SF_FORMAT_PCM_16 } })
+		{
+			const std::filesystem::path path = directory / name;
+			if (std::filesystem::exists(path) || WriteTestFile(path, format))
+			{
+				files.push_back(path);
+			}
+		}
+		return files;
+	}
+
+	struct Result
+	{
+		std::string backend;
+		double framesPerSecond{ 0.0 };
+	};
+
+	// Whole file front to back, in the streamer's chunk size
+	double TimeDecode(AudioDecoder& decoder, std::vector<float>& buffer)
+	{
+		return Test::Time(
+		        [&]()
+		        {
+			        decoder.Seek(0);
+			        while (decoder.ReadFrames(buffer.data(), READ_FRAMES) > 0)
+			        {
+			        }
+			        Test::Consume(buffer[0]);
+		        },
+		        1.0);
+	}
+
+	// Random seeks with the preroll the streamer decodes before each, and a short read after
+	double TimeSeeks(AudioDecoder& decoder, std::vector<float>& buffer)
+	{
+		const std::int64_t frames = decoder.GetFormat().frameCount;
+		const std::int64_t preroll = decoder.GetSeekPreroll();
+		std::mt19937 random(7);
+		std::uniform_int_distribution<std::int64_t> target(0, max(frames - static_cast<std::int64_t>(SEEK_READ_FRAMES), static_cast<std::int64_t>(0)));
+		return Test::Time(
+		        [&]()
+		        {
+			        for (std::size_t seek = 0; seek < SEEKS; seek++)
+			        {
+				        const std::int64_t frame = target(random);
+				        const std::int64_t start = max(frame - preroll, static_cast<std::int64_t>(0));
+				        decoder.Seek(start);
+				        std::size_t remaining = static_cast<std::size_t>(frame - start) + SEEK_READ_FRAMES;
+				        while (remaining > 0)
+				        {
+					        const std::size_t read = decoder.ReadFrames(buffer.data(), min(remaining, READ_FRAMES));
+					        if (read == 0)
+						        break;
+					        remaining -= read;
+				        }
+			        }
+			        Test::Consume(buffer[0]);
+		        },
+		        1.0);
+	}
+} // namespace
+
+BENCHMARK(DecoderBackends)
+{
+	// A cache of its own, emptied so every file is stored afresh
+	const std::filesystem::path cacheDirectory = std::filesystem::temp_directory_path() / "FlyTests" / "PcmCache";
+	std::error_code error;
+	std::filesystem::remove_all(cacheDirectory, error);
+	PcmCache& cache = PcmCache::Get();
+	cache.SetDirectory(cacheDirectory);
+	cache.SetEnabled(true);
+
+	for (const std::filesystem::path& path: GetBenchmarkFiles())
+	{
+		const std::string filename = path.string();
+		const std::string label = path.filename().string();
+		std::vector<Result> results;
+		for (const DecoderFactory create: BACKENDS)
+		{
+			std::unique_ptr<AudioDecoder> decoder = create();
+			if (!decoder->Open(filename))
+				continue;
+
+			const AudioDecoder::Format& format = decoder->GetFormat();
+			std::vector<float> buffer(READ_FRAMES * format.channelCount);
+			const double frames = static_cast<double>(format.frameCount);
+			const double decodeSeconds = TimeDecode(*decoder, buffer);
+			Test::Report(std::format("{} {} decode", label, decoder->GetName()), decodeSeconds, frames, "frame");
+			Test::Report(std::format("{} {} seek", label, decoder->GetName()), TimeSeeks(*decoder, buffer), SEEKS, "seek");
+			results.push_back({ decoder->GetName(), frames / decodeSeconds });
+		}
+
+		std::unique_ptr<AudioDecoder> chosen = DecoderRegistry::Get().OpenUncached(filename);
+		CHECK_MESSAGE(chosen != nullptr && !results.empty(), "no backend opens {}", label);
+		if (!chosen || results.empty())
+			continue;
+
+		const auto fastest = std::max_element(results.begin(), results.end(), [](const Result& a, const Result& b) { return a.framesPerSecond < b.framesPerSecond; });
+		const auto picked = std::find_if(results.begin(), results.end(), [&](const Result& result) { return result.backend == chosen->GetName(); });
+		CHECK_MESSAGE(picked != results.end() && picked->framesPerSecond >= fastest->framesPerSecond * ORDER_TOLERANCE, "the registry opens {} with {}, {} decodes it faster", label,
+		              chosen->GetName(), fastest->backend);
+
+		// Storing decodes the whole file once with the registry's choice, on the worker in the player.
+		// A hit skips the source format altogether, so it is left out of the order check
+		const auto storeStart = std::chrono::steady_clock::now();
+		const bool stored = cache.Store(filename);
+		const double storeSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - storeStart).count();
+		std::unique_ptr<AudioDecoder> cached = stored ? cache.Open(filename) : nullptr;
+		CHECK_MESSAGE(cached != nullptr, "the PCM cache does not hold {} after storing it", label);
+		if (!cached)
+			continue;
+
+		const AudioDecoder::Format& format = cached->GetFormat();
+		std::vector<float> buffer(READ_FRAMES * format.channelCount);
+		const double frames = static_cast<double>(format.frameCount);
+		Test::Report(std::format("{} {} store", label, cached->GetName()), storeSeconds, frames, "frame");
+		Test::Report(std::format("{} {} decode", label, cached->GetName()), TimeDecode(*cached, buffer), frames, "frame");
+		Test::Report(std::format("{} {} seek", label, cached->GetName()), TimeSeeks(*cached, buffer), SEEKS, "seek");
+	}
+
+	cache.SetEnabled(false);
+}
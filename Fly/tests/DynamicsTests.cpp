@@ -0,0 +1,108 @@
+#include "pch.h"
+
+#include "Test.h"
+#include "TestSignals.h"
+
+#include "Dynamics.h"
+#include "dsp/LoudnessMeter.h"
+
+// The limiter has to keep the true peak under its ceiling and delay the audio by exactly the
+// latency it reports, whether it is on or not, so switching it never moves the clock or clicks
+namespace
+{
+	Dynamics::Settings MakeSettings(bool limiterEnabled, float ceilingDb)
+	{
+		Dynamics::Settings settings;
+		settings.compressorEnabled = false;
+		settings.limiterEnabled = limiterEnabled;
+		settings.ceilingDb = ceilingDb;
+		return settings;
+	}
+
+	void Render(std::function<void(std::vector<float>&, unsigned int, unsigned int)>& processor, std::vector<float>& samples, std::size_t firstBlock, std::size_t blocks)
+	{
+		std::vector<float> block(Test::BLOCK_FRAMES * Test::CHANNELS);
+		for (std::size_t index = firstBlock; index < firstBlock + blocks; index++)
+		{
+			const auto start = samples.begin() + static_cast<std::ptrdiff_t>(index * block.size());
+			std::copy(start, start + static_cast<std::ptrdiff_t>(block.size()), block.begin());
+			processor(block, Test::CHANNELS, Test::SAMPLE_RATE);
+			std::copy(block.begin(), block.end(), start);
+		}
+	}
+} // namespace
+
+TEST(DynamicsTruePeakCeiling)
+{
+	// A quarter of the rate at 45 degrees puts every sample 3 dB under the peak between them, on a
+	// bass line that pushes the sum 8 dB over full scale
+	const std::size_t blocks = 24;
+	std::vector<float> samples = Test::MakeSine(100.0, blocks * Test::BLOCK_FRAMES, 1.0f);
+	for (std::size_t frame = 0; frame < blocks * Test::BLOCK_FRAMES; frame++)
+	{
+		const float value = static_cast<float>(1.5 * std::sin(M_PI * 0.5 * static_cast<double>(frame) + M_PI * 0.25));
+		samples[frame * Test::CHANNELS] += value;
+		samples[frame * Test::CHANNELS + 1] += value;
+	}
+
+	for (const float ceilingDb: { -1.0f, -6.0f })
+	{
+		Dynamics dynamics;
+		dynamics.SetSettings(MakeSettings(true, ceilingDb));
+		auto processor = dynamics.CreateProcessor();
+		std::vector<float> output = samples;
+		Render(processor, output, 0, blocks);
+
+		// Read the way the level meter and BS.1770 read it, at 4x. The limiter's gain lands right on
+		// the ceiling, a thousandth of a dB allows for the two ends' float rounding
+		LoudnessMeter meter;
+		meter.Configure(Test::CHANNELS, Test::SAMPLE_RATE);
+		meter.Process(output.data(), blocks * Test::BLOCK_FRAMES, 0);
+		CHECK_MESSAGE(meter.GetMaxTruePeak() <= ceilingDb + 0.001f, "true peak {:.3f} dBTP over a {} dBTP ceiling", meter.GetMaxTruePeak(), ceilingDb);
+	}
+}
+
+TEST(DynamicsLatency)
+{
+	// Quiet impulses come out exactly the reported latency later, limiter on or off, and the latency
+	// holds across switching it
+	Dynamics dynamics;
+	auto processor = dynamics.CreateProcessor();
+	std::size_t latency = 0;
+	for (std::size_t block = 0; block < 6; block++)
+	{
+		dynamics.SetSettings(MakeSettings(block % 2 == 0, -1.0f));
+		std::vector<float> samples(Test::BLOCK_FRAMES * Test::CHANNELS, 0.0f);
+		samples[(Test::BLOCK_FRAMES / 2) * Test::CHANNELS] = 0.5f;
+		processor(samples, Test::CHANNELS, Test::SAMPLE_RATE);
+		if (block == 0)
+			latency = dynamics.GetLatency();
+
+		CHECK_MESSAGE(dynamics.GetLatency() == latency, "latency moved from {} to {} in block {}", latency, dynamics.GetLatency(), block);
+		CHECK_MESSAGE(latency > 0 && samples[(Test::BLOCK_FRAMES / 2 + latency) * Test::CHANNELS] == 0.5f, "impulse not {} frames late in block {}", latency, block);
+	}
+	CHECK_MESSAGE(latency * 1000 >= static_cast<std::size_t>(Dynamics::LOOKAHEAD_MS) * Test::SAMPLE_RATE, "latency of {} frames is under the lookahead", latency);
+}
+
+TEST(DynamicsLimiterToggle)
+{
+	// A bass line held 6 dB down by the limiter, which is then switched off. The gain has to release
+	// rather than step, so the output moves no faster than the sine would at full level
+	Dynamics dynamics;
+	auto processor = dynamics.CreateProcessor();
+	std::vector<float> samples = Test::MakeSine(50.0, 16 * Test::BLOCK_FRAMES, 2.0f);
+	dynamics.SetSettings(MakeSettings(true, -6.0f));
+	Render(processor, samples, 0, 4);
+	dynamics.SetSettings(MakeSettings(false, -6.0f));
+	Render(processor, samples, 4, 12);
+
+	const float slope = static_cast<float>(2.0 * 2.0 * M_PI * 50.0 / Test::SAMPLE_RATE);
+	float largest = 0.0f;
+	for (std::size_t frame = Test::BLOCK_FRAMES; frame < samples.size() / Test::CHANNELS; frame++)
+	{
+		largest = max(largest, std::abs(samples[frame * Test::CHANNELS] - samples[(frame - 1) * Test::CHANNELS]));
+	}
+	CHECK_MESSAGE(largest <= slope * 1.05f, "output steps by {:.4f}, the sine by at most {:.4f}", largest, slope);
+	// Released all the way by the end, the last block only went through the delay line
+	CHECK(dynamics.GetLimiterReduction() == 0.0f);
+}
@@ -0,0 +1,64 @@
+#include "pch.h"
+
+#include "Test.h"
+#include "TestSignals.h"
+
+#include "Equalizer.h"
+
+// The equalizer only runs the bands that change the sound, so a 31-band curve with a few moved
+// sliders should cost about what those few cost. Checked on the active band count and timed
+namespace
+{
+	// Moves the first count of the 31 graphic bands, spread over the whole range rather than bunched at the bottom
+	void MoveBands(Equalizer& equalizer, std::size_t count)
+	{
+		equalizer.SetMode(Equalizer::Mode::Graphic31);
+		for (std::size_t i = 0; i < count; i++)
+		{
+			const std::size_t index = i * Equalizer::MAX_BANDS / max(count, static_cast<std::size_t>(1));
+			Equalizer::Band band = equalizer.GetBand(index);
+			band.gainDb = i % 2 ? -4.0f : 4.0f;
+			equalizer.SetBand(index, band);
+		}
+	}
+} // namespace
+
+TEST(EqualizerActiveBands)
+{
+	for (const std::size_t moved: { 0, 1, 4, 10, 31 })
+	{
+		Equalizer equalizer;
+		MoveBands(equalizer, moved);
+		auto processor = equalizer.CreateProcessor();
+
+		const std::vector<float> input = Test::MakeNoise(Test::BLOCK_FRAMES * Test::CHANNELS);
+		std::vector<float> buffer = input;
+		processor(buffer, Test::CHANNELS, Test::SAMPLE_RATE);
+
+		CHECK_MESSAGE(equalizer.GetActiveBandCount() == moved, "{} bands moved, {} active", moved, equalizer.GetActiveBandCount());
+		if (moved == 0)
+		{
+			// A flat curve has to leave the signal alone
+			CHECK(std::memcmp(buffer.data(), input.data(), input.size() * sizeof(float)) == 0);
+		}
+	}
+}
+
+BENCHMARK(EqualizerThroughput)
+{
+	for (const std::size_t moved: { 0, 1, 4, 10, 20, 31 })
+	{
+		Equalizer equalizer;
+		MoveBands(equalizer, moved);
+		auto processor = equalizer.CreateProcessor();
+
+		std::vector<float> buffer = Test::MakeNoise(Test::BLOCK_FRAMES * Test::CHANNELS);
+		const double seconds = Test::Time(
+		        [&]()
+		        {
+			        processor(buffer, Test::CHANNELS, Test::SAMPLE_RATE);
+			        Test::Consume(buffer[0]);
+		        });
+		Test::Report(std::format("31-band graphic, {} active", equalizer.GetActiveBandCount()), seconds, Test::BLOCK_FRAMES, "frame");
+	}
+}
@@ -0,0 +1,194 @@
+#include "pch.h"
+
+#include "Test.h"
+#include "TestSignals.h"
+
+#include "dsp/FFTPlan.h"
+
+#include <numbers>
+
+// FFTPlan against a direct DFT in double both ways, Inverse undoing Forward, and its speed next to
+// the visualizer's transform it replaced
+namespace
+{
+	// Every bin summed out in double, DC to Nyquist like Forward
+	std::vector<std::complex<double>> DirectDft(const std::vector<float>& samples)
+	{
+		const std::size_t size = samples.size();
+		std::vector<std::complex<double>> bins(size / 2 + 1);
+		for (std::size_t k = 0; k < bins.size(); k++)
+		{
+			std::complex<double> sum = 0.0;
+			for (std::size_t n = 0; n < size; n++)
+			{
+				const double angle = -2.0 * std::numbers::pi * static_cast<double>((k * n) % size) / static_cast<double>(size);
+				sum += static_cast<double>(samples[n]) * std::complex<double>(std::cos(angle), std::sin(angle));
+			}
+			bins[k] = sum;
+		}
+		return bins;
+	}
+
+	// The real signal of a half spectrum, with the 1 / size scale Inverse uses
+	std::vector<double> DirectInverse(const std::vector<std::complex<float>>& bins, std::size_t size)
+	{
+		std::vector<double> samples(size);
+		for (std::size_t n = 0; n < size; n++)
+		{
+			double sum = bins[0].real() + bins[size / 2].real() * ((n % 2) ? -1.0 : 1.0);
+			for (std::size_t k = 1; k < size / 2; k++)
+			{
+				const double angle = 2.0 * std::numbers::pi * static_cast<double>((k * n) % size) / static_cast<double>(size);
+				sum += 2.0 * (bins[k].real() * std::cos(angle) - bins[k].imag() * std::sin(angle));
+			}
+			samples[n] = sum / static_cast<double>(size);
+		}
+		return samples;
+	}
+
+	// The transform AudioVisualizer::PerformFFT ran before FFTPlan, kept as it was. The permutation
+	// pass ran once per sample, an even number of times, which left the input in its own order
+	void PerformFFT(std::vector<std::complex<float>>& fftInput)
+	{
+		size_t n = fftInput.size();
+		for (size_t k = 0; k < n; ++k)
+		{
+			size_t j = 0;
+			for (size_t i = 0; i < n; ++i)
+			{
+				if (i < j)
+				{
+					std::swap(fftInput[i], fftInput[j]);
+				}
+				size_t m = n >> 1;
+				while (j >= m && m > 0)
+				{
+					j -= m;
+					m >>= 1;
+				}
+				j += m;
+			}
+		}
+
+		for (size_t len = 2; len <= n; len <<= 1)
+		{
+			float angle = -2.0f * M_PI / static_cast<float>(len);
+			std::complex<float> wlen(std::cos(angle), std::sin(angle));
+			for (size_t i = 0; i < n; i += len)
+			{
+				std::complex<float> w(1.0f, 0.0f);
+				for (size_t j = 0; j < len / 2; ++j)
+				{
+					std::complex<float> u = fftInput[i + j];
+					std::complex<float> v = fftInput[i + j + len / 2] * w;
+					fftInput[i + j] = u + v;
+					fftInput[i + j + len / 2] = u - v;
+					w *= wlen;
+				}
+			}
+		}
+	}
+} // namespace
+
+TEST(FFTPlanMatchesDft)
+{
+	// Float rounding grows with the number of stages and the bins with the square root of the size,
+	// so the error is measured against that
+	for (const std::size_t size: { 2, 4, 16, 64, 512, 2048, 4096 })
+	{
+		FFTPlan plan(size);
+		const std::vector<float> samples = Test::MakeNoise(size);
+		std::vector<std::complex<float>> bins(plan.GetBinCount());
+		plan.Forward(samples.data(), bins.data());
+
+		const std::vector<std::complex<double>> reference = DirectDft(samples);
+		double worst = 0.0;
+		for (std::size_t k = 0; k < bins.size(); k++)
+		{
+			worst = max(worst, std::abs(std::complex<double>(bins[k]) - reference[k]));
+		}
+		const double scaled = worst / std::sqrt(static_cast<double>(size));
+		CHECK_MESSAGE(scaled < 1e-6, "forward {} differs from the DFT by {:.2e}", size, worst);
+		CHECK_MESSAGE(bins[0].imag() == 0.0f && bins[size / 2].imag() == 0.0f, "forward {} has imaginary DC or Nyquist", size);
+
+		// Any half spectrum back, not only one Forward made
+		std::vector<std::complex<float>> spectrum(plan.GetBinCount());
+		const std::vector<float> parts = Test::MakeNoise(spectrum.size() * 2, 2);
+		for (std::size_t k = 0; k < spectrum.size(); k++)
+		{
+			spectrum[k] = { parts[2 * k], k == 0 || k == size / 2 ? 0.0f : parts[2 * k + 1] };
+		}
+		std::vector<float> output(size);
+		plan.Inverse(spectrum.data(), output.data());
+
+		const std::vector<double> inverse = DirectInverse(spectrum, size);
+		worst = 0.0;
+		for (std::size_t n = 0; n < size; n++)
+		{
+			worst = max(worst, std::abs(static_cast<double>(output[n]) - inverse[n]));
+		}
+		CHECK_MESSAGE(worst < 1e-6, "inverse {} differs from the DFT by {:.2e}", size, worst);
+	}
+}
+
+TEST(FFTPlanRoundTrip)
+{
+	// Inverse(Forward(x)) gives x back at every size the visualizer and the convolvers use
+	for (std::size_t size = 2; size <= 16384; size <<= 1)
+	{
+		FFTPlan plan(size);
+		const std::vector<float> samples = Test::MakeNoise(size, static_cast<unsigned int>(size));
+		std::vector<std::complex<float>> bins(plan.GetBinCount());
+		std::vector<float> output(size);
+		plan.Forward(samples.data(), bins.data());
+		plan.Inverse(bins.data(), output.data());
+
+		double worst = 0.0;
+		for (std::size_t n = 0; n < size; n++)
+		{
+			worst = max(worst, std::abs(static_cast<double>(output[n]) - samples[n]));
+		}
+		CHECK_MESSAGE(worst < 1e-5, "round trip at {} is off by {:.2e}", size, worst);
+	}
+}
+
+BENCHMARK(FFTPlanThroughput)
+{
+	// Per transform at the visualizer's sizes. The old transform spends nearly all its time in the
+	// repeated permutation, which grows with the square of the size
+	for (const std::size_t size: { 512, 2048, 4096, 16384 })
+	{
+		FFTPlan plan(size);
+		const std::vector<float> samples = Test::MakeNoise(size);
+		std::vector<std::complex<float>> bins(plan.GetBinCount());
+		const double planSeconds = Test::Time(
+		        [&]()
+		        {
+			        plan.Forward(samples.data(), bins.data());
+			        Test::Consume(bins[1].real());
+		        });
+		Test::Report(std::format("FFTPlan::Forward {}", size), planSeconds, 1.0, "transform");
+
+		std::vector<float> output(size);
+		const double inverseSeconds = Test::Time(
+		        [&]()
+		        {
+			        plan.Inverse(bins.data(), output.data());
+			        Test::Consume(output[1]);
+		        });
+		Test::Report(std::format("FFTPlan::Inverse {}", size), inverseSeconds, 1.0, "transform");
+
+		std::vector<std::complex<float>> input(size);
+		const double oldSeconds = Test::Time(
+		        [&]()
+		        {
+			        for (std::size_t i = 0; i < size; i++)
+			        {
+				        input[i] = { samples[i], 0.0f };
+			        }
+			        PerformFFT(input);
+			        Test::Consume(input[1].real());
+		        });
+		Test::Report(std::format("PerformFFT {}, {:.0f}x the plan", size, oldSeconds / planSeconds), oldSeconds, 1.0, "transform");
+	}
+}
@@ -0,0 +1,293 @@
+#include "pch.h"
+
+#include "Test.h"
+
+#include <random>
+
+#include "dsp/FastMath.h"
+
+// Checks the error bounds listed in FastMath.h against libm in double precision, over the ranges
+// given there, for every form of each function, and that the forms agree bit for bit
+namespace
+{
+	enum class Error
+	{
+		Absolute,
+		Relative
+	};
+
+	struct Worst
+	{
+		double error{ 0.0 };
+		float input{ 0.0f };
+	};
+
+	void Accumulate(Worst& worst, float input, float approximate, double exact, Error kind)
+	{
+		double error = std::abs(static_cast<double>(approximate) - exact);
+		if (kind == Error::Relative)
+			error /= std::abs(exact);
+		if (error > worst.error)
+			worst = { error, input };
+	}
+
+	// Evenly spaced from low to high, ends included, a multiple of four long so the lanes line up
+	std::vector<float> Sweep(float low, float high, std::size_t count)
+	{
+		std::vector<float> values(count);
+		for (std::size_t i = 0; i < count; i++)
+		{
+			values[i] = low + (high - low) * static_cast<float>(static_cast<double>(i) / static_cast<double>(count - 1));
+		}
+		return values;
+	}
+
+	using ArrayForm = void (*)(const float*, float*, std::size_t);
+
+	// Scalar, four lanes and, when there is one, the array form. The array runs three short so its
+	// padded tail is covered too
+	template<typename Scalar, typename Vector, typename Reference>
+	void CheckForms(const char* name, const std::vector<float>& inputs, Scalar scalar, Vector vector, ArrayForm array, Reference reference, Error kind, double bound)
+	{
+		const std::size_t count = inputs.size();
+		std::vector<float> scalarOut(count), vectorOut(count), arrayOut(count);
+		for (std::size_t i = 0; i < count; i++)
+		{
+			scalarOut[i] = scalar(inputs[i]);
+		}
+		for (std::size_t i = 0; i + 4 <= count; i += 4)
+		{
+			_mm_storeu_ps(vectorOut.data() + i, vector(_mm_loadu_ps(inputs.data() + i)));
+		}
+		const std::size_t arrayCount = array ? count - 3 : 0;
+		if (array)
+		{
+			array(inputs.data(), arrayOut.data(), arrayCount);
+		}
+
+		Worst worst;
+		std::size_t mismatches = 0;
+		for (std::size_t i = 0; i < count; i++)
+		{
+			const double exact = reference(static_cast<double>(inputs[i]));
+			Accumulate(worst, inputs[i], scalarOut[i], exact, kind);
+			Accumulate(worst, inputs[i], vectorOut[i], exact, kind);
+			mismatches += std::memcmp(&scalarOut[i], &vectorOut[i], sizeof(float)) != 0;
+			if (i < arrayCount)
+			{
+				Accumulate(worst, inputs[i], arrayOut[i], exact, kind);
+				mismatches += std::memcmp(&scalarOut[i], &arrayOut[i], sizeof(float)) != 0;
+			}
+		}
+
+		std::cout << std::format("  {:<12} {} error {:.3g} at {}", name, kind == Error::Relative ? "relative" : "absolute", worst.error, worst.input) << std::endl;
+		CHECK_MESSAGE(worst.error <= bound, "{} error {:.3g} at {} is over the documented {:.3g}", name, worst.error, worst.input, bound);
+		CHECK_MESSAGE(mismatches == 0, "{} forms disagree on {} values", name, mismatches);
+	}
+
+	constexpr std::size_t SWEEP_COUNT = 1 << 20;
+}
+
+TEST(FastMathExp2)
+{
+	CheckForms("Exp2", Sweep(-126.0f, 126.0f, SWEEP_COUNT), [](float x) { return FastMath::Exp2(x); }, [](__m128 x) { return FastMath::Exp2(x); },
+	           FastMath::Exp2, [](double x) { return std::exp2(x); }, Error::Relative, 1.2e-7);
+}
+
+TEST(FastMathLog2)
+{
+	// Absolute around 1 where log2 goes through zero, relative over the rest of the float range
+	CheckForms("Log2 near 1", Sweep(0.5f, 2.0f, SWEEP_COUNT), [](float x) { return FastMath::Log2(x); }, [](__m128 x) { return FastMath::Log2(x); },
+	           FastMath::Log2, [](double x) { return std::log2(x); }, Error::Absolute, 1.5e-7);
+
+	std::vector<float> inputs = Sweep(-126.0f, 126.0f, SWEEP_COUNT);
+	std::erase_if(inputs, [](float e) { return std::abs(e) < 1.0f; });
+	inputs.resize(inputs.size() & ~static_cast<std::size_t>(3));
+	for (float& x: inputs)
+	{
+		x = std::exp2(x);
+	}
+	CheckForms("Log2", inputs, [](float x) { return FastMath::Log2(x); }, [](__m128 x) { return FastMath::Log2(x); }, FastMath::Log2,
+	           [](double x) { return std::log2(x); }, Error::Relative, 1e-7);
+}
+
+TEST(FastMathPow)
+{
+	// Over a grid of both arguments, x spaced evenly in log
+	const std::vector<float> exponents = Sweep(-3.0f, 3.0f, 256);
+	const std::vector<float> bases = Sweep(std::log2(0.01f), std::log2(100.0f), 4096);
+
+	std::vector<float> values(bases.size()), array(bases.size());
+	for (std::size_t i = 0; i < bases.size(); i++)
+	{
+		values[i] = std::exp2(bases[i]);
+	}
+
+	Worst worst;
+	std::size_t mismatches = 0;
+	for (float y: exponents)
+	{
+		// The array runs three short so its padded tail is covered too
+		FastMath::Pow(values.data(), array.data(), values.size() - 3, y);
+		for (std::size_t i = 0; i < values.size(); i += 4)
+		{
+			alignas(16) float lanes[4];
+			_mm_store_ps(lanes, FastMath::Pow(_mm_loadu_ps(values.data() + i), _mm_set1_ps(y)));
+
+			for (std::size_t lane = 0; lane < 4; lane++)
+			{
+				const float x = values[i + lane];
+				const float scalar = FastMath::Pow(x, y);
+				const double exact = std::pow(static_cast<double>(x), static_cast<double>(y));
+				Accumulate(worst, x, scalar, exact, Error::Relative);
+				Accumulate(worst, x, lanes[lane], exact, Error::Relative);
+				mismatches += std::memcmp(&scalar, &lanes[lane], sizeof(float)) != 0;
+				if (i + lane < values.size() - 3)
+				{
+					mismatches += std::memcmp(&scalar, &array[i + lane], sizeof(float)) != 0;
+				}
+			}
+		}
+	}
+
+	std::cout << std::format("  {:<12} relative error {:.3g} at x {}", "Pow", worst.error, worst.input) << std::endl;
+	CHECK_MESSAGE(worst.error <= 1.5e-6, "Pow error {:.3g} at {} is over the documented 1.5e-6", worst.error, worst.input);
+	CHECK_MESSAGE(mismatches == 0, "Pow forms disagree on {} values", mismatches);
+}
+
+TEST(FastMathDecibels)
+{
+	CheckForms("DbToLinear", Sweep(-120.0f, 20.0f, SWEEP_COUNT), [](float x) { return FastMath::DbToLinear(x); }, [](__m128 x) { return FastMath::DbToLinear(x); },
+	           FastMath::DbToLinear, [](double db) { return std::pow(10.0, db / 20.0); }, Error::Relative, 8e-7);
+
+	// Back the other way in dB, over the same span of levels
+	std::vector<float> levels = Sweep(-6.0f, 1.0f, SWEEP_COUNT);
+	for (float& x: levels)
+	{
+		x = std::pow(10.0f, x);
+	}
+	CheckForms("LinearToDb", levels, [](float x) { return FastMath::LinearToDb(x); }, [](__m128 x) { return FastMath::LinearToDb(x); }, FastMath::LinearToDb,
+	           [](double x) { return 20.0 * std::log10(x); }, Error::Absolute, 1.5e-5);
+	CheckForms("PowerToDb", levels, [](float x) { return FastMath::PowerToDb(x); }, [](__m128 x) { return FastMath::PowerToDb(x); }, FastMath::PowerToDb,
+	           [](double x) { return 10.0 * std::log10(x); }, Error::Absolute, 7.5e-6);
+}
+
+TEST(FastMathTanh)
+{
+	CheckForms("Tanh", Sweep(-20.0f, 20.0f, SWEEP_COUNT), [](float x) { return FastMath::Tanh(x); }, [](__m128 x) { return FastMath::Tanh(x); },
+	           FastMath::Tanh, [](double x) { return std::tanh(x); }, Error::Absolute, 1.2e-7);
+}
+
+TEST(FastMathSinCos)
+{
+	// Sine and cosine out of the same call, checked separately
+	const std::vector<float> inputs = Sweep(-8192.0f, 8192.0f, SWEEP_COUNT * 4);
+	Worst worstSin, worstCos;
+	std::size_t mismatches = 0;
+	for (std::size_t i = 0; i < inputs.size(); i += 4)
+	{
+		alignas(16) float sinLanes[4], cosLanes[4];
+		__m128 s, c;
+		FastMath::SinCos(_mm_loadu_ps(inputs.data() + i), s, c);
+		_mm_store_ps(sinLanes, s);
+		_mm_store_ps(cosLanes, c);
+
+		for (int lane = 0; lane < 4; lane++)
+		{
+			const float x = inputs[i + lane];
+			float sinScalar, cosScalar;
+			FastMath::SinCos(x, sinScalar, cosScalar);
+			Accumulate(worstSin, x, sinScalar, std::sin(static_cast<double>(x)), Error::Absolute);
+			Accumulate(worstSin, x, sinLanes[lane], std::sin(static_cast<double>(x)), Error::Absolute);
+			Accumulate(worstCos, x, cosScalar, std::cos(static_cast<double>(x)), Error::Absolute);
+			Accumulate(worstCos, x, cosLanes[lane], std::cos(static_cast<double>(x)), Error::Absolute);
+			mismatches += std::memcmp(&sinScalar, &sinLanes[lane], sizeof(float)) != 0 || std::memcmp(&cosScalar, &cosLanes[lane], sizeof(float)) != 0;
+		}
+	}
+
+	std::cout << std::format("  {:<12} absolute error {:.3g} at {}, cosine {:.3g} at {}", "SinCos", worstSin.error, worstSin.input, worstCos.error, worstCos.input) << std::endl;
+	CHECK_MESSAGE(worstSin.error <= 5e-7, "Sine error {:.3g} at {} is over the documented 5e-7", worstSin.error, worstSin.input);
+	CHECK_MESSAGE(worstCos.error <= 5e-7, "Cosine error {:.3g} at {} is over the documented 5e-7", worstCos.error, worstCos.input);
+	CHECK_MESSAGE(mismatches == 0, "SinCos forms disagree on {} values", mismatches);
+}
+
+// ---- Throughput, libm against each form over the same block of inputs ----
+
+namespace
+{
+	constexpr std::size_t BENCH_COUNT = 4096;
+
+	template<typename Libm, typename Scalar, typename Vector>
+	void BenchForms(const char* name, float low, float high, Libm libm, Scalar scalar, Vector vector, ArrayForm array)
+	{
+		std::vector<float> inputs(BENCH_COUNT), outputs(BENCH_COUNT);
+		std::mt19937 random(1);
+		std::uniform_real_distribution<float> distribution(low, high);
+		for (float& x: inputs)
+		{
+			x = distribution(random);
+		}
+
+		auto run = [&](const char* form, auto body)
+		{
+			const double seconds = Test::Time([&]
+			{
+				body();
+				Test::Consume(outputs[BENCH_COUNT / 2]);
+			});
+			Test::Report(std::format("{} {}", name, form), seconds, static_cast<double>(BENCH_COUNT), "value");
+		};
+
+		run("libm", [&]
+		{
+			for (std::size_t i = 0; i < BENCH_COUNT; i++)
+				outputs[i] = libm(inputs[i]);
+		});
+		run("scalar", [&]
+		{
+			for (std::size_t i = 0; i < BENCH_COUNT; i++)
+				outputs[i] = scalar(inputs[i]);
+		});
+		run("vector", [&]
+		{
+			for (std::size_t i = 0; i < BENCH_COUNT; i += 4)
+				_mm_storeu_ps(outputs.data() + i, vector(_mm_loadu_ps(inputs.data() + i)));
+		});
+		if (array)
+		{
+			run("array", [&] { array(inputs.data(), outputs.data(), BENCH_COUNT); });
+		}
+	}
+}
+
+BENCHMARK(FastMathThroughput)
+{
+	BenchForms("Exp2", -126.0f, 126.0f, [](float x) { return std::exp2(x); }, [](float x) { return FastMath::Exp2(x); },
+	           [](__m128 x) { return FastMath::Exp2(x); }, FastMath::Exp2);
+	BenchForms("Log2", 1e-6f, 1e6f, [](float x) { return std::log2(x); }, [](float x) { return FastMath::Log2(x); },
+	           [](__m128 x) { return FastMath::Log2(x); }, FastMath::Log2);
+	BenchForms("Pow", 0.01f, 100.0f, [](float x) { return std::pow(x, 0.37f); }, [](float x) { return FastMath::Pow(x, 0.37f); },
+	           [](__m128 x) { return FastMath::Pow(x, _mm_set1_ps(0.37f)); }, [](const float* in, float* out, std::size_t count) { FastMath::Pow(in, out, count, 0.37f); });
+	BenchForms("DbToLinear", -120.0f, 20.0f, [](float db) { return std::pow(10.0f, db / 20.0f); }, [](float db) { return FastMath::DbToLinear(db); },
+	           [](__m128 db) { return FastMath::DbToLinear(db); }, FastMath::DbToLinear);
+	BenchForms("LinearToDb", 1e-6f, 10.0f, [](float x) { return 20.0f * std::log10(x); }, [](float x) { return FastMath::LinearToDb(x); },
+	           [](__m128 x) { return FastMath::LinearToDb(x); }, FastMath::LinearToDb);
+	BenchForms("Tanh", -5.0f, 5.0f, [](float x) { return std::tanh(x); }, [](float x) { return FastMath::Tanh(x); },
+	           [](__m128 x) { return FastMath::Tanh(x); }, FastMath::Tanh);
+
+	// Both outputs count as one value, against a separate sin and cos
+	BenchForms("SinCos", -8192.0f, 8192.0f, [](float x) { return std::sin(x) + std::cos(x); },
+	           [](float x)
+	           {
+		           float s, c;
+		           FastMath::SinCos(x, s, c);
+		           return s + c;
+	           },
+	           [](__m128 x)
+	           {
+		           __m128 s, c;
+		           FastMath::SinCos(x, s, c);
+		           return _mm_add_ps(s, c);
+	           },
+	           nullptr);
+}
@@ -0,0 +1,148 @@
+#include "pch.h"
+
+#include "Test.h"
+#include "TestSignals.h"
+
+#include "dsp/FdnReverb.h"
+
+// FdnReverb promises the same output for the same input and parameters, however the stream is cut
+// into calls, and a late decay that drops 60 dB in decayTime. Both are checked on rendered audio
+namespace
+{
+	// An impulse on the left, then a burst of noise, then silence for the reverb to ring out in
+	std::vector<float> MakeInput(std::size_t frames)
+	{
+		std::vector<float> samples = Test::MakeImpulse(frames);
+		const std::vector<float> noise = Test::MakeNoise(Test::SAMPLE_RATE / 10 * Test::CHANNELS);
+		std::copy(noise.begin(), noise.end(), samples.begin() + Test::SAMPLE_RATE / 10 * Test::CHANNELS);
+		return samples;
+	}
+
+	FdnReverb::Parameters MakeParameters()
+	{
+		FdnReverb::Parameters parameters;
+		parameters.decayTime = 1.5f;
+		parameters.decayHFRatio = 0.6f;
+		parameters.reflectionsGain = 0.3f;
+		parameters.lateGain = 1.0f;
+		return parameters;
+	}
+
+	std::vector<float> Render(FdnReverb& reverb, std::vector<float> samples, const std::vector<std::size_t>& callFrames)
+	{
+		std::size_t frame = 0;
+		const std::size_t frames = samples.size() / Test::CHANNELS;
+		for (std::size_t call = 0; frame < frames; call++)
+		{
+			const std::size_t count = min(callFrames[call % callFrames.size()], frames - frame);
+			reverb.Process(samples.data() + frame * Test::CHANNELS, count);
+			frame += count;
+		}
+		return samples;
+	}
+
+	bool Identical(const std::vector<float>& a, const std::vector<float>& b)
+	{
+		return a.size() == b.size() && std::memcmp(a.data(), b.data(), a.size() * sizeof(float)) == 0;
+	}
+
+	// Decay time from the Schroeder integral of the left channel, fitted from -5 to -35 dB like a T30
+	double MeasureDecayTime(const std::vector<float>& samples)
+	{
+		const std::size_t frames = samples.size() / Test::CHANNELS;
+		std::vector<double> integral(frames + 1, 0.0);
+		for (std::size_t frame = frames; frame-- > 0;)
+		{
+			const double sample = samples[frame * Test::CHANNELS];
+			integral[frame] = integral[frame + 1] + sample * sample;
+		}
+
+		double sumT = 0.0, sumL = 0.0, sumTT = 0.0, sumTL = 0.0;
+		std::size_t count = 0;
+		for (std::size_t frame = 0; frame < frames; frame++)
+		{
+			const double level = 10.0 * std::log10(integral[frame] / integral[0]);
+			if (level > -5.0 || level < -35.0)
+				continue;
+
+			const double time = static_cast<double>(frame) / Test::SAMPLE_RATE;
+			sumT += time;
+			sumL += level;
+			sumTT += time * time;
+			sumTL += time * level;
+			count++;
+		}
+
+		const double n = static_cast<double>(count);
+		const double slope = (n * sumTL - sumT * sumL) / (n * sumTT - sumT * sumT);
+		return -60.0 / slope;
+	}
+} // namespace
+
+TEST(FdnReverbRenderTwice)
+{
+	const std::vector<float> input = MakeInput(Test::SAMPLE_RATE);
+
+	FdnReverb reverb;
+	reverb.Configure(Test::CHANNELS, Test::SAMPLE_RATE);
+	reverb.SetParameters(MakeParameters());
+	const std::vector<float> first = Render(reverb, input, { 512 });
+
+	// Reset has to forget everything, and a second instance must not differ from the first
+	reverb.Reset();
+	CHECK(Identical(first, Render(reverb, input, { 512 })));
+
+	FdnReverb other;
+	other.Configure(Test::CHANNELS, Test::SAMPLE_RATE);
+	other.SetParameters(MakeParameters());
+	CHECK(Identical(first, Render(other, input, { 512 })));
+
+	// And it has to have done something
+	CHECK(!Identical(first, input));
+}
+
+TEST(FdnReverbSplitCalls)
+{
+	const std::vector<float> input = MakeInput(Test::SAMPLE_RATE);
+
+	FdnReverb whole;
+	whole.Configure(Test::CHANNELS, Test::SAMPLE_RATE);
+	whole.SetParameters(MakeParameters());
+	const std::vector<float> reference = Render(whole, input, { input.size() / Test::CHANNELS });
+
+	// Odd sizes, single frames and calls longer than any delay line
+	for (const std::vector<std::size_t>& calls: { std::vector<std::size_t>{ 1 }, { 7, 64, 1, 333 }, { 4096 }, { 5000, 3 } })
+	{
+		FdnReverb split;
+		split.Configure(Test::CHANNELS, Test::SAMPLE_RATE);
+		split.SetParameters(MakeParameters());
+		CHECK_MESSAGE(Identical(reference, Render(split, input, calls)), "differs when rendered in calls of {} frames first", calls.front());
+	}
+}
+
+TEST(FdnReverbDecayTime)
+{
+	// No HF damping and no air absorption, so every line decays at the set time. Reflections off
+	// so the fit only sees the late reverb
+	for (const float decayTime: { 0.5f, 1.5f, 4.0f })
+	{
+		FdnReverb::Parameters parameters;
+		parameters.decayTime = decayTime;
+		parameters.decayHFRatio = 1.0f;
+		parameters.airAbsorption = 1.0f;
+		parameters.reflectionsGain = 0.0f;
+		parameters.lateGain = 1.0f;
+
+		FdnReverb reverb;
+		reverb.Configure(Test::CHANNELS, Test::SAMPLE_RATE);
+		reverb.SetParameters(parameters);
+
+		// The dry impulse is removed again so it does not count as energy at time zero
+		std::vector<float> samples = Test::MakeImpulse(static_cast<std::size_t>(decayTime * 1.5f * Test::SAMPLE_RATE));
+		reverb.Process(samples.data(), samples.size() / Test::CHANNELS);
+		samples[0] -= 1.0f;
+
+		const double measured = MeasureDecayTime(samples);
+		CHECK_MESSAGE(std::abs(measured / decayTime - 1.0) < 0.02, "decay time {:.3f} s measured for {:.3f} s", measured, decayTime);
+	}
+}
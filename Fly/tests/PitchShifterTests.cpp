@@ -0,0 +1,74 @@
+#include "pch.h"
+
+#include "Test.h"
+#include "TestSignals.h"
+
+#include "PitchShifter.h"
+
+// PitchShifter's bypass has to be the same delay the vocoder has, so the latency the clock
+// compensates for holds still and moving the pitch in and out of 0 neither clicks nor drops audio
+namespace
+{
+	// Left channel of output against input, after the given number of frames has settled
+	double ResidualDb(const std::vector<float>& output, const std::vector<float>& input, std::size_t latency, std::size_t settle)
+	{
+		double error = 0.0, reference = 0.0;
+		for (std::size_t frame = settle; frame + latency < input.size() / Test::CHANNELS; frame++)
+		{
+			const double difference = static_cast<double>(output[(frame + latency) * Test::CHANNELS]) - input[frame * Test::CHANNELS];
+			error += difference * difference;
+			reference += static_cast<double>(input[frame * Test::CHANNELS]) * input[frame * Test::CHANNELS];
+		}
+		return 10.0 * std::log10(error / reference + 1e-30);
+	}
+} // namespace
+
+TEST(PitchShifterBypassDelay)
+{
+	// At 0 the input comes out delayed by exactly the latency, and at a hundredth of a semitone the
+	// synthesis hop rounds to the analysis hop, so the vocoder has to line up with the same delay
+	for (const float semitones: { 0.0f, 0.01f })
+	{
+		PitchShifter shifter;
+		shifter.SetPitch(semitones);
+		const std::vector<float> input = Test::MakeSine(441.0, 2 * Test::SAMPLE_RATE);
+		std::vector<float> output = input;
+		for (std::size_t frame = 0; frame < input.size() / Test::CHANNELS; frame += Test::BLOCK_FRAMES)
+		{
+			shifter.Process(output.data() + frame * Test::CHANNELS, min(Test::BLOCK_FRAMES, input.size() / Test::CHANNELS - frame), Test::CHANNELS, Test::SAMPLE_RATE);
+		}
+
+		const double residual = ResidualDb(output, input, shifter.GetLatency(), Test::SAMPLE_RATE / 2);
+		CHECK_MESSAGE(residual < -60.0, "{} semitones differ from the input {} frames back by {:.1f} dB", semitones, shifter.GetLatency(), residual);
+	}
+}
+
+TEST(PitchShifterToggle)
+{
+	// Every other block shifted up a third. The latency has to stay put and the output has to stay
+	// as smooth as the sines either side of the fade, a dropped frame or a hop of silence steps by far more
+	PitchShifter shifter;
+	std::vector<float> samples = Test::MakeSine(220.0, 8 * Test::BLOCK_FRAMES);
+	std::size_t latency = 0;
+	for (std::size_t block = 0; block < 8; block++)
+	{
+		shifter.SetPitch(block % 2 ? 4.0f : 0.0f);
+		shifter.Process(samples.data() + block * Test::BLOCK_FRAMES * Test::CHANNELS, Test::BLOCK_FRAMES, Test::CHANNELS, Test::SAMPLE_RATE);
+		if (block == 0)
+			latency = shifter.GetLatency();
+		CHECK_MESSAGE(shifter.GetLatency() == latency, "latency moved from {} to {} in block {}", latency, shifter.GetLatency(), block);
+	}
+
+	float largest = 0.0f;
+	std::size_t where = 0;
+	for (std::size_t frame = latency + 1; frame < samples.size() / Test::CHANNELS; frame++)
+	{
+		const float step = std::abs(samples[frame * Test::CHANNELS] - samples[(frame - 1) * Test::CHANNELS]);
+		if (step > largest)
+		{
+			largest = step;
+			where = frame;
+		}
+	}
+	CHECK_MESSAGE(largest < 0.05f, "output steps by {:.3f} at frame {}", largest, where);
+}
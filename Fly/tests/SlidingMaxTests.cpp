@@ -0,0 +1,54 @@
+#include "pch.h"
+
+#include "Test.h"
+
+#include "containers/SlidingMax.h"
+
+#include <random>
+
+// SlidingMax against the maximum of the window taken the slow way, on noise and on the runs that
+// stress a monotonic deque: long falls keep every entry, long rises and ties drop them all
+TEST(SlidingMaxMatchesBruteForce)
+{
+	std::mt19937 random(3);
+	std::uniform_int_distribution<int> level(0, 20);
+	std::vector<int> values;
+	for (int i = 0; i < 2000; i++)
+	{
+		values.push_back(level(random));
+	}
+	for (int i = 0; i < 300; i++)
+	{
+		values.push_back(300 - i);
+	}
+	for (int i = 0; i < 300; i++)
+	{
+		values.push_back(i);
+	}
+	values.insert(values.end(), 200, 7);
+
+	SlidingMax<int> sliding;
+	for (const std::size_t window: { 1, 2, 3, 16, 245, 4096 })
+	{
+		// Reconfigured rather than made fresh, so stale entries from the last window would show
+		sliding.Configure(window);
+		CHECK(sliding.GetWindow() == window);
+		for (std::size_t i = 0; i < values.size(); i++)
+		{
+			const int result = sliding.Push(values[i]);
+			const std::size_t first = i + 1 > window ? i + 1 - window : 0;
+			const int expected = *std::max_element(values.begin() + static_cast<std::ptrdiff_t>(first), values.begin() + static_cast<std::ptrdiff_t>(i) + 1);
+			if (result != expected)
+			{
+				CHECK_MESSAGE(result == expected, "window {} push {}: {} instead of {}", window, i, result, expected);
+				break;
+			}
+		}
+	}
+
+	// Clearing forgets everything pushed before
+	sliding.Configure(8);
+	sliding.Push(100);
+	sliding.Clear();
+	CHECK(sliding.Push(1) == 1);
+}
@@ -0,0 +1,209 @@
+#include "pch.h"
+
+#include "Test.h"
+#include "TestSignals.h"
+
+#include "analysis/SpectrogramImage.h"
+#include "analysis/SpectrogramView.h"
+#include "dsp/FFTPlan.h"
+
+#include <fstream>
+
+// SpectrogramView and SpectrogramImage without a window: a sweep is analyzed hop by hop the way
+// AudioVisualizer does it, the columns are rendered and written out with WritePPM. The hop, a 4096
+// point FFT and the filterbank, is timed against one frame at 60 fps
+namespace
+{
+	constexpr int FFT_SIZE = 4096;
+	constexpr double FRAME_BUDGET = 1.0 / 60.0;
+
+	// AudioVisualizer's hop: Hann window, forward transform and magnitudes scaled so a full-scale sine peaks at 1
+	class Analyzer
+	{
+	public:
+		explicit Analyzer(int size)
+		      : m_plan(size), m_window(size), m_input(size), m_spectrum(m_plan.GetBinCount()), m_magnitudes(size / 2)
+		{
+			float windowSum = 0.0f;
+			for (int i = 0; i < size; i++)
+			{
+				m_window[i] = 0.5f * (1.0f - std::cos(2.0f * M_PI * i / (size - 1)));
+				windowSum += m_window[i];
+			}
+			m_scale = 2.0f / windowSum;
+		}
+
+		// Analyzes the window starting at samples and hands the frame to the view
+		void Process(const float* samples, SpectrogramView& view)
+		{
+			for (std::size_t i = 0; i < m_input.size(); i++)
+			{
+				m_input[i] = samples[i] * m_window[i];
+			}
+			m_plan.Forward(m_input.data(), m_spectrum.data());
+			for (std::size_t i = 0; i < m_magnitudes.size(); i++)
+			{
+				m_magnitudes[i] = std::abs(m_spectrum[i]) * m_scale;
+			}
+
+			AnalysisFrame frame;
+			frame.samples = samples;
+			frame.sampleCount = m_input.size();
+			frame.magnitudes = m_magnitudes.data();
+			frame.binCount = m_magnitudes.size();
+			frame.fftSize = static_cast<int>(m_input.size());
+			frame.sampleRate = Test::SAMPLE_RATE;
+			view.Process(frame);
+		}
+
+	private:
+		FFTPlan m_plan;
+		std::vector<float> m_window;
+		std::vector<float> m_input;
+		std::vector<std::complex<float>> m_spectrum;
+		std::vector<float> m_magnitudes;
+		float m_scale;
+	};
+
+	// Exponential sweep, mono
+	std::vector<float> MakeSweep(double from, double to, std::size_t frames)
+	{
+		std::vector<float> samples(frames);
+		const double rate = std::log(to / from) / static_cast<double>(frames);
+		for (std::size_t frame = 0; frame < frames; frame++)
+		{
+			const double phase = 2.0 * M_PI * from / Test::SAMPLE_RATE * (std::exp(rate * static_cast<double>(frame)) - 1.0) / rate;
+			samples[frame] = static_cast<float>(0.5 * std::sin(phase));
+		}
+		return samples;
+	}
+
+	// The colormap only gets brighter towards the top, so the brightest pixel is the loudest row
+	int LoudestRow(const std::uint32_t* column, int rows)
+	{
+		int loudest = 0, brightest = -1;
+		for (int row = 0; row < rows; row++)
+		{
+			const std::uint32_t pixel = column[row];
+			const int brightness = static_cast<int>((pixel >> IM_COL32_R_SHIFT) & 0xFF) + static_cast<int>((pixel >> IM_COL32_G_SHIFT) & 0xFF) +
+			                       static_cast<int>((pixel >> IM_COL32_B_SHIFT) & 0xFF);
+			if (brightness > brightest)
+			{
+				brightest = brightness;
+				loudest = row;
+			}
+		}
+		return loudest;
+	}
+} // namespace
+
+TEST(SpectrogramRendersSweep)
+{
+	constexpr int COLUMNS = 300;
+	constexpr std::size_t HOP = 800; // 60 columns a second
+	const std::vector<float> sweep = MakeSweep(60.0, 15000.0, FFT_SIZE + HOP * COLUMNS);
+
+	for (const SpectrogramView::Scale scale: { SpectrogramView::Scale::Log, SpectrogramView::Scale::Mel })
+	{
+		SpectrogramView view(256, scale);
+		SpectrogramImage image(256);
+		Analyzer analyzer(FFT_SIZE);
+
+		// The sweep only rises, so every column's loudest row is at or above the one before it
+		int firstRow = 0, lastRow = 0, falls = 0;
+		for (int column = 0; column < COLUMNS; column++)
+		{
+			analyzer.Process(sweep.data() + column * HOP, view);
+			CHECK(image.Consume(view) == 1);
+			const int row = LoudestRow(image.GetColumn(column % image.GetWidth()), image.GetRows());
+			firstRow = column == 0 ? row : firstRow;
+			falls += row < lastRow;
+			lastRow = row;
+		}
+		CHECK_MESSAGE(falls == 0, "the sweep falls {} times", falls);
+		// 60 Hz to 15 kHz of 30 Hz to 20 kHz, bottom eighth to top eighth on either axis
+		CHECK_MESSAGE(firstRow < image.GetRows() / 8, "starts at row {}", firstRow);
+		CHECK_MESSAGE(lastRow > image.GetRows() * 7 / 8, "ends at row {}", lastRow);
+		CHECK(image.GetTotalColumns() == COLUMNS);
+
+		// The ring wrapped, so the image holds the last width columns, highest frequency on top
+		const std::filesystem::path path = std::filesystem::temp_directory_path() / std::format("FlyTests_spectrogram_{}.ppm", scale == SpectrogramView::Scale::Log ? "log" : "mel");
+		CHECK(image.WritePPM(path.string()));
+
+		std::ifstream file(path, std::ios::binary);
+		std::string magic;
+		int width = 0, height = 0, maxValue = 0;
+		file >> magic >> width >> height >> maxValue;
+		file.get();
+		std::vector<char> pixels(static_cast<std::size_t>(width) * height * 3);
+		file.read(pixels.data(), static_cast<std::streamsize>(pixels.size()));
+		CHECK(magic == "P6" && width == image.GetWidth() && height == image.GetRows() && maxValue == 255);
+		CHECK_MESSAGE(file.gcount() == static_cast<std::streamsize>(pixels.size()) && file.peek() == std::ifstream::traits_type::eof(), "{} holds the wrong amount of pixels",
+		              path.string());
+
+		// Top left of the file is the highest row of the oldest column still in the ring
+		const std::uint32_t oldest = image.GetColumn(static_cast<int>(image.GetTotalColumns() % image.GetWidth()))[image.GetRows() - 1];
+		CHECK(static_cast<unsigned char>(pixels[0]) == ((oldest >> IM_COL32_R_SHIFT) & 0xFF) && static_cast<unsigned char>(pixels[2]) == ((oldest >> IM_COL32_B_SHIFT) & 0xFF));
+		std::filesystem::remove(path);
+	}
+}
+
+TEST(SpectrogramRowChange)
+{
+	// A new row count takes effect on the next hop and restarts the image
+	const std::vector<float> sine = Test::MakeSine(1000.0, FFT_SIZE, 0.5f, 1);
+	SpectrogramView view(256);
+	SpectrogramImage image(64);
+	Analyzer analyzer(FFT_SIZE);
+	for (int column = 0; column < 10; column++)
+	{
+		analyzer.Process(sine.data(), view);
+	}
+	image.Consume(view);
+	const std::uint32_t generation = image.GetGeneration();
+
+	view.SetRows(128);
+	analyzer.Process(sine.data(), view);
+	CHECK(image.Consume(view) == 1);
+	CHECK(image.GetRows() == 128);
+	CHECK(image.GetTotalColumns() == 1);
+	CHECK(image.GetGeneration() != generation);
+	CHECK(!SpectrogramImage(64).WritePPM((std::filesystem::temp_directory_path() / "FlyTests_empty.ppm").string()));
+}
+
+BENCHMARK(SpectrogramHop)
+{
+	// One hop per displayed frame, the FFT alone and then with the filterbank and the column copy on
+	// top. Both have to fit well inside a 60 fps frame next to the other views
+	const std::vector<float> noise = Test::MakeNoise(FFT_SIZE);
+	Analyzer analyzer(FFT_SIZE);
+	SpectrogramView idle;
+	const double fftSeconds = Test::Time(
+	        [&]()
+	        {
+		        // The queue fills up and the view drops the columns, leaving only the transform
+		        analyzer.Process(noise.data(), idle);
+		        Test::Consume(noise[0]);
+	        });
+	Test::Report(std::format("{} point FFT, {:.2f}% of a 60 fps frame", FFT_SIZE, fftSeconds / FRAME_BUDGET * 100.0), fftSeconds, 1.0, "hop");
+
+	for (const SpectrogramView::Scale scale: { SpectrogramView::Scale::Log, SpectrogramView::Scale::Mel })
+	{
+		for (const int rows: { 128, 256, 512 })
+		{
+			SpectrogramView view(rows, scale);
+			SpectrogramImage image(512);
+			const double seconds = Test::Time(
+			        [&]()
+			        {
+				        analyzer.Process(noise.data(), view);
+				        image.Consume(view);
+				        Test::Consume(static_cast<float>(image.GetColumn(0)[0]));
+			        });
+			Test::Report(std::format("{} point FFT + {} {} rows, {:.2f}% of a 60 fps frame", FFT_SIZE, rows, scale == SpectrogramView::Scale::Log ? "log" : "mel",
+			                         seconds / FRAME_BUDGET * 100.0),
+			             seconds, 1.0, "hop");
+			CHECK_MESSAGE(seconds < FRAME_BUDGET, "a hop takes {:.2f} ms", seconds * 1e3);
+		}
+	}
+}
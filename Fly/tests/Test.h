@@ -0,0 +1,73 @@
+#pragma once
+
+#include <chrono>
+#include <filesystem>
+#include <format>
+#include <string>
+#include <vector>
+
+// Minimal test and benchmark registry for FlyTests. Cases register themselves at static
+// initialization, tests fail through CHECK and carry on so one run reports every failure,
+// benchmarks only run when asked for and print their throughput.
+namespace Test
+{
+	struct Case
+	{
+		const char* name;
+		void (*function)();
+		bool benchmark;
+	};
+
+	std::vector<Case>& GetRegistry();
+
+	struct Registrar
+	{
+		Registrar(const char* name, void (*function)(), bool benchmark)
+		{
+			GetRegistry().push_back({ name, function, benchmark });
+		}
+	};
+
+	void Fail(const char* file, int line, const std::string& message);
+
+	// Files given after --input on the command line, for cases that can also run on real material
+	const std::vector<std::filesystem::path>& GetInputFiles();
+
+	// Seconds per call of function, from as many calls as fit in minSeconds after a warm-up call
+	template<typename Function>
+	double Time(Function&& function, double minSeconds = 0.25)
+	{
+		function();
+
+		using Clock = std::chrono::steady_clock;
+		const Clock::time_point start = Clock::now();
+		std::size_t calls = 0;
+		double elapsed = 0.0;
+		do
+		{
+			function();
+			calls++;
+			elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+		} while (elapsed < minSeconds);
+		return elapsed / static_cast<double>(calls);
+	}
+
+	// One line per measurement, nanoseconds per item and items per second
+	void Report(const std::string& name, double secondsPerCall, double itemsPerCall, const char* unit);
+
+	// Keeps the optimizer from dropping a result nothing else reads
+	void Consume(float value);
+}
+
+#define TEST(name)                                                        \
+	static void name();                                                   \
+	static const Test::Registrar name##Registrar(#name, name, false); \
+	static void name()
+
+#define BENCHMARK(name)                                                  \
+	static void name();                                                  \
+	static const Test::Registrar name##Registrar(#name, name, true); \
+	static void name()
+
+#define CHECK(condition) ((condition) ? (void) 0 : Test::Fail(__FILE__, __LINE__, #condition))
+#define CHECK_MESSAGE(condition, ...) ((condition) ? (void) 0 : Test::Fail(__FILE__, __LINE__, std::format(__VA_ARGS__)))
@@ -0,0 +1,84 @@
+#include "pch.h"
+
+#include "Test.h"
+
+#include <atomic>
+
+// FlyTests [--bench] [filter] [--input file...]
+// Runs every test whose name contains filter, and the benchmarks as well with --bench. Everything
+// after --input is handed to the cases that read files.
+// Returns the number of failed checks, capped so the exit code stays meaningful.
+namespace
+{
+	int s_failures = 0;
+	std::atomic<float> s_sink{ 0.0f };
+	std::vector<std::filesystem::path> s_inputFiles;
+}
+
+std::vector<Test::Case>& Test::GetRegistry()
+{
+	static std::vector<Case> registry;
+	return registry;
+}
+
+void Test::Fail(const char* file, int line, const std::string& message)
+{
+	s_failures++;
+	std::cout << std::format("  FAILED {}({}): {}", std::filesystem::path(file).filename().string(), line, message) << std::endl;
+}
+
+const std::vector<std::filesystem::path>& Test::GetInputFiles()
+{
+	return s_inputFiles;
+}
+
+void Test::Report(const std::string& name, double secondsPerCall, double itemsPerCall, const char* unit)
+{
+	const double nanoseconds = secondsPerCall * 1e9 / itemsPerCall;
+	std::cout << std::format("  {:<48} {:>10.2f} ns/{:<8} {:>10.1f} M{}/s", name, nanoseconds, unit, itemsPerCall / secondsPerCall * 1e-6, unit) << std::endl;
+}
+
+void Test::Consume(float value)
+{
+	s_sink.store(value, std::memory_order_relaxed);
+}
+
+int main(int argc, char** argv)
+{
+	bool benchmarks = false;
+	std::string filter;
+	bool inputs = false;
+	for (int i = 1; i < argc; i++)
+	{
+		std::string argument = argv[i];
+		if (inputs)
+			s_inputFiles.push_back(argument);
+		else if (argument == "--bench")
+			benchmarks = true;
+		else if (argument == "--input")
+			inputs = true;
+		else
+			filter = argument;
+	}
+
+	int run = 0;
+	for (const Test::Case& testCase: Test::GetRegistry())
+	{
+		if (testCase.benchmark && !benchmarks)
+			continue;
+		if (!filter.empty() && std::string(testCase.name).find(filter) == std::string::npos)
+			continue;
+
+		const int failuresBefore = s_failures;
+		std::cout << (testCase.benchmark ? "[bench] " : "[test]  ") << testCase.name << std::endl;
+		testCase.function();
+		if (s_failures != failuresBefore)
+		{
+			std::cout << std::format("  {} failed checks", s_failures - failuresBefore) << std::endl;
+		}
+		run++;
+	}
+
+	std::cout << std::format("{} cases run, {} failed checks", run, s_failures) << std::endl;
+	return min(s_failures, 100);
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <random>
+#include <vector>
+
+// Stream layout and test signals shared by the cases. Signals are interleaved and repeatable, the
+// seed only picks a different noise where a case needs two that do not correlate
+namespace Test
+{
+	constexpr unsigned int CHANNELS = 2;
+	constexpr unsigned int SAMPLE_RATE = 48000;
+	constexpr std::size_t BLOCK_FRAMES = 4096; // Frames per Process call, a typical streamer buffer
+
+	// Uniform noise from -0.5 to 0.5, samples long whatever the channel count
+	inline std::vector<float> MakeNoise(std::size_t samples, unsigned int seed = 1)
+	{
+		std::mt19937 random(seed);
+		std::uniform_real_distribution<float> noise(-0.5f, 0.5f);
+		std::vector<float> values(samples);
+		for (float& value: values)
+		{
+			value = noise(random);
+		}
+		return values;
+	}
+
+	// The same sine on every channel
+	inline std::vector<float> MakeSine(double frequency, std::size_t frames, float amplitude = 0.5f, unsigned int channels = CHANNELS, unsigned int sampleRate = SAMPLE_RATE)
+	{
+		std::vector<float> samples(frames * channels);
+		for (std::size_t frame = 0; frame < frames; frame++)
+		{
+			const float value = static_cast<float>(amplitude * std::sin(2.0 * M_PI * frequency * static_cast<double>(frame) / sampleRate));
+			for (unsigned int channel = 0; channel < channels; channel++)
+			{
+				samples[frame * channels + channel] = value;
+			}
+		}
+		return samples;
+	}
+
+	// A unit impulse on the first channel followed by silence
+	inline std::vector<float> MakeImpulse(std::size_t frames, unsigned int channels = CHANNELS)
+	{
+		std::vector<float> samples(frames * channels, 0.0f);
+		samples[0] = 1.0f;
+		return samples;
+	}
+}
@@ -0,0 +1,108 @@
+#include "pch.h"
+
+#include "Test.h"
+#include "TestSignals.h"
+
+#include "dsp/TimeStretcher.h"
+
+// TimeStretcher on a sine: the output has to last input / speed and keep the sine's frequency, and
+// the positions it reports have to reach the end of the input. Timed at the speeds the UI offers
+namespace
+{
+	// Pushes in streamer sized blocks, pulling whatever is ready in between, then flushes and drains
+	std::vector<float> Stretch(TimeStretcher& stretcher, const std::vector<float>& input)
+	{
+		std::vector<float> output;
+		std::vector<float> block(Test::BLOCK_FRAMES * Test::CHANNELS);
+		auto pull = [&]()
+		{
+			while (stretcher.GetAvailable() > 0)
+			{
+				const std::size_t frames = stretcher.Pull(block.data(), Test::BLOCK_FRAMES);
+				output.insert(output.end(), block.begin(), block.begin() + static_cast<std::ptrdiff_t>(frames * Test::CHANNELS));
+			}
+		};
+
+		const std::size_t frames = input.size() / Test::CHANNELS;
+		for (std::size_t frame = 0; frame < frames; frame += Test::BLOCK_FRAMES)
+		{
+			stretcher.Push(input.data() + frame * Test::CHANNELS, min(Test::BLOCK_FRAMES, frames - frame));
+			pull();
+		}
+		stretcher.Flush();
+		pull();
+		return output;
+	}
+
+	// Upward zero crossings of the left channel over the middle half, away from the ramps at either end
+	double MeasureFrequency(const std::vector<float>& samples)
+	{
+		const std::size_t frames = samples.size() / Test::CHANNELS;
+		const std::size_t begin = frames / 4, end = frames * 3 / 4;
+		std::size_t first = 0, last = 0, crossings = 0;
+		for (std::size_t frame = begin + 1; frame < end; frame++)
+		{
+			if (samples[(frame - 1) * Test::CHANNELS] < 0.0f && samples[frame * Test::CHANNELS] >= 0.0f)
+			{
+				if (crossings == 0)
+					first = frame;
+				last = frame;
+				crossings++;
+			}
+		}
+		return crossings > 1 ? static_cast<double>(crossings - 1) * Test::SAMPLE_RATE / static_cast<double>(last - first) : 0.0;
+	}
+} // namespace
+
+TEST(TimeStretcherSine)
+{
+	constexpr double FREQUENCY = 441.0;
+	const std::vector<float> input = Test::MakeSine(FREQUENCY, 5 * Test::SAMPLE_RATE);
+	const std::size_t inputFrames = input.size() / Test::CHANNELS;
+
+	for (const float speed: { 0.5f, 0.8f, 1.0f, 1.5f, 2.0f })
+	{
+		TimeStretcher stretcher;
+		stretcher.Configure(Test::CHANNELS, Test::SAMPLE_RATE);
+		stretcher.SetSpeed(speed);
+		const std::vector<float> output = Stretch(stretcher, input);
+
+		// Within one 20 ms frame of the ideal length, and drained at the end of the input
+		const double expected = static_cast<double>(inputFrames) / speed;
+		const double outputFrames = static_cast<double>(output.size() / Test::CHANNELS);
+		CHECK_MESSAGE(std::abs(outputFrames - expected) <= 0.02 * Test::SAMPLE_RATE, "{} frames out at {}x, {:.0f} expected", outputFrames, speed, expected);
+		const double position = stretcher.GetOutputPosition();
+		CHECK_MESSAGE(std::abs(position - static_cast<double>(inputFrames)) <= 0.02 * Test::SAMPLE_RATE, "drained at position {:.0f} of {} at {}x", position, inputFrames, speed);
+		CHECK(stretcher.IsDrained());
+
+		const double frequency = MeasureFrequency(output);
+		CHECK_MESSAGE(std::abs(frequency / FREQUENCY - 1.0) < 0.01, "{:.1f} Hz out at {}x", frequency, speed);
+	}
+}
+
+BENCHMARK(TimeStretcherThroughput)
+{
+	// Ten seconds of a chord, per input frame. 1x is the straight copy, 2x reads the most input per frame
+	std::vector<float> input = Test::MakeSine(220.0, 10 * Test::SAMPLE_RATE);
+	const std::vector<float> fifth = Test::MakeSine(330.0, 10 * Test::SAMPLE_RATE);
+	for (std::size_t i = 0; i < input.size(); i++)
+	{
+		input[i] += fifth[i];
+	}
+
+	for (const float speed: { 0.5f, 1.0f, 1.5f, 2.0f })
+	{
+		TimeStretcher stretcher;
+		stretcher.Configure(Test::CHANNELS, Test::SAMPLE_RATE);
+		const double seconds = Test::Time(
+		        [&]()
+		        {
+			        stretcher.Reset();
+			        stretcher.SetSpeed(speed);
+			        const std::vector<float> output = Stretch(stretcher, input);
+			        Test::Consume(output.empty() ? 0.0f : output.back());
+		        },
+		        1.0);
+		Test::Report(std::format("Stretch {}x, {:.0f}x realtime", speed, 10.0 / seconds), seconds, static_cast<double>(input.size() / Test::CHANNELS), "frame");
+	}
+}